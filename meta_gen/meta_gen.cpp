@@ -1,18 +1,285 @@
+#include "clang/AST/RecordLayout.h"
 #include "clang/AST/RecursiveASTVisitor.h"
-#include "clang/ASTMatchers/ASTMatchFinder.h"
-#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Basic/Version.h"
 #include "clang/Frontend/ASTConsumers.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 using namespace clang;
 using namespace clang::tooling;
-using namespace clang::ast_matchers;
 using namespace llvm;
 
-constexpr const char *kID = "id";
 constexpr const char *kReflectAnnotation = "reflect";
+// part of every cache key, change it whenever the generated code changes
+constexpr const char *kGeneratorVersion = "meta_gen 9";
+
+static llvm::cl::OptionCategory optionCategory("ast options");
+
+static llvm::cl::opt<bool> layoutReport(
+    "layout-report",
+    llvm::cl::desc("Write padding holes, cache line spans and a smaller field "
+                   "order of every reflected type to <file>_layout.txt"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<unsigned>
+    cacheLineSize("cache-line-size",
+                  llvm::cl::desc("Cache line size used by the layout report"),
+                  llvm::cl::init(64), llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<bool> emitPadded(
+    "emit-padded",
+    llvm::cl::desc("Generate PaddedStorage<T>, a variant of every type with "
+                   "thread_owned fields that puts each owner on its own cache "
+                   "line"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<bool> emitCpp(
+    "emit-cpp",
+    llvm::cl::desc("Define the reflection of types declared in headers in "
+                   "<file>_gen_refl.cpp, the generated header only declares "
+                   "it; pointer, array and reference types of all files are "
+                   "defined once, in the -types-file"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> typesFile(
+    "types-file",
+    llvm::cl::desc("Source file that defines the pointer, array and "
+                   "reference types used by all files with -emit-cpp"),
+    llvm::cl::init("reflection_types_gen_refl.cpp"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> cacheFile(
+    "cache",
+    llvm::cl::desc("Incremental generation cache, files whose inputs did not "
+                   "change are not parsed again (empty: no cache)"),
+    llvm::cl::init(".meta_gen_cache"), llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<unsigned>
+    jobs("j",
+         llvm::cl::desc("Number of files parsed in parallel (0: one per core)"),
+         llvm::cl::init(0), llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> prefixHeader(
+    "prefix-header",
+    llvm::cl::desc("Header every source file includes first, precompiled once "
+                   "per set of compile flags and reused across files and "
+                   "runs; it must not declare reflected types"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<bool>
+    watch("watch",
+          llvm::cl::desc("Keep running after the first generation and "
+                         "regenerate whenever a file the generated files "
+                         "depend on changes (Linux only)"),
+          llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> watchSocket(
+    "watch-socket",
+    llvm::cl::desc("Unix socket of the watch mode, answers 'status', 'wait' "
+                   "and 'stop'"),
+    llvm::cl::init(".meta_gen.sock"), llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<bool>
+    timing("timing",
+           llvm::cl::desc("Print the time spent in each generation phase"),
+           llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> timeTrace(
+    "time-trace",
+    llvm::cl::desc("Write a Chrome trace (chrome://tracing, Perfetto) of the "
+                   "phases of every file and record and the generation "
+                   "counters to the given file, rewritten after every run "
+                   "in -watch mode"),
+    llvm::cl::cat(optionCategory));
+
+static llvm::cl::opt<std::string> costReport(
+    "cost-report",
+    llvm::cl::desc("Write the estimated compile cost of every generated file "
+                   "and of the records in it to the given file"),
+    llvm::cl::cat(optionCategory));
+
+// warnings of the translation unit a worker is generating, printed in input
+// order once every file is done so that parallel runs report like serial ones
+static thread_local raw_ostream *warningStream = nullptr;
+
+static raw_ostream &Warnings() {
+  return warningStream != nullptr ? *warningStream : llvm::errs();
+}
+
+using Clock = std::chrono::steady_clock;
+
+// -time-trace. Every thread records its spans into one list, written as
+// complete events of a Chrome trace; the counters of a run are counter events
+// at its end. A daemon rewrites the file after every run and starts the next
+// one from an empty recorder, so the file holds the last run only.
+struct TraceEvent {
+  std::string name;
+  std::string detail;
+  uint64_t thread;
+  Clock::time_point start;
+  Clock::time_point end;
+};
+
+struct TraceCounter {
+  std::string name;
+  Clock::time_point time;
+  uint64_t value;
+};
+
+class TraceRecorder {
+public:
+  void AddEvent(TraceEvent event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(event));
+  }
+
+  void AddCounter(TraceCounter counter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.push_back(std::move(counter));
+  }
+
+  // drops the events and counters written so far, timestamps restart at zero
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+    counters.clear();
+    start = Clock::now();
+  }
+
+  void Write(StringRef fileName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code error;
+    llvm::raw_fd_ostream os(fileName, error);
+    if (error) {
+      llvm::errs() << "error: cannot write " << fileName << ": "
+                   << error.message() << "\n";
+      return;
+    }
+
+    auto microseconds = [this](Clock::time_point time) -> int64_t {
+      return std::chrono::duration_cast<std::chrono::microseconds>(time -
+                                                                   start)
+          .count();
+    };
+
+    json::OStream json(os);
+    json.object([&] {
+      json.attributeArray("traceEvents", [&] {
+        for (auto const &event : events) {
+          json.object([&] {
+            json.attribute("pid", 1);
+            json.attribute("tid", static_cast<int64_t>(event.thread));
+            json.attribute("ph", "X");
+            json.attribute("ts", microseconds(event.start));
+            json.attribute("dur", microseconds(event.end) -
+                                      microseconds(event.start));
+            json.attribute("name", event.name);
+            if (!event.detail.empty()) {
+              json.attributeObject(
+                  "args", [&] { json.attribute("detail", event.detail); });
+            }
+          });
+        }
+        for (auto const &counter : counters) {
+          json.object([&] {
+            json.attribute("pid", 1);
+            json.attribute("tid", 0);
+            json.attribute("ph", "C");
+            json.attribute("ts", microseconds(counter.time));
+            json.attribute("name", counter.name);
+            json.attributeObject("args", [&] {
+              json.attribute(counter.name, static_cast<int64_t>(counter.value));
+            });
+          });
+        }
+        json.object([&] {
+          json.attribute("pid", 1);
+          json.attribute("tid", 0);
+          json.attribute("ph", "M");
+          json.attribute("name", "process_name");
+          json.attributeObject("args",
+                               [&] { json.attribute("name", "meta_gen"); });
+        });
+      });
+      json.attribute("displayTimeUnit", "ms");
+    });
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  std::vector<TraceCounter> counters;
+  Clock::time_point start = Clock::now();
+};
+
+// set by main with -time-trace, before any worker starts
+static TraceRecorder *traceRecorder = nullptr;
+
+static void AddTraceEvent(StringRef name, StringRef detail,
+                          Clock::time_point start, Clock::time_point end) {
+  if (traceRecorder != nullptr) {
+    traceRecorder->AddEvent(
+        TraceEvent{name.str(), detail.str(), get_threadid(), start, end});
+  }
+}
+
+// a span of the calling thread from here to the end of the scope
+class TraceScope {
+public:
+  explicit TraceScope(StringRef _name, StringRef _detail = StringRef()) {
+    if (traceRecorder != nullptr) {
+      name = _name.str();
+      detail = _detail.str();
+      start = Clock::now();
+    }
+  }
+
+  ~TraceScope() { AddTraceEvent(name, detail, start, Clock::now()); }
+
+private:
+  std::string name;
+  std::string detail;
+  Clock::time_point start;
+};
 
 static bool IsPredefinedType(QualType const &qualType) {
   auto type = qualType.split().Ty;
@@ -20,14 +287,44 @@ static bool IsPredefinedType(QualType const &qualType) {
          type->isPointerType();
 }
 
+// names as they are spelled in the generated C++ code, "bool" rather than
+// "_Bool"
+static PrintingPolicy GetPrintingPolicy() {
+  LangOptions langOptions;
+  langOptions.CPlusPlus = true;
+  langOptions.Bool = true;
+  PrintingPolicy policy(langOptions);
+  policy.SuppressTagKeyword = true;
+  return policy;
+}
+
+// Foo, or Vec<float, 4> for an instantiation of a class template
+static std::string GetRecordName(RecordDecl const *decl) {
+  std::string name;
+  raw_string_ostream os(name);
+  decl->getNameForDiagnostic(os, GetPrintingPolicy(), true);
+  return os.str();
+}
+
+// a type name passed to offsetof, whose commas would split the macro argument
+static std::string GetMacroArgument(StringRef name) {
+  std::string argument;
+  for (char c : name) {
+    if (c == ',') {
+      argument += " REFL_COMMA";
+    } else {
+      argument += c;
+    }
+  }
+  return argument;
+}
+
 static std::string GetQualTypeQualifiedName(QualType const &qualType) {
   auto type = qualType.split().Ty;
   if (type->isBuiltinType()) {
-    return type->getAs<BuiltinType>()
-        ->getName(PrintingPolicy(LangOptions()))
-        .str();
+    return type->getAs<BuiltinType>()->getName(GetPrintingPolicy()).str();
   } else if (type->isRecordType()) {
-    return type->getAs<RecordType>()->getDecl()->getQualifiedNameAsString();
+    return GetRecordName(type->getAs<RecordType>()->getDecl());
   } else if (type->isConstantArrayType()) {
     // todo: how to handle non-constant array?
     ConstantArrayType const *arrayType =
@@ -35,11 +332,8 @@ static std::string GetQualTypeQualifiedName(QualType const &qualType) {
     auto size = arrayType->getSize();
     SmallString<255> S;
     size.toString(S, 10, true, false);
-    return (arrayType->getElementType()
-                ->getAsTagDecl()
-                ->getQualifiedNameAsString() +
-            "[" + S + "]")
-        .str();
+    return GetQualTypeQualifiedName(arrayType->getElementType()) + "[" +
+           S.str().str() + "]";
   } else if (type->isVoidType()) {
     return "void";
   } else if (type->isVoidPointerType()) {
@@ -305,11 +599,676 @@ static raw_ostream &PrintLinkage(raw_ostream &os,
   return os;
 }
 
+// FIELD(encoding=varint) ends up as annotate("reflectencoding=varint")
+static StringRef GetReflectAnnotation(Decl const *decl) {
+  for (auto const *attr : decl->specific_attrs<AnnotateAttr>()) {
+    StringRef annotation = attr->getAnnotation();
+    if (annotation.startswith(kReflectAnnotation)) {
+      return annotation.drop_front(StringRef(kReflectAnnotation).size());
+    }
+  }
+  return StringRef();
+}
+
+static bool IsReflected(Decl const *decl) {
+  for (auto const *attr : decl->specific_attrs<AnnotateAttr>()) {
+    if (attr->getAnnotation().startswith(kReflectAnnotation)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Annotation options. The macros stringify their arguments, so
+// FIELD(hot, name="x, y", range=0..100) becomes the annotation
+// reflecthot, name="x, y", range=0..100: a comma separated list of keys,
+// each optionally followed by = and a value. A quoted value may contain
+// commas and the escapes \" and \\, any other value runs up to the next comma.
+struct AnnotationOption {
+  std::string key;
+  std::string value;
+  bool hasValue;
+};
+
+// parses as many options as are well-formed; returns false and describes the
+// first error otherwise
+static bool ParseAnnotationOptions(StringRef text,
+                                   std::vector<AnnotationOption> &options,
+                                   std::string &error) {
+  size_t i = 0;
+  auto skipSpace = [&]() {
+    while (i < text.size() && isSpace(text[i])) {
+      i++;
+    }
+  };
+
+  skipSpace();
+  if (i == text.size()) {
+    return true;
+  }
+
+  while (true) {
+    AnnotationOption option;
+    option.hasValue = false;
+
+    size_t keyStart = i;
+    while (i < text.size() && (isAlnum(text[i]) || text[i] == '_')) {
+      i++;
+    }
+    if (i == keyStart || isDigit(text[keyStart])) {
+      error = keyStart == text.size()
+                  ? "expected an option name at the end"
+                  : "expected an option name at '" +
+                        text.drop_front(keyStart).str() + "'";
+      return false;
+    }
+    option.key = text.slice(keyStart, i).str();
+
+    skipSpace();
+    if (i < text.size() && text[i] == '=') {
+      i++;
+      skipSpace();
+      option.hasValue = true;
+      if (i < text.size() && text[i] == '"') {
+        i++;
+        while (i < text.size() && text[i] != '"') {
+          if (text[i] == '\\' && i + 1 < text.size()) {
+            i++;
+          }
+          option.value += text[i++];
+        }
+        if (i == text.size()) {
+          error = "unterminated string in option '" + option.key + "'";
+          return false;
+        }
+        i++;
+      } else {
+        size_t valueStart = i;
+        while (i < text.size() && text[i] != ',') {
+          i++;
+        }
+        option.value = text.slice(valueStart, i).rtrim().str();
+        if (option.value.empty()) {
+          error = "missing value of option '" + option.key + "'";
+          return false;
+        }
+      }
+    }
+    options.push_back(std::move(option));
+
+    skipSpace();
+    if (i == text.size()) {
+      return true;
+    }
+    if (text[i] != ',') {
+      error = "expected ',' after option '" + options.back().key + "'";
+      return false;
+    }
+    i++;
+    skipSpace();
+  }
+}
+
+static std::vector<AnnotationOption> GetAnnotationOptions(Decl const *decl) {
+  std::vector<AnnotationOption> options;
+  std::string error;
+  ParseAnnotationOptions(GetReflectAnnotation(decl), options, error);
+  return options;
+}
+
+// the value of FIELD(key=value), empty when the option is not given
+static std::string GetAnnotationOption(Decl const *decl, StringRef key) {
+  for (auto const &option : GetAnnotationOptions(decl)) {
+    if (option.hasValue && option.key == key) {
+      return option.value;
+    }
+  }
+  return std::string();
+}
+
+// options with a bit in AnnotationFlags
+enum class OptionValue { kNone, kOptional, kRequired };
+
+struct KnownOption {
+  char const *key;
+  char const *flag;
+  OptionValue value;
+};
+
+static KnownOption const kKnownOptions[] = {
+    {"transient", "AnnotationFlags::kTransient", OptionValue::kNone},
+    {"hot", "AnnotationFlags::kHot", OptionValue::kNone},
+    {"cold", "AnnotationFlags::kCold", OptionValue::kNone},
+    {"thread_owned", "AnnotationFlags::kThreadOwned", OptionValue::kOptional},
+    {"encoding", "AnnotationFlags::kEncoding", OptionValue::kRequired},
+    {"memory_order", "AnnotationFlags::kMemoryOrder", OptionValue::kRequired},
+    {"name", "AnnotationFlags::kName", OptionValue::kRequired},
+    {"range", "AnnotationFlags::kRange", OptionValue::kRequired},
+    {"instantiations", "AnnotationFlags::kInstantiations",
+     OptionValue::kRequired},
+};
+
+static KnownOption const *FindKnownOption(StringRef key) {
+  for (auto const &option : kKnownOptions) {
+    if (key == option.key) {
+      return &option;
+    }
+  }
+  return nullptr;
+}
+
+// warns about malformed annotations, repeated options and known options with
+// a missing or unexpected value; called once per reflected declaration
+static void CheckAnnotation(NamedDecl const *decl) {
+  std::vector<AnnotationOption> options;
+  std::string error;
+  if (!ParseAnnotationOptions(GetReflectAnnotation(decl), options, error)) {
+    Warnings() << "warning: " << error << " in the annotation of "
+               << decl->getQualifiedNameAsString() << "\n";
+  }
+
+  StringSet<> keys;
+  for (auto const &option : options) {
+    if (!keys.insert(option.key).second) {
+      Warnings() << "warning: option '" << option.key << "' is given twice on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    }
+    auto const *known = FindKnownOption(option.key);
+    if (known == nullptr) {
+      continue;
+    }
+    if (known->value == OptionValue::kNone && option.hasValue) {
+      Warnings() << "warning: option '" << option.key
+                 << "' does not take a value on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    } else if (known->value == OptionValue::kRequired && !option.hasValue) {
+      Warnings() << "warning: option '" << option.key << "' needs a value on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    }
+  }
+}
+
+// AnnotationFlags::kHot | AnnotationFlags::kName, empty without known options
+static std::string GetAnnotationFlags(Decl const *decl) {
+  std::string flags;
+  for (auto const &option : GetAnnotationOptions(decl)) {
+    auto const *known = FindKnownOption(option.key);
+    if (known != nullptr && flags.find(known->flag) == std::string::npos) {
+      flags += (flags.empty() ? "" : " | ") + std::string(known->flag);
+    }
+  }
+  return flags;
+}
+
+// STRUCT(Vec, instantiations=explicit) limits an annotated class template to
+// the instantiations named by template struct Vec<float, 4>; by default every
+// instantiation the translation unit completes is reflected
+static bool IsExplicitInstantiationsOnly(ClassTemplateDecl const *decl) {
+  return GetAnnotationOption(decl->getTemplatedDecl(), "instantiations") ==
+         "explicit";
+}
+
+static bool
+IsReflectedInstantiation(ClassTemplateSpecializationDecl const *decl) {
+  auto kind = decl->getSpecializationKind();
+  if (kind == TSK_Undeclared || kind == TSK_ExplicitSpecialization ||
+      decl->isDependentContext() ||
+      decl->getDefinition() == nullptr ||
+      !IsReflected(decl->getDefinition())) {
+    return false;
+  }
+  return !IsExplicitInstantiationsOnly(decl->getSpecializedTemplate()) ||
+         kind == TSK_ExplicitInstantiationDefinition ||
+         kind == TSK_ExplicitInstantiationDeclaration;
+}
+
+static raw_ostream &PrintEncoding(raw_ostream &os, NamedDecl const *decl) {
+  auto encoding = GetAnnotationOption(decl, "encoding");
+  if (encoding == "fixed") {
+    os << "Encoding::kFixed";
+  } else if (encoding == "varint") {
+    os << "Encoding::kVarint";
+  } else if (encoding == "delta") {
+    os << "Encoding::kDelta";
+  } else {
+    if (!encoding.empty()) {
+      Warnings() << "warning: unknown encoding '" << encoding << "' on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    }
+    os << "Encoding::kDefault";
+  }
+  return os;
+}
+
+static bool HasEncoding(Decl const *decl) {
+  return !GetAnnotationOption(decl, "encoding").empty();
+}
+
+// FIELD(hot) or FIELD(cold), options without a value
+static bool HasAnnotationFlag(Decl const *decl, StringRef flag) {
+  for (auto const &option : GetAnnotationOptions(decl)) {
+    if (!option.hasValue && option.key == flag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// FIELD(memory_order=acquire), used by the atomic accessors of Field
+static raw_ostream &PrintMemoryOrder(raw_ostream &os, NamedDecl const *decl) {
+  auto order = GetAnnotationOption(decl, "memory_order");
+  if (order == "relaxed") {
+    os << "MemoryOrder::kRelaxed";
+  } else if (order == "consume") {
+    os << "MemoryOrder::kConsume";
+  } else if (order == "acquire") {
+    os << "MemoryOrder::kAcquire";
+  } else if (order == "release") {
+    os << "MemoryOrder::kRelease";
+  } else if (order == "acq_rel") {
+    os << "MemoryOrder::kAcqRel";
+  } else {
+    if (!order.empty() && order != "seq_cst") {
+      Warnings() << "warning: unknown memory order '" << order << "' on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    }
+    os << "MemoryOrder::kSeqCst";
+  }
+  return os;
+}
+
+static bool HasMemoryOrder(Decl const *decl) {
+  return !GetAnnotationOption(decl, "memory_order").empty();
+}
+
+// FIELD(thread_owned) gives the field an owner of its own,
+// FIELD(thread_owned=render) groups the fields written by the same thread;
+// returns an empty string for shared fields
+static std::string GetThreadOwner(NamedDecl const *decl) {
+  if (HasAnnotationFlag(decl, "thread_owned")) {
+    return decl->getNameAsString();
+  }
+  return GetAnnotationOption(decl, "thread_owned");
+}
+
 static void PrintIndent(raw_ostream &os, int count) {
   for (int i = 0; i < count; ++i)
     os << "\t";
 }
 
+// static Attribute const field_0_attributeList[] = { { "name", "x" } };
+// static AttributeTable const field_0_attributes = { field_0_attributeList, 1 };
+// lists the options with a value and the unknown ones, the known options
+// without a value are only flags; returns the constructor argument
+static std::string PrintAttributeTable(raw_ostream &os, int indent,
+                                       Decl const *decl, StringRef prefix) {
+  std::vector<AnnotationOption> attributes;
+  for (auto &option : GetAnnotationOptions(decl)) {
+    if (option.hasValue || FindKnownOption(option.key) == nullptr) {
+      attributes.push_back(std::move(option));
+    }
+  }
+  if (attributes.empty()) {
+    return "nullptr";
+  }
+
+  PrintIndent(os, indent);
+  os << "static Attribute const " << prefix << "_attributeList[] = {";
+  for (size_t i = 0; i < attributes.size(); ++i) {
+    os << (i > 0 ? ", " : " ") << "{ \"" << attributes[i].key << "\", \"";
+    os.write_escaped(attributes[i].value);
+    os << "\" }";
+  }
+  os << " };\n";
+  PrintIndent(os, indent);
+  os << "static AttributeTable const " << prefix << "_attributes = { " << prefix
+     << "_attributeList, " << attributes.size() << " };\n";
+  return "&" + prefix.str() + "_attributes";
+}
+
+// trailing AnnotationFlags and AttributeTable constructor arguments
+static void PrintAnnotations(raw_ostream &os, std::string const &flags,
+                             std::string const &attributes) {
+  os << ", " << (flags.empty() ? "AnnotationFlags::kNone" : flags) << ", "
+     << attributes;
+}
+
+// trailing Field constructor arguments: Encoding, indirection, MemoryOrder,
+// AnnotationFlags and AttributeTable, printed only as far as they differ from
+// the defaults
+static void PrintFieldOptions(raw_ostream &os, NamedDecl const *decl,
+                              std::string const &indirection,
+                              std::string const &attributes) {
+  auto flags = GetAnnotationFlags(decl);
+  bool hasAnnotations = !flags.empty() || attributes != "nullptr";
+  bool hasMemoryOrder = HasMemoryOrder(decl) || hasAnnotations;
+  bool hasIndirection = !indirection.empty() || hasMemoryOrder;
+  if (HasEncoding(decl) || hasIndirection) {
+    os << ", ";
+    PrintEncoding(os, decl);
+  }
+  if (hasIndirection) {
+    os << ", " << (indirection.empty() ? "kNoIndirection" : indirection);
+  }
+  if (hasMemoryOrder) {
+    os << ", ";
+    PrintMemoryOrder(os, decl);
+  }
+  if (hasAnnotations) {
+    PrintAnnotations(os, flags, attributes);
+  }
+}
+
+// Layout analysis. Holes are found by marking every byte that a scalar, a
+// vtable pointer or a bit-field occupies, recursing through bases, nested
+// records and arrays, so reused tail padding and unions are handled.
+
+struct PaddingRange {
+  uint64_t offset;
+  uint64_t size;
+};
+
+static bool HasLayout(RecordDecl const *decl) {
+  return decl->getDefinition() && !decl->isInvalidDecl() &&
+         !decl->isDependentType();
+}
+
+static void MarkCovered(ASTContext const &context, QualType type,
+                        uint64_t offset, BitVector &covered);
+
+static void MarkRecordCovered(ASTContext const &context,
+                              RecordDecl const *decl, uint64_t offset,
+                              bool completeObject, BitVector &covered) {
+  auto const &layout = context.getASTRecordLayout(decl);
+
+  if (auto const *cxxDecl = dyn_cast<CXXRecordDecl>(decl)) {
+    uint64_t pointerSize = context.getTargetInfo().getPointerWidth(0) / 8;
+    if (layout.hasOwnVFPtr()) {
+      covered.set(offset, offset + pointerSize);
+    }
+    if (layout.hasOwnVBPtr()) {
+      uint64_t vbptr = offset + layout.getVBPtrOffset().getQuantity();
+      covered.set(vbptr, vbptr + pointerSize);
+    }
+
+    for (auto const &base : cxxDecl->bases()) {
+      auto const *baseDecl = base.getType()->getAsCXXRecordDecl();
+      if (!base.isVirtual() && baseDecl) {
+        MarkRecordCovered(context, baseDecl,
+                          offset +
+                              layout.getBaseClassOffset(baseDecl).getQuantity(),
+                          false, covered);
+      }
+    }
+
+    // virtual bases are placed by the most derived object only
+    if (completeObject) {
+      for (auto const &base : cxxDecl->vbases()) {
+        auto const *baseDecl = base.getType()->getAsCXXRecordDecl();
+        if (baseDecl) {
+          MarkRecordCovered(
+              context, baseDecl,
+              offset + layout.getVBaseClassOffset(baseDecl).getQuantity(),
+              false, covered);
+        }
+      }
+    }
+  }
+
+  for (auto const *field : decl->fields()) {
+    uint64_t bits = layout.getFieldOffset(field->getFieldIndex());
+    if (field->isBitField()) {
+      uint64_t width = field->getBitWidthValue(context);
+      if (width > 0) {
+        covered.set(offset + bits / 8, offset + (bits + width + 7) / 8);
+      }
+    } else if (!field->isZeroSize(context)) {
+      MarkCovered(context, field->getType(), offset + bits / 8, covered);
+    }
+  }
+}
+
+static void MarkCovered(ASTContext const &context, QualType type,
+                        uint64_t offset, BitVector &covered) {
+  type = type.getCanonicalType();
+  if (auto const *arrayType = context.getAsConstantArrayType(type)) {
+    QualType elementType = arrayType->getElementType();
+    uint64_t elementSize =
+        context.getTypeSizeInChars(elementType).getQuantity();
+    uint64_t length = arrayType->getSize().getZExtValue();
+    for (uint64_t i = 0; i < length; ++i) {
+      MarkCovered(context, elementType, offset + i * elementSize, covered);
+    }
+    return;
+  }
+
+  if (auto const *recordType = type->getAs<RecordType>()) {
+    MarkRecordCovered(context, recordType->getDecl()->getDefinition(), offset,
+                      true, covered);
+    return;
+  }
+
+  uint64_t size = context.getTypeSizeInChars(type).getQuantity();
+  covered.set(offset, offset + size);
+}
+
+static std::vector<PaddingRange> GetPaddingHoles(ASTContext const &context,
+                                                 RecordDecl const *decl) {
+  std::vector<PaddingRange> holes;
+  auto const *cxxDecl = dyn_cast<CXXRecordDecl>(decl);
+  if (cxxDecl && cxxDecl->isEmpty()) {
+    return holes;
+  }
+
+  unsigned size = context.getASTRecordLayout(decl).getSize().getQuantity();
+  BitVector covered(size);
+  MarkRecordCovered(context, decl, 0, true, covered);
+
+  int begin = covered.find_first_unset();
+  while (begin != -1) {
+    int end = covered.find_next(begin);
+    if (end == -1) {
+      end = size;
+    }
+    holes.push_back({static_cast<uint64_t>(begin),
+                     static_cast<uint64_t>(end - begin)});
+    begin = static_cast<unsigned>(end) < size ? covered.find_next_unset(end)
+                                              : -1;
+  }
+  return holes;
+}
+
+static uint64_t GetFieldSize(ASTContext const &context, FieldDecl const *field,
+                             uint64_t bits) {
+  if (field->isBitField()) {
+    return (bits % 8 + field->getBitWidthValue(context) + 7) / 8;
+  }
+  return context.getTypeSizeInChars(field->getType()).getQuantity();
+}
+
+static void PrintLayoutReport(raw_ostream &os, ASTContext const &context,
+                              RecordDecl const *decl) {
+  auto const &layout = context.getASTRecordLayout(decl);
+  uint64_t size = layout.getSize().getQuantity();
+  uint64_t alignment = layout.getAlignment().getQuantity();
+  auto holes = GetPaddingHoles(context, decl);
+
+  uint64_t wasted = 0;
+  for (auto const &hole : holes) {
+    wasted += hole.size;
+  }
+
+  os << decl->getQualifiedNameAsString() << ": size " << size << ", align "
+     << alignment << ", " << wasted << " bytes of padding in " << holes.size()
+     << " holes\n";
+
+  bool hasBitFields = false;
+  for (auto const *field : decl->fields()) {
+    uint64_t bits = layout.getFieldOffset(field->getFieldIndex());
+    uint64_t begin = bits / 8;
+    uint64_t fieldSize = GetFieldSize(context, field, bits);
+    hasBitFields |= field->isBitField();
+
+    os << "  [" << begin << ", " << begin + fieldSize << ") "
+       << field->getNameAsString() << ": " << field->getType().getAsString();
+    if (field->isBitField()) {
+      os << " : " << field->getBitWidthValue(context);
+    }
+    if (fieldSize > 0 &&
+        begin / cacheLineSize != (begin + fieldSize - 1) / cacheLineSize) {
+      os << " (straddles a " << cacheLineSize << " byte cache line)";
+    }
+    os << "\n";
+  }
+
+  for (auto const &hole : holes) {
+    os << "  hole [" << hole.offset << ", " << hole.offset + hole.size << ") "
+       << hole.size << " bytes\n";
+  }
+
+  // largest alignment first, then largest size, keeps every field aligned
+  // without inner holes; bases and the vtable pointer stay in front
+  if (hasBitFields || decl->isUnion() || decl->field_empty()) {
+    os << "\n";
+    return;
+  }
+
+  struct Slot {
+    FieldDecl const *field;
+    uint64_t size;
+    uint64_t alignment;
+  };
+
+  std::vector<Slot> slots;
+  uint64_t start = size;
+  for (auto const *field : decl->fields()) {
+    uint64_t bits = layout.getFieldOffset(field->getFieldIndex());
+    start = std::min(start, bits / 8);
+    slots.push_back(
+        {field, GetFieldSize(context, field, bits),
+         static_cast<uint64_t>(
+             context.getTypeAlignInChars(field->getType()).getQuantity())});
+  }
+
+  std::stable_sort(slots.begin(), slots.end(),
+                   [](Slot const &a, Slot const &b) {
+                     return a.alignment != b.alignment
+                                ? a.alignment > b.alignment
+                                : a.size > b.size;
+                   });
+
+  uint64_t offset = start;
+  for (auto const &slot : slots) {
+    offset = alignTo(offset, slot.alignment) + slot.size;
+  }
+  offset = alignTo(offset, alignment);
+
+  if (offset < size) {
+    os << "  reordered size " << offset << " saves " << size - offset
+       << " bytes:";
+    for (auto const &slot : slots) {
+      os << " " << slot.field->getNameAsString();
+    }
+    os << "\n";
+  }
+  os << "\n";
+}
+
+// every non-static data member is reflected, also in the records nested by
+// value, and nothing else takes bytes of the object: no bases, no vtable
+// pointer, no bit-fields, no references, no anonymous members
+static bool HasCompleteFields(ASTContext const &context,
+                              RecordDecl const *decl) {
+  auto const *cxxDecl = dyn_cast<CXXRecordDecl>(decl);
+  if (cxxDecl == nullptr || decl->isUnion() || cxxDecl->getNumBases() > 0 ||
+      cxxDecl->getNumVBases() > 0 || cxxDecl->isDynamicClass()) {
+    return false;
+  }
+
+  for (auto const *field : decl->fields()) {
+    if (!IsReflected(field) || field->isBitField() ||
+        field->isAnonymousStructOrUnion() ||
+        field->getType()->isReferenceType()) {
+      return false;
+    }
+    auto const *record =
+        context.getBaseElementType(field->getType())->getAsRecordDecl();
+    if (record != nullptr && !HasCompleteFields(context, record)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout, empty when
+// no trait holds
+static std::string GetTypeTraits(ASTContext const &context,
+                                 RecordDecl const *decl) {
+  auto const *cxxDecl = dyn_cast<CXXRecordDecl>(decl);
+  QualType recordType = context.getRecordType(decl);
+  std::string traits;
+  auto add = [&traits](StringRef trait) {
+    traits += (traits.empty() ? "" : " | ") + ("TypeTraits::" + trait).str();
+  };
+
+  if (recordType.isTriviallyCopyableType(context)) {
+    add("kTriviallyCopyable");
+  }
+  if (cxxDecl != nullptr && cxxDecl->isStandardLayout()) {
+    add("kStandardLayout");
+  }
+  if (context.hasUniqueObjectRepresentations(recordType)) {
+    add("kUniqueRepresentations");
+  }
+  if (HasCompleteFields(context, decl)) {
+    add("kFieldsComplete");
+  }
+  return traits;
+}
+
+// static_assert(sizeof(Foo) == 8, "...");
+static void PrintLayoutAsserts(raw_ostream &os, int indent,
+                               ASTContext const &context,
+                               RecordDecl const *decl, SmallString<64> &type,
+                               std::vector<FieldDecl const *> const &fields) {
+  auto const &layout = context.getASTRecordLayout(decl);
+  std::string message =
+      "\"layout of " + type.str().str() + " changed, regenerate reflection\"";
+
+  PrintIndent(os, indent);
+  os << "static_assert(sizeof(" << type
+     << ") == " << layout.getSize().getQuantity() << ", " << message
+     << ");\n";
+  PrintIndent(os, indent);
+  os << "static_assert(alignof(" << type
+     << ") == " << layout.getAlignment().getQuantity() << ", " << message
+     << ");\n";
+
+  // the fast paths of object_ops.hpp rely on the recorded traits
+  auto const *cxxDecl = dyn_cast<CXXRecordDecl>(decl);
+  if (context.getRecordType(decl).isTriviallyCopyableType(context)) {
+    PrintIndent(os, indent);
+    os << "static_assert(std::is_trivially_copyable<" << type
+       << ">::value, " << message << ");\n";
+  }
+  if (cxxDecl != nullptr && cxxDecl->isStandardLayout()) {
+    PrintIndent(os, indent);
+    os << "static_assert(std::is_standard_layout<" << type << ">::value, "
+       << message << ");\n";
+  }
+
+  for (auto const *field : fields) {
+    if (field->isBitField()) {
+      continue;
+    }
+    PrintIndent(os, indent);
+    os << "static_assert(offsetof(" << GetMacroArgument(type) << ", "
+       << GetMacroArgument(field->getQualifiedNameAsString()) << ") == " << layout.getFieldOffset(field->getFieldIndex()) / 8 << ", "
+       << message << ");\n";
+  }
+  os << "\n";
+}
+
 static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
                        FieldDecl const *decl, int index) {
   // static Type field_0_Type = *GetType<Bar>();
@@ -318,6 +1277,9 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
      << "field_" << index << "_Type"
      << " = *GetType<" << GetQualTypeQualifiedName(decl->getType()) << ">();\n";
 
+  auto attributes = PrintAttributeTable(
+      os, indent, decl, "field_" + std::to_string(index));
+
   PrintIndent(os, indent);
   // typeStorage.fields[0] = Reflection::Field(
   os << "typeStorage.fields[" << index << "] = Reflection::Field(";
@@ -328,7 +1290,8 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
   os << "&field_" << index << "_Type";
   os << ", ";
   // offset
-  os << "offsetof(" << type << ", " << decl->getQualifiedNameAsString() << ")";
+  os << "offsetof(" << GetMacroArgument(type) << ", "
+     << GetMacroArgument(decl->getQualifiedNameAsString()) << ")";
   os << ", ";
   // CVRQualifier
   PrintCVRQualifier(os, decl);
@@ -344,6 +1307,8 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
   os << ", ";
   // AccessSpecifier
   PrintAccessSpecifier(os, decl);
+  // Encoding, indirection, MemoryOrder, AnnotationFlags, AttributeTable
+  PrintFieldOptions(os, decl, std::string(), attributes);
   os << ");\n";
 }
 
@@ -355,6 +1320,9 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
      << "field_" << index << "_Type"
      << " = *GetType<" << GetQualTypeQualifiedName(decl->getType()) << ">();\n";
 
+  auto attributes = PrintAttributeTable(
+      os, indent, decl, "field_" + std::to_string(index));
+
   PrintIndent(os, indent);
 
   // typeStorage.fields[0] = Reflection::Field(
@@ -370,8 +1338,8 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
 
   // offset
   if (!decl->isStaticDataMember()) {
-    os << "offsetof(" << type << ", " << decl->getQualifiedNameAsString()
-       << ")";
+    os << "offsetof(" << GetMacroArgument(type) << ", "
+       << GetMacroArgument(decl->getQualifiedNameAsString()) << ")";
   } else {
     os << "0";
   }
@@ -396,6 +1364,9 @@ static void PrintField(raw_ostream &os, int indent, SmallString<64> &type,
   // AccessSpecifier
   PrintAccessSpecifier(os, decl);
 
+  // Encoding, indirection, MemoryOrder, AnnotationFlags, AttributeTable
+  PrintFieldOptions(os, decl, std::string(), attributes);
+
   // );
   os << ");\n";
 }
@@ -456,6 +1427,9 @@ static void PrintMethod(raw_ostream &os, int indent, SmallString<64> &type,
     }
   }
 
+  auto attributes = PrintAttributeTable(os, indent, decl,
+                                        "method_" + std::to_string(index));
+
   // typeStorage.methods[index] = Reflection::Method(
   PrintIndent(os, indent);
   os << "typeStorage.methods[" << index << "] = Reflection::Method(";
@@ -486,20 +1460,168 @@ static void PrintMethod(raw_ostream &os, int indent, SmallString<64> &type,
   // Linkage
   PrintLinkage(os, decl);
 
+  // AnnotationFlags, AttributeTable
+  auto flags = GetAnnotationFlags(decl);
+  if (!flags.empty() || attributes != "nullptr") {
+    PrintAnnotations(os, flags, attributes);
+  }
+
   // );
   os << ");\n";
 }
 
-static void PrintType(raw_ostream &os, int indent,
+// builtin types that reflection.hpp declares a descriptor for
+static bool HasBuiltinDescriptor(BuiltinType const *type) {
+  switch (type->getKind()) {
+  case BuiltinType::Void:
+  case BuiltinType::Bool:
+  case BuiltinType::Char_S:
+  case BuiltinType::Char_U:
+  case BuiltinType::UChar:
+  case BuiltinType::Short:
+  case BuiltinType::UShort:
+  case BuiltinType::Int:
+  case BuiltinType::UInt:
+  case BuiltinType::Long:
+  case BuiltinType::ULong:
+  case BuiltinType::LongLong:
+  case BuiltinType::ULongLong:
+  case BuiltinType::Float:
+  case BuiltinType::Double:
+  case BuiltinType::LongDouble:
+    return true;
+  default:
+    return false;
+  }
+}
 
-                      RecordDecl const *decl, SmallString<64> &type,
-                      std::vector<FieldDecl const *> const &fields,
-                      std::vector<VarDecl const *> const &var_fields,
-                      std::vector<FunctionDecl const *> const &methods) {
+// &GetType<float> for a template argument, nullptr when nothing defines the
+// descriptor of the type
+static std::string GetTypeGetter(QualType const &qualType) {
+  auto canonical = qualType.getCanonicalType();
+  auto const *type = canonical.getTypePtr();
+  if (canonical.hasQualifiers()) {
+    return "nullptr";
+  }
+  if (auto const *builtin = dyn_cast<BuiltinType>(type)) {
+    if (HasBuiltinDescriptor(builtin)) {
+      return "&GetType<" + GetQualTypeQualifiedName(canonical) + ">";
+    }
+  } else if (auto const *record = type->getAsCXXRecordDecl()) {
+    auto const *instantiation =
+        dyn_cast<ClassTemplateSpecializationDecl>(record);
+    bool reflected =
+        instantiation != nullptr &&
+                instantiation->getSpecializationKind() !=
+                    TSK_ExplicitSpecialization
+            ? IsReflectedInstantiation(instantiation)
+            : record->hasDefinition() && IsReflected(record);
+    if (reflected) {
+      return "&GetType<" + GetRecordName(record) + ">";
+    }
+  }
+  return "nullptr";
+}
+
+// int64_t initializer for the value of a template argument
+static std::string GetTemplateValue(APSInt const &value) {
+  APSInt truncated = value.extOrTrunc(64);
+  if (truncated.isSigned()) {
+    int64_t signedValue = truncated.getExtValue();
+    return signedValue == INT64_MIN ? "INT64_MIN"
+                                    : std::to_string(signedValue);
+  }
+  uint64_t unsignedValue = truncated.getZExtValue();
+  if (unsignedValue > static_cast<uint64_t>(INT64_MAX)) {
+    return "static_cast<int64_t>(" + std::to_string(unsignedValue) + "ull)";
+  }
+  return std::to_string(unsignedValue);
+}
+
+// static TemplateArgument const templateArgumentList[] = { ... };
+// static TemplateArguments const templateArguments = { "Vec", ..., 2 };
+static void PrintTemplateArguments(raw_ostream &os, int indent,
+                                   ClassTemplateSpecializationDecl const *decl) {
+  SmallVector<TemplateArgument, 8> arguments;
+  for (auto const &argument : decl->getTemplateArgs().asArray()) {
+    if (argument.getKind() == TemplateArgument::Pack) {
+      arguments.append(argument.pack_begin(), argument.pack_end());
+    } else {
+      arguments.push_back(argument);
+    }
+  }
+
+  auto policy = GetPrintingPolicy();
+  if (!arguments.empty()) {
+    PrintIndent(os, indent);
+    os << "static TemplateArgument const templateArgumentList[] = {";
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      auto const &argument = arguments[i];
+      std::string name;
+      raw_string_ostream nameStream(name);
+      argument.print(policy, nameStream, false);
+      nameStream.flush();
+
+      os << (i > 0 ? ", " : " ") << "{ ";
+      if (argument.getKind() == TemplateArgument::Type) {
+        os << "TemplateArgumentKind::kType, \"" << name << "\", "
+           << GetTypeGetter(argument.getAsType()) << ", 0";
+      } else if (argument.getKind() == TemplateArgument::Integral) {
+        os << "TemplateArgumentKind::kValue, \"" << name << "\", "
+           << GetTypeGetter(argument.getIntegralType()) << ", "
+           << GetTemplateValue(argument.getAsIntegral());
+      } else {
+        os << "TemplateArgumentKind::kOther, \"" << name << "\", nullptr, 0";
+      }
+      os << " }";
+    }
+    os << " };\n";
+  }
+
+  PrintIndent(os, indent);
+  os << "static TemplateArguments const templateArguments = { \""
+     << decl->getSpecializedTemplate()->getQualifiedNameAsString() << "\", "
+     << (arguments.empty() ? "nullptr" : "templateArgumentList") << ", "
+     << arguments.size() << " };\n";
+}
+
+// Generated code goes to the header and, with -emit-cpp, to a source file. The
+// header gets what includers need (variant structs, declarations), the source
+// file the GetTypeImpl definitions and the layout checks. Without -emit-cpp
+// both are the header and the definitions are inline.
+struct CodeStreams {
+  raw_ostream &header;
+  raw_ostream &source;
+
+  bool IsSplit() const { return &header != &source; }
+};
+
+// template<> inline Type const* GetTypeImpl(Tag<Foo>) noexcept, declared in
+// the header when the definition goes to the source file
+static void PrintTypeImplHead(CodeStreams &streams, int indent,
+                              StringRef type) {
+  if (streams.IsSplit()) {
+    PrintIndent(streams.header, indent);
+    streams.header << "template<> Type const* GetTypeImpl(Tag<" << type
+                   << ">) noexcept;\n\n";
+  }
+
+  auto &os = streams.source;
   PrintIndent(os, indent);
   os << "template<>\n";
   PrintIndent(os, indent);
-  os << "Type const* GetTypeImpl(Tag<" << type << ">) noexcept\n";
+  os << (streams.IsSplit() ? "" : "inline ") << "Type const* GetTypeImpl(Tag<"
+     << type << ">) noexcept\n";
+}
+
+static void PrintType(CodeStreams &streams, int indent,
+                      ASTContext const &context, RecordDecl const *decl,
+                      SmallString<64> &type,
+                      std::vector<FieldDecl const *> const &fields,
+                      std::vector<VarDecl const *> const &var_fields,
+                      std::vector<FunctionDecl const *> const &methods) {
+  auto &os = streams.source;
+  PrintTypeImplHead(streams, indent, type);
   PrintIndent(os, indent);
   os << "{\n";
   indent++;
@@ -508,6 +1630,13 @@ static void PrintType(raw_ostream &os, int indent,
      << fields.size() + var_fields.size() << ", " << methods.size()
      << "> typeStorage;\n";
 
+  // the tables are filled once, inside a thread-safe static initialization,
+  // so GetType may be called concurrently
+  // static bool initialized = [] {
+  PrintIndent(os, indent);
+  os << "static bool initialized = [] {\n";
+  indent++;
+
   int fieldIndex = 0;
 
   for (auto &field : fields) {
@@ -523,13 +1652,81 @@ static void PrintType(raw_ostream &os, int indent,
     PrintMethod(os, indent, type, method, methodIndex++);
   }
 
+  // return true; }();
+  PrintIndent(os, indent);
+  os << "return true;\n";
+  indent--;
+  PrintIndent(os, indent);
+  os << "}();\n";
+  PrintIndent(os, indent);
+  os << "(void)initialized;\n";
+
+  // static PaddingHole const paddingHoles[] = { { 4, 4 } };
+  // static PaddingMap const paddingMap = { paddingHoles, 1, 4 };
+  bool hasLayout = HasLayout(decl);
+  if (hasLayout) {
+    TraceScope scope("Layout analysis", type);
+    auto holes = GetPaddingHoles(context, decl);
+    uint64_t paddingSize = 0;
+    if (!holes.empty()) {
+      PrintIndent(os, indent);
+      os << "static PaddingHole const paddingHoles[] = {";
+      for (size_t i = 0; i < holes.size(); ++i) {
+        os << (i > 0 ? ", " : " ") << "{ " << holes[i].offset << ", "
+           << holes[i].size << " }";
+        paddingSize += holes[i].size;
+      }
+      os << " };\n";
+    }
+    PrintIndent(os, indent);
+    os << "static PaddingMap const paddingMap = { "
+       << (holes.empty() ? "nullptr" : "paddingHoles") << ", " << holes.size()
+       << ", " << paddingSize << " };\n";
+  }
+
+  auto const *specialization = dyn_cast<ClassTemplateSpecializationDecl>(decl);
+  if (specialization != nullptr) {
+    PrintTemplateArguments(os, indent, specialization);
+  }
+  auto flags = GetAnnotationFlags(decl);
+  auto attributes = PrintAttributeTable(os, indent, decl, "type");
+  std::string traits;
+  if (hasLayout) {
+    TraceScope scope("Layout analysis", type);
+    traits = GetTypeTraits(context, decl);
+  }
+  bool hasTraits = !traits.empty();
+  bool hasAnnotations = !flags.empty() || attributes != "nullptr" || hasTraits;
+  bool hasTemplateArguments = specialization != nullptr || hasAnnotations;
+  bool hasPaddingMap = hasLayout || hasTemplateArguments;
+
   // static Type type("int", sizeof(int),
   PrintIndent(os, indent);
   os << "static Type type(\"" << type << "\", sizeof(" << type << "), ";
   // TypeSpecifierType,
   PrintTypeSpecifierType(os, decl->getTypeForDecl());
   os << ", typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, "
-        "typeStorage.kMethodsNum);\n";
+        "typeStorage.kMethodsNum";
+  // Encoding, PaddingMap, TemplateArguments, AnnotationFlags, AttributeTable,
+  // TypeTraits
+  if (HasEncoding(decl) || hasPaddingMap) {
+    os << ", ";
+    PrintEncoding(os, decl);
+  }
+  if (hasPaddingMap) {
+    os << ", " << (hasLayout ? "&paddingMap" : "nullptr");
+  }
+  if (hasTemplateArguments) {
+    os << ", "
+       << (specialization != nullptr ? "&templateArguments" : "nullptr");
+  }
+  if (hasAnnotations) {
+    PrintAnnotations(os, flags, attributes);
+  }
+  if (hasTraits) {
+    os << ", " << traits;
+  }
+  os << ");\n";
 
   // return &type;
   PrintIndent(os, indent);
@@ -539,23 +1736,239 @@ static void PrintType(raw_ostream &os, int indent,
   indent--;
   PrintIndent(os, indent);
   os << "};\n\n";
+
+  // the generated offsets are only valid for the layout they were taken from
+  if (hasLayout) {
+    PrintLayoutAsserts(os, indent, context, decl, type, fields);
+  }
+}
+
+// reflection of a layout variant generated for a record, field i of the
+// variant is field i of the record; indirect fields live in storage::Cold
+static void PrintVariantType(CodeStreams &streams, int indent,
+                             std::string const &storage,
+                             std::vector<FieldDecl const *> const &fields,
+                             std::vector<FieldDecl const *> const &coldFields) {
+  auto &os = streams.source;
+  PrintTypeImplHead(streams, indent, storage);
+  PrintIndent(os, indent);
+  os << "{\n";
+  indent++;
+  PrintIndent(os, indent);
+  os << "static TypeStorage<" << storage << ", " << fields.size()
+     << ", 0> typeStorage;\n";
+  PrintIndent(os, indent);
+  os << "static bool initialized = [] {\n";
+  indent++;
+
+  int index = 0;
+  for (auto const *field : fields) {
+    bool isCold = std::find(coldFields.begin(), coldFields.end(), field) !=
+                  coldFields.end();
+
+    PrintIndent(os, indent);
+    os << "static Type field_" << index << "_Type = *GetType<"
+       << GetQualTypeQualifiedName(field->getType()) << ">();\n";
+    auto attributes = PrintAttributeTable(os, indent, field,
+                                          "field_" + std::to_string(index));
+
+    PrintIndent(os, indent);
+    os << "typeStorage.fields[" << index << "] = Reflection::Field(\""
+       << field->getQualifiedNameAsString() << "\", &field_" << index
+       << "_Type, offsetof(" << GetMacroArgument(storage)
+       << (isCold ? "::Cold" : "") << ", "
+       << field->getNameAsString() << "), ";
+    PrintCVRQualifier(os, field);
+    os << ", StorageClassSpecifier::kNone, "
+          "ThreadStorageClassSpecifier::kUnSpecified, "
+          "StorageDuration::kNone, ";
+    PrintAccessSpecifier(os, field);
+    PrintFieldOptions(os, field,
+                      isCold ? "offsetof(" + GetMacroArgument(storage) +
+                                   ", cold)"
+                             : std::string(),
+                      attributes);
+    os << ");\n";
+    index++;
+  }
+
+  PrintIndent(os, indent);
+  os << "return true;\n";
+  indent--;
+  PrintIndent(os, indent);
+  os << "}();\n";
+  PrintIndent(os, indent);
+  os << "(void)initialized;\n";
+  PrintIndent(os, indent);
+  os << "static Type type(\"" << storage << "\", sizeof(" << storage
+     << "), TypeSpecifierType::kStruct, typeStorage.fields, "
+        "typeStorage.kFieldsNum, typeStorage.methods, "
+        "typeStorage.kMethodsNum);\n";
+  PrintIndent(os, indent);
+  os << "return &type;\n";
+  indent--;
+  PrintIndent(os, indent);
+  os << "};\n\n";
 }
 
-static std::unordered_map<std::string, int> name2PredefinedType;
+static void PrintVariantMember(raw_ostream &os, int indent,
+                               FieldDecl const *field,
+                               StringRef prefix = StringRef()) {
+  PrintIndent(os, indent);
+  os << prefix << "std::remove_cv<decltype("
+     << field->getQualifiedNameAsString() << ")>::type "
+     << field->getNameAsString() << ";\n";
+}
 
-static bool PrintPredefinedType(raw_ostream &os, int indent,
-                                QualType const &type) {
-  if (!IsPredefinedType(type)) {
-    return false;
+// template<> struct SplitStorage<Entity>, hot fields inline and cold fields
+// behind a pointer, plus its reflection; the fields keep the order of Entity so
+// that field i of both types is the same member
+static void PrintSplitStorage(CodeStreams &streams, int indent,
+                              ASTContext const &context, RecordDecl const *decl,
+                              SmallString<64> &type,
+                              std::vector<FieldDecl const *> const &fields) {
+  std::vector<FieldDecl const *> hotFields;
+  std::vector<FieldDecl const *> coldFields;
+  for (auto const *field : fields) {
+    if (HasAnnotationFlag(field, "hot") && HasAnnotationFlag(field, "cold")) {
+      Warnings() << "warning: " << field->getQualifiedNameAsString()
+                 << " is annotated both hot and cold, keeping it hot\n";
+    }
+    if (HasAnnotationFlag(field, "cold") && !HasAnnotationFlag(field, "hot")) {
+      coldFields.push_back(field);
+    } else {
+      hotFields.push_back(field);
+    }
   }
-  auto qualifiedName = GetQualTypeQualifiedName(type);
-  if (name2PredefinedType.count(qualifiedName) <= 0) {
-    name2PredefinedType[qualifiedName] = 1;
-    PrintIndent(os, indent);
-    os << "DECLARE_TYPE(" << qualifiedName << ");\n";
-    return true;
+
+  if (coldFields.empty()) {
+    return;
   }
-  return false;
+
+  // largest alignment first, so neither part has inner padding
+  auto byAlignment = [&context](FieldDecl const *a, FieldDecl const *b) {
+    return context.getTypeAlignInChars(a->getType()) >
+           context.getTypeAlignInChars(b->getType());
+  };
+  std::stable_sort(hotFields.begin(), hotFields.end(), byAlignment);
+  std::stable_sort(coldFields.begin(), coldFields.end(), byAlignment);
+
+  std::string storage = "SplitStorage<" + type.str().str() + ">";
+  auto &os = streams.header;
+  PrintIndent(os, indent);
+  os << "template<>\n";
+  PrintIndent(os, indent);
+  os << "struct " << storage << "\n";
+  PrintIndent(os, indent);
+  os << "{\n";
+  PrintIndent(os, indent + 1);
+  os << "struct Cold\n";
+  PrintIndent(os, indent + 1);
+  os << "{\n";
+  for (auto const *field : coldFields) {
+    PrintVariantMember(os, indent + 2, field);
+  }
+  PrintIndent(os, indent + 1);
+  os << "};\n\n";
+  for (auto const *field : hotFields) {
+    PrintVariantMember(os, indent + 1, field);
+  }
+  PrintIndent(os, indent + 1);
+  os << "Cold* cold;\n";
+  PrintIndent(os, indent);
+  os << "};\n\n";
+
+  PrintVariantType(streams, indent, storage, fields, coldFields);
+}
+
+// thread_owned fields of different owners that share a cache line bounce the
+// line between the writing cores
+static void CheckFalseSharing(ASTContext const &context,
+                              RecordDecl const *decl,
+                              std::vector<FieldDecl const *> const &fields) {
+  auto const &layout = context.getASTRecordLayout(decl);
+  struct Span {
+    FieldDecl const *field;
+    std::string owner;
+    uint64_t firstLine;
+    uint64_t lastLine;
+  };
+
+  std::vector<Span> spans;
+  for (auto const *field : fields) {
+    auto owner = GetThreadOwner(field);
+    uint64_t bits = layout.getFieldOffset(field->getFieldIndex());
+    uint64_t size = GetFieldSize(context, field, bits);
+    if (owner.empty() || size == 0) {
+      continue;
+    }
+    spans.push_back({field, owner, bits / 8 / cacheLineSize,
+                     (bits / 8 + size - 1) / cacheLineSize});
+  }
+
+  for (size_t i = 0; i < spans.size(); ++i) {
+    for (size_t j = i + 1; j < spans.size(); ++j) {
+      if (spans[i].owner != spans[j].owner &&
+          spans[i].firstLine <= spans[j].lastLine &&
+          spans[j].firstLine <= spans[i].lastLine) {
+        Warnings() << "warning: "
+                   << spans[i].field->getQualifiedNameAsString() << " and "
+                   << spans[j].field->getQualifiedNameAsString()
+                   << " are owned by different threads but share a "
+                   << cacheLineSize << " byte cache line\n";
+      }
+    }
+  }
+}
+
+// template<> struct PaddedStorage<Counters>, the shared fields first and every
+// owner's fields starting on a new cache line; the struct is aligned to the
+// cache line, so the last group is padded up to the end of its line too
+static void PrintPaddedStorage(CodeStreams &streams, int indent,
+                               SmallString<64> &type,
+                               std::vector<FieldDecl const *> const &fields) {
+  std::vector<std::string> owners;
+  for (auto const *field : fields) {
+    auto owner = GetThreadOwner(field);
+    if (!owner.empty() &&
+        std::find(owners.begin(), owners.end(), owner) == owners.end()) {
+      owners.push_back(owner);
+    }
+  }
+
+  if (owners.empty()) {
+    return;
+  }
+
+  std::string storage = "PaddedStorage<" + type.str().str() + ">";
+  std::string alignment = "alignas(" + std::to_string(cacheLineSize) + ") ";
+
+  auto &os = streams.header;
+  PrintIndent(os, indent);
+  os << "template<>\n";
+  PrintIndent(os, indent);
+  os << "struct " << storage << "\n";
+  PrintIndent(os, indent);
+  os << "{\n";
+  for (auto const *field : fields) {
+    if (GetThreadOwner(field).empty()) {
+      PrintVariantMember(os, indent + 1, field);
+    }
+  }
+  for (auto const &owner : owners) {
+    bool first = true;
+    for (auto const *field : fields) {
+      if (GetThreadOwner(field) == owner) {
+        PrintVariantMember(os, indent + 1, field,
+                           first ? StringRef(alignment) : StringRef());
+        first = false;
+      }
+    }
+  }
+  PrintIndent(os, indent);
+  os << "};\n\n";
+
+  PrintVariantType(streams, indent, storage, fields, {});
 }
 
 class ASTResult {
@@ -597,167 +2010,1746 @@ public:
     methods.push_back(method);
   }
 
-  void PrintPredefinedTypes(raw_ostream &os, int indent) {
-    int count = 0;
-    for (auto &field : fields) {
-      auto type = field->getType();
-      if (PrintPredefinedType(os, indent, type)) {
-        count++;
+  // predefined types used by the record, in first use order; DECLARE_TYPE
+  // defines a specialization, so each one is printed only once per run
+  void CollectPredefinedTypes(std::vector<std::string> &names) {
+    auto add = [&names](QualType const &type) {
+      if (IsPredefinedType(type)) {
+        names.push_back(GetQualTypeQualifiedName(type));
       }
+    };
+
+    for (auto &field : fields) {
+      add(field->getType());
     }
 
     for (auto &field : varFields) {
-      auto type = field->getType();
-      if (PrintPredefinedType(os, indent, type)) {
-        count++;
-      }
+      add(field->getType());
     }
 
     for (auto &method : methods) {
       for (unsigned int i = 0; i < method->getNumParams(); ++i) {
-        auto type = method->getParamDecl(i)->getType();
-        if (PrintPredefinedType(os, indent, type)) {
-          count++;
-        }
+        add(method->getParamDecl(i)->getType());
       }
     }
+  }
+
+  // an implicit or explicit instantiation of an annotated class template
+  bool IsInstantiation() const {
+    auto const *specialization =
+        dyn_cast<ClassTemplateSpecializationDecl>(record);
+    return specialization != nullptr &&
+           specialization->getSpecializationKind() !=
+               TSK_ExplicitSpecialization;
+  }
+
+  void Print(CodeStreams &streams, ASTContext const &context) {
+    SmallString<64> type(GetRecordName(record));
+    PrintType(streams, 1, context, record, type, fields, varFields, methods);
+    if (HasLayout(record)) {
+      TraceScope scope("Layout analysis", type);
+      PrintSplitStorage(streams, 1, context, record, type, fields);
+      CheckFalseSharing(context, record, fields);
+    }
+    if (emitPadded) {
+      PrintPaddedStorage(streams, 1, type, fields);
+    }
+  }
+
+  // the file the record is declared in
+  std::string GetFileName(SourceManager const &sourceManager) const {
+    auto location = sourceManager.getFileLoc(record->getLocation());
+    return sourceManager.getFilename(location).str();
+  }
+
+  std::string GetQualifiedName() const { return GetRecordName(record); }
 
-    os << " \n";
+  unsigned GetFieldCount() const { return fields.size() + varFields.size(); }
+  unsigned GetMethodCount() const { return methods.size(); }
+
+  // &GetType<Foo>
+  void PrintGetter(raw_ostream &os) {
+    os << "&GetType<" << GetRecordName(record) << ">";
+  }
+
+  void PrintLayout(raw_ostream &os, ASTContext const &context) {
+    if (HasLayout(record)) {
+      TraceScope scope("Layout analysis", GetRecordName(record));
+      PrintLayoutReport(os, context, record);
+    }
   }
+};
+
+// Everything generated for one translation unit. It is rendered while the AST
+// is alive, the parts that depend on other translation units (predefined types
+// already declared by an earlier header) are resolved when merging.
+struct GeneratedRecord {
+  // Foo, qualified
+  std::string name;
+  std::vector<std::string> predefinedTypes;
+  // the file the record is declared in
+  std::string declaringFile;
+  // Vec<float, 4> for an instantiation of a class template; other files may
+  // generate it as well, so its header part is guarded
+  std::string instantiation;
+  // header part, everything unless the record is split with -emit-cpp
+  std::string body;
+  // source file part with -emit-cpp
+  std::string definitions;
+  std::string layout;
+  std::string getter;
+  unsigned fields = 0;
+  unsigned methods = 0;
+
+  bool IsSplit() const { return !definitions.empty(); }
+};
+
+// a file the translation unit read, with what it looked like at the time
+struct Dependency {
+  std::string path;
+  uint64_t size;
+  int64_t modified;
+  uint64_t hash;
+};
 
-  void Print(raw_ostream &os) {
-    SmallString<64> type;
-    raw_svector_ostream stos(type);
-    record->printQualifiedName(stos);
-    PrintPredefinedTypes(os, 1);
-    PrintType(os, 1, record, type, fields, varFields, methods);
+// milliseconds spent on one translation unit, not cached
+struct PhaseTimes {
+  double precompile = 0;
+  double parse = 0;
+  double traverse = 0;
+  double dependencies = 0;
+  double render = 0;
+
+  PhaseTimes &operator+=(PhaseTimes const &other) {
+    precompile += other.precompile;
+    parse += other.parse;
+    traverse += other.traverse;
+    dependencies += other.dependencies;
+    render += other.render;
+    return *this;
   }
 };
 
-class AnnotationFinder : public MatchFinder::MatchCallback {
+static double GetMilliseconds(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct GeneratedFile {
+  // source file of the reflected records, empty when nothing is reflected
+  std::string fileName;
+  std::vector<GeneratedRecord> records;
+  std::string warnings;
+  std::vector<Dependency> dependencies;
+  PhaseTimes times;
+  bool failed = false;
+};
+
+static bool GetDependency(StringRef path, Dependency &dependency) {
+  sys::fs::file_status status;
+  auto buffer = MemoryBuffer::getFile(path);
+  if (sys::fs::status(path, status) || !buffer) {
+    return false;
+  }
+  dependency.path = path.str();
+  dependency.size = status.getSize();
+  dependency.modified =
+      status.getLastModificationTime().time_since_epoch().count();
+  dependency.hash = xxHash64((*buffer)->getBuffer());
+  return true;
+}
+
+// a file whose size and time match is assumed unchanged, otherwise its
+// content decides, so touching a header does not force a parse
+static bool IsUnchanged(Dependency const &dependency) {
+  sys::fs::file_status status;
+  if (sys::fs::status(dependency.path, status)) {
+    return false;
+  }
+  if (status.getSize() == dependency.size &&
+      status.getLastModificationTime().time_since_epoch().count() ==
+          dependency.modified) {
+    return true;
+  }
+  auto buffer = MemoryBuffer::getFile(dependency.path);
+  return buffer && xxHash64((*buffer)->getBuffer()) == dependency.hash;
+}
+
+// Files the reflection macros were expanded in. A reflected record can only be
+// declared in one of them or in the main file, everything else (the standard
+// library, reflection.hpp itself, most project headers) is skipped without
+// being traversed.
+class AnnotatedFileCallbacks : public PPCallbacks {
 public:
-  template <unsigned N>
-  StringRef GetAnnotations(Attr const *attr, SmallString<N> &str) {
-    str.clear();
-    raw_svector_ostream os(str);
-    LangOptions langopts;
-    PrintingPolicy policy(langopts);
-    attr->printPretty(os, policy);
-    return str.slice(26, str.size() - 4);
-  }
-
-  bool HasAnnotation(clang::AttrVec const &attrs, llvm::StringRef keyword) {
-    for (auto &attr : attrs) {
-      if (attr->getKind() == attr::Kind::Annotate) {
-        SmallString<64> str;
-        auto annotationStr = GetAnnotations(attr, str);
-        if (annotationStr.startswith(keyword)) {
-          return true;
-        }
-      }
+  AnnotatedFileCallbacks(SourceManager const &_sourceManager,
+                         DenseSet<FileID> &_files)
+      : sourceManager(_sourceManager), files(_files) {}
+
+  void MacroExpands(Token const &macroName, MacroDefinition const &definition,
+                    SourceRange range, MacroArgs const *args) override {
+    auto name = macroName.getIdentifierInfo()->getName();
+    if (name == "CLASS" || name == "STRUCT") {
+      auto location = sourceManager.getExpansionLoc(range.getBegin());
+      files.insert(sourceManager.getFileID(location));
     }
+  }
 
-    return false;
+private:
+  SourceManager const &sourceManager;
+  DenseSet<FileID> &files;
+};
+
+// One pass over the declarations of the annotated files. Members are taken
+// from the annotated record that declares them, so records are collected in
+// declaration order and nested or interleaved records keep their own members.
+class AnnotationVisitor : public RecursiveASTVisitor<AnnotationVisitor> {
+  using Base = RecursiveASTVisitor<AnnotationVisitor>;
+
+public:
+  AnnotationVisitor(SourceManager const &_sourceManager,
+                    DenseSet<FileID> const &_annotatedFiles)
+      : sourceManager(_sourceManager), annotatedFiles(_annotatedFiles) {}
+
+  std::vector<ASTResult> records;
+  std::string fileName;
+
+  bool IsAnnotatedFile(SourceLocation location) const {
+    if (location.isInvalid()) {
+      return false;
+    }
+    auto file =
+        sourceManager.getFileID(sourceManager.getExpansionLoc(location));
+    return file == sourceManager.getMainFileID() ||
+           annotatedFiles.count(file) > 0;
   }
 
-  virtual void run(MatchFinder::MatchResult const &result) override {
-    CXXRecordDecl const *record = result.Nodes.getNodeAs<CXXRecordDecl>(kID);
-    if (record) {
-      records.emplace_back(record);
-      astContext = result.Context;
-      fileName = (std::string)result.SourceManager->getFilename(
-          result.SourceManager->getFileLoc(record->getLocation()));
-      return;
+  // only declarations at namespace scope are checked, what is below them is
+  // declared in the same file
+  bool TraverseDecl(Decl *decl) {
+    if (decl != nullptr && !isa<TranslationUnitDecl>(decl) &&
+        decl->getDeclContext()->getRedeclContext()->isFileContext() &&
+        !IsAnnotatedFile(decl->getLocation())) {
+      return true;
+    }
+    return Base::TraverseDecl(decl);
+  }
+
+  // records declared in function bodies cannot be reflected
+  bool TraverseStmt(Stmt *, DataRecursionQueue * = nullptr) { return true; }
+
+  bool VisitCXXRecordDecl(CXXRecordDecl *record) {
+    // instantiations are collected from their template
+    auto const *specialization =
+        dyn_cast<ClassTemplateSpecializationDecl>(record);
+    if (!record->isThisDeclarationADefinition() ||
+        record->isDependentContext() || !IsReflected(record) ||
+        (specialization != nullptr &&
+         specialization->getSpecializationKind() !=
+             TSK_ExplicitSpecialization)) {
+      return true;
     }
 
-    FunctionDecl const *methodNode = result.Nodes.getNodeAs<FunctionDecl>(kID);
-    if (methodNode) {
-      if (methodNode->hasAttr<AnnotateAttr>() &&
-          HasAnnotation(methodNode->getAttrs(), kReflectAnnotation)) {
-        records.back().AddMethod(methodNode);
-      }
-      return;
+    AddRecord(record);
+    if (!hasInstantiations) {
+      fileName = records.back().GetFileName(sourceManager);
     }
+    return true;
+  }
 
-    FieldDecl const *fieldNode = result.Nodes.getNodeAs<FieldDecl>(kID);
-    if (fieldNode) {
-      if (fieldNode->hasAttr<AnnotateAttr>() &&
-          HasAnnotation(fieldNode->getAttrs(), kReflectAnnotation)) {
-        records.back().AddField(fieldNode);
-      }
-      return;
+  // The instantiations of an annotated class template, in the order the
+  // translation unit completed them. Their descriptors belong to the main
+  // file, the template's own file is shared with other translation units that
+  // instantiate it differently.
+  bool VisitClassTemplateDecl(ClassTemplateDecl *decl) {
+    auto const *pattern = decl->getTemplatedDecl();
+    if (!decl->isThisDeclarationADefinition() || !IsReflected(pattern)) {
+      return true;
     }
 
-    VarDecl const *varNode = result.Nodes.getNodeAs<VarDecl>(kID);
-    if (varNode) {
-      if (varNode->hasAttr<AnnotateAttr>() &&
-          HasAnnotation(varNode->getAttrs(), kReflectAnnotation)) {
-        records.back().AddStaticField(varNode);
+    auto mode = GetAnnotationOption(pattern, "instantiations");
+    if (!mode.empty() && mode != "all" && mode != "explicit") {
+      Warnings() << "warning: unknown instantiations '" << mode << "' on "
+                 << decl->getQualifiedNameAsString() << "\n";
+    }
+
+    for (auto *specialization : decl->specializations()) {
+      if (IsReflectedInstantiation(specialization)) {
+        AddRecord(specialization->getDefinition());
+        hasInstantiations = true;
+        fileName = sourceManager
+                       .getFilename(sourceManager.getLocForStartOfFile(
+                           sourceManager.getMainFileID()))
+                       .str();
       }
-      return;
     }
+    return true;
   }
 
-  void PrintHeader(raw_ostream &os) {
-    os << "// auto-generated file.\n";
-    os << "#pragma once\n";
-    os << "#include \"reflection.hpp\"\n";
-    os << "\n\n\n";
+private:
+  SourceManager const &sourceManager;
+  DenseSet<FileID> const &annotatedFiles;
+  bool hasInstantiations = false;
+
+  void AddRecord(CXXRecordDecl const *record) {
+    ASTResult result(record);
+    CheckAnnotation(record);
+    for (auto *member : record->decls()) {
+      if (!IsReflected(member)) {
+        continue;
+      }
+      if (auto *named = dyn_cast<NamedDecl>(member)) {
+        CheckAnnotation(named);
+      }
+      if (auto *field = dyn_cast<FieldDecl>(member)) {
+        result.AddField(field);
+      } else if (auto *var = dyn_cast<VarDecl>(member)) {
+        result.AddStaticField(var);
+      } else if (auto *method = dyn_cast<FunctionDecl>(member)) {
+        result.AddMethod(method);
+      }
+    }
+    records.push_back(std::move(result));
   }
+};
+
+static bool IsHeaderFile(StringRef fileName) {
+  auto extension = sys::path::extension(fileName).lower();
+  return extension.empty() || extension == ".h" || extension == ".hh" ||
+         extension == ".hpp" || extension == ".hxx" || extension == ".inl";
+}
 
-  void PrintNamespace(raw_ostream &os) {
-    os << "namespace Reflection\n";
-    os << "{\n";
+class AnnotationConsumer : public ASTConsumer {
+public:
+  AnnotationConsumer(GeneratedFile &_result,
+                     DenseSet<FileID> const &_annotatedFiles,
+                     Clock::time_point _parseStart)
+      : result(_result), annotatedFiles(_annotatedFiles),
+        parseStart(_parseStart) {}
+
+  // only what was parsed for this file, the declarations of a precompiled
+  // prefix header are never deserialized
+  bool HandleTopLevelDecl(DeclGroupRef group) override {
+    topLevelDecls.append(group.begin(), group.end());
+    return true;
   }
 
-  void PrintEndNamespace(raw_ostream &os) { os << "}\n"; }
+  void HandleInterestingDecl(DeclGroupRef group) override {}
+
+  void HandleTranslationUnit(ASTContext &context) override {
+    auto const &sourceManager = context.getSourceManager();
+    auto mainFile = sourceManager.getFilename(
+        sourceManager.getLocForStartOfFile(sourceManager.getMainFileID()));
+
+    // the whole translation unit is parsed before it is handed over
+    auto traverseStart = Clock::now();
+    AddTraceEvent("Parse", mainFile, parseStart, traverseStart);
+    AnnotationVisitor visitor(sourceManager, annotatedFiles);
+    {
+      TraceScope scope("Match", mainFile);
+      for (auto *decl : topLevelDecls) {
+        visitor.TraverseDecl(decl);
+      }
+    }
+
+    // every file the preprocessor read, relative paths are relative to the
+    // directory of the compile command
+    auto dependenciesStart = Clock::now();
+    auto &fileManager = sourceManager.getFileManager();
+    for (auto it = sourceManager.fileinfo_begin();
+         it != sourceManager.fileinfo_end(); ++it) {
+      SmallString<256> path(it->first->getName());
+      fileManager.makeAbsolutePath(path);
+      Dependency dependency;
+      if (GetDependency(path, dependency)) {
+        result.dependencies.push_back(std::move(dependency));
+      }
+    }
 
-  virtual void onEndOfTranslationUnit() override {
-    std::error_code error;
-    std::string fileNameWithoutExt = fileName.substr(0, fileName.rfind("."));
-    fileNameWithoutExt.append("_gen_refl.h");
-    llvm::outs() << fileNameWithoutExt << " generated.\n";
-    llvm::raw_fd_ostream os(fileNameWithoutExt, error);
+    auto renderStart = Clock::now();
+    AddTraceEvent("Dependencies", mainFile, dependenciesStart, renderStart);
+    result.fileName = visitor.fileName;
+    for (auto &record : visitor.records) {
+      TraceScope recordScope("Record", record.GetQualifiedName());
+      GeneratedRecord generated;
+      generated.name = record.GetQualifiedName();
+      record.CollectPredefinedTypes(generated.predefinedTypes);
+      generated.fields = record.GetFieldCount();
+      generated.methods = record.GetMethodCount();
+      generated.declaringFile = record.GetFileName(sourceManager);
+      if (record.IsInstantiation()) {
+        generated.instantiation = record.GetQualifiedName();
+      }
 
-    PrintHeader(os);
-    PrintNamespace(os);
-    for (auto &record : records) {
-      record.Print(os);
+      // a type declared in a source file is only visible there, so its
+      // generated header is only included there and may define it; an
+      // instantiation stays inline as well, the arguments may name types that
+      // only the instantiating file sees
+      bool split = emitCpp && !record.IsInstantiation() &&
+                   IsHeaderFile(generated.declaringFile);
+      if (emitCpp && !split && !record.IsInstantiation()) {
+        Warnings() << "warning: " << record.GetQualifiedName()
+                   << " is declared in " << generated.declaringFile
+                   << ", which is not a header; its reflection stays in the "
+                      "generated header\n";
+      }
+
+      raw_string_ostream body(generated.body);
+      raw_string_ostream definitions(generated.definitions);
+      CodeStreams streams = {body, split ? definitions : body};
+      {
+        TraceScope scope("Emit", record.GetQualifiedName());
+        record.Print(streams, context);
+      }
+      body.flush();
+      definitions.flush();
+
+      raw_string_ostream getter(generated.getter);
+      record.PrintGetter(getter);
+      getter.flush();
+
+      if (layoutReport) {
+        raw_string_ostream layout(generated.layout);
+        record.PrintLayout(layout, context);
+        layout.flush();
+      }
+      result.records.push_back(std::move(generated));
     }
-    PrintEndNamespace(os);
+
+    auto end = Clock::now();
+    result.times.traverse += GetMilliseconds(traverseStart, dependenciesStart);
+    result.times.dependencies +=
+        GetMilliseconds(dependenciesStart, renderStart);
+    result.times.render += GetMilliseconds(renderStart, end);
   }
 
 private:
-  ASTContext const *astContext;
-  std::string fileName;
-  std::vector<ASTResult> records;
+  GeneratedFile &result;
+  DenseSet<FileID> const &annotatedFiles;
+  Clock::time_point parseStart;
+  SmallVector<Decl *, 256> topLevelDecls;
 };
 
-static llvm::cl::OptionCategory optionCategory("ast options");
+class AnnotationAction : public ASTFrontendAction {
+public:
+  explicit AnnotationAction(GeneratedFile &_result) : result(_result) {}
 
-int main(int argc, const char **argv) {
-  auto optionsParser = CommonOptionsParser::create(argc, argv, optionCategory);
-  ClangTool tool(optionsParser->getCompilations(),
-                 optionsParser->getSourcePathList());
+  bool BeginSourceFileAction(CompilerInstance &compiler) override {
+    parseStart = Clock::now();
+    compiler.getPreprocessor().addPPCallbacks(
+        std::make_unique<AnnotatedFileCallbacks>(compiler.getSourceManager(),
+                                                 annotatedFiles));
+    return true;
+  }
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &compiler,
+                                                 StringRef file) override {
+    return std::make_unique<AnnotationConsumer>(result, annotatedFiles,
+                                                parseStart);
+  }
+
+private:
+  GeneratedFile &result;
+  DenseSet<FileID> annotatedFiles;
+  Clock::time_point parseStart;
+};
 
-  AnnotationFinder annotationFinder;
-  MatchFinder finder;
+class CallbackActionFactory : public FrontendActionFactory {
+public:
+  using Create = std::function<std::unique_ptr<FrontendAction>()>;
+
+  explicit CallbackActionFactory(Create _createAction)
+      : createAction(std::move(_createAction)) {}
 
-  static DeclarationMatcher const typeMatcher =
-      cxxRecordDecl(decl().bind(kID), hasAttr(attr::Annotate));
-  finder.addMatcher(typeMatcher, &annotationFinder);
+  std::unique_ptr<FrontendAction> create() override { return createAction(); }
+
+private:
+  Create createAction;
+};
 
-  static DeclarationMatcher const fieldMatcher =
-      fieldDecl(decl().bind(kID), hasAttr(attr::Annotate));
-  finder.addMatcher(fieldMatcher, &annotationFinder);
+static void PrintHeader(raw_ostream &os) {
+  os << "// auto-generated file.\n";
+  os << "#pragma once\n";
+  os << "#include \"reflection.hpp\"\n";
+  os << "\n\n\n";
+}
 
-  static DeclarationMatcher const methodMatcher =
-      functionDecl(decl().bind(kID), hasAttr(attr::Annotate));
-  finder.addMatcher(methodMatcher, &annotationFinder);
+static void PrintNamespace(raw_ostream &os) {
+  os << "namespace Reflection\n";
+  os << "{\n";
+}
 
-  static DeclarationMatcher const staticMatcher =
-      varDecl(decl().bind(kID), hasAttr(attr::Annotate));
-  finder.addMatcher(staticMatcher, &annotationFinder);
+static void PrintEndNamespace(raw_ostream &os) { os << "}\n"; }
 
-  return tool.run(newFrontendActionFactory(&finder).get());
-}
\ No newline at end of file
+// the getters of every reflected type of the file, named after the file, for
+// registering a module with REFLECTION_MODULE(name, main_gen_refl_types)
+static void PrintTypeList(raw_ostream &os, GeneratedFile const &file) {
+  if (file.records.empty()) {
+    return;
+  }
+  std::string name = sys::path::stem(file.fileName).str() + "_gen_refl_types";
+  for (auto &c : name) {
+    if (!llvm::isAlnum(c)) {
+      c = '_';
+    }
+  }
+  if (llvm::isDigit(name.front())) {
+    name.insert(0, "_");
+  }
+
+  PrintIndent(os, 1);
+  os << "constexpr TypeGetter " << name << "[] = {";
+  for (size_t i = 0; i < file.records.size(); ++i) {
+    os << (i > 0 ? ", " : " ") << file.records[i].getter;
+  }
+  os << " };\n\n";
+}
+
+// Cache file: the generator version, then per source file its path, the key
+// of its compile command and options, its dependencies and what was generated
+// from it. Integers are 64-bit little endian, strings are length prefixed.
+struct CacheEntry {
+  uint64_t key;
+  GeneratedFile file;
+};
+
+static void WriteCacheValue(raw_ostream &os, uint64_t value) {
+  char bytes[sizeof(value)];
+  support::endian::write64le(bytes, value);
+  os.write(bytes, sizeof(bytes));
+}
+
+static void WriteCacheString(raw_ostream &os, StringRef text) {
+  WriteCacheValue(os, text.size());
+  os << text;
+}
+
+class CacheReader {
+private:
+  StringRef data;
+
+public:
+  explicit CacheReader(StringRef _data) : data(_data) {}
+
+  bool ReadValue(uint64_t &value) {
+    if (data.size() < sizeof(value)) {
+      return false;
+    }
+    value = support::endian::read64le(data.data());
+    data = data.drop_front(sizeof(value));
+    return true;
+  }
+
+  bool ReadString(std::string &text) {
+    uint64_t length;
+    if (!ReadValue(length) || data.size() < length) {
+      return false;
+    }
+    text = data.take_front(length).str();
+    data = data.drop_front(length);
+    return true;
+  }
+
+  bool IsEnd() const { return data.empty(); }
+};
+
+static void WriteDependencies(raw_ostream &os,
+                              std::vector<Dependency> const &dependencies) {
+  WriteCacheValue(os, dependencies.size());
+  for (auto const &dependency : dependencies) {
+    WriteCacheString(os, dependency.path);
+    WriteCacheValue(os, dependency.size);
+    WriteCacheValue(os, static_cast<uint64_t>(dependency.modified));
+    WriteCacheValue(os, dependency.hash);
+  }
+}
+
+static bool ReadDependencies(CacheReader &reader,
+                             std::vector<Dependency> &dependencies) {
+  uint64_t length;
+  if (!reader.ReadValue(length)) {
+    return false;
+  }
+  dependencies.resize(length);
+  for (auto &dependency : dependencies) {
+    uint64_t modified;
+    if (!reader.ReadString(dependency.path) ||
+        !reader.ReadValue(dependency.size) || !reader.ReadValue(modified) ||
+        !reader.ReadValue(dependency.hash)) {
+      return false;
+    }
+    dependency.modified = static_cast<int64_t>(modified);
+  }
+  return true;
+}
+
+// Precompiled prefix header. The headers every file starts with (the standard
+// library, engine headers) are parsed once per set of compile flags and loaded
+// with -include-pch by every file of that set. The PCH is kept next to the
+// cache (or in the temporary directory) together with the files it was built
+// from, later runs reuse it while none of them changed. A file that uses it
+// depends on these files too, so they are added to its cache dependencies.
+struct PrecompiledHeader {
+  // empty when the files are parsed without a PCH
+  std::string path;
+  std::vector<Dependency> dependencies;
+};
+
+// the flags of a compile command without its input and outputs, files compiled
+// with the same flags can load the same PCH
+static std::vector<std::string> GetCompileFlags(CompileCommand const &command) {
+  auto arguments = getClangStripOutputAdjuster()(command.CommandLine,
+                                                 command.Filename);
+  arguments =
+      getClangStripDependencyFileAdjuster()(arguments, command.Filename);
+
+  SmallString<256> absoluteFileName(command.Filename);
+  sys::fs::make_absolute(command.Directory, absoluteFileName);
+
+  std::vector<std::string> flags;
+  for (size_t i = 1; i < arguments.size(); ++i) {
+    StringRef argument = arguments[i];
+    if (argument == "-x") {
+      ++i;
+      continue;
+    }
+    if (argument == "-c" || argument == "--" || argument.startswith("-x") ||
+        argument == command.Filename || argument == absoluteFileName) {
+      continue;
+    }
+    flags.push_back(argument.str());
+  }
+  return flags;
+}
+
+static std::string GetPrecompiledHeaderPath(uint64_t key) {
+  SmallString<256> path;
+  if (!cacheFile.empty()) {
+    path = cacheFile;
+    path += ".";
+  } else {
+    sys::path::system_temp_directory(true, path);
+    sys::path::append(path, "meta_gen.");
+  }
+  path += utohexstr(key);
+  path += ".pch";
+  return path.str().str();
+}
+
+// builds a PCH of the prefix header and records which files went into it
+class PrefixHeaderAction : public GeneratePCHAction {
+public:
+  PrefixHeaderAction(std::string _outputFile, PrecompiledHeader &_result,
+                     DenseSet<FileID> &_annotatedFiles)
+      : outputFile(std::move(_outputFile)), result(_result),
+        annotatedFiles(_annotatedFiles) {}
+
+  bool BeginSourceFileAction(CompilerInstance &compiler) override {
+    compiler.getFrontendOpts().OutputFile = outputFile;
+    compiler.getPreprocessor().addPPCallbacks(
+        std::make_unique<AnnotatedFileCallbacks>(compiler.getSourceManager(),
+                                                 annotatedFiles));
+    return GeneratePCHAction::BeginSourceFileAction(compiler);
+  }
+
+  void EndSourceFileAction() override {
+    auto const &sourceManager = getCompilerInstance().getSourceManager();
+    auto &fileManager = sourceManager.getFileManager();
+    for (auto it = sourceManager.fileinfo_begin();
+         it != sourceManager.fileinfo_end(); ++it) {
+      SmallString<256> path(it->first->getName());
+      fileManager.makeAbsolutePath(path);
+      Dependency dependency;
+      if (GetDependency(path, dependency)) {
+        result.dependencies.push_back(std::move(dependency));
+      }
+    }
+    GeneratePCHAction::EndSourceFileAction();
+  }
+
+private:
+  std::string outputFile;
+  PrecompiledHeader &result;
+  DenseSet<FileID> &annotatedFiles;
+};
+
+// clang checks the size and time of every input of a PCH when loading it, so
+// unlike the generated files a PCH is only reused when both still match
+static bool IsIdentical(Dependency const &dependency) {
+  sys::fs::file_status status;
+  return !sys::fs::status(dependency.path, status) &&
+         status.getSize() == dependency.size &&
+         status.getLastModificationTime().time_since_epoch().count() ==
+             dependency.modified;
+}
+
+// PCH file, then "<PCH file>.deps" with the generator and compiler version and
+// the dependencies of the PCH
+static bool LoadPrecompiledHeader(std::string const &path,
+                                  PrecompiledHeader &header) {
+  auto buffer = MemoryBuffer::getFile(path + ".deps");
+  if (!buffer || !sys::fs::exists(path)) {
+    return false;
+  }
+
+  CacheReader reader((*buffer)->getBuffer());
+  std::string version;
+  if (!reader.ReadString(version) ||
+      version != std::string(kGeneratorVersion) + ' ' + getClangFullVersion() ||
+      !ReadDependencies(reader, header.dependencies) ||
+      !std::all_of(header.dependencies.begin(), header.dependencies.end(),
+                   IsIdentical)) {
+    header.dependencies.clear();
+    return false;
+  }
+  header.path = path;
+  return true;
+}
+
+static PrecompiledHeader BuildPrecompiledHeader(CompileCommand const &command,
+                                                std::vector<std::string> flags,
+                                                uint64_t key) {
+  PrecompiledHeader header;
+  auto path = GetPrecompiledHeaderPath(key);
+  if (LoadPrecompiledHeader(path, header)) {
+    return header;
+  }
+
+  FixedCompilationDatabase database(command.Directory, flags);
+  IntrusiveRefCntPtr<vfs::FileSystem> fileSystem(
+      vfs::createPhysicalFileSystem().release());
+  ClangTool tool(database, {prefixHeader},
+                 std::make_shared<PCHContainerOperations>(), fileSystem);
+  tool.appendArgumentsAdjuster(
+      getInsertArgumentAdjuster(CommandLineArguments{"-x", "c++-header"},
+                                ArgumentInsertPosition::BEGIN));
+
+  DenseSet<FileID> annotatedFiles;
+  CallbackActionFactory factory([&] {
+    return std::make_unique<PrefixHeaderAction>(path, header, annotatedFiles);
+  });
+  // a header that failed keeps its dependencies, so that a daemon tries again
+  // once one of them changed
+  if (tool.run(&factory) != 0) {
+    Warnings() << "warning: could not precompile " << prefixHeader
+               << ", files are parsed without it\n";
+    return header;
+  }
+
+  // reflected types in the PCH would be invisible to the visitor
+  if (!annotatedFiles.empty()) {
+    Warnings() << "warning: " << prefixHeader
+               << " declares reflected types, files are parsed without it\n";
+    sys::fs::remove(path);
+    return header;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream os(path + ".deps", error);
+  if (!error) {
+    WriteCacheString(os, std::string(kGeneratorVersion) + ' ' +
+                             getClangFullVersion());
+    WriteDependencies(os, header.dependencies);
+  }
+  header.path = path;
+  return header;
+}
+
+// the PCHs of a run, built by the first worker that needs one; a daemon keeps
+// them for later runs and builds one again once one of its inputs changed
+class PrefixHeaders {
+private:
+  std::mutex mutex;
+  std::unordered_map<uint64_t, std::shared_future<PrecompiledHeader>> headers;
+
+  static bool IsStale(std::shared_future<PrecompiledHeader> const &header) {
+    if (header.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return false;
+    }
+    auto const &dependencies = header.get().dependencies;
+    return !std::all_of(dependencies.begin(), dependencies.end(), IsIdentical);
+  }
+
+public:
+  PrecompiledHeader Get(CompileCommand const &command) {
+    auto flags = GetCompileFlags(command);
+    std::string key = std::string(kGeneratorVersion) + '\0' +
+                      command.Directory + '\0' + prefixHeader;
+    for (auto const &flag : flags) {
+      key += '\0' + flag;
+    }
+    uint64_t hash = xxHash64(key);
+
+    std::promise<PrecompiledHeader> promise;
+    std::shared_future<PrecompiledHeader> header;
+    bool build = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = headers.find(hash);
+      if (it != headers.end() && IsStale(it->second)) {
+        headers.erase(it);
+        it = headers.end();
+      }
+      if (it == headers.end()) {
+        header = promise.get_future().share();
+        headers.emplace(hash, header);
+        build = true;
+      } else {
+        header = it->second;
+      }
+    }
+
+    if (build) {
+      promise.set_value(
+          BuildPrecompiledHeader(command, std::move(flags), hash));
+    }
+    return header.get();
+  }
+};
+
+// parses one source file with a frontend of its own, safe to call from
+// several threads
+static GeneratedFile GenerateFile(CompilationDatabase const &compilations,
+                                  std::string const &sourcePath,
+                                  PrefixHeaders &prefixHeaders) {
+  TraceScope scope("Translation unit", sourcePath);
+  GeneratedFile result;
+  raw_string_ostream warnings(result.warnings);
+  warningStream = &warnings;
+
+  // every tool gets a file system with its own working directory, ClangTool
+  // would otherwise change the process-wide one under the other workers
+  IntrusiveRefCntPtr<vfs::FileSystem> fileSystem(
+      vfs::createPhysicalFileSystem().release());
+  ClangTool tool(compilations, {sourcePath},
+                 std::make_shared<PCHContainerOperations>(), fileSystem);
+
+  // the first file of a set of flags builds the prefix header, the others
+  // wait for it
+  auto start = Clock::now();
+  auto commands = compilations.getCompileCommands(sourcePath);
+  if (!prefixHeader.empty() && !commands.empty()) {
+    auto header = prefixHeaders.Get(commands.front());
+    if (!header.path.empty()) {
+      tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+          CommandLineArguments{"-include-pch", header.path},
+          ArgumentInsertPosition::BEGIN));
+      result.dependencies = std::move(header.dependencies);
+    }
+  }
+
+  // whatever is not traversing or rendering is spent in the frontend, most
+  // of it parsing
+  auto parseStart = Clock::now();
+  if (!prefixHeader.empty()) {
+    AddTraceEvent("Precompile", sourcePath, start, parseStart);
+  }
+  CallbackActionFactory factory(
+      [&result] { return std::make_unique<AnnotationAction>(result); });
+  result.failed = tool.run(&factory) != 0;
+  result.times.precompile = GetMilliseconds(start, parseStart);
+  result.times.parse = GetMilliseconds(parseStart, Clock::now()) -
+                       result.times.traverse - result.times.dependencies -
+                       result.times.render;
+  warnings.flush();
+  warningStream = nullptr;
+  return result;
+}
+
+// the compile command, the generator and every option that changes the output
+static uint64_t GetCacheKey(CompilationDatabase const &compilations,
+                            std::string const &sourcePath) {
+  std::string key = kGeneratorVersion;
+  for (auto const &command : compilations.getCompileCommands(sourcePath)) {
+    key += '\0' + command.Directory + '\0' + command.Filename;
+    for (auto const &argument : command.CommandLine) {
+      key += '\0' + argument;
+    }
+  }
+  key += '\0' + std::to_string(layoutReport ? 1 : 0) + ' ' +
+         std::to_string(static_cast<unsigned>(cacheLineSize)) + ' ' +
+         std::to_string(emitPadded ? 1 : 0) + ' ' +
+         std::to_string(emitCpp ? 1 : 0) + '\0' + prefixHeader;
+  return xxHash64(key);
+}
+
+static void LoadCache(std::unordered_map<std::string, CacheEntry> &entries) {
+  TraceScope scope("Load cache", cacheFile);
+  auto buffer = MemoryBuffer::getFile(cacheFile);
+  if (!buffer) {
+    return;
+  }
+
+  CacheReader reader((*buffer)->getBuffer());
+  std::string version;
+  if (!reader.ReadString(version) || version != kGeneratorVersion) {
+    return;
+  }
+
+  while (!reader.IsEnd()) {
+    std::string sourcePath;
+    CacheEntry entry;
+    uint64_t length;
+    auto &file = entry.file;
+    if (!reader.ReadString(sourcePath) || !reader.ReadValue(entry.key) ||
+        !reader.ReadString(file.fileName) ||
+        !reader.ReadString(file.warnings) ||
+        !ReadDependencies(reader, file.dependencies) ||
+        !reader.ReadValue(length)) {
+      return;
+    }
+    file.records.resize(length);
+    for (auto &record : file.records) {
+      uint64_t fields;
+      uint64_t methods;
+      if (!reader.ReadValue(length)) {
+        return;
+      }
+      record.predefinedTypes.resize(length);
+      for (auto &name : record.predefinedTypes) {
+        if (!reader.ReadString(name)) {
+          return;
+        }
+      }
+      if (!reader.ReadString(record.name) ||
+          !reader.ReadString(record.declaringFile) ||
+          !reader.ReadString(record.instantiation) ||
+          !reader.ReadString(record.body) ||
+          !reader.ReadString(record.definitions) ||
+          !reader.ReadString(record.layout) ||
+          !reader.ReadString(record.getter) || !reader.ReadValue(fields) ||
+          !reader.ReadValue(methods)) {
+        return;
+      }
+      record.fields = fields;
+      record.methods = methods;
+    }
+    entries[sourcePath] = std::move(entry);
+  }
+}
+
+static void SaveCache(std::vector<std::string> const &sourcePaths,
+                      std::vector<uint64_t> const &keys,
+                      std::vector<GeneratedFile> const &files) {
+  TraceScope scope("Save cache", cacheFile);
+  // written next to the cache and renamed, an interrupted run keeps the old one
+  std::string temporaryName = cacheFile + ".tmp";
+  std::error_code error;
+  {
+    llvm::raw_fd_ostream os(temporaryName, error);
+    if (error) {
+      return;
+    }
+
+    WriteCacheString(os, kGeneratorVersion);
+    for (size_t i = 0; i < files.size(); ++i) {
+      auto const &file = files[i];
+      if (file.failed) {
+        continue;
+      }
+
+      WriteCacheString(os, sourcePaths[i]);
+      WriteCacheValue(os, keys[i]);
+      WriteCacheString(os, file.fileName);
+      WriteCacheString(os, file.warnings);
+      WriteDependencies(os, file.dependencies);
+      WriteCacheValue(os, file.records.size());
+      for (auto const &record : file.records) {
+        WriteCacheValue(os, record.predefinedTypes.size());
+        for (auto const &name : record.predefinedTypes) {
+          WriteCacheString(os, name);
+        }
+        WriteCacheString(os, record.name);
+        WriteCacheString(os, record.declaringFile);
+        WriteCacheString(os, record.instantiation);
+        WriteCacheString(os, record.body);
+        WriteCacheString(os, record.definitions);
+        WriteCacheString(os, record.layout);
+        WriteCacheString(os, record.getter);
+        WriteCacheValue(os, record.fields);
+        WriteCacheValue(os, record.methods);
+      }
+    }
+  }
+  sys::fs::rename(temporaryName, cacheFile);
+}
+
+// an unchanged file keeps its time stamp, so nothing that includes it is
+// rebuilt; returns whether the file was written
+static bool WriteIfChanged(std::string const &fileName,
+                           std::string const &content) {
+  TraceScope scope("Write file", fileName);
+  auto existing = MemoryBuffer::getFile(fileName);
+  if (existing && (*existing)->getBuffer() == content) {
+    return false;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream os(fileName, error);
+  os << content;
+  return true;
+}
+
+struct GenerationStats {
+  unsigned hits = 0;
+  unsigned misses = 0;
+  unsigned written = 0;
+  unsigned unchanged = 0;
+  // what the generated files contain, cached files included
+  unsigned records = 0;
+  unsigned fields = 0;
+  unsigned methods = 0;
+  unsigned predefinedTypes = 0;
+  uint64_t generatedBytes = 0;
+};
+
+// Compile cost of generated code in relative units, about one per simple
+// statement. The descriptors are dominated by template work: every GetType<T>,
+// Tag<T> or TypeStorage<T> names a specialization that has to be looked up or
+// instantiated, every DECLARE_TYPE specializes GetTypeImpl with four branches
+// of type traits and every static object adds a guarded initializer. Only the
+// ranking matters, the units do not translate to milliseconds.
+constexpr uint64_t kCostPerLine = 1;
+constexpr uint64_t kCostPerTemplateUse = 4;
+constexpr uint64_t kCostPerStaticObject = 2;
+constexpr uint64_t kCostPerPredefinedType = 24;
+
+struct CompileCost {
+  uint64_t bytes = 0;
+  uint64_t cost = 0;
+};
+
+static CompileCost EstimateCompileCost(StringRef code) {
+  CompileCost result;
+  result.bytes = code.size();
+  result.cost = code.count('\n') * kCostPerLine +
+                (code.count("GetType<") + code.count("Tag<") +
+                 code.count("TypeStorage<")) *
+                    kCostPerTemplateUse +
+                code.count("static ") * kCostPerStaticObject +
+                (code.count("DECLARE_TYPE(") + code.count("DEFINE_TYPE(")) *
+                    kCostPerPredefinedType;
+  return result;
+}
+
+// a generated file and the records in it, for -cost-report
+struct FileCost {
+  std::string fileName;
+  CompileCost total;
+  std::vector<std::pair<std::string, CompileCost>> parts;
+};
+
+static void WriteCostReport(std::vector<FileCost> &files) {
+  auto byCost = [](CompileCost const &a, CompileCost const &b) {
+    return a.cost > b.cost;
+  };
+  std::stable_sort(files.begin(), files.end(),
+                   [&](FileCost const &a, FileCost const &b) {
+                     return byCost(a.total, b.total);
+                   });
+
+  std::string report;
+  raw_string_ostream os(report);
+  os << "// estimated compile cost of the generated files, in relative units\n";
+  for (auto &file : files) {
+    std::stable_sort(file.parts.begin(), file.parts.end(),
+                     [&](std::pair<std::string, CompileCost> const &a,
+                         std::pair<std::string, CompileCost> const &b) {
+                       return byCost(a.second, b.second);
+                     });
+    os << file.fileName << ": cost " << file.total.cost << ", "
+       << file.total.bytes << " bytes\n";
+    for (auto const &part : file.parts) {
+      unsigned percent =
+          file.total.cost > 0 ? part.second.cost * 100 / file.total.cost : 0;
+      os << llvm::format("  %8llu %3u%%  ",
+                         static_cast<unsigned long long>(part.second.cost),
+                         percent)
+         << part.first << "\n";
+    }
+  }
+  os.flush();
+  WriteIfChanged(costReport, report);
+}
+
+// #include "Foo.h" in a file generated next to generatedFile
+static std::string GetIncludePath(StringRef generatedFile, StringRef file) {
+  SmallString<256> path(file);
+  sys::fs::make_absolute(path);
+  sys::path::remove_dots(path, true);
+  SmallString<256> directory(sys::path::parent_path(generatedFile));
+  sys::fs::make_absolute(directory);
+  sys::path::remove_dots(directory, true);
+  if (sys::path::parent_path(path) == directory) {
+    return sys::path::filename(path).str();
+  }
+  return path.str().str();
+}
+
+// the project-wide translation unit of -emit-cpp, it defines every pointer,
+// array and reference type used by the split records of all files once
+static void WriteTypesFile(std::vector<GeneratedFile> const &files,
+                           std::vector<std::string> const &names,
+                           GenerationStats &stats,
+                           std::vector<FileCost> &costs) {
+  std::string content;
+  raw_string_ostream os(content);
+  os << "// auto-generated file.\n";
+  os << "#include \"reflection.hpp\"\n";
+  std::vector<std::string> includes;
+  for (auto const &file : files) {
+    for (auto const &record : file.records) {
+      auto include = GetIncludePath(typesFile, record.declaringFile);
+      if (record.IsSplit() && std::find(includes.begin(), includes.end(),
+                                        include) == includes.end()) {
+        includes.push_back(include);
+        os << "#include \"" << include << "\"\n";
+      }
+    }
+  }
+  os << "\n\n\n";
+  PrintNamespace(os);
+  for (auto const &name : names) {
+    PrintIndent(os, 1);
+    os << "DEFINE_TYPE(" << name << ");\n";
+  }
+  PrintEndNamespace(os);
+  os.flush();
+
+  stats.predefinedTypes += names.size();
+  stats.generatedBytes += content.size();
+  auto cost = EstimateCompileCost(content);
+  costs.push_back(
+      FileCost{typesFile, cost, {{"predefined types", cost}}});
+
+  if (WriteIfChanged(typesFile, content)) {
+    llvm::outs() << typesFile << " generated.\n";
+    stats.written++;
+  } else {
+    stats.unchanged++;
+  }
+}
+
+// Every file that uses Vec<float, 4> defines its descriptor inline, a
+// translation unit that includes several of them keeps the first definition
+// and the linker merges the rest into one descriptor.
+static void PrintInstantiation(raw_ostream &os, GeneratedRecord const &record) {
+  std::string guard =
+      "REFL_INSTANTIATION_" + utohexstr(xxHash64(record.instantiation));
+  os << "#ifndef " << guard << "\n";
+  os << "#define " << guard << "\n";
+  os << record.body;
+  os << "#endif\n";
+}
+
+// writes the generated files in input order, so that the output does not
+// depend on which worker finished first
+static void WriteGeneratedFiles(std::vector<GeneratedFile> const &files,
+                                GenerationStats &stats) {
+  std::unordered_map<std::string, int> name2PredefinedType;
+  std::vector<FileCost> costs;
+
+  // with -emit-cpp the predefined types of split records are defined once for
+  // the whole project and only declared by the headers
+  std::vector<std::string> externTypes;
+  StringSet<> externTypeSet;
+  if (emitCpp) {
+    for (auto const &file : files) {
+      for (auto const &record : file.records) {
+        for (auto const &name : record.predefinedTypes) {
+          if (record.IsSplit() && externTypeSet.insert(name).second) {
+            externTypes.push_back(name);
+          }
+        }
+      }
+    }
+  }
+
+  for (auto const &file : files) {
+    llvm::errs() << file.warnings;
+    if (file.records.empty()) {
+      continue;
+    }
+
+    std::string fileNameWithoutExt =
+        file.fileName.substr(0, file.fileName.rfind("."));
+    std::string headerName = fileNameWithoutExt + "_gen_refl.h";
+    std::string sourceName = fileNameWithoutExt + "_gen_refl.cpp";
+
+    std::string content;
+    raw_string_ostream os(content);
+    FileCost headerCost;
+    PrintHeader(os);
+    PrintNamespace(os);
+    StringSet<> externDeclared;
+    for (auto const &record : file.records) {
+      // the declarations a record adds are charged to the record
+      std::string declarations;
+      raw_string_ostream dos(declarations);
+      for (auto const &name : record.predefinedTypes) {
+        if (externTypeSet.count(name) > 0) {
+          if (externDeclared.insert(name).second) {
+            PrintIndent(dos, 1);
+            dos << "DECLARE_EXTERN_TYPE(" << name << ");\n";
+          }
+        } else if (name2PredefinedType.count(name) <= 0) {
+          name2PredefinedType[name] = 1;
+          PrintIndent(dos, 1);
+          dos << "DECLARE_TYPE(" << name << ");\n";
+          stats.predefinedTypes++;
+        }
+      }
+      dos << " \n";
+      dos.flush();
+      auto recordCost = EstimateCompileCost(declarations);
+      auto bodyCost = EstimateCompileCost(record.body);
+      recordCost.bytes += bodyCost.bytes;
+      recordCost.cost += bodyCost.cost;
+      headerCost.parts.emplace_back(record.name, recordCost);
+
+      os << declarations;
+      if (record.instantiation.empty()) {
+        os << record.body;
+      } else {
+        PrintInstantiation(os, record);
+      }
+      stats.records++;
+      stats.fields += record.fields;
+      stats.methods += record.methods;
+    }
+    PrintTypeList(os, file);
+    PrintEndNamespace(os);
+    os.flush();
+
+    stats.generatedBytes += content.size();
+    headerCost.fileName = headerName;
+    headerCost.total = EstimateCompileCost(content);
+    costs.push_back(std::move(headerCost));
+
+    if (WriteIfChanged(headerName, content)) {
+      llvm::outs() << headerName << " generated.\n";
+      stats.written++;
+    } else {
+      stats.unchanged++;
+    }
+
+    bool hasSplitRecords = std::any_of(
+        file.records.begin(), file.records.end(),
+        [](GeneratedRecord const &record) { return record.IsSplit(); });
+    if (hasSplitRecords) {
+      std::string source;
+      raw_string_ostream sos(source);
+      sos << "// auto-generated file.\n";
+      std::vector<std::string> includes;
+      for (auto const &record : file.records) {
+        auto include = GetIncludePath(sourceName, record.declaringFile);
+        if (record.IsSplit() && std::find(includes.begin(), includes.end(),
+                                          include) == includes.end()) {
+          includes.push_back(include);
+          sos << "#include \"" << include << "\"\n";
+        }
+      }
+      sos << "#include \"" << sys::path::filename(headerName) << "\"\n";
+      sos << "\n\n\n";
+      PrintNamespace(sos);
+      for (auto const &record : file.records) {
+        sos << record.definitions;
+      }
+      PrintEndNamespace(sos);
+      sos.flush();
+
+      stats.generatedBytes += source.size();
+      FileCost sourceCost{sourceName, EstimateCompileCost(source), {}};
+      for (auto const &record : file.records) {
+        if (record.IsSplit()) {
+          sourceCost.parts.emplace_back(record.name,
+                                        EstimateCompileCost(record.definitions));
+        }
+      }
+      costs.push_back(std::move(sourceCost));
+
+      if (WriteIfChanged(sourceName, source)) {
+        llvm::outs() << sourceName << " generated.\n";
+        stats.written++;
+      } else {
+        stats.unchanged++;
+      }
+    }
+
+    if (layoutReport) {
+      std::string reportName = fileNameWithoutExt + "_layout.txt";
+      std::string report;
+      for (auto const &record : file.records) {
+        report += record.layout;
+      }
+      if (WriteIfChanged(reportName, report)) {
+        llvm::outs() << reportName << " generated.\n";
+      }
+    }
+  }
+
+  if (emitCpp) {
+    WriteTypesFile(files, externTypes, stats, costs);
+  }
+  if (!costReport.empty()) {
+    WriteCostReport(costs);
+  }
+}
+
+// what is kept between the runs of a daemon; a single run starts with the
+// cache file
+struct GenerationState {
+  std::unordered_map<std::string, CacheEntry> cache;
+  PrefixHeaders prefixHeaders;
+  ThreadPool pool;
+
+  GenerationState() : pool(hardware_concurrency(jobs)) {}
+};
+
+// regenerates the files whose inputs changed since the last run, returns
+// whether every file could be parsed
+static bool Generate(CompilationDatabase const &compilations,
+                     std::vector<std::string> const &sourcePaths,
+                     GenerationState &state) {
+  std::vector<GeneratedFile> files(sourcePaths.size());
+  std::vector<uint64_t> keys(sourcePaths.size());
+  GenerationStats stats;
+
+  // files whose compile command and dependencies are unchanged reuse the
+  // cached result and are not parsed
+  auto cacheStart = Clock::now();
+  std::vector<size_t> misses;
+  for (size_t i = 0; i < sourcePaths.size(); ++i) {
+    keys[i] = GetCacheKey(compilations, sourcePaths[i]);
+    auto it = state.cache.find(sourcePaths[i]);
+    bool hit = it != state.cache.end() && it->second.key == keys[i] &&
+               std::all_of(it->second.file.dependencies.begin(),
+                           it->second.file.dependencies.end(), IsUnchanged);
+    if (hit) {
+      files[i] = it->second.file;
+      stats.hits++;
+    } else {
+      misses.push_back(i);
+      stats.misses++;
+    }
+  }
+
+  // one frontend per worker, every file writes only its own slot
+  auto generateStart = Clock::now();
+  for (auto i : misses) {
+    state.pool.async([&, i] {
+      files[i] =
+          GenerateFile(compilations, sourcePaths[i], state.prefixHeaders);
+    });
+  }
+  state.pool.wait();
+
+  auto writeStart = Clock::now();
+  WriteGeneratedFiles(files, stats);
+  if (!cacheFile.empty()) {
+    SaveCache(sourcePaths, keys, files);
+  }
+  for (auto i : misses) {
+    if (!files[i].failed) {
+      state.cache[sourcePaths[i]] = CacheEntry{keys[i], files[i]};
+    }
+  }
+  auto end = Clock::now();
+
+  llvm::outs() << "cache: " << stats.hits << " hits, " << stats.misses
+               << " misses; " << stats.written << " files written, "
+               << stats.unchanged << " unchanged\n";
+
+  if (traceRecorder != nullptr) {
+    AddTraceEvent("Cache lookup", StringRef(), cacheStart, generateStart);
+    AddTraceEvent("Generate", StringRef(), generateStart, writeStart);
+    AddTraceEvent("Write", StringRef(), writeStart, end);
+    std::pair<char const *, uint64_t> const counters[] = {
+        {"records", stats.records},
+        {"fields", stats.fields},
+        {"methods", stats.methods},
+        {"predefined types", stats.predefinedTypes},
+        {"generated bytes", stats.generatedBytes},
+        {"cache hits", stats.hits},
+        {"cache misses", stats.misses}};
+    for (auto const &counter : counters) {
+      traceRecorder->AddCounter(
+          TraceCounter{counter.first, end, counter.second});
+    }
+    traceRecorder->Write(timeTrace);
+    traceRecorder->Reset();
+  }
+
+  // the per file phases are summed over the workers, so together they can
+  // exceed the wall time of the generation
+  if (timing) {
+    PhaseTimes total;
+    for (auto i : misses) {
+      total += files[i].times;
+    }
+    llvm::errs()
+        << llvm::format("time: cache lookup %.1f ms\n",
+                        GetMilliseconds(cacheStart, generateStart))
+        << llvm::format("time: generate %.1f ms (%u files on %u workers)\n",
+                        GetMilliseconds(generateStart, writeStart),
+                        static_cast<unsigned>(misses.size()),
+                        state.pool.getThreadCount())
+        << llvm::format("time:   precompile %.1f ms\n", total.precompile)
+        << llvm::format("time:   parse %.1f ms\n", total.parse)
+        << llvm::format("time:   traverse %.1f ms\n", total.traverse)
+        << llvm::format("time:   dependencies %.1f ms\n", total.dependencies)
+        << llvm::format("time:   render %.1f ms\n", total.render)
+        << llvm::format("time: write %.1f ms\n",
+                        GetMilliseconds(writeStart, end))
+        << "generated: " << stats.records << " records, " << stats.fields
+        << " fields, " << stats.methods << " methods, "
+        << stats.predefinedTypes << " predefined types, "
+        << stats.generatedBytes << " bytes\n";
+  }
+
+  bool failed = false;
+  for (auto const &file : files) {
+    failed |= file.failed;
+  }
+  return !failed;
+}
+
+#ifdef __linux__
+// Watch mode. After the first run meta_gen stays up with its cache and PCHs in
+// memory, watches the directories of every file the generated files depend on
+// and runs again shortly after one of them was saved; the cache decides which
+// files are parsed. Each run gets fresh file managers, a cached stat of a file
+// that was just saved would be wrong. Build systems talk to the daemon
+// through a Unix socket, one command per line:
+//
+//   status  replies "fresh <run>", "failed <run>" or "stale <run>" at once
+//   wait    replies the same once no change is pending or being generated
+//   stop    ends the daemon
+//
+// Changes that arrive within kSettleDelay are generated together, editors
+// save a file in several steps.
+constexpr std::chrono::milliseconds kSettleDelay{20};
+
+class WatchDaemon {
+private:
+  struct Client {
+    int fd;
+    std::string input;
+    bool waiting;
+  };
+
+  CompilationDatabase const &compilations;
+  std::vector<std::string> const &sourcePaths;
+  GenerationState &state;
+
+  int inotifyFd = -1;
+  int listenFd = -1;
+  // signaled by the worker when a run is done
+  int doneFd = -1;
+  std::unordered_map<int, std::string> directories;
+  StringSet<> watchedDirectories;
+  StringSet<> dependencies;
+  std::vector<Client> clients;
+
+  std::thread worker;
+  bool runSucceeded = true;
+  bool succeeded;
+  bool running = false;
+  bool pending = false;
+  bool stopping = false;
+  unsigned runs = 1;
+  Clock::time_point lastChange;
+
+  void AddDependency(StringRef file) {
+    SmallString<256> path(file);
+    sys::fs::make_absolute(path);
+    sys::path::remove_dots(path, true);
+    dependencies.insert(path);
+
+    auto directory = sys::path::parent_path(path);
+    if (watchedDirectories.insert(directory).second) {
+      SmallString<256> name(directory);
+      int watchFd = inotify_add_watch(inotifyFd, name.c_str(),
+                                      IN_CLOSE_WRITE | IN_MOVED_TO |
+                                          IN_CREATE | IN_DELETE);
+      if (watchFd >= 0) {
+        directories[watchFd] = name.str().str();
+      }
+    }
+  }
+
+  // the files of the last run, a file that failed to parse is at least
+  // watched itself
+  void UpdateWatches() {
+    dependencies.clear();
+    for (auto const &sourcePath : sourcePaths) {
+      AddDependency(sourcePath);
+      auto it = state.cache.find(sourcePath);
+      if (it != state.cache.end()) {
+        for (auto const &dependency : it->second.file.dependencies) {
+          AddDependency(dependency.path);
+        }
+      }
+    }
+  }
+
+  char const *GetStatus() const {
+    if (pending || running) {
+      return "stale";
+    }
+    return succeeded ? "fresh" : "failed";
+  }
+
+  void Reply(Client const &client, StringRef text) {
+    std::string line = text.str() + ' ' + std::to_string(runs) + '\n';
+    ::send(client.fd, line.data(), line.size(), MSG_NOSIGNAL);
+  }
+
+  void ReadChanges() {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+      for (char *it = buffer; it < buffer + length;) {
+        auto *event = reinterpret_cast<inotify_event *>(it);
+        it += sizeof(inotify_event) + event->len;
+
+        bool changed = (event->mask & IN_Q_OVERFLOW) != 0;
+        auto directory = directories.find(event->wd);
+        if (!changed && event->len > 0 && directory != directories.end()) {
+          SmallString<256> path(directory->second);
+          sys::path::append(path, event->name);
+          changed = dependencies.count(path) > 0;
+        }
+        if (changed) {
+          pending = true;
+          lastChange = Clock::now();
+        }
+      }
+    }
+  }
+
+  // returns false once the client is gone
+  bool ReadClient(Client &client) {
+    char buffer[256];
+    ssize_t length = ::read(client.fd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return length < 0 && errno == EAGAIN;
+    }
+    client.input.append(buffer, length);
+
+    size_t end;
+    while ((end = client.input.find('\n')) != std::string::npos) {
+      StringRef command = StringRef(client.input).take_front(end).trim();
+      if (command == "status") {
+        Reply(client, GetStatus());
+      } else if (command == "wait") {
+        if (pending || running) {
+          client.waiting = true;
+        } else {
+          Reply(client, GetStatus());
+        }
+      } else if (command == "stop") {
+        stopping = true;
+      } else {
+        Reply(client, "error");
+      }
+      client.input.erase(0, end + 1);
+    }
+    return true;
+  }
+
+  void StartRun() {
+    pending = false;
+    running = true;
+    worker = std::thread([this] {
+      runSucceeded = Generate(compilations, sourcePaths, state);
+      uint64_t one = 1;
+      ::write(doneFd, &one, sizeof(one));
+    });
+  }
+
+  void FinishRun() {
+    uint64_t count;
+    ::read(doneFd, &count, sizeof(count));
+    worker.join();
+    running = false;
+    succeeded = runSucceeded;
+    runs++;
+    llvm::outs().flush();
+    UpdateWatches();
+
+    if (!pending) {
+      for (auto &client : clients) {
+        if (client.waiting) {
+          Reply(client, GetStatus());
+          client.waiting = false;
+        }
+      }
+    }
+  }
+
+public:
+  WatchDaemon(CompilationDatabase const &_compilations,
+              std::vector<std::string> const &_sourcePaths,
+              GenerationState &_state, bool _succeeded)
+      : compilations(_compilations), sourcePaths(_sourcePaths), state(_state),
+        succeeded(_succeeded) {}
+
+  ~WatchDaemon() {
+    if (worker.joinable()) {
+      worker.join();
+    }
+    for (auto const &client : clients) {
+      ::close(client.fd);
+    }
+    for (int fd : {inotifyFd, listenFd, doneFd}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    if (listenFd >= 0) {
+      ::unlink(watchSocket.c_str());
+    }
+  }
+
+  bool Start() {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (watchSocket.size() >= sizeof(address.sun_path)) {
+      llvm::errs() << "error: socket path " << watchSocket << " is too long\n";
+      return false;
+    }
+    std::copy(watchSocket.begin(), watchSocket.end(), address.sun_path);
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    doneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int socketFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (inotifyFd < 0 || doneFd < 0 || socketFd < 0) {
+      llvm::errs() << "error: " << std::strerror(errno) << "\n";
+      if (socketFd >= 0) {
+        ::close(socketFd);
+      }
+      return false;
+    }
+
+    // a socket left behind by a daemon that was killed is replaced;
+    // sys::fs::remove refuses to remove sockets
+    ::unlink(watchSocket.c_str());
+    if (::bind(socketFd, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(socketFd, 16) != 0) {
+      llvm::errs() << "error: cannot listen on " << watchSocket << ": "
+                   << std::strerror(errno) << "\n";
+      ::close(socketFd);
+      return false;
+    }
+    listenFd = socketFd;
+
+    UpdateWatches();
+    return true;
+  }
+
+  // returns whether the last run succeeded
+  bool Run() {
+    while (!stopping) {
+      std::vector<pollfd> fds = {{inotifyFd, POLLIN, 0},
+                                 {doneFd, POLLIN, 0},
+                                 {listenFd, POLLIN, 0}};
+      for (auto const &client : clients) {
+        fds.push_back({client.fd, POLLIN, 0});
+      }
+
+      int timeout = -1;
+      if (pending && !running) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            kSettleDelay - (Clock::now() - lastChange));
+        timeout = std::max<int>(0, wait.count());
+      }
+      if (::poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+        llvm::errs() << "error: " << std::strerror(errno) << "\n";
+        break;
+      }
+
+      if (fds[0].revents & POLLIN) {
+        ReadChanges();
+      }
+      if (fds[1].revents & POLLIN) {
+        FinishRun();
+      }
+      for (size_t i = clients.size(); i-- > 0;) {
+        if (fds[3 + i].revents != 0 && !ReadClient(clients[i])) {
+          ::close(clients[i].fd);
+          clients.erase(clients.begin() + i);
+        }
+      }
+      if (fds[2].revents & POLLIN) {
+        int clientFd =
+            ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientFd >= 0) {
+          clients.push_back(Client{clientFd, std::string(), false});
+        }
+      }
+
+      if (pending && !running && Clock::now() - lastChange >= kSettleDelay) {
+        StartRun();
+      }
+    }
+
+    if (running) {
+      worker.join();
+      succeeded = runSucceeded;
+    }
+    return succeeded;
+  }
+};
+#endif
+
+static bool Watch(CompilationDatabase const &compilations,
+                  std::vector<std::string> const &sourcePaths,
+                  GenerationState &state, bool succeeded) {
+#ifdef __linux__
+  WatchDaemon daemon(compilations, sourcePaths, state, succeeded);
+  if (!daemon.Start()) {
+    return false;
+  }
+  llvm::outs() << "watching, socket " << watchSocket << "\n";
+  llvm::outs().flush();
+  return daemon.Run();
+#else
+  llvm::errs() << "error: -watch is only supported on Linux\n";
+  return false;
+#endif
+}
+
+int main(int argc, const char **argv) {
+  auto optionsParser = CommonOptionsParser::create(argc, argv, optionCategory);
+  if (!optionsParser) {
+    llvm::errs() << optionsParser.takeError();
+    return 1;
+  }
+
+  auto const &compilations = optionsParser->getCompilations();
+  auto const &sourcePaths = optionsParser->getSourcePathList();
+
+  // the PCH is built in the directory of a compile command
+  if (!prefixHeader.empty()) {
+    SmallString<256> path(prefixHeader);
+    sys::fs::make_absolute(path);
+    prefixHeader.setValue(path.str().str());
+  }
+
+  TraceRecorder recorder;
+  if (!timeTrace.empty()) {
+    traceRecorder = &recorder;
+  }
+
+  GenerationState state;
+  if (!cacheFile.empty()) {
+    LoadCache(state.cache);
+  }
+
+  bool succeeded = Generate(compilations, sourcePaths, state);
+  if (watch) {
+    return Watch(compilations, sourcePaths, state, succeeded) ? 0 : 1;
+  }
+  return succeeded ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+#pragma once
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define REFL_SIMD_SHUFFLE 1
+#else
+#define REFL_SIMD_SHUFFLE 0
+#endif
+
+#include "serialization.hpp"
+
+#if defined(_MSC_VER)
+#define REFL_BSWAP16(x) _byteswap_ushort(x)
+#define REFL_BSWAP32(x) _byteswap_ulong(x)
+#define REFL_BSWAP64(x) _byteswap_uint64(x)
+#else
+#define REFL_BSWAP16(x) __builtin_bswap16(x)
+#define REFL_BSWAP32(x) __builtin_bswap32(x)
+#define REFL_BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+namespace Reflection
+{
+	enum class ByteOrder : Byte
+	{
+		kLittle,
+		kBig,
+		kNative = REFL_LITTLE_ENDIAN ? kLittle : kBig
+	};
+
+	// count consecutive values of one width starting at offset
+	struct ByteSwapRun
+	{
+		Offset offset;
+		Size count;
+	};
+
+	static inline void SwapValues(BytePointer data, Size count, Size width) noexcept
+	{
+		Size i = 0;
+
+#if REFL_SIMD_SHUFFLE
+		__m128i mask;
+		switch (width)
+		{
+		case 2: mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14); break;
+		case 4: mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12); break;
+		default: mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8); break;
+		}
+
+		Size perVector = 16 / width;
+		for (; i + perVector <= count; i += perVector)
+		{
+			auto p = reinterpret_cast<__m128i*>(data + i * width);
+			_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			BytePointer p = data + i * width;
+			switch (width)
+			{
+			case 2: { uint16_t v; REFL_MEMCPY(&v, p, 2); v = REFL_BSWAP16(v); REFL_MEMCPY(p, &v, 2); break; }
+			case 4: { uint32_t v; REFL_MEMCPY(&v, p, 4); v = REFL_BSWAP32(v); REFL_MEMCPY(p, &v, 4); break; }
+			case 8: { uint64_t v; REFL_MEMCPY(&v, p, 8); v = REFL_BSWAP64(v); REFL_MEMCPY(p, &v, 8); break; }
+			}
+		}
+	}
+
+	// Byte-swap plan over one element of a reflected type. Scalars are grouped by width into runs;
+	// when every scalar fits in a 16-byte lane the whole element is also folded into a repeating
+	// shuffle pattern so arrays of structs are swapped 16 bytes at a time. Cold fields of split
+	// objects get runs of their own, applied through the side allocation pointer of each element.
+	class ByteSwapPlan
+	{
+	private:
+		static constexpr Size kWidthsLength = 3;
+
+		typedef std::vector<Offset> OffsetLists[kWidthsLength];
+		typedef std::vector<ByteSwapRun> RunLists[kWidthsLength];
+
+		// scalars of the side allocation the pointer at offset pointer refers to
+		struct SideOffsets
+		{
+			Offset pointer;
+			OffsetLists offsets;
+		};
+
+		struct SideRuns
+		{
+			Offset pointer;
+			RunLists runs;
+		};
+
+		Size stride;
+		RunLists runs;
+		std::vector<SideRuns> sides;
+		std::vector<Byte> pattern;
+
+		static Size GetWidth(Size index) noexcept { return Size(2) << index; }
+
+		static OffsetLists& GetSideOffsets(std::vector<SideOffsets>& sides, Offset pointer)
+		{
+			for (auto& side : sides)
+			{
+				if (side.pointer == pointer)
+				{
+					return side.offsets;
+				}
+			}
+
+			sides.emplace_back();
+			sides.back().pointer = pointer;
+			return sides.back().offsets;
+		}
+
+		static void Collect(Type const* type, Offset base, DataLayout layout, OffsetLists& offsets, std::vector<SideOffsets>& sides)
+		{
+			if (type->IsPointer() || type->IsReference())
+			{
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				Size elementSize = layout == DataLayout::kObject ? elementType->GetSize() : GetSerializedSize(elementType);
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					Collect(elementType, base + i * elementSize, layout, offsets, sides);
+				}
+				return;
+			}
+
+			if (type->IsBuiltin())
+			{
+				// single bytes need no swap, wider values than 8 bytes have no portable representation
+				for (Size i = 0; i < kWidthsLength; ++i)
+				{
+					if (type->GetSize() == GetWidth(i))
+					{
+						offsets[i].push_back(base);
+					}
+				}
+				return;
+			}
+
+			Offset packed = base;
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!IsSerializableField(field))
+				{
+					continue;
+				}
+
+				if (layout == DataLayout::kSerialized)
+				{
+					Collect(field->GetType(), packed, layout, offsets, sides);
+					packed += GetSerializedSize(field->GetType());
+				}
+				else if (field->IsIndirect())
+				{
+					Collect(field->GetType(), field->GetOffset(), layout, GetSideOffsets(sides, base + field->GetIndirection()), sides);
+				}
+				else
+				{
+					Collect(field->GetType(), base + field->GetOffset(), layout, offsets, sides);
+				}
+			}
+		}
+
+		void BuildPattern()
+		{
+			Size length = stride <= 16 && 16 % stride == 0 ? 16 : (stride % 16 == 0 ? stride : 0);
+			if (length == 0)
+			{
+				return;
+			}
+
+			std::vector<Size> permutation(stride);
+			for (Size i = 0; i < stride; ++i)
+			{
+				permutation[i] = i;
+			}
+
+			for (Size w = 0; w < kWidthsLength; ++w)
+			{
+				Size width = GetWidth(w);
+				for (auto& run : runs[w])
+				{
+					for (Size i = 0; i < run.count; ++i)
+					{
+						Offset offset = run.offset + i * width;
+						if (offset % 16 + width > 16)
+						{
+							// crosses a lane, pshufb can not move it
+							return;
+						}
+
+						for (Size b = 0; b < width; ++b)
+						{
+							permutation[offset + b] = offset + width - 1 - b;
+						}
+					}
+				}
+			}
+
+			pattern.resize(length);
+			for (Size i = 0; i < length; ++i)
+			{
+				// shuffle indices are relative to the 16-byte lane
+				pattern[i] = static_cast<Byte>(((i / stride) * stride + permutation[i % stride]) % 16);
+			}
+		}
+
+		static void BuildRuns(OffsetLists& offsets, RunLists& runs)
+		{
+			for (Size w = 0; w < kWidthsLength; ++w)
+			{
+				std::sort(offsets[w].begin(), offsets[w].end());
+				for (auto offset : offsets[w])
+				{
+					auto& widthRuns = runs[w];
+					if (!widthRuns.empty() && widthRuns.back().offset + widthRuns.back().count * GetWidth(w) == offset)
+					{
+						widthRuns.back().count++;
+					}
+					else
+					{
+						widthRuns.push_back(ByteSwapRun{ offset, 1 });
+					}
+				}
+			}
+		}
+
+		static bool IsEmpty(RunLists const& runs) noexcept
+		{
+			return runs[0].empty() && runs[1].empty() && runs[2].empty();
+		}
+
+		static void SwapRuns(BytePointer base, RunLists const& runs) noexcept
+		{
+			for (Size w = 0; w < kWidthsLength; ++w)
+			{
+				for (auto& run : runs[w])
+				{
+					SwapValues(base + run.offset, run.count, GetWidth(w));
+				}
+			}
+		}
+
+		// the scalars stored inline in the elements
+		void ApplyInline(BytePointer bytes, Size count) const noexcept
+		{
+			if (IsEmpty(runs))
+			{
+				return;
+			}
+
+			// a type made of one run of equal-width scalars is a flat array of them
+			for (Size w = 0; w < kWidthsLength; ++w)
+			{
+				if (runs[w].size() == 1 && runs[w][0].offset == 0 && runs[w][0].count * GetWidth(w) == stride &&
+					runs[(w + 1) % kWidthsLength].empty() && runs[(w + 2) % kWidthsLength].empty())
+				{
+					SwapValues(bytes, count * runs[w][0].count, GetWidth(w));
+					return;
+				}
+			}
+
+			Size element = 0;
+
+#if REFL_SIMD_SHUFFLE
+			if (!pattern.empty())
+			{
+				Size length = pattern.size();
+				Size total = count * stride;
+				Size position = 0;
+				for (; position + length <= total; position += length)
+				{
+					for (Size lane = 0; lane < length; lane += 16)
+					{
+						auto p = reinterpret_cast<__m128i*>(bytes + position + lane);
+						auto mask = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pattern.data() + lane));
+						_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+					}
+				}
+				element = position / stride;
+			}
+#endif
+
+			for (; element < count; ++element)
+			{
+				SwapRuns(bytes + element * stride, runs);
+			}
+		}
+
+	public:
+		ByteSwapPlan(Type const* type, DataLayout layout) :
+			stride(layout == DataLayout::kObject ? type->GetSize() : GetSerializedSize(type))
+		{
+			OffsetLists offsets;
+			std::vector<SideOffsets> sideOffsets;
+			Collect(type, 0, layout, offsets, sideOffsets);
+
+			BuildRuns(offsets, runs);
+			for (auto& side : sideOffsets)
+			{
+				sides.emplace_back();
+				sides.back().pointer = side.pointer;
+				BuildRuns(side.offsets, sides.back().runs);
+				if (IsEmpty(sides.back().runs))
+				{
+					sides.pop_back();
+				}
+			}
+
+			if (stride > 0)
+			{
+				BuildPattern();
+			}
+		}
+
+		Size GetStride() const noexcept { return stride; }
+		std::vector<ByteSwapRun> const& GetRuns(Size width) const noexcept { return runs[width == 2 ? 0 : (width == 4 ? 1 : 2)]; }
+
+		bool IsIdentity() const noexcept
+		{
+			return IsEmpty(runs) && sides.empty();
+		}
+
+		// swaps count consecutive elements in place, side allocations included
+		void Apply(void* data, Size count) const noexcept
+		{
+			auto bytes = static_cast<BytePointer>(data);
+			if (IsIdentity() || count == 0)
+			{
+				return;
+			}
+
+			ApplyInline(bytes, count);
+			for (auto& side : sides)
+			{
+				for (Size element = 0; element < count; ++element)
+				{
+					BytePointer base;
+					REFL_MEMCPY(&base, bytes + element * stride + side.pointer, sizeof(base));
+					if (base != nullptr)
+					{
+						SwapRuns(base, side.runs);
+					}
+				}
+			}
+		}
+	};
+
+	// plans are built once per type and layout and never freed
+	inline ByteSwapPlan const& GetByteSwapPlan(Type const* type, DataLayout layout)
+	{
+		static std::mutex mutex;
+		static std::unordered_map<Type const*, std::unique_ptr<ByteSwapPlan>> plans[2];
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& plan = plans[static_cast<Size>(layout)][type];
+		if (!plan)
+		{
+			plan.reset(new ByteSwapPlan(type, layout));
+		}
+		return *plan;
+	}
+
+	// converts count objects in place between host order and order, a no-op when they match
+	inline void ConvertByteOrder(Type const* type, void* objects, Size count, ByteOrder order)
+	{
+		if (order != ByteOrder::kNative)
+		{
+			GetByteSwapPlan(type, DataLayout::kObject).Apply(objects, count);
+		}
+	}
+
+	// writes count consecutive objects in the given byte order
+	inline bool SerializeArray(Type const* type, void const* objects, Size count, OutputStream& os, ByteOrder order = ByteOrder::kNative)
+	{
+		auto bytes = static_cast<Byte const*>(objects);
+
+		if (order == ByteOrder::kNative)
+		{
+			for (Size i = 0; i < count; ++i)
+			{
+				if (!Serialize(type, bytes + i * type->GetSize(), os))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		MemoryOutputStream buffer;
+		for (Size i = 0; i < count; ++i)
+		{
+			if (!Serialize(type, bytes + i * type->GetSize(), buffer))
+			{
+				return false;
+			}
+		}
+
+		std::vector<Byte> swapped(buffer.GetData(), buffer.GetData() + buffer.GetSize());
+		GetByteSwapPlan(type, DataLayout::kSerialized).Apply(swapped.data(), count);
+		return os.Write(swapped.data(), swapped.size()) == swapped.size();
+	}
+
+	// reads count consecutive objects written in the given byte order
+	inline bool DeserializeArray(Type const* type, Pointer objects, Size count, void const* data, Size size, ByteOrder order = ByteOrder::kNative)
+	{
+		auto target = static_cast<BytePointer>(objects);
+		auto source = static_cast<Byte const*>(data);
+		Size elementSize = GetSerializedSize(type);
+
+		if (size < count * elementSize)
+		{
+			return false;
+		}
+
+		for (Size i = 0; i < count; ++i)
+		{
+			if (!Deserialize(type, target + i * type->GetSize(), source + i * elementSize, elementSize))
+			{
+				return false;
+			}
+		}
+
+		ConvertByteOrder(type, objects, count, order);
+		return true;
+	}
+
+	template<typename T>
+	bool SerializeArray(T const* objects, Size count, OutputStream& os, ByteOrder order = ByteOrder::kNative)
+	{
+		return SerializeArray(GetType<T>(), objects, count, os, order);
+	}
+
+	template<typename T>
+	bool DeserializeArray(T* objects, Size count, void const* data, Size size, ByteOrder order = ByteOrder::kNative)
+	{
+		return DeserializeArray(GetType<T>(), objects, count, data, size, order);
+	}
+}
@@ -0,0 +1,562 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L && __has_include(<charconv>)
+#include <charconv>
+#endif
+
+#include "serialization.hpp"
+
+namespace Reflection
+{
+	// Flattens a reflected type into leaf columns: nested records become "outer.inner",
+	// fixed arrays "values[i]". Only scalars with a portable width are exported. The cold
+	// fields of a split type are gathered through the side pointer at indirection.
+
+	enum class ColumnKind : Byte
+	{
+		kBool,
+		kSigned,
+		kUnsigned,
+		kFloat
+	};
+
+	struct Column
+	{
+		std::string name;
+		ColumnKind kind;
+		Offset offset;
+		Size width;
+		Offset indirection;
+	};
+
+	static inline void CollectColumns(Type const* type, std::string const& name, Offset offset, Offset indirection, std::vector<Column>& columns)
+	{
+		if (type->IsPointer() || type->IsReference())
+		{
+			return;
+		}
+
+		if (type->IsArray())
+		{
+			auto elementType = type->GetRawType();
+			for (Size i = 0; i < type->GetArrayLength(); ++i)
+			{
+				CollectColumns(elementType, name + "[" + std::to_string(i) + "]", offset + i * elementType->GetSize(), indirection, columns);
+			}
+			return;
+		}
+
+		if (type->IsBuiltin())
+		{
+			Size width = type->GetSize();
+			switch (type->GetNumericKind())
+			{
+			case NumericKind::kSigned:
+				columns.push_back(Column{ name, ColumnKind::kSigned, offset, width, indirection });
+				break;
+			case NumericKind::kUnsigned:
+				columns.push_back(Column{ name, strcmp(type->GetName(), "bool") == 0 ? ColumnKind::kBool : ColumnKind::kUnsigned, offset, width, indirection });
+				break;
+			case NumericKind::kFloat:
+				if (width == 4 || width == 8)
+				{
+					columns.push_back(Column{ name, ColumnKind::kFloat, offset, width, indirection });
+				}
+				break;
+			default:
+				break;
+			}
+			return;
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (field->IsStatic() || (field->IsIndirect() && indirection != kNoIndirection))
+			{
+				// a side allocation inside a side allocation is not reachable with one indirection
+				continue;
+			}
+
+			std::string fieldName = GetUnqualifiedName(field->GetName());
+			std::string columnName = name.empty() ? fieldName : name + "." + fieldName;
+			if (field->IsIndirect())
+			{
+				CollectColumns(field->GetType(), columnName, field->GetOffset(), offset + field->GetIndirection(), columns);
+			}
+			else
+			{
+				CollectColumns(field->GetType(), columnName, offset + field->GetOffset(), indirection, columns);
+			}
+		}
+	}
+
+	inline std::vector<Column> BuildColumnSchema(Type const* type)
+	{
+		std::vector<Column> columns;
+		CollectColumns(type, std::string(), 0, kNoIndirection, columns);
+		return columns;
+	}
+
+	// the bytes of a cell, nullptr for a cold field of an object without its side allocation
+	static inline Byte const* GetCell(Column const& column, Byte const* object) noexcept
+	{
+		if (column.indirection != kNoIndirection)
+		{
+			REFL_MEMCPY(&object, object + column.indirection, sizeof(object));
+			if (object == nullptr)
+			{
+				return nullptr;
+			}
+		}
+		return object + column.offset;
+	}
+
+	// gather kernels: one call per column and batch, the width is a template argument
+	typedef void (*GatherKernel)(Byte const* objects, Size stride, Column const& column, Size count, BytePointer out);
+
+	template<Size Width>
+	static void GatherValues(Byte const* objects, Size stride, Column const& column, Size count, BytePointer out)
+	{
+		Byte const* source = objects + column.offset;
+		for (Size i = 0; i < count; ++i)
+		{
+			REFL_MEMCPY(out + i * Width, source + i * stride, Width);
+		}
+	}
+
+	// cold fields, an object without its side allocation gets a zero
+	template<Size Width>
+	static void GatherIndirectValues(Byte const* objects, Size stride, Column const& column, Size count, BytePointer out)
+	{
+		for (Size i = 0; i < count; ++i)
+		{
+			auto cell = GetCell(column, objects + i * stride);
+			if (cell != nullptr)
+			{
+				REFL_MEMCPY(out + i * Width, cell, Width);
+			}
+			else
+			{
+				std::memset(out + i * Width, 0, Width);
+			}
+		}
+	}
+
+	// bools are bit-packed, LSB first
+	static void GatherBits(Byte const* objects, Size stride, Column const& column, Size count, BytePointer out)
+	{
+		for (Size i = 0; i < count; i += 8)
+		{
+			Byte bits = 0;
+			Size length = count - i < 8 ? count - i : 8;
+			for (Size b = 0; b < length; ++b)
+			{
+				auto cell = GetCell(column, objects + (i + b) * stride);
+				bits |= static_cast<Byte>((cell != nullptr && *cell != 0) << b);
+			}
+			out[i / 8] = bits;
+		}
+	}
+
+	static inline GatherKernel SelectGatherKernel(Column const& column) noexcept
+	{
+		if (column.kind == ColumnKind::kBool)
+		{
+			return &GatherBits;
+		}
+
+		bool indirect = column.indirection != kNoIndirection;
+		switch (column.width)
+		{
+		case 1: return indirect ? &GatherIndirectValues<1> : &GatherValues<1>;
+		case 2: return indirect ? &GatherIndirectValues<2> : &GatherValues<2>;
+		case 4: return indirect ? &GatherIndirectValues<4> : &GatherValues<4>;
+		default: return indirect ? &GatherIndirectValues<8> : &GatherValues<8>;
+		}
+	}
+
+	static inline Size GetColumnBufferSize(Column const& column, Size rows) noexcept
+	{
+		return column.kind == ColumnKind::kBool ? (rows + 7) / 8 : rows * column.width;
+	}
+
+	// Column batch stream. This is not Arrow IPC and Arrow readers can not open it: only the
+	// message framing is borrowed (0xFFFFFFFF continuation marker, int32 metadata length,
+	// metadata padded to 8 bytes, then the body), the metadata is a plain binary description
+	// instead of Arrow's flatbuffers. The body holds one contiguous, 8-byte aligned value buffer
+	// per column, bools bit-packed, without validity bitmaps (a cold field of an object without
+	// its side allocation is written as zero):
+	//
+	//   schema: uint8 1, uint32 columns, per column uint8 kind, uint8 bit width, uint16 name length, name
+	//   batch:  uint8 2, uint64 rows, uint32 buffers, per buffer uint64 offset, uint64 length
+	//
+	// The stream ends with an end-of-stream marker (0xFFFFFFFF, 0).
+	class ColumnarExporter
+	{
+	private:
+		static constexpr uint32_t kContinuation = 0xFFFFFFFF;
+		static constexpr Size kBufferAlignment = 8;
+
+		Type const* type;
+		OutputStream& os;
+		std::vector<Column> columns;
+		std::vector<GatherKernel> kernels;
+		std::vector<Byte> rows;
+		Size batch_rows;
+		Size pending_rows;
+		bool valid;
+
+		static void Pad(std::vector<Byte>& bytes)
+		{
+			bytes.resize((bytes.size() + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment, 0);
+		}
+
+		template<typename T>
+		static void Append(std::vector<Byte>& bytes, T const& value)
+		{
+			auto data = reinterpret_cast<Byte const*>(&value);
+			bytes.insert(bytes.end(), data, data + sizeof(T));
+		}
+
+		bool WriteMessage(std::vector<Byte>& metadata, std::vector<Byte> const& body)
+		{
+			Pad(metadata);
+			uint32_t prefix[2] = { kContinuation, static_cast<uint32_t>(metadata.size()) };
+			return os.Write(prefix, sizeof(prefix)) == sizeof(prefix) &&
+				os.Write(metadata.data(), metadata.size()) == metadata.size() &&
+				(body.empty() || os.Write(body.data(), body.size()) == body.size());
+		}
+
+		bool WriteSchema()
+		{
+			std::vector<Byte> metadata;
+			Append(metadata, static_cast<uint8_t>(1));
+			Append(metadata, static_cast<uint32_t>(columns.size()));
+			for (auto& column : columns)
+			{
+				Append(metadata, static_cast<uint8_t>(column.kind));
+				Append(metadata, static_cast<uint8_t>(column.kind == ColumnKind::kBool ? 1 : column.width * 8));
+				Append(metadata, static_cast<uint16_t>(column.name.size()));
+				metadata.insert(metadata.end(), column.name.begin(), column.name.end());
+			}
+			return WriteMessage(metadata, std::vector<Byte>());
+		}
+
+		bool WriteBatch(Byte const* objects, Size count)
+		{
+			std::vector<Byte> metadata;
+			std::vector<Byte> body;
+			Append(metadata, static_cast<uint8_t>(2));
+			Append(metadata, static_cast<uint64_t>(count));
+			Append(metadata, static_cast<uint32_t>(columns.size()));
+
+			for (Size i = 0; i < columns.size(); ++i)
+			{
+				Size offset = body.size();
+				Size length = GetColumnBufferSize(columns[i], count);
+				body.resize(offset + length);
+				kernels[i](objects, type->GetSize(), columns[i], count, body.data() + offset);
+				Pad(body);
+				Append(metadata, static_cast<uint64_t>(offset));
+				Append(metadata, static_cast<uint64_t>(length));
+			}
+
+			return WriteMessage(metadata, body);
+		}
+
+	public:
+		// batches hold at most batchRows rows, which bounds the memory used by the exporter
+		ColumnarExporter(Type const* _type, OutputStream& _os, Size batchRows = 1 << 16) :
+			type(_type),
+			os(_os),
+			columns(BuildColumnSchema(_type)),
+			batch_rows(batchRows > 0 ? batchRows : 1),
+			pending_rows(0),
+			valid(false)
+		{
+			for (auto& column : columns)
+			{
+				kernels.push_back(SelectGatherKernel(column));
+			}
+			valid = WriteSchema();
+		}
+
+		std::vector<Column> const& GetColumns() const noexcept { return columns; }
+
+		// false when the schema message could not be written, every later call then fails
+		bool IsValid() const noexcept { return valid; }
+
+		bool Write(void const* objects, Size count)
+		{
+			if (!valid)
+			{
+				return false;
+			}
+
+			auto bytes = static_cast<Byte const*>(objects);
+			Size stride = type->GetSize();
+
+			// top up a partially filled batch first
+			while (pending_rows > 0 && count > 0)
+			{
+				Size take = batch_rows - pending_rows < count ? batch_rows - pending_rows : count;
+				rows.insert(rows.end(), bytes, bytes + take * stride);
+				pending_rows += take;
+				bytes += take * stride;
+				count -= take;
+				if (pending_rows == batch_rows && !Flush())
+				{
+					return false;
+				}
+			}
+
+			// full batches are gathered straight from the caller's array
+			while (count >= batch_rows)
+			{
+				if (!WriteBatch(bytes, batch_rows))
+				{
+					return false;
+				}
+				bytes += batch_rows * stride;
+				count -= batch_rows;
+			}
+
+			rows.insert(rows.end(), bytes, bytes + count * stride);
+			pending_rows += count;
+			return true;
+		}
+
+		bool Flush()
+		{
+			if (!valid)
+			{
+				return false;
+			}
+
+			if (pending_rows == 0)
+			{
+				return true;
+			}
+
+			bool written = WriteBatch(rows.data(), pending_rows);
+			rows.clear();
+			pending_rows = 0;
+			return written;
+		}
+
+		bool Finish()
+		{
+			uint32_t endOfStream[2] = { kContinuation, 0 };
+			return Flush() && os.Write(endOfStream, sizeof(endOfStream)) == sizeof(endOfStream);
+		}
+	};
+
+	// number formatting without iostreams
+	static char const kDigitPairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+
+	inline char* FormatUnsigned(uint64_t value, char* out) noexcept
+	{
+		char buffer[20];
+		char* end = buffer + sizeof(buffer);
+		char* cursor = end;
+
+		while (value >= 100)
+		{
+			Size pair = static_cast<Size>(value % 100) * 2;
+			value /= 100;
+			*--cursor = kDigitPairs[pair + 1];
+			*--cursor = kDigitPairs[pair];
+		}
+
+		if (value >= 10)
+		{
+			Size pair = static_cast<Size>(value) * 2;
+			*--cursor = kDigitPairs[pair + 1];
+			*--cursor = kDigitPairs[pair];
+		}
+		else
+		{
+			*--cursor = static_cast<char>('0' + value);
+		}
+
+		Size length = static_cast<Size>(end - cursor);
+		REFL_MEMCPY(out, cursor, length);
+		return out + length;
+	}
+
+	inline char* FormatSigned(int64_t value, char* out) noexcept
+	{
+		if (value < 0)
+		{
+			*out++ = '-';
+			return FormatUnsigned(0 - static_cast<uint64_t>(value), out);
+		}
+		return FormatUnsigned(static_cast<uint64_t>(value), out);
+	}
+
+	// shortest round-trip form when <charconv> is available
+	inline char* FormatFloat(double value, bool isSingle, char* out) noexcept
+	{
+#if defined(__cpp_lib_to_chars)
+		auto result = isSingle ? std::to_chars(out, out + 32, static_cast<float>(value)) : std::to_chars(out, out + 32, value);
+		return result.ptr;
+#else
+		int length = std::snprintf(out, 32, isSingle ? "%.9g" : "%.17g", value);
+		return out + (length > 0 ? length : 0);
+#endif
+	}
+
+	class CsvExporter
+	{
+	private:
+		static constexpr Size kMaxCellLength = 32;
+
+		Type const* type;
+		OutputStream& os;
+		std::vector<Column> columns;
+		std::vector<char> buffer;
+		Size used;
+
+		static char* FormatCell(Column const& column, Byte const* cell, char* out) noexcept
+		{
+			switch (column.kind)
+			{
+			case ColumnKind::kBool:
+				*out++ = *cell != 0 ? '1' : '0';
+				return out;
+			case ColumnKind::kSigned:
+				switch (column.width)
+				{
+				case 1: { int8_t v; REFL_MEMCPY(&v, cell, 1); return FormatSigned(v, out); }
+				case 2: { int16_t v; REFL_MEMCPY(&v, cell, 2); return FormatSigned(v, out); }
+				case 4: { int32_t v; REFL_MEMCPY(&v, cell, 4); return FormatSigned(v, out); }
+				default: { int64_t v; REFL_MEMCPY(&v, cell, 8); return FormatSigned(v, out); }
+				}
+			case ColumnKind::kUnsigned:
+				switch (column.width)
+				{
+				case 1: { uint8_t v; REFL_MEMCPY(&v, cell, 1); return FormatUnsigned(v, out); }
+				case 2: { uint16_t v; REFL_MEMCPY(&v, cell, 2); return FormatUnsigned(v, out); }
+				case 4: { uint32_t v; REFL_MEMCPY(&v, cell, 4); return FormatUnsigned(v, out); }
+				default: { uint64_t v; REFL_MEMCPY(&v, cell, 8); return FormatUnsigned(v, out); }
+				}
+			case ColumnKind::kFloat:
+				if (column.width == 4)
+				{
+					float v;
+					REFL_MEMCPY(&v, cell, 4);
+					return FormatFloat(v, true, out);
+				}
+				else
+				{
+					double v;
+					REFL_MEMCPY(&v, cell, 8);
+					return FormatFloat(v, false, out);
+				}
+			}
+			return out;
+		}
+
+		bool Reserve(Size length)
+		{
+			if (used + length > buffer.size())
+			{
+				if (!Flush())
+				{
+					return false;
+				}
+
+				if (length > buffer.size())
+				{
+					buffer.resize(length);
+				}
+			}
+			return true;
+		}
+
+	public:
+		// the output is flushed whenever bufferSize bytes are pending
+		CsvExporter(Type const* _type, OutputStream& _os, Size bufferSize = 1 << 16) :
+			type(_type),
+			os(_os),
+			columns(BuildColumnSchema(_type)),
+			buffer(bufferSize > 0 ? bufferSize : 1),
+			used(0)
+		{}
+
+		std::vector<Column> const& GetColumns() const noexcept { return columns; }
+
+		bool WriteHeader()
+		{
+			for (Size i = 0; i < columns.size(); ++i)
+			{
+				auto& name = columns[i].name;
+				if (!Reserve(name.size() + 1))
+				{
+					return false;
+				}
+
+				REFL_MEMCPY(buffer.data() + used, name.data(), name.size());
+				used += name.size();
+				buffer[used++] = i + 1 < columns.size() ? ',' : '\n';
+			}
+			return true;
+		}
+
+		bool Write(void const* objects, Size count)
+		{
+			auto bytes = static_cast<Byte const*>(objects);
+			Size rowLength = columns.size() * (kMaxCellLength + 1) + 1;
+
+			for (Size row = 0; row < count; ++row)
+			{
+				if (!Reserve(rowLength))
+				{
+					return false;
+				}
+
+				Byte const* object = bytes + row * type->GetSize();
+				char* out = buffer.data() + used;
+				for (Size i = 0; i < columns.size(); ++i)
+				{
+					// a cold field of an object without its side allocation is left empty
+					auto cell = GetCell(columns[i], object);
+					if (cell != nullptr)
+					{
+						out = FormatCell(columns[i], cell, out);
+					}
+					*out++ = ',';
+				}
+
+				if (!columns.empty())
+				{
+					out--;
+				}
+				*out++ = '\n';
+				used = static_cast<Size>(out - buffer.data());
+			}
+			return true;
+		}
+
+		bool Flush()
+		{
+			bool written = used == 0 || os.Write(buffer.data(), used) == used;
+			used = 0;
+			return written;
+		}
+	};
+}
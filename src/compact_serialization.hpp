@@ -0,0 +1,472 @@
+#pragma once
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "serialization.hpp"
+
+namespace Reflection
+{
+	// Compact wire format for replication traffic:
+	//
+	//   record:   presence bitmask (one bit per serializable field, LSB first) + the present fields
+	//   integers: Encoding::kVarint -> zigzag LEB128 of the value
+	//             Encoding::kDelta  -> zigzag LEB128 of the difference to the baseline
+	//   others:   raw bytes, like the plain binary format
+	//
+	// A field is omitted when it equals the baseline, or is all zero when there is no baseline.
+	// The encoding comes from FIELD(encoding=...) and falls back to CLASS(name, encoding=...).
+
+	constexpr Size kMaxVarintLength = 10;
+
+	inline uint64_t ZigZagEncode(int64_t value) noexcept
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	inline int64_t ZigZagDecode(uint64_t value) noexcept
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	static inline unsigned CountLeadingZeros(uint64_t value) noexcept
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanReverse64(&index, value) ? 63 - index : 64;
+#else
+		return value != 0 ? __builtin_clzll(value) : 64;
+#endif
+	}
+
+	static inline unsigned CountTrailingZeros(uint64_t value) noexcept
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanForward64(&index, value) ? index : 64;
+#else
+		return value != 0 ? __builtin_ctzll(value) : 64;
+#endif
+	}
+
+	inline Size GetVarintLength(uint64_t value) noexcept
+	{
+		return (64 - CountLeadingZeros(value | 1) + 6) / 7;
+	}
+
+	// out must have kMaxVarintLength writable bytes
+	inline Size EncodeVarint(uint64_t value, BytePointer out) noexcept
+	{
+		Size length = GetVarintLength(value);
+
+#if REFL_LITTLE_ENDIAN
+		if (length <= 8)
+		{
+			// spread the 7-bit groups into bytes, then set the continuation bits in one go
+			uint64_t x = value;
+			x = (x & 0x000000000FFFFFFFull) | ((x & 0x00FFFFFFF0000000ull) << 4);
+			x = (x & 0x00003FFF00003FFFull) | ((x & 0x0FFFC0000FFFC000ull) << 2);
+			x = (x & 0x007F007F007F007Full) | ((x & 0x3F803F803F803F80ull) << 1);
+			x |= 0x8080808080808080ull & ((1ull << (8 * (length - 1))) - 1);
+			REFL_MEMCPY(out, &x, sizeof(x));
+			return length;
+		}
+#endif
+
+		for (Size i = 0; i + 1 < length; ++i)
+		{
+			out[i] = static_cast<Byte>(value | 0x80);
+			value >>= 7;
+		}
+		out[length - 1] = static_cast<Byte>(value);
+		return length;
+	}
+
+	// returns the number of bytes read, 0 on truncated or malformed input
+	inline Size DecodeVarint(Byte const* data, Byte const* end, uint64_t& value) noexcept
+	{
+#if REFL_LITTLE_ENDIAN
+		if (end - data >= 8)
+		{
+			uint64_t word;
+			REFL_MEMCPY(&word, data, sizeof(word));
+			uint64_t stops = ~word & 0x8080808080808080ull;
+			if (stops != 0)
+			{
+				// keep the bytes up to the first one without a continuation bit, then gather the 7-bit groups
+				uint64_t x = word & (stops ^ (stops - 1)) & 0x7F7F7F7F7F7F7F7Full;
+				x = ((x & 0x7F007F007F007F00ull) >> 1) | (x & 0x007F007F007F007Full);
+				x = ((x & 0x3FFF00003FFF0000ull) >> 2) | (x & 0x00003FFF00003FFFull);
+				x = ((x & 0x0FFFFFFF00000000ull) >> 4) | (x & 0x000000000FFFFFFFull);
+				value = x;
+				return CountTrailingZeros(stops) / 8 + 1;
+			}
+		}
+#endif
+
+		uint64_t result = 0;
+		for (Size i = 0; i < kMaxVarintLength && data + i < end; ++i)
+		{
+			result |= static_cast<uint64_t>(data[i] & 0x7F) << (7 * i);
+			if ((data[i] & 0x80) == 0)
+			{
+				value = result;
+				return i + 1;
+			}
+		}
+		return 0;
+	}
+
+	static inline bool IsVarintType(Type const* type) noexcept
+	{
+		auto kind = type->GetNumericKind();
+		return (kind == NumericKind::kSigned || kind == NumericKind::kUnsigned) && type->GetSize() <= sizeof(uint64_t);
+	}
+
+	static inline uint64_t LoadInteger(Byte const* data, Size size, bool isSigned) noexcept
+	{
+		switch (size)
+		{
+		case 1: { uint8_t v; REFL_MEMCPY(&v, data, 1); return isSigned ? static_cast<uint64_t>(static_cast<int8_t>(v)) : v; }
+		case 2: { uint16_t v; REFL_MEMCPY(&v, data, 2); return isSigned ? static_cast<uint64_t>(static_cast<int16_t>(v)) : v; }
+		case 4: { uint32_t v; REFL_MEMCPY(&v, data, 4); return isSigned ? static_cast<uint64_t>(static_cast<int32_t>(v)) : v; }
+		default: { uint64_t v; REFL_MEMCPY(&v, data, 8); return v; }
+		}
+	}
+
+	static inline void StoreInteger(BytePointer data, Size size, uint64_t value) noexcept
+	{
+		switch (size)
+		{
+		case 1: { uint8_t v = static_cast<uint8_t>(value); REFL_MEMCPY(data, &v, 1); break; }
+		case 2: { uint16_t v = static_cast<uint16_t>(value); REFL_MEMCPY(data, &v, 2); break; }
+		case 4: { uint32_t v = static_cast<uint32_t>(value); REFL_MEMCPY(data, &v, 4); break; }
+		default: REFL_MEMCPY(data, &value, 8); break;
+		}
+	}
+
+	// interprets the low size bytes of value as a two's complement integer
+	static inline int64_t SignExtend(uint64_t value, Size size) noexcept
+	{
+		unsigned shift = static_cast<unsigned>(64 - size * 8);
+		return static_cast<int64_t>(value << shift) >> shift;
+	}
+
+	static inline bool IsZero(Byte const* data, Size size) noexcept
+	{
+		for (Size i = 0; i < size; ++i)
+		{
+			if (data[i] != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static inline Encoding ResolveEncoding(Encoding encoding, Encoding inherited) noexcept
+	{
+		return encoding != Encoding::kDefault ? encoding : inherited;
+	}
+
+	static inline void AppendBytes(std::vector<Byte>& out, void const* data, Size size)
+	{
+		auto bytes = static_cast<Byte const*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	static inline void AppendVarint(std::vector<Byte>& out, uint64_t value)
+	{
+		Size position = out.size();
+		out.resize(position + kMaxVarintLength);
+		out.resize(position + EncodeVarint(value, &out[position]));
+	}
+
+	static bool EncodeCompactRecord(Type const* type, Byte const* value, Byte const* base, Encoding inherited, std::vector<Byte>& out);
+
+	static bool EncodeCompactValue(Type const* type, Byte const* value, Byte const* base, Encoding encoding, std::vector<Byte>& out)
+	{
+		if (type->IsArray())
+		{
+			auto elementType = type->GetRawType();
+			if (elementType->IsBuiltin() && (encoding == Encoding::kDefault || encoding == Encoding::kFixed || !IsVarintType(elementType)))
+			{
+				AppendBytes(out, value, type->GetSize());
+				return true;
+			}
+
+			Size stride = elementType->GetSize();
+			for (Size i = 0; i < type->GetArrayLength(); ++i)
+			{
+				if (!EncodeCompactValue(elementType, value + i * stride, base ? base + i * stride : nullptr, encoding, out))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		if (!type->IsBuiltin())
+		{
+			return EncodeCompactRecord(type, value, base, encoding, out);
+		}
+
+		if ((encoding == Encoding::kVarint || encoding == Encoding::kDelta) && IsVarintType(type))
+		{
+			Size size = type->GetSize();
+			bool isSigned = type->GetNumericKind() == NumericKind::kSigned;
+			uint64_t integer = LoadInteger(value, size, isSigned);
+
+			if (encoding == Encoding::kDelta && base)
+			{
+				// the difference wraps at the width of the field
+				AppendVarint(out, ZigZagEncode(SignExtend(integer - LoadInteger(base, size, isSigned), size)));
+			}
+			else if (isSigned)
+			{
+				AppendVarint(out, ZigZagEncode(static_cast<int64_t>(integer)));
+			}
+			else
+			{
+				AppendVarint(out, integer);
+			}
+			return true;
+		}
+
+		AppendBytes(out, value, type->GetSize());
+		return true;
+	}
+
+	// false when the field lives in a side allocation the object at bytes does not have
+	static inline bool HasSide(Field const* field, Byte const* bytes)
+	{
+		if (!field->IsIndirect())
+		{
+			return true;
+		}
+
+		Pointer side;
+		REFL_MEMCPY(&side, bytes + field->GetIndirection(), sizeof(side));
+		return side != nullptr;
+	}
+
+	static bool EncodeCompactRecord(Type const* type, Byte const* value, Byte const* base, Encoding inherited, std::vector<Byte>& out)
+	{
+		Encoding encoding = ResolveEncoding(type->GetEncoding(), inherited);
+
+		Size fieldsLength = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			fieldsLength += IsSerializableField(type->GetField(i)) ? 1 : 0;
+		}
+
+		Size maskPosition = out.size();
+		out.resize(maskPosition + (fieldsLength + 7) / 8, 0);
+
+		Size bit = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!IsSerializableField(field))
+			{
+				continue;
+			}
+
+			if (!HasSide(field, value) || (base && !HasSide(field, base)))
+			{
+				return false;
+			}
+
+			auto fieldType = field->GetType();
+			auto fieldValue = field->GetAddress(value);
+			auto fieldBase = base ? field->GetAddress(base) : nullptr;
+			bool isDefault = fieldBase ? std::memcmp(fieldValue, fieldBase, fieldType->GetSize()) == 0 : IsZero(fieldValue, fieldType->GetSize());
+
+			if (!isDefault)
+			{
+				out[maskPosition + bit / 8] |= static_cast<Byte>(1 << (bit % 8));
+				if (!EncodeCompactValue(fieldType, fieldValue, fieldBase, ResolveEncoding(field->GetEncoding(), encoding), out))
+				{
+					return false;
+				}
+			}
+			bit++;
+		}
+		return true;
+	}
+
+	static bool DecodeCompactRecord(Type const* type, BytePointer value, Byte const* base, Encoding inherited, Byte const*& cursor, Byte const* end);
+
+	static bool DecodeCompactValue(Type const* type, BytePointer value, Byte const* base, Encoding encoding, Byte const*& cursor, Byte const* end)
+	{
+		if (type->IsArray())
+		{
+			auto elementType = type->GetRawType();
+			if (elementType->IsBuiltin() && (encoding == Encoding::kDefault || encoding == Encoding::kFixed || !IsVarintType(elementType)))
+			{
+				if (static_cast<Size>(end - cursor) < type->GetSize())
+				{
+					return false;
+				}
+
+				REFL_MEMCPY(value, cursor, type->GetSize());
+				cursor += type->GetSize();
+				return true;
+			}
+
+			Size stride = elementType->GetSize();
+			for (Size i = 0; i < type->GetArrayLength(); ++i)
+			{
+				if (!DecodeCompactValue(elementType, value + i * stride, base ? base + i * stride : nullptr, encoding, cursor, end))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		if (!type->IsBuiltin())
+		{
+			return DecodeCompactRecord(type, value, base, encoding, cursor, end);
+		}
+
+		if ((encoding == Encoding::kVarint || encoding == Encoding::kDelta) && IsVarintType(type))
+		{
+			uint64_t encoded;
+			Size length = DecodeVarint(cursor, end, encoded);
+			if (length == 0)
+			{
+				return false;
+			}
+			cursor += length;
+
+			Size size = type->GetSize();
+			bool isSigned = type->GetNumericKind() == NumericKind::kSigned;
+
+			if (encoding == Encoding::kDelta && base)
+			{
+				StoreInteger(value, size, LoadInteger(base, size, isSigned) + static_cast<uint64_t>(ZigZagDecode(encoded)));
+			}
+			else
+			{
+				StoreInteger(value, size, isSigned ? static_cast<uint64_t>(ZigZagDecode(encoded)) : encoded);
+			}
+			return true;
+		}
+
+		if (static_cast<Size>(end - cursor) < type->GetSize())
+		{
+			return false;
+		}
+
+		REFL_MEMCPY(value, cursor, type->GetSize());
+		cursor += type->GetSize();
+		return true;
+	}
+
+	static bool DecodeCompactRecord(Type const* type, BytePointer value, Byte const* base, Encoding inherited, Byte const*& cursor, Byte const* end)
+	{
+		Encoding encoding = ResolveEncoding(type->GetEncoding(), inherited);
+
+		Size fieldsLength = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			fieldsLength += IsSerializableField(type->GetField(i)) ? 1 : 0;
+		}
+
+		Size maskLength = (fieldsLength + 7) / 8;
+		if (static_cast<Size>(end - cursor) < maskLength)
+		{
+			return false;
+		}
+
+		Byte const* mask = cursor;
+		cursor += maskLength;
+
+		Size bit = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!IsSerializableField(field))
+			{
+				continue;
+			}
+
+			if (!HasSide(field, value) || (base && !HasSide(field, base)))
+			{
+				return false;
+			}
+
+			auto fieldType = field->GetType();
+			auto fieldValue = field->GetAddress(value);
+			auto fieldBase = base ? field->GetAddress(base) : nullptr;
+
+			if (mask[bit / 8] & (1 << (bit % 8)))
+			{
+				if (!DecodeCompactValue(fieldType, fieldValue, fieldBase, ResolveEncoding(field->GetEncoding(), encoding), cursor, end))
+				{
+					return false;
+				}
+			}
+			else if (fieldBase)
+			{
+				REFL_MEMCPY(fieldValue, fieldBase, fieldType->GetSize());
+			}
+			else
+			{
+				std::memset(fieldValue, 0, fieldType->GetSize());
+			}
+			bit++;
+		}
+
+		return true;
+	}
+
+	// baseline, when given, must be an object of the same type known to both sides. Split objects
+	// without their side allocation fail and leave out as it was.
+	inline bool SerializeCompact(Type const* type, void const* obj, std::vector<Byte>& out, void const* baseline = nullptr)
+	{
+		Size size = out.size();
+		if (!EncodeCompactValue(type, static_cast<Byte const*>(obj), static_cast<Byte const*>(baseline), Encoding::kDefault, out))
+		{
+			out.resize(size);
+			return false;
+		}
+		return true;
+	}
+
+	inline bool SerializeCompact(Type const* type, void const* obj, OutputStream& os, void const* baseline = nullptr)
+	{
+		std::vector<Byte> buffer;
+		return SerializeCompact(type, obj, buffer, baseline) && os.Write(buffer.data(), buffer.size()) == buffer.size();
+	}
+
+	inline bool DeserializeCompact(Type const* type, Pointer obj, void const* data, Size size, void const* baseline = nullptr, Size* consumed = nullptr)
+	{
+		auto cursor = static_cast<Byte const*>(data);
+		if (!DecodeCompactValue(type, static_cast<BytePointer>(obj), static_cast<Byte const*>(baseline), Encoding::kDefault, cursor, cursor + size))
+		{
+			return false;
+		}
+
+		if (consumed)
+		{
+			*consumed = cursor - static_cast<Byte const*>(data);
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool SerializeCompact(T const& obj, std::vector<Byte>& out, T const* baseline = nullptr)
+	{
+		return SerializeCompact(GetType<T>(), &obj, out, baseline);
+	}
+
+	template<typename T>
+	bool DeserializeCompact(T& obj, void const* data, Size size, T const* baseline = nullptr, Size* consumed = nullptr)
+	{
+		return DeserializeCompact(GetType<T>(), &obj, data, size, baseline, consumed);
+	}
+}
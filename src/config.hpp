@@ -0,0 +1,625 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// Config files in an INI/TOML-like format loaded into a reflected object:
+	//
+	//   # comment
+	//   threads = 8
+	//   [server]
+	//   name = "edge-01"
+	//   ports = [80, 443]
+	//   limits.timeout = 2.5
+	//
+	// Section names and keys are FieldPaths below the root type; a key is resolved once and the
+	// path is reused by every reload. A reload parses the whole file into a staging copy, compares
+	// it with the live object key by key and writes only the keys that changed, inside a seqlock:
+	// readers copy the object (or a single value) without locking and retry when a write was in
+	// progress. Keys missing from the file keep their value. A file with errors is not applied.
+
+	struct ConfigEntry
+	{
+		std::string key;
+		std::string value;
+		Size line;
+	};
+
+	static inline std::string TrimConfigText(std::string const& text)
+	{
+		Size begin = text.find_first_not_of(" \t\r");
+		if (begin == std::string::npos)
+		{
+			return std::string();
+		}
+		return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+	}
+
+	// drops a trailing comment that is not inside a quoted string
+	static inline std::string StripConfigComment(std::string const& text)
+	{
+		bool quoted = false;
+		for (Size i = 0; i < text.size(); ++i)
+		{
+			if (text[i] == '"' && (i == 0 || text[i - 1] != '\\'))
+			{
+				quoted = !quoted;
+			}
+			else if (!quoted && (text[i] == '#' || text[i] == ';'))
+			{
+				return text.substr(0, i);
+			}
+		}
+		return text;
+	}
+
+	inline bool ParseConfig(std::string const& text, std::vector<ConfigEntry>& entries, std::string& error)
+	{
+		std::istringstream stream(text);
+		std::string line;
+		std::string section;
+		Size number = 0;
+
+		entries.clear();
+		while (std::getline(stream, line))
+		{
+			++number;
+			line = TrimConfigText(StripConfigComment(line));
+			if (line.empty())
+			{
+				continue;
+			}
+
+			if (line.front() == '[')
+			{
+				if (line.back() != ']')
+				{
+					error = "line " + std::to_string(number) + ": unterminated section";
+					return false;
+				}
+				section = TrimConfigText(line.substr(1, line.size() - 2));
+				continue;
+			}
+
+			Size equals = line.find('=');
+			if (equals == std::string::npos)
+			{
+				error = "line " + std::to_string(number) + ": expected key = value";
+				return false;
+			}
+
+			auto key = TrimConfigText(line.substr(0, equals));
+			if (key.empty())
+			{
+				error = "line " + std::to_string(number) + ": empty key";
+				return false;
+			}
+			entries.push_back(ConfigEntry{ section.empty() ? key : section + "." + key, TrimConfigText(line.substr(equals + 1)), number });
+		}
+		return true;
+	}
+
+	template<typename T>
+	static inline void StoreConfigInteger(BytePointer target, Size size, T value) noexcept
+	{
+		switch (size)
+		{
+		case 1: { int8_t v = static_cast<int8_t>(value); REFL_MEMCPY(target, &v, 1); break; }
+		case 2: { int16_t v = static_cast<int16_t>(value); REFL_MEMCPY(target, &v, 2); break; }
+		case 4: { int32_t v = static_cast<int32_t>(value); REFL_MEMCPY(target, &v, 4); break; }
+		default: { int64_t v = static_cast<int64_t>(value); REFL_MEMCPY(target, &v, 8); break; }
+		}
+	}
+
+	// writes a scalar value into a builtin, a bool or a char array
+	static inline bool ParseConfigScalar(Type const* type, std::string const& value, BytePointer target)
+	{
+		if (type->IsArray() && strcmp(type->GetRawType()->GetName(), "char") == 0)
+		{
+			if (value.size() < 2 || value.front() != '"' || value.back() != '"')
+			{
+				return false;
+			}
+
+			std::string text;
+			for (Size i = 1; i + 1 < value.size(); ++i)
+			{
+				char c = value[i];
+				if (c == '\\' && i + 2 < value.size())
+				{
+					c = value[++i];
+					c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+				}
+				text.push_back(c);
+			}
+
+			if (text.size() >= type->GetArrayLength())
+			{
+				return false;
+			}
+			std::memset(target, 0, type->GetSize());
+			REFL_MEMCPY(target, text.data(), text.size());
+			return true;
+		}
+
+		if (!type->IsBuiltin() || value.empty())
+		{
+			return false;
+		}
+
+		char const* begin = value.c_str();
+		char* end = nullptr;
+		errno = 0;
+		Size size = type->GetSize();
+
+		if (strcmp(type->GetName(), "bool") == 0)
+		{
+			if (value != "true" && value != "false" && value != "1" && value != "0")
+			{
+				return false;
+			}
+			bool flag = value == "true" || value == "1";
+			REFL_MEMCPY(target, &flag, sizeof(flag));
+			return true;
+		}
+
+		switch (type->GetNumericKind())
+		{
+		case NumericKind::kSigned:
+		{
+			long long number = std::strtoll(begin, &end, 0);
+			long long limit = size >= sizeof(long long) ? 0 : 1ll << (size * 8 - 1);
+			if (*end != '\0' || errno != 0 || (limit != 0 && (number < -limit || number >= limit)))
+			{
+				return false;
+			}
+			StoreConfigInteger(target, size, number);
+			return true;
+		}
+		case NumericKind::kUnsigned:
+		{
+			if (value.front() == '-')
+			{
+				return false;
+			}
+			unsigned long long number = std::strtoull(begin, &end, 0);
+			if (*end != '\0' || errno != 0 || (size < sizeof(number) && (number >> (size * 8)) != 0))
+			{
+				return false;
+			}
+			StoreConfigInteger(target, size, number);
+			return true;
+		}
+		case NumericKind::kFloat:
+		{
+			long double number = std::strtold(begin, &end);
+			if (*end != '\0' || errno != 0)
+			{
+				return false;
+			}
+			if (size == sizeof(float)) { float v = static_cast<float>(number); REFL_MEMCPY(target, &v, sizeof(v)); }
+			else if (size == sizeof(double)) { double v = static_cast<double>(number); REFL_MEMCPY(target, &v, sizeof(v)); }
+			else { REFL_MEMCPY(target, &number, size); }
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	// scalars, or [a, b, ...] lists for arrays of scalars
+	inline bool ParseConfigValue(Type const* type, std::string const& value, BytePointer target)
+	{
+		if (!type->IsArray() || value.empty() || value.front() != '[')
+		{
+			return ParseConfigScalar(type, value, target);
+		}
+
+		if (value.back() != ']')
+		{
+			return false;
+		}
+
+		auto elementType = type->GetRawType();
+		std::vector<std::string> items;
+		std::string item;
+		bool quoted = false;
+		for (Size i = 1; i + 1 < value.size(); ++i)
+		{
+			char c = value[i];
+			if (c == '"' && value[i - 1] != '\\')
+			{
+				quoted = !quoted;
+			}
+			if (c == ',' && !quoted)
+			{
+				items.push_back(TrimConfigText(item));
+				item.clear();
+				continue;
+			}
+			item.push_back(c);
+		}
+		if (!TrimConfigText(item).empty() || !items.empty())
+		{
+			items.push_back(TrimConfigText(item));
+		}
+
+		if (items.size() > type->GetArrayLength())
+		{
+			return false;
+		}
+
+		// missing trailing elements are zero
+		std::memset(target, 0, type->GetSize());
+		for (Size i = 0; i < items.size(); ++i)
+		{
+			if (!ParseConfigValue(elementType, items[i], target + i * elementType->GetSize()))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// relaxed atomic copies for the seqlock, torn copies are detected by the sequence
+	static inline void LoadRelaxed(BytePointer target, Byte const* source, Size size) noexcept
+	{
+#if defined(_MSC_VER)
+		REFL_MEMCPY(target, source, size);
+#else
+		Size i = 0;
+		for (; i < size && (reinterpret_cast<uintptr_t>(source + i) & 7) != 0; ++i)
+		{
+			target[i] = __atomic_load_n(source + i, __ATOMIC_RELAXED);
+		}
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word = __atomic_load_n(reinterpret_cast<uint64_t const*>(source + i), __ATOMIC_RELAXED);
+			REFL_MEMCPY(target + i, &word, 8);
+		}
+		for (; i < size; ++i)
+		{
+			target[i] = __atomic_load_n(source + i, __ATOMIC_RELAXED);
+		}
+#endif
+	}
+
+	static inline void StoreRelaxed(BytePointer target, Byte const* source, Size size) noexcept
+	{
+#if defined(_MSC_VER)
+		REFL_MEMCPY(target, source, size);
+#else
+		Size i = 0;
+		for (; i < size && (reinterpret_cast<uintptr_t>(target + i) & 7) != 0; ++i)
+		{
+			__atomic_store_n(target + i, source[i], __ATOMIC_RELAXED);
+		}
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			REFL_MEMCPY(&word, source + i, 8);
+			__atomic_store_n(reinterpret_cast<uint64_t*>(target + i), word, __ATOMIC_RELAXED);
+		}
+		for (; i < size; ++i)
+		{
+			__atomic_store_n(target + i, source[i], __ATOMIC_RELAXED);
+		}
+#endif
+	}
+
+	class ConfigLoader
+	{
+	public:
+		typedef std::function<void(FieldPath const&)> ChangeCallback;
+
+	private:
+		struct Callback
+		{
+			FieldPath path;
+			ChangeCallback function;
+		};
+
+		Type const* type;
+		BytePointer object;
+		std::string file_name;
+		std::atomic<uint32_t> sequence;
+
+		mutable std::mutex writer_mutex;
+		std::unordered_map<std::string, FieldPath> paths;
+		std::vector<Callback> callbacks;
+		std::vector<Byte> staging;
+		std::string error;
+
+		FieldPath const* Resolve(std::string const& key)
+		{
+			auto it = paths.find(key);
+			if (it == paths.end())
+			{
+				it = paths.emplace(key, FieldPath::Resolve(type, key.c_str())).first;
+			}
+			return it->second.IsValid() ? &it->second : nullptr;
+		}
+
+		bool Fail(std::string message)
+		{
+			error = std::move(message);
+			return false;
+		}
+
+	public:
+		ConfigLoader(Type const* _type, Pointer _object, std::string _file_name) :
+			type(_type),
+			object(static_cast<BytePointer>(_object)),
+			file_name(std::move(_file_name)),
+			sequence(0)
+		{}
+
+		template<typename T>
+		ConfigLoader(T& _object, std::string _file_name) : ConfigLoader(Reflection::GetType<T>(), &_object, std::move(_file_name)) {}
+
+		ConfigLoader(ConfigLoader const&) = delete;
+		ConfigLoader& operator=(ConfigLoader const&) = delete;
+
+		std::string const& GetFileName() const noexcept { return file_name; }
+
+		std::string GetError() const
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+			return error;
+		}
+
+		// called after every reload that changed a value inside path, at most once per reload;
+		// returns false when path does not resolve
+		bool OnChange(char const* path, ChangeCallback function)
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+			auto resolved = FieldPath::Resolve(type, path);
+			if (!resolved.IsValid())
+			{
+				return false;
+			}
+			callbacks.push_back(Callback{ resolved, std::move(function) });
+			return true;
+		}
+
+		// parses text and applies the keys whose value differs from the live object
+		bool Apply(std::string const& text)
+		{
+			std::vector<FieldPath> changed;
+			std::vector<Callback> triggered;
+			{
+				std::lock_guard<std::mutex> lock(writer_mutex);
+				std::vector<ConfigEntry> entries;
+				std::string parseError;
+				if (!ParseConfig(text, entries, parseError))
+				{
+					return Fail(file_name + ": " + parseError);
+				}
+
+				// the writer is the only one modifying the object, it may read it directly
+				staging.assign(object, object + type->GetSize());
+				std::vector<FieldPath const*> assigned;
+				for (auto& entry : entries)
+				{
+					auto path = Resolve(entry.key);
+					if (path == nullptr)
+					{
+						return Fail(file_name + ": line " + std::to_string(entry.line) + ": unknown key '" + entry.key + "'");
+					}
+					if (!ParseConfigValue(path->GetType(), entry.value, staging.data() + path->GetOffset()))
+					{
+						return Fail(file_name + ": line " + std::to_string(entry.line) + ": invalid value for '" + entry.key + "' of type " + path->GetType()->GetName());
+					}
+					assigned.push_back(path);
+				}
+
+				for (auto path : assigned)
+				{
+					if (std::memcmp(staging.data() + path->GetOffset(), object + path->GetOffset(), path->GetSize()) != 0)
+					{
+						changed.push_back(*path);
+					}
+				}
+
+				if (!changed.empty())
+				{
+					uint32_t current = sequence.load(std::memory_order_relaxed);
+					sequence.store(current + 1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_release);
+					for (auto& path : changed)
+					{
+						StoreRelaxed(object + path.GetOffset(), staging.data() + path.GetOffset(), path.GetSize());
+					}
+					sequence.store(current + 2, std::memory_order_release);
+				}
+
+				for (auto& callback : callbacks)
+				{
+					for (auto& path : changed)
+					{
+						if (path.GetOffset() < callback.path.GetOffset() + callback.path.GetSize() &&
+							callback.path.GetOffset() < path.GetOffset() + path.GetSize())
+						{
+							triggered.push_back(callback);
+							break;
+						}
+					}
+				}
+				error.clear();
+			}
+
+			// outside the lock, so a callback may reload or register another callback
+			for (auto& callback : triggered)
+			{
+				callback.function(callback.path);
+			}
+			return true;
+		}
+
+		bool Load()
+		{
+			std::ifstream stream(file_name, std::ios::binary);
+			if (!stream)
+			{
+				std::lock_guard<std::mutex> lock(writer_mutex);
+				return Fail(file_name + ": can not be opened");
+			}
+
+			std::ostringstream text;
+			text << stream.rdbuf();
+			return Apply(text.str());
+		}
+
+		// consistent copy of the whole object, never blocks the writer
+		void Read(Pointer copy) const noexcept
+		{
+			ReadBytes(0, static_cast<BytePointer>(copy), type->GetSize());
+		}
+
+		void ReadBytes(Offset offset, BytePointer copy, Size size) const noexcept
+		{
+			for (;;)
+			{
+				uint32_t before = sequence.load(std::memory_order_acquire);
+				if ((before & 1) != 0)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				LoadRelaxed(copy, object + offset, size);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == before)
+				{
+					return;
+				}
+			}
+		}
+
+		template<typename T>
+		T Read() const noexcept
+		{
+			T copy;
+			Read(&copy);
+			return copy;
+		}
+
+		template<typename T>
+		T ReadValue(FieldPath const& path) const noexcept
+		{
+			T value;
+			ReadBytes(path.GetOffset(), reinterpret_cast<BytePointer>(&value), sizeof(T));
+			return value;
+		}
+	};
+
+#if defined(__linux__)
+	// reloads a config whenever its file is written or replaced; the directory is watched, so
+	// editors that save through a temporary file and a rename are picked up too
+	class ConfigWatcher
+	{
+	private:
+		ConfigLoader& loader;
+		std::function<void(std::string const&)> on_error;
+		int inotify_fd;
+		int stop_fd;
+		std::thread thread;
+
+		void Run(std::string name)
+		{
+			alignas(inotify_event) char buffer[4096];
+			pollfd fds[2] = { { inotify_fd, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+			for (;;)
+			{
+				if (poll(fds, 2, -1) < 0 && errno != EINTR)
+				{
+					return;
+				}
+				if ((fds[1].revents & POLLIN) != 0)
+				{
+					return;
+				}
+				if ((fds[0].revents & POLLIN) == 0)
+				{
+					continue;
+				}
+
+				ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+				bool modified = false;
+				for (ssize_t i = 0; i < length; )
+				{
+					auto event = reinterpret_cast<inotify_event const*>(buffer + i);
+					modified |= event->len > 0 && name == event->name;
+					i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+				}
+
+				if (modified && !loader.Load() && on_error)
+				{
+					on_error(loader.GetError());
+				}
+			}
+		}
+
+	public:
+		explicit ConfigWatcher(ConfigLoader& _loader, std::function<void(std::string const&)> _on_error = nullptr) :
+			loader(_loader),
+			on_error(std::move(_on_error)),
+			inotify_fd(inotify_init1(IN_CLOEXEC)),
+			stop_fd(eventfd(0, EFD_CLOEXEC))
+		{
+			auto& fileName = loader.GetFileName();
+			Size slash = fileName.rfind('/');
+			std::string directory = slash == std::string::npos ? "." : fileName.substr(0, slash + 1);
+			std::string name = slash == std::string::npos ? fileName : fileName.substr(slash + 1);
+
+			if (inotify_fd >= 0 && stop_fd >= 0 &&
+				inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0)
+			{
+				thread = std::thread(&ConfigWatcher::Run, this, name);
+			}
+		}
+
+		~ConfigWatcher()
+		{
+			if (thread.joinable())
+			{
+				uint64_t one = 1;
+				(void)!write(stop_fd, &one, sizeof(one));
+				thread.join();
+			}
+			if (inotify_fd >= 0)
+			{
+				close(inotify_fd);
+			}
+			if (stop_fd >= 0)
+			{
+				close(stop_fd);
+			}
+		}
+
+		ConfigWatcher(ConfigWatcher const&) = delete;
+		ConfigWatcher& operator=(ConfigWatcher const&) = delete;
+
+		bool IsWatching() const noexcept { return thread.joinable(); }
+	};
+#endif
+}
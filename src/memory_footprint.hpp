@@ -0,0 +1,450 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "object_graph.hpp"
+#include "thread_pool.hpp"
+
+namespace Reflection
+{
+	// Deep memory accounting. Every object reachable through reflected pointer fields is counted
+	// once per (address, type):
+	//   shallow bytes - sizeof of the objects of a type
+	//   heap bytes    - shallow bytes of the objects first reached through a pointer field of that type
+	//   padding bytes - bytes of the objects not covered by any field, nested records included
+	//   side bytes    - side allocations holding the cold fields of split objects, counted once and
+	//                   attributed like heap bytes
+	// Pointers are assumed to address single objects.
+
+	// padding inside one object of type, exact when the generator recorded the layout, otherwise
+	// estimated from the reflected fields (unreflected fields count as padding, cold fields of a
+	// split type are not part of the object)
+	inline Size GetPaddingSize(Type const* type) noexcept
+	{
+		if (type->GetPaddingMap() != nullptr)
+		{
+			return type->GetPaddingMap()->padding_size;
+		}
+
+		if (type->IsPointer() || type->IsReference() || type->IsBuiltin())
+		{
+			return 0;
+		}
+
+		if (type->IsArray())
+		{
+			return type->GetArrayLength() * GetPaddingSize(type->GetRawType());
+		}
+
+		Size covered = 0;
+		Size nested = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic() && !field->IsIndirect())
+			{
+				covered += field->GetType()->GetSize();
+				nested += GetPaddingSize(field->GetType());
+			}
+		}
+		return covered < type->GetSize() ? type->GetSize() - covered + nested : nested;
+	}
+
+	// alignment of the scalars in type, the alignment of the type on the usual ABIs
+	inline Size GetScalarAlignment(Type const* type) noexcept
+	{
+		if (type->IsPointer() || type->IsReference())
+		{
+			return sizeof(void*);
+		}
+
+		if (type->IsBuiltin())
+		{
+			return type->GetSize() < alignof(std::max_align_t) ? type->GetSize() : alignof(std::max_align_t);
+		}
+
+		if (type->IsArray())
+		{
+			return GetScalarAlignment(type->GetRawType());
+		}
+
+		Size alignment = 1;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			Size fieldAlignment = field->IsStatic() ? 1 : GetScalarAlignment(field->GetType());
+			alignment = fieldAlignment > alignment ? fieldAlignment : alignment;
+		}
+		return alignment;
+	}
+
+	// size of the side allocation behind the pointer at indirection, the Cold struct is not
+	// reflected so it is laid out again from the cold fields
+	inline Size GetSideSize(Type const* type, Offset indirection) noexcept
+	{
+		Size end = 0;
+		Size alignment = 1;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic() && field->GetIndirection() == indirection)
+			{
+				Size fieldEnd = field->GetOffset() + field->GetType()->GetSize();
+				Size fieldAlignment = GetScalarAlignment(field->GetType());
+				end = fieldEnd > end ? fieldEnd : end;
+				alignment = fieldAlignment > alignment ? fieldAlignment : alignment;
+			}
+		}
+		return (end + alignment - 1) / alignment * alignment;
+	}
+
+	struct TypeFootprint
+	{
+		Type const* type;
+		Size instances;
+		Size shallow_bytes;
+		Size heap_bytes;
+		Size padding_bytes;
+		Size side_bytes;
+	};
+
+	class FootprintReport
+	{
+	private:
+		std::vector<TypeFootprint> types;
+		std::unordered_map<Type const*, Size> indices;
+		std::vector<Size> paddings;
+
+		static void WriteJsonString(std::ostream& os, char const* text)
+		{
+			os << '"';
+			for (; *text != '\0'; ++text)
+			{
+				if (*text == '"' || *text == '\\')
+				{
+					os << '\\';
+				}
+				os << *text;
+			}
+			os << '"';
+		}
+
+		// fingerprints are written as 16 hex digits, JSON numbers do not hold 64 bits exactly
+		static void WriteJsonFingerprint(std::ostream& os, Fingerprint fingerprint)
+		{
+			char digits[18] = { '"' };
+			for (Size i = 0; i < 16; ++i)
+			{
+				digits[16 - i] = "0123456789abcdef"[(fingerprint >> (i * 4)) & 0xF];
+			}
+			digits[17] = '"';
+			os.write(digits, 18);
+		}
+
+		static void WriteJsonCounters(std::ostream& os, TypeFootprint const& entry)
+		{
+			os << "\"instances\":" << entry.instances << ",\"shallow_bytes\":" << entry.shallow_bytes <<
+				",\"heap_bytes\":" << entry.heap_bytes << ",\"padding_bytes\":" << entry.padding_bytes <<
+				",\"side_bytes\":" << entry.side_bytes;
+		}
+
+	public:
+		Size GetIndex(Type const* type)
+		{
+			auto result = indices.emplace(type, types.size());
+			if (result.second)
+			{
+				types.push_back(TypeFootprint{ type, 0, 0, 0, 0, 0 });
+				paddings.push_back(GetPaddingSize(type));
+			}
+			return result.first->second;
+		}
+
+		// counts one object, returns its index for heap attribution
+		Size AddInstance(Type const* type)
+		{
+			Size index = GetIndex(type);
+			auto& entry = types[index];
+			entry.instances++;
+			entry.shallow_bytes += type->GetSize();
+			entry.padding_bytes += paddings[index];
+			return index;
+		}
+
+		void AddHeap(Size index, Size bytes) noexcept { types[index].heap_bytes += bytes; }
+
+		void AddSide(Size index, Size bytes) noexcept { types[index].side_bytes += bytes; }
+
+		void Merge(FootprintReport const& other)
+		{
+			for (auto& entry : other.types)
+			{
+				auto& target = types[GetIndex(entry.type)];
+				target.instances += entry.instances;
+				target.shallow_bytes += entry.shallow_bytes;
+				target.heap_bytes += entry.heap_bytes;
+				target.padding_bytes += entry.padding_bytes;
+				target.side_bytes += entry.side_bytes;
+			}
+		}
+
+		std::vector<TypeFootprint> const& GetTypes() const noexcept { return types; }
+
+		TypeFootprint GetTotal() const noexcept
+		{
+			TypeFootprint total = { nullptr, 0, 0, 0, 0, 0 };
+			for (auto& entry : types)
+			{
+				total.instances += entry.instances;
+				total.shallow_bytes += entry.shallow_bytes;
+				total.heap_bytes += entry.heap_bytes;
+				total.padding_bytes += entry.padding_bytes;
+				total.side_bytes += entry.side_bytes;
+			}
+			return total;
+		}
+
+		// {"total":{...},"types":[{"name":...,"fingerprint":"<hex>",...}]}
+		void WriteJson(std::ostream& os) const
+		{
+			os << "{\"total\":{";
+			WriteJsonCounters(os, GetTotal());
+			os << "},\"types\":[";
+			for (Size i = 0; i < types.size(); ++i)
+			{
+				os << (i > 0 ? ",{\"name\":" : "{\"name\":");
+				WriteJsonString(os, types[i].type->GetName());
+				os << ",\"fingerprint\":";
+				WriteJsonFingerprint(os, types[i].type->GetFingerprint());
+				os << ',';
+				WriteJsonCounters(os, types[i]);
+				os << '}';
+			}
+			os << "]}\n";
+		}
+	};
+
+	// visited objects of a single walk
+	class PointerSet
+	{
+	private:
+		PointerIdMap map;
+
+	public:
+		bool Insert(void const* address, Type const* type)
+		{
+			Size length = map.GetLength();
+			map.FindOrInsert(address, type, 1);
+			return map.GetLength() != length;
+		}
+	};
+
+	// visited objects shared by parallel walks, the lock is split by address
+	class ShardedPointerSet
+	{
+	private:
+		static constexpr Size kShardsLength = 64;
+
+		struct Shard
+		{
+			std::mutex mutex;
+			PointerIdMap map;
+		};
+
+		std::unique_ptr<Shard[]> shards;
+
+	public:
+		ShardedPointerSet() : shards(new Shard[kShardsLength]) {}
+
+		bool Insert(void const* address, Type const* type)
+		{
+			uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(address) >> 4) * 0x9E3779B97F4A7C15ull;
+			auto& shard = shards[static_cast<Size>(hash >> 58) % kShardsLength];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			Size length = shard.map.GetLength();
+			shard.map.FindOrInsert(address, type, 1);
+			return shard.map.GetLength() != length;
+		}
+	};
+
+	template<typename Set>
+	class FootprintWalker
+	{
+	private:
+		struct Pending
+		{
+			Type const* type;
+			Byte const* address;
+		};
+
+		Set& visited;
+		FootprintReport& report;
+		std::vector<Pending> stack;
+
+		void VisitFields(Type const* type, Byte const* bytes, Size owner)
+		{
+			if (type->IsPointer())
+			{
+				void const* target;
+				REFL_MEMCPY(&target, bytes, sizeof(target));
+				auto pointee = type->GetRawType();
+				if (target != nullptr && pointee != nullptr && pointee->GetSize() > 0 && visited.Insert(target, pointee))
+				{
+					report.AddHeap(owner, pointee->GetSize());
+					stack.push_back(Pending{ pointee, static_cast<Byte const*>(target) });
+				}
+				return;
+			}
+
+			if (type->IsReference() || type->IsBuiltin() || (!HasPointers(type) && !HasIndirectFields(type)))
+			{
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					VisitFields(elementType, bytes + i * elementType->GetSize(), owner);
+				}
+				return;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (field->IsStatic())
+				{
+					continue;
+				}
+
+				if (field->IsIndirect())
+				{
+					// the side allocation is counted once, by the first of its cold fields
+					void const* side;
+					REFL_MEMCPY(&side, bytes + field->GetIndirection(), sizeof(side));
+					if (side == nullptr)
+					{
+						continue;
+					}
+
+					if (visited.Insert(side, type))
+					{
+						report.AddSide(owner, GetSideSize(type, field->GetIndirection()));
+					}
+				}
+				VisitFields(field->GetType(), field->GetAddress(bytes), owner);
+			}
+		}
+
+	public:
+		FootprintWalker(Set& _visited, FootprintReport& _report) : visited(_visited), report(_report) {}
+
+		// counts obj and everything reachable from it that has not been visited yet
+		void Walk(Type const* type, void const* obj)
+		{
+			stack.push_back(Pending{ type, static_cast<Byte const*>(obj) });
+			while (!stack.empty())
+			{
+				Pending object = stack.back();
+				stack.pop_back();
+				VisitFields(object.type, object.address, report.AddInstance(object.type));
+			}
+		}
+	};
+
+	static inline Size GetDeepBytes(FootprintReport const& report) noexcept
+	{
+		auto total = report.GetTotal();
+		return total.shallow_bytes + total.side_bytes;
+	}
+
+	// total bytes of obj and of everything reachable from it, side allocations included
+	inline Size DeepSize(Type const* type, void const* obj, FootprintReport* report = nullptr)
+	{
+		FootprintReport local;
+		auto& target = report != nullptr ? *report : local;
+		Size before = GetDeepBytes(target);
+
+		PointerSet visited;
+		visited.Insert(obj, type);
+		FootprintWalker<PointerSet> walker(visited, target);
+		walker.Walk(type, obj);
+		return GetDeepBytes(target) - before;
+	}
+
+	// count consecutive objects and their graphs, shared objects counted once
+	inline Size DeepSize(Type const* type, void const* objects, Size count, FootprintReport* report = nullptr)
+	{
+		FootprintReport local;
+		auto& target = report != nullptr ? *report : local;
+		Size before = GetDeepBytes(target);
+		auto bytes = static_cast<Byte const*>(objects);
+
+		PointerSet visited;
+		for (Size i = 0; i < count; ++i)
+		{
+			visited.Insert(bytes + i * type->GetSize(), type);
+		}
+
+		FootprintWalker<PointerSet> walker(visited, target);
+		for (Size i = 0; i < count; ++i)
+		{
+			walker.Walk(type, bytes + i * type->GetSize());
+		}
+		return GetDeepBytes(target) - before;
+	}
+
+	// same as DeepSize over an array, the roots are split across the pool and every worker keeps
+	// its own report until the end; the visited set is shared and sharded
+	inline Size DeepSizeParallel(ThreadPool& pool, Type const* type, void const* objects, Size count, FootprintReport* report = nullptr, Size grain = 0)
+	{
+		FootprintReport local;
+		auto& target = report != nullptr ? *report : local;
+		Size before = GetDeepBytes(target);
+		auto bytes = static_cast<Byte const*>(objects);
+		grain = grain > 0 ? grain : (count / (pool.GetThreadsLength() * 8) > 0 ? count / (pool.GetThreadsLength() * 8) : 1);
+
+		// roots first, so that pointers between them are never counted as heap of another root
+		ShardedPointerSet visited;
+		pool.ParallelFor(count, grain, [&](Size begin, Size end)
+		{
+			for (Size i = begin; i < end; ++i)
+			{
+				visited.Insert(bytes + i * type->GetSize(), type);
+			}
+		});
+
+		std::mutex mutex;
+		pool.ParallelFor(count, grain, [&](Size begin, Size end)
+		{
+			FootprintReport partial;
+			FootprintWalker<ShardedPointerSet> walker(visited, partial);
+			for (Size i = begin; i < end; ++i)
+			{
+				walker.Walk(type, bytes + i * type->GetSize());
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			target.Merge(partial);
+		});
+
+		return GetDeepBytes(target) - before;
+	}
+
+	template<typename T>
+	Size DeepSize(T const& obj, FootprintReport* report = nullptr)
+	{
+		return DeepSize(GetType<T>(), &obj, report);
+	}
+
+	template<typename T>
+	Size DeepSize(T const* objects, Size count, FootprintReport* report = nullptr)
+	{
+		return DeepSize(GetType<T>(), objects, count, report);
+	}
+}
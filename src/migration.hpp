@@ -0,0 +1,393 @@
+#pragma once
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "schema.hpp"
+#include "thread_pool.hpp"
+
+namespace Reflection
+{
+	// Layout migration of live objects after a reflected type changed, e.g. when a plugin is
+	// reloaded with a new version of a struct. Both versions of the type must still be loaded:
+	//
+	//   load the new module, LayoutMigration migration(oldType, newType), register the live
+	//   objects, pools and references, Run(), then unload the old module
+	//
+	// The plan is built once from the two field tables, matching fields by name: unchanged fields
+	// and nested records are copied bytewise (adjacent ones merged into one run), numbers whose
+	// type changed are converted as in schema.hpp, everything else is zeroed. Pointer fields are
+	// copied, so references between migrated objects are patched like registered references.
+	// Objects are treated as trivially relocatable, no constructor or destructor is run. Split
+	// types are refused: their cold fields live in a side allocation the plan can not move.
+
+	struct MigrationRun
+	{
+		Offset source_offset;
+		Offset target_offset;
+		Size size;
+	};
+
+	struct MigrationPlan
+	{
+		Size source_size;
+		Size target_size;
+		std::vector<MigrationRun> runs;
+		std::vector<ConversionOp> conversions;
+		// false when either type is split, the plan is empty then
+		bool migratable;
+	};
+
+	static inline bool IsMigratableField(Field const* field) noexcept
+	{
+		return !field->IsStatic() && !field->GetType()->IsReference();
+	}
+
+	static inline void AddMigrationRun(MigrationPlan& plan, Offset sourceOffset, Offset targetOffset, Size size)
+	{
+		plan.runs.push_back(MigrationRun{ sourceOffset, targetOffset, size });
+	}
+
+	// fields of target matched by name in source, nested records whose layout changed are matched
+	// recursively
+	inline void CollectMigrationOps(MigrationPlan& plan, Type const* sourceType, Offset sourceBase, Type const* targetType, Offset targetBase)
+	{
+		for (Size i = 0; i < targetType->GetFieldsLength(); ++i)
+		{
+			auto targetField = targetType->GetField(i);
+			if (!IsMigratableField(targetField))
+			{
+				continue;
+			}
+
+			Field const* sourceField = nullptr;
+			auto name = GetUnqualifiedName(targetField->GetName());
+			for (Size j = 0; j < sourceType->GetFieldsLength() && sourceField == nullptr; ++j)
+			{
+				auto candidate = sourceType->GetField(j);
+				if (IsMigratableField(candidate) && strcmp(GetUnqualifiedName(candidate->GetName()), name) == 0)
+				{
+					sourceField = candidate;
+				}
+			}
+
+			if (sourceField == nullptr)
+			{
+				continue;
+			}
+
+			auto source = sourceField->GetType();
+			auto target = targetField->GetType();
+			Offset sourceOffset = sourceBase + sourceField->GetOffset();
+			Offset targetOffset = targetBase + targetField->GetOffset();
+
+			if (source->IsPointer() && target->IsPointer())
+			{
+				AddMigrationRun(plan, sourceOffset, targetOffset, target->GetSize());
+			}
+			else if (GetLayoutFingerprint(source) == GetLayoutFingerprint(target))
+			{
+				AddMigrationRun(plan, sourceOffset, targetOffset, target->GetSize());
+			}
+			else if (source->IsBuiltin() && target->IsBuiltin())
+			{
+				ConversionOp op;
+				op.kind = ConversionOpKind::kConvert;
+				op.source_kind = source->GetNumericKind();
+				op.target_kind = target->GetNumericKind();
+				op.source_offset = sourceOffset;
+				op.source_size = source->GetSize();
+				op.target_offset = targetOffset;
+				op.target_indirection = kNoIndirection;
+				op.target_type = target;
+				if (op.source_kind != NumericKind::kNone && op.target_kind != NumericKind::kNone)
+				{
+					plan.conversions.push_back(op);
+				}
+			}
+			else if (!source->IsArray() && !target->IsArray() && !source->IsBuiltin() && !target->IsBuiltin())
+			{
+				CollectMigrationOps(plan, source, sourceOffset, target, targetOffset);
+			}
+		}
+	}
+
+	inline MigrationPlan BuildMigrationPlan(Type const* sourceType, Type const* targetType)
+	{
+		MigrationPlan plan;
+		plan.source_size = sourceType->GetSize();
+		plan.target_size = targetType->GetSize();
+		plan.migratable = !HasIndirectFields(sourceType) && !HasIndirectFields(targetType);
+
+		if (!plan.migratable)
+		{
+			return plan;
+		}
+
+		// the layout fingerprint covers the offsets, equal ones make the objects bit-for-bit alike
+		if (GetLayoutFingerprint(sourceType) == GetLayoutFingerprint(targetType))
+		{
+			AddMigrationRun(plan, 0, 0, plan.target_size);
+			return plan;
+		}
+
+		CollectMigrationOps(plan, sourceType, 0, targetType, 0);
+
+		// fields that kept their relative position become one memcpy
+		std::sort(plan.runs.begin(), plan.runs.end(), [](MigrationRun const& a, MigrationRun const& b)
+		{
+			return a.target_offset < b.target_offset;
+		});
+
+		Size length = 0;
+		for (auto& run : plan.runs)
+		{
+			if (length > 0)
+			{
+				auto& last = plan.runs[length - 1];
+				if (last.source_offset + last.size == run.source_offset && last.target_offset + last.size == run.target_offset)
+				{
+					last.size += run.size;
+					continue;
+				}
+			}
+			plan.runs[length++] = run;
+		}
+		plan.runs.resize(length);
+		return plan;
+	}
+
+	// target is zeroed first, so new and unmatched fields start out zero
+	inline void RunMigrationPlan(MigrationPlan const& plan, void const* source, Pointer target) noexcept
+	{
+		auto sourceBytes = static_cast<Byte const*>(source);
+		auto targetBytes = static_cast<BytePointer>(target);
+
+		if (plan.runs.size() != 1 || plan.runs[0].size != plan.target_size)
+		{
+			std::memset(targetBytes, 0, plan.target_size);
+		}
+
+		for (auto& run : plan.runs)
+		{
+			REFL_MEMCPY(targetBytes + run.target_offset, sourceBytes + run.source_offset, run.size);
+		}
+
+		for (auto& op : plan.conversions)
+		{
+			ConvertNumeric(op, sourceBytes + op.source_offset, targetBytes + op.target_offset);
+		}
+	}
+
+	struct MigrationResult
+	{
+		Size objects;
+		Size patched_references;
+		Size unresolved_references;
+	};
+
+	class LayoutMigration
+	{
+	public:
+		typedef void* (*AllocateFunction)(Size size);
+		typedef void (*FreeFunction)(void* address);
+
+	private:
+		// storage of old objects, old and new address of the first object
+		struct Block
+		{
+			void** slot;
+			Size length;
+			Byte const* source;
+			BytePointer target;
+		};
+
+		MigrationPlan plan;
+		Type const* source_type;
+		std::vector<Block> blocks;
+		std::vector<void**> references;
+		AllocateFunction allocate_function;
+		FreeFunction free_function;
+
+		static void* DefaultAllocate(Size size) { return ::operator new(size); }
+		static void DefaultFree(void* address) { ::operator delete(address); }
+
+		// maps an old object address to the new one, interior pointers are mapped by field
+		bool Relocate(void*& address) const noexcept
+		{
+			auto bytes = static_cast<Byte const*>(address);
+			auto it = std::upper_bound(blocks.begin(), blocks.end(), bytes, [](Byte const* key, Block const& block)
+			{
+				return key < block.source;
+			});
+			if (it == blocks.begin())
+			{
+				return false;
+			}
+
+			auto& block = *--it;
+			if (block.length == 0)
+			{
+				return false;
+			}
+
+			Size offset = static_cast<Size>(bytes - block.source);
+			if (offset >= block.length * plan.source_size)
+			{
+				return false;
+			}
+
+			Size index = offset / plan.source_size;
+			Size inner = offset % plan.source_size;
+			BytePointer object = block.target + index * plan.target_size;
+			if (inner == 0)
+			{
+				address = object;
+				return true;
+			}
+
+			for (auto& run : plan.runs)
+			{
+				if (inner >= run.source_offset && inner < run.source_offset + run.size)
+				{
+					address = object + run.target_offset + (inner - run.source_offset);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void Patch(void** slot, MigrationResult& result) const noexcept
+		{
+			void* address;
+			REFL_MEMCPY(&address, slot, sizeof(address));
+			if (address == nullptr)
+			{
+				return;
+			}
+
+			if (Relocate(address))
+			{
+				REFL_MEMCPY(slot, &address, sizeof(address));
+				result.patched_references++;
+			}
+			else
+			{
+				result.unresolved_references++;
+			}
+		}
+
+	public:
+		LayoutMigration(Type const* sourceType, Type const* targetType, AllocateFunction _allocate_function = nullptr, FreeFunction _free_function = nullptr) :
+			plan(BuildMigrationPlan(sourceType, targetType)),
+			source_type(sourceType),
+			allocate_function(_allocate_function != nullptr ? _allocate_function : &DefaultAllocate),
+			free_function(_free_function != nullptr ? _free_function : &DefaultFree)
+		{}
+
+		MigrationPlan const& GetPlan() const noexcept { return plan; }
+		bool IsMigratable() const noexcept { return plan.migratable; }
+
+		// *slot owns a single object, it is replaced by the migrated copy
+		void AddObject(void** slot) { blocks.push_back(Block{ slot, 1, nullptr, nullptr }); }
+
+		// *slot owns length consecutive objects, migrated in parallel when Run gets a pool
+		void AddPool(void** slot, Size length) { blocks.push_back(Block{ slot, length, nullptr, nullptr }); }
+
+		// *slot points to (or into) one of the migrated objects
+		void AddReference(void** slot) { references.push_back(slot); }
+
+		// allocates and fills the new objects, patches every registered reference and the pointer
+		// fields of the new objects, then frees the old storage; when the types are not migratable
+		// nothing is touched and the result is all zero
+		MigrationResult Run(ThreadPool* pool = nullptr, Size grain = 1024)
+		{
+			MigrationResult result = { 0, 0, 0 };
+			if (!plan.migratable)
+			{
+				blocks.clear();
+				references.clear();
+				return result;
+			}
+
+			for (auto& block : blocks)
+			{
+				block.source = static_cast<Byte const*>(*block.slot);
+				if (block.source == nullptr || block.length == 0)
+				{
+					block.length = 0;
+					continue;
+				}
+				block.target = static_cast<BytePointer>(allocate_function(block.length * plan.target_size));
+
+				if (pool != nullptr && block.length > grain)
+				{
+					pool->ParallelFor(block.length, grain, [&](Size begin, Size end)
+					{
+						for (Size i = begin; i < end; ++i)
+						{
+							RunMigrationPlan(plan, block.source + i * plan.source_size, block.target + i * plan.target_size);
+						}
+					});
+				}
+				else
+				{
+					for (Size i = 0; i < block.length; ++i)
+					{
+						RunMigrationPlan(plan, block.source + i * plan.source_size, block.target + i * plan.target_size);
+					}
+				}
+				result.objects += block.length;
+			}
+
+			std::sort(blocks.begin(), blocks.end(), [](Block const& a, Block const& b) { return a.source < b.source; });
+
+			// top level pointer fields of the migrated objects that point into migrated storage
+			std::vector<Offset> pointerOffsets;
+			for (Size i = 0; i < source_type->GetFieldsLength(); ++i)
+			{
+				auto field = source_type->GetField(i);
+				if (IsMigratableField(field) && field->GetType()->IsPointer())
+				{
+					for (auto& run : plan.runs)
+					{
+						if (field->GetOffset() >= run.source_offset && field->GetOffset() < run.source_offset + run.size)
+						{
+							pointerOffsets.push_back(run.target_offset + (field->GetOffset() - run.source_offset));
+						}
+					}
+				}
+			}
+
+			for (auto& block : blocks)
+			{
+				for (Size i = 0; i < block.length && !pointerOffsets.empty(); ++i)
+				{
+					for (auto offset : pointerOffsets)
+					{
+						MigrationResult ignored = { 0, 0, 0 };
+						Patch(reinterpret_cast<void**>(block.target + i * plan.target_size + offset), ignored);
+					}
+				}
+			}
+
+			for (auto slot : references)
+			{
+				Patch(slot, result);
+			}
+
+			for (auto& block : blocks)
+			{
+				if (block.length > 0)
+				{
+					*block.slot = block.target;
+					free_function(const_cast<Byte*>(block.source));
+				}
+			}
+
+			blocks.clear();
+			references.clear();
+			return result;
+		}
+	};
+}
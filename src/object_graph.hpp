@@ -0,0 +1,572 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "serialization.hpp"
+
+namespace Reflection
+{
+	// Object graph format: every object reachable from the root through reflected pointer fields
+	// is written once, in discovery order, and pointers are replaced by object ids (0 is null,
+	// the root is 1). Shared objects and cycles survive the round trip.
+	//
+	//   uint32 magic, uint32 types length, per type: uint64 fingerprint, uint32 body size
+	//   uint32 objects length, per object: uint32 type index
+	//   object bodies in id order
+	//
+	// A body is the binary format of serialization.hpp with every pointer written as a uint32 id.
+	// Pointers address whole objects: a pointer into the middle of another object is written as
+	// a separate copy.
+
+	constexpr uint32_t kObjectGraphMagic = 0x47524652;
+
+	typedef uint32_t ObjectId;
+
+	// open addressing map from (address, type) to object id, linear probing, power of two capacity
+	class PointerIdMap
+	{
+	private:
+		struct Slot
+		{
+			void const* key;
+			Type const* type;
+			ObjectId id;
+		};
+
+		std::vector<Slot> slots;
+		Size length;
+
+		static Size Hash(void const* key, Type const* type) noexcept
+		{
+			uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)) ^ (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(type)) << 7);
+			value *= 0x9E3779B97F4A7C15ull;
+			return static_cast<Size>(value ^ (value >> 32));
+		}
+
+		void Grow()
+		{
+			std::vector<Slot> old(slots.size() * 2, Slot{ nullptr, nullptr, 0 });
+			old.swap(slots);
+			for (auto& slot : old)
+			{
+				if (slot.key != nullptr)
+				{
+					Size mask = slots.size() - 1;
+					Size index = Hash(slot.key, slot.type) & mask;
+					while (slots[index].key != nullptr)
+					{
+						index = (index + 1) & mask;
+					}
+					slots[index] = slot;
+				}
+			}
+		}
+
+	public:
+		explicit PointerIdMap(Size capacity = 64) : length(0)
+		{
+			Size size = 16;
+			while (size < capacity * 2)
+			{
+				size *= 2;
+			}
+			slots.assign(size, Slot{ nullptr, nullptr, 0 });
+		}
+
+		// returns the id of key, or inserts id and returns it when key is new
+		ObjectId FindOrInsert(void const* key, Type const* type, ObjectId id)
+		{
+			if ((length + 1) * 2 > slots.size())
+			{
+				Grow();
+			}
+
+			Size mask = slots.size() - 1;
+			Size index = Hash(key, type) & mask;
+			while (slots[index].key != nullptr)
+			{
+				if (slots[index].key == key && slots[index].type == type)
+				{
+					return slots[index].id;
+				}
+				index = (index + 1) & mask;
+			}
+
+			slots[index] = Slot{ key, type, id };
+			length++;
+			return id;
+		}
+
+		Size GetLength() const noexcept { return length; }
+	};
+
+	// size of one object body, pointers count as ids
+	inline Size GetGraphBodySize(Type const* type) noexcept
+	{
+		if (type->IsPointer())
+		{
+			return sizeof(ObjectId);
+		}
+
+		if (type->IsReference())
+		{
+			return 0;
+		}
+
+		if (type->IsArray())
+		{
+			return type->GetArrayLength() * GetGraphBodySize(type->GetRawType());
+		}
+
+		if (type->IsBuiltin())
+		{
+			return type->GetSize();
+		}
+
+		Size size = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic())
+			{
+				size += GetGraphBodySize(field->GetType());
+			}
+		}
+		return size;
+	}
+
+	static inline bool HasPointers(Type const* type) noexcept
+	{
+		if (type->IsPointer())
+		{
+			return true;
+		}
+
+		if (type->IsArray())
+		{
+			return HasPointers(type->GetRawType());
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic() && HasPointers(field->GetType()))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	class ObjectGraphWriter
+	{
+	private:
+		struct Object
+		{
+			Byte const* address;
+			Type const* type;
+			uint32_t type_index;
+		};
+
+		struct TypeEntry
+		{
+			Type const* type;
+			Size body_size;
+		};
+
+		std::vector<Object> objects;
+		std::vector<TypeEntry> types;
+		PointerIdMap ids;
+		MemoryOutputStream bodies;
+
+		uint32_t GetTypeIndex(Type const* type)
+		{
+			for (Size i = 0; i < types.size(); ++i)
+			{
+				if (types[i].type == type)
+				{
+					return static_cast<uint32_t>(i);
+				}
+			}
+
+			types.push_back(TypeEntry{ type, GetGraphBodySize(type) });
+			return static_cast<uint32_t>(types.size() - 1);
+		}
+
+		ObjectId GetId(void const* address, Type const* type)
+		{
+			if (address == nullptr || type == nullptr || type->GetSize() == 0)
+			{
+				return 0;
+			}
+
+			ObjectId next = static_cast<ObjectId>(objects.size() + 1);
+			ObjectId id = ids.FindOrInsert(address, type, next);
+			if (id == next)
+			{
+				objects.push_back(Object{ static_cast<Byte const*>(address), type, GetTypeIndex(type) });
+			}
+			return id;
+		}
+
+		void WriteBody(Type const* type, Byte const* bytes)
+		{
+			if (type->IsPointer())
+			{
+				void const* target;
+				REFL_MEMCPY(&target, bytes, sizeof(target));
+				ObjectId id = GetId(target, type->GetRawType());
+				bodies.Write(&id, sizeof(id));
+				return;
+			}
+
+			if (type->IsReference())
+			{
+				return;
+			}
+
+			if (type->IsBuiltin() || !HasPointers(type))
+			{
+				Serialize(type, bytes, bodies);
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					WriteBody(elementType, bytes + i * elementType->GetSize());
+				}
+				return;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!field->IsStatic())
+				{
+					WriteBody(field->GetType(), field->GetAddress(bytes));
+				}
+			}
+		}
+
+	public:
+		bool Write(Type const* type, void const* root, OutputStream& os)
+		{
+			objects.clear();
+			types.clear();
+			ids = PointerIdMap();
+			bodies.Clear();
+
+			GetId(root, type);
+
+			// objects found while writing a body are appended and written in turn
+			for (Size i = 0; i < objects.size(); ++i)
+			{
+				Object object = objects[i];
+				WriteBody(object.type, object.address);
+			}
+
+			for (auto& entry : types)
+			{
+				if (HasIndirectFields(entry.type))
+				{
+					// the loader could not give the object its side allocation
+					return false;
+				}
+			}
+
+			MemoryOutputStream header;
+			uint32_t magic = kObjectGraphMagic;
+			uint32_t typesLength = static_cast<uint32_t>(types.size());
+			uint32_t objectsLength = static_cast<uint32_t>(objects.size());
+			header.Write(&magic, sizeof(magic));
+			header.Write(&typesLength, sizeof(typesLength));
+			for (auto& entry : types)
+			{
+				Fingerprint fingerprint = entry.type->GetFingerprint();
+				uint32_t bodySize = static_cast<uint32_t>(entry.body_size);
+				header.Write(&fingerprint, sizeof(fingerprint));
+				header.Write(&bodySize, sizeof(bodySize));
+			}
+			header.Write(&objectsLength, sizeof(objectsLength));
+			for (auto& object : objects)
+			{
+				header.Write(&object.type_index, sizeof(object.type_index));
+			}
+
+			return os.Write(header.GetData(), header.GetSize()) == header.GetSize() &&
+				os.Write(bodies.GetData(), bodies.GetSize()) == bodies.GetSize();
+		}
+
+		Size GetObjectsLength() const noexcept { return objects.size(); }
+	};
+
+	// Rebuilt graph. Objects are allocated in one zero-filled arena per type; the first pass
+	// assigns every id its address in a flat table, the second fills the bodies and resolves
+	// pointers by indexing that table. Constructors are not run, so the loaded types should be
+	// plain data aside from their reflected fields, and split types are refused.
+	class ObjectGraph
+	{
+	private:
+		struct Arena
+		{
+			Type const* type;
+			std::unique_ptr<std::max_align_t[]> storage;
+			Size length;
+		};
+
+		std::vector<Arena> arenas;
+		std::vector<Pointer> objects;
+		// arena index of every object, so that a pointer can be checked against its pointee type
+		std::vector<uint32_t> object_arenas;
+
+		static void CollectTypes(Type const* type, std::vector<Type const*>& reachable)
+		{
+			if (type == nullptr)
+			{
+				return;
+			}
+
+			if (type->IsPointer())
+			{
+				auto pointee = type->GetRawType();
+				if (pointee == nullptr || pointee->GetSize() == 0)
+				{
+					return;
+				}
+
+				for (auto known : reachable)
+				{
+					if (known->GetFingerprint() == pointee->GetFingerprint())
+					{
+						return;
+					}
+				}
+
+				reachable.push_back(pointee);
+				CollectTypes(pointee, reachable);
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				CollectTypes(type->GetRawType(), reachable);
+				return;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!field->IsStatic())
+				{
+					CollectTypes(field->GetType(), reachable);
+				}
+			}
+		}
+
+		bool ReadBody(Type const* type, BytePointer target, Byte const*& source)
+		{
+			if (type->IsPointer())
+			{
+				ObjectId id;
+				REFL_MEMCPY(&id, source, sizeof(id));
+				source += sizeof(id);
+				if (id >= objects.size())
+				{
+					return false;
+				}
+				if (id != 0)
+				{
+					// an id of an object of another type would alias it through the wrong fields
+					auto pointee = type->GetRawType();
+					if (pointee == nullptr || arenas[object_arenas[id]].type->GetFingerprint() != pointee->GetFingerprint())
+					{
+						return false;
+					}
+				}
+				REFL_MEMCPY(target, &objects[id], sizeof(Pointer));
+				return true;
+			}
+
+			if (type->IsReference())
+			{
+				return true;
+			}
+
+			if (type->IsBuiltin() || !HasPointers(type))
+			{
+				Size size = GetSerializedSize(type);
+				Deserialize(type, target, source, size);
+				source += size;
+				return true;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					if (!ReadBody(elementType, target + i * elementType->GetSize(), source))
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!field->IsStatic() && !ReadBody(field->GetType(), field->GetAddress(target), source))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		// type is the root type, the types of all other objects are found through its pointer fields
+		bool Load(Type const* type, void const* data, Size size)
+		{
+			arenas.clear();
+			objects.clear();
+			object_arenas.clear();
+
+			auto bytes = static_cast<Byte const*>(data);
+			auto end = bytes + size;
+			uint32_t magic;
+			uint32_t typesLength;
+			if (size < sizeof(magic) + sizeof(typesLength))
+			{
+				return false;
+			}
+
+			REFL_MEMCPY(&magic, bytes, sizeof(magic));
+			REFL_MEMCPY(&typesLength, bytes + sizeof(magic), sizeof(typesLength));
+			bytes += sizeof(magic) + sizeof(typesLength);
+			if (magic != kObjectGraphMagic || Size(end - bytes) < Size(typesLength) * 12 + sizeof(uint32_t))
+			{
+				return false;
+			}
+
+			std::vector<Type const*> reachable(1, type);
+			CollectTypes(type, reachable);
+
+			for (uint32_t i = 0; i < typesLength; ++i)
+			{
+				Fingerprint fingerprint;
+				uint32_t bodySize;
+				REFL_MEMCPY(&fingerprint, bytes, sizeof(fingerprint));
+				REFL_MEMCPY(&bodySize, bytes + sizeof(fingerprint), sizeof(bodySize));
+				bytes += sizeof(fingerprint) + sizeof(bodySize);
+
+				Type const* match = nullptr;
+				for (auto candidate : reachable)
+				{
+					if (candidate->GetFingerprint() == fingerprint)
+					{
+						match = candidate;
+						break;
+					}
+				}
+
+				// arenas are zero-filled, split types would have no side allocation
+				if (match == nullptr || GetGraphBodySize(match) != bodySize || HasIndirectFields(match))
+				{
+					return false;
+				}
+				arenas.push_back(Arena{ match, nullptr, 0 });
+			}
+
+			uint32_t objectsLength;
+			REFL_MEMCPY(&objectsLength, bytes, sizeof(objectsLength));
+			bytes += sizeof(objectsLength);
+			if (Size(end - bytes) < Size(objectsLength) * sizeof(uint32_t))
+			{
+				return false;
+			}
+
+			// pass 1: size the arenas, then give every id its address
+			Byte const* table = bytes;
+			Size bodiesSize = 0;
+			for (uint32_t i = 0; i < objectsLength; ++i)
+			{
+				uint32_t typeIndex;
+				REFL_MEMCPY(&typeIndex, table + i * sizeof(typeIndex), sizeof(typeIndex));
+				// object 1 is the root, it must be of the requested type
+				if (typeIndex >= arenas.size() || (i == 0 && arenas[typeIndex].type->GetFingerprint() != type->GetFingerprint()))
+				{
+					return false;
+				}
+				arenas[typeIndex].length++;
+				bodiesSize += GetGraphBodySize(arenas[typeIndex].type);
+			}
+			bytes += objectsLength * sizeof(uint32_t);
+			if (Size(end - bytes) != bodiesSize)
+			{
+				return false;
+			}
+
+			std::vector<Size> used(arenas.size(), 0);
+			for (auto& arena : arenas)
+			{
+				Size slots = (arena.length * arena.type->GetSize() + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+				arena.storage.reset(new std::max_align_t[slots]());
+			}
+
+			objects.resize(objectsLength + 1, nullptr);
+			object_arenas.resize(objectsLength + 1, 0);
+			for (uint32_t i = 0; i < objectsLength; ++i)
+			{
+				uint32_t typeIndex;
+				REFL_MEMCPY(&typeIndex, table + i * sizeof(typeIndex), sizeof(typeIndex));
+				object_arenas[i + 1] = typeIndex;
+				auto& arena = arenas[typeIndex];
+				objects[i + 1] = reinterpret_cast<BytePointer>(arena.storage.get()) + used[typeIndex]++ * arena.type->GetSize();
+			}
+
+			// pass 2: fill the bodies, pointers are plain table lookups
+			for (uint32_t i = 0; i < objectsLength; ++i)
+			{
+				uint32_t typeIndex;
+				REFL_MEMCPY(&typeIndex, table + i * sizeof(typeIndex), sizeof(typeIndex));
+				if (!ReadBody(arenas[typeIndex].type, static_cast<BytePointer>(objects[i + 1]), bytes))
+				{
+					arenas.clear();
+					objects.clear();
+					object_arenas.clear();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		Pointer GetRoot() const noexcept { return objects.size() > 1 ? objects[1] : nullptr; }
+		Size GetObjectsLength() const noexcept { return objects.empty() ? 0 : objects.size() - 1; }
+
+		template<typename T>
+		T* GetRoot() const noexcept { return static_cast<T*>(GetRoot()); }
+	};
+
+	inline bool SerializeGraph(Type const* type, void const* root, OutputStream& os)
+	{
+		ObjectGraphWriter writer;
+		return writer.Write(type, root, os);
+	}
+
+	template<typename T>
+	bool SerializeGraph(T const& root, OutputStream& os)
+	{
+		return SerializeGraph(GetType<T>(), &root, os);
+	}
+
+	template<typename T>
+	T* LoadGraph(ObjectGraph& graph, void const* data, Size size)
+	{
+		return graph.Load(GetType<T>(), data, size) ? graph.GetRoot<T>() : nullptr;
+	}
+}
@@ -0,0 +1,462 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// Copy, swap, equality and hashing of reflected objects. Each operation checks the traits of
+	// the type first: a trivially copyable type is copied and swapped with one memcpy, a type with
+	// unique representations whose field table covers every byte is compared with one memcmp and
+	// hashed over its bytes. Other types go through a plan built once per type from the field
+	// tables, where every nested record or array that allows it is again a single run and
+	// adjacent runs are merged.
+	//
+	// Only instance fields take part: static fields and references are skipped, pointers are
+	// copied and compared as addresses. Floating point values compare by value, so +0 equals -0,
+	// and hash alike. Other builtins compare as raw bytes, as in serialization.hpp.
+	//
+	// Split types (split_storage.hpp) never take the single memcpy or memcmp, whatever their
+	// traits: the side pointer is left alone and the cold fields are copied, swapped, compared
+	// and hashed through it, each object keeps its own side allocation.
+
+	enum class ObjectRunKind : Byte
+	{
+		kBytes,
+		kFloat
+	};
+
+	struct ObjectRun
+	{
+		Offset offset;
+		Size size;
+		ObjectRunKind kind;
+	};
+
+	// runs of the cold fields of a split type, relative to the side pointer stored at indirection
+	struct ObjectSide
+	{
+		Offset indirection;
+		std::vector<ObjectRun> copy_runs;
+		std::vector<ObjectRun> compare_runs;
+	};
+
+	// one memcpy copies the object. A complete field table can not hold a split record, whose
+	// side pointer is not reflected, so the field walk only runs for the other types.
+	inline bool IsBytewiseCopyable(Type const* type) noexcept
+	{
+		return type->IsTriviallyCopyable() && (type->HasCompleteFields() || !HasIndirectFields(type));
+	}
+
+	// one memcmp decides equality and the object bytes are its hash
+	inline bool IsBytewiseComparable(Type const* type) noexcept
+	{
+		return type->HasUniqueRepresentations() && type->HasCompleteFields();
+	}
+
+	class ObjectPlan
+	{
+	private:
+		std::vector<ObjectRun> copy_runs;
+		std::vector<ObjectRun> compare_runs;
+		std::vector<ObjectSide> sides;
+		// false when a part is neither trivially copyable nor made of reflected fields, or is a
+		// split record inside a side allocation
+		bool is_copyable;
+		bool is_comparable;
+
+		static void AddRun(std::vector<ObjectRun>& runs, Offset offset, Size size, ObjectRunKind kind)
+		{
+			if (size == 0)
+			{
+				return;
+			}
+			if (kind == ObjectRunKind::kBytes && !runs.empty() && runs.back().kind == kind && runs.back().offset + runs.back().size == offset)
+			{
+				runs.back().size += size;
+				return;
+			}
+			runs.push_back(ObjectRun{ offset, size, kind });
+		}
+
+		static bool IsObjectField(Field const* field) noexcept
+		{
+			return !field->IsStatic() && !field->GetType()->IsReference();
+		}
+
+		ObjectSide* GetSide(Offset indirection)
+		{
+			for (auto& side : sides)
+			{
+				if (side.indirection == indirection)
+				{
+					return &side;
+				}
+			}
+			sides.push_back(ObjectSide{ indirection, {}, {} });
+			return &sides.back();
+		}
+
+		// side is null while collecting the object itself
+		void CollectCopy(Type const* type, Offset base, ObjectSide* side)
+		{
+			auto& runs = side != nullptr ? side->copy_runs : copy_runs;
+			if (IsBytewiseCopyable(type))
+			{
+				AddRun(runs, base, type->GetSize(), ObjectRunKind::kBytes);
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					CollectCopy(elementType, base + i * elementType->GetSize(), side);
+				}
+				return;
+			}
+
+			if (type->IsBuiltin() || type->IsPointer() || type->GetFieldsLength() == 0)
+			{
+				is_copyable = false;
+				return;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!IsObjectField(field))
+				{
+					continue;
+				}
+				if (!field->IsIndirect())
+				{
+					CollectCopy(field->GetType(), base + field->GetOffset(), side);
+				}
+				else if (side == nullptr)
+				{
+					CollectCopy(field->GetType(), field->GetOffset(), GetSide(base + field->GetIndirection()));
+				}
+				else
+				{
+					is_copyable = false;
+				}
+			}
+		}
+
+		void CollectCompare(Type const* type, Offset base, ObjectSide* side)
+		{
+			auto& runs = side != nullptr ? side->compare_runs : compare_runs;
+			if (IsBytewiseComparable(type) || type->IsPointer())
+			{
+				AddRun(runs, base, type->GetSize(), ObjectRunKind::kBytes);
+				return;
+			}
+
+			if (type->IsArray())
+			{
+				auto elementType = type->GetRawType();
+				for (Size i = 0; i < type->GetArrayLength(); ++i)
+				{
+					CollectCompare(elementType, base + i * elementType->GetSize(), side);
+				}
+				return;
+			}
+
+			if (type->IsBuiltin())
+			{
+				AddRun(runs, base, type->GetSize(), type->GetNumericKind() == NumericKind::kFloat ? ObjectRunKind::kFloat : ObjectRunKind::kBytes);
+				return;
+			}
+
+			for (Size i = 0; i < type->GetFieldsLength(); ++i)
+			{
+				auto field = type->GetField(i);
+				if (!IsObjectField(field))
+				{
+					continue;
+				}
+				if (!field->IsIndirect())
+				{
+					CollectCompare(field->GetType(), base + field->GetOffset(), side);
+				}
+				else if (side == nullptr)
+				{
+					CollectCompare(field->GetType(), field->GetOffset(), GetSide(base + field->GetIndirection()));
+				}
+				else
+				{
+					is_comparable = false;
+				}
+			}
+		}
+
+	public:
+		explicit ObjectPlan(Type const* type) :
+			is_copyable(true),
+			is_comparable(true)
+		{
+			CollectCopy(type, 0, nullptr);
+			CollectCompare(type, 0, nullptr);
+		}
+
+		std::vector<ObjectRun> const& GetCopyRuns() const noexcept { return copy_runs; }
+		std::vector<ObjectRun> const& GetCompareRuns() const noexcept { return compare_runs; }
+		std::vector<ObjectSide> const& GetSides() const noexcept { return sides; }
+		bool IsCopyable() const noexcept { return is_copyable; }
+		bool IsComparable() const noexcept { return is_comparable; }
+	};
+
+	// plans are built once per type and never freed
+	inline ObjectPlan const& GetObjectPlan(Type const* type)
+	{
+		static std::mutex mutex;
+		static std::unordered_map<Type const*, std::unique_ptr<ObjectPlan>> plans;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& plan = plans[type];
+		if (!plan)
+		{
+			plan.reset(new ObjectPlan(type));
+		}
+		return *plan;
+	}
+
+	// the side allocation of a split object, null when it has none
+	static inline BytePointer LoadSide(void const* obj, Offset indirection) noexcept
+	{
+		BytePointer side;
+		REFL_MEMCPY(&side, static_cast<Byte const*>(obj) + indirection, sizeof(side));
+		return side;
+	}
+
+	// every side allocation the plan needs is present in both objects
+	static inline bool HasSides(ObjectPlan const& plan, void const* a, void const* b) noexcept
+	{
+		for (auto& side : plan.GetSides())
+		{
+			if (LoadSide(a, side.indirection) == nullptr || LoadSide(b, side.indirection) == nullptr)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static inline void SwapBytes(BytePointer a, BytePointer b, Size size) noexcept
+	{
+		Byte buffer[256];
+		while (size > 0)
+		{
+			Size count = size < sizeof(buffer) ? size : sizeof(buffer);
+			REFL_MEMCPY(buffer, a, count);
+			REFL_MEMCPY(a, b, count);
+			REFL_MEMCPY(b, buffer, count);
+			a += count;
+			b += count;
+			size -= count;
+		}
+	}
+
+	// float, double or long double by its size, widened so that values compare exactly
+	static inline long double LoadFloat(Byte const* bytes, Size size) noexcept
+	{
+		if (size == sizeof(float))
+		{
+			float value;
+			REFL_MEMCPY(&value, bytes, sizeof(value));
+			return value;
+		}
+		if (size == sizeof(double))
+		{
+			double value;
+			REFL_MEMCPY(&value, bytes, sizeof(value));
+			return value;
+		}
+		long double value;
+		REFL_MEMCPY(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	static inline void CopyRuns(std::vector<ObjectRun> const& runs, BytePointer target, Byte const* source) noexcept
+	{
+		for (auto& run : runs)
+		{
+			REFL_MEMCPY(target + run.offset, source + run.offset, run.size);
+		}
+	}
+
+	static inline void SwapRuns(std::vector<ObjectRun> const& runs, BytePointer a, BytePointer b) noexcept
+	{
+		for (auto& run : runs)
+		{
+			SwapBytes(a + run.offset, b + run.offset, run.size);
+		}
+	}
+
+	static inline bool EqualRuns(std::vector<ObjectRun> const& runs, Byte const* a, Byte const* b) noexcept
+	{
+		for (auto& run : runs)
+		{
+			if (run.kind == ObjectRunKind::kFloat)
+			{
+				if (LoadFloat(a + run.offset, run.size) != LoadFloat(b + run.offset, run.size))
+				{
+					return false;
+				}
+			}
+			else if (std::memcmp(a + run.offset, b + run.offset, run.size) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static inline Fingerprint HashRuns(std::vector<ObjectRun> const& runs, Byte const* bytes, Fingerprint hash) noexcept
+	{
+		for (auto& run : runs)
+		{
+			if (run.kind == ObjectRunKind::kFloat)
+			{
+				double value = static_cast<double>(LoadFloat(bytes + run.offset, run.size));
+				if (value == 0)
+				{
+					value = 0;
+				}
+				hash = HashBytes(&value, sizeof(value), hash);
+			}
+			else
+			{
+				hash = HashBytes(bytes + run.offset, run.size, hash);
+			}
+		}
+		return hash;
+	}
+
+	// copies the instance fields of source into target, returns false without writing anything
+	// when the type has a part that cannot be copied bytewise. The cold fields of a split type
+	// are copied into the side allocation target already owns, so both objects need one.
+	inline bool CopyObject(Type const* type, Pointer target, void const* source)
+	{
+		if (IsBytewiseCopyable(type))
+		{
+			REFL_MEMCPY(target, source, type->GetSize());
+			return true;
+		}
+
+		auto& plan = GetObjectPlan(type);
+		if (!plan.IsCopyable() || !HasSides(plan, target, source))
+		{
+			return false;
+		}
+
+		CopyRuns(plan.GetCopyRuns(), static_cast<BytePointer>(target), static_cast<Byte const*>(source));
+		for (auto& side : plan.GetSides())
+		{
+			CopyRuns(side.copy_runs, LoadSide(target, side.indirection), LoadSide(source, side.indirection));
+		}
+		return true;
+	}
+
+	// exchanges the instance fields of a and b, under the same conditions as CopyObject; split
+	// objects keep their side allocations and exchange the cold fields in them
+	inline bool SwapObjects(Type const* type, Pointer a, Pointer b)
+	{
+		if (IsBytewiseCopyable(type))
+		{
+			SwapBytes(static_cast<BytePointer>(a), static_cast<BytePointer>(b), type->GetSize());
+			return true;
+		}
+
+		auto& plan = GetObjectPlan(type);
+		if (!plan.IsCopyable() || !HasSides(plan, a, b))
+		{
+			return false;
+		}
+
+		SwapRuns(plan.GetCopyRuns(), static_cast<BytePointer>(a), static_cast<BytePointer>(b));
+		for (auto& side : plan.GetSides())
+		{
+			SwapRuns(side.copy_runs, LoadSide(a, side.indirection), LoadSide(b, side.indirection));
+		}
+		return true;
+	}
+
+	// cold fields are compared through the side pointers, a split object without its side
+	// allocation only equals another one without it; types the plan can not compare are never
+	// equal
+	inline bool EqualObjects(Type const* type, void const* a, void const* b)
+	{
+		if (IsBytewiseComparable(type))
+		{
+			return std::memcmp(a, b, type->GetSize()) == 0;
+		}
+
+		auto& plan = GetObjectPlan(type);
+		if (!plan.IsComparable() || !EqualRuns(plan.GetCompareRuns(), static_cast<Byte const*>(a), static_cast<Byte const*>(b)))
+		{
+			return false;
+		}
+
+		for (auto& side : plan.GetSides())
+		{
+			auto aSide = LoadSide(a, side.indirection);
+			auto bSide = LoadSide(b, side.indirection);
+			if (aSide == nullptr || bSide == nullptr ? aSide != bSide : !EqualRuns(side.compare_runs, aSide, bSide))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// FNV-1a over the compared parts, objects that are EqualObjects hash alike
+	inline Fingerprint HashObject(Type const* type, void const* obj)
+	{
+		if (IsBytewiseComparable(type))
+		{
+			return HashBytes(obj, type->GetSize());
+		}
+
+		auto& plan = GetObjectPlan(type);
+		Fingerprint hash = HashRuns(plan.GetCompareRuns(), static_cast<Byte const*>(obj), kFingerprintBasis);
+		for (auto& side : plan.GetSides())
+		{
+			auto bytes = LoadSide(obj, side.indirection);
+			if (bytes != nullptr)
+			{
+				hash = HashRuns(side.compare_runs, bytes, hash);
+			}
+		}
+		return hash;
+	}
+
+	template<typename T>
+	bool CopyObject(T& target, T const& source)
+	{
+		return CopyObject(GetType<T>(), &target, &source);
+	}
+
+	template<typename T>
+	bool SwapObjects(T& a, T& b)
+	{
+		return SwapObjects(GetType<T>(), &a, &b);
+	}
+
+	template<typename T>
+	bool EqualObjects(T const& a, T const& b)
+	{
+		return EqualObjects(GetType<T>(), &a, &b);
+	}
+
+	template<typename T>
+	Fingerprint HashObject(T const& obj)
+	{
+		return HashObject(GetType<T>(), &obj);
+	}
+}
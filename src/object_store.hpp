@@ -0,0 +1,544 @@
+#pragma once
+#if defined(_WIN32)
+#error "object_store.hpp requires POSIX mmap/msync"
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "schema.hpp"
+
+namespace Reflection
+{
+	// Object store file layout, for arrays of trivially copyable reflected types. Split types are
+	// refused, their cold fields live behind a pointer that has no meaning in a file:
+	//
+	//   ObjectStoreHeader
+	//   per field: uint64 offset, uint64 size, uint64 type layout fingerprint,
+	//              uint16 name length, uint16 type name length, uint32 nested fields length,
+	//              name, type name, the fields of a record in the same format
+	//   padding up to data_offset, a multiple of kObjectStoreAlignment
+	//   count * element_size bytes of raw elements
+	//
+	// The fingerprints are layout fingerprints, which also cover field offsets. A file whose
+	// fingerprint matches the current type is mapped and used in place, otherwise its elements
+	// are converted through a name-matched conversion plan.
+
+	constexpr uint32_t kObjectStoreMagic = 0x4F4C4652; // "RFLO"
+	constexpr Size kObjectStoreAlignment = 4096;
+	constexpr Size kObjectStoreReadBlock = 1 << 16;
+
+	struct ObjectStoreHeader
+	{
+		uint32_t magic;
+		uint32_t fields_length;
+		Fingerprint fingerprint;
+		uint64_t element_size;
+		uint64_t count;
+		uint64_t data_offset;
+	};
+
+	static inline Size AlignUp(Size value, Size alignment) noexcept
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// offsets of nested fields count from the start of the element
+	static inline void WriteObjectStoreFields(Type const* type, Offset base, OutputStream& os)
+	{
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!IsSerializableField(field))
+			{
+				continue;
+			}
+
+			auto fieldType = field->GetType();
+			auto name = GetUnqualifiedName(field->GetName());
+			auto typeName = fieldType->GetName();
+			bool isRecord = IsSchemaRecord(fieldType);
+			WriteValue(os, static_cast<uint64_t>(base + field->GetOffset()));
+			WriteValue(os, static_cast<uint64_t>(fieldType->GetSize()));
+			WriteValue(os, GetLayoutFingerprint(fieldType));
+			WriteValue(os, static_cast<uint16_t>(std::strlen(name)));
+			WriteValue(os, static_cast<uint16_t>(std::strlen(typeName)));
+			WriteValue(os, isRecord ? GetSchemaFieldsLength(fieldType) : uint32_t(0));
+			os.Write(name, std::strlen(name));
+			os.Write(typeName, std::strlen(typeName));
+			if (isRecord)
+			{
+				WriteObjectStoreFields(fieldType, base + field->GetOffset(), os);
+			}
+		}
+	}
+
+	// header, field table and padding of an empty store
+	inline std::vector<Byte> BuildObjectStoreHeader(Type const* type)
+	{
+		MemoryOutputStream os;
+		ObjectStoreHeader header;
+		header.magic = kObjectStoreMagic;
+		header.fields_length = 0;
+		header.fingerprint = GetLayoutFingerprint(type);
+		header.element_size = type->GetSize();
+		header.count = 0;
+		header.data_offset = 0;
+		header.fields_length = GetSchemaFieldsLength(type);
+
+		WriteValue(os, header);
+		WriteObjectStoreFields(type, 0, os);
+
+		std::vector<Byte> bytes(os.GetData(), os.GetData() + os.GetSize());
+		header.data_offset = AlignUp(bytes.size(), kObjectStoreAlignment);
+		bytes.resize(header.data_offset, 0);
+		REFL_MEMCPY(bytes.data(), &header, sizeof(header));
+		return bytes;
+	}
+
+	// nested fields must lie within the record they belong to
+	static inline bool ReadObjectStoreFieldList(Byte const*& cursor, Byte const* end, uint32_t fieldsLength, uint64_t begin, uint64_t limit, Size depth, std::vector<SchemaField>& fields)
+	{
+		if (depth > kMaxSchemaDepth)
+		{
+			return false;
+		}
+
+		fields.clear();
+		fields.reserve(fieldsLength < 256 ? fieldsLength : 256);
+		for (uint32_t i = 0; i < fieldsLength; ++i)
+		{
+			SchemaField field;
+			uint64_t offset, fieldSize;
+			uint16_t nameLength, typeNameLength;
+			uint32_t nestedLength;
+			if (!ReadValue(cursor, end, offset) ||
+				!ReadValue(cursor, end, fieldSize) ||
+				!ReadValue(cursor, end, field.type_fingerprint) ||
+				!ReadValue(cursor, end, nameLength) ||
+				!ReadValue(cursor, end, typeNameLength) ||
+				!ReadValue(cursor, end, nestedLength) ||
+				static_cast<Size>(end - cursor) < static_cast<Size>(nameLength) + typeNameLength ||
+				offset < begin || offset > limit || fieldSize > limit - offset)
+			{
+				return false;
+			}
+
+			field.name.assign(reinterpret_cast<char const*>(cursor), nameLength);
+			cursor += nameLength;
+			field.type_name.assign(reinterpret_cast<char const*>(cursor), typeNameLength);
+			cursor += typeNameLength;
+			field.offset = static_cast<Offset>(offset);
+			field.size = static_cast<Size>(fieldSize);
+			if (!ReadObjectStoreFieldList(cursor, end, nestedLength, offset, offset + fieldSize, depth + 1, field.fields))
+			{
+				return false;
+			}
+			fields.push_back(std::move(field));
+		}
+
+		return true;
+	}
+
+	inline bool ReadObjectStoreFields(Byte const* data, Size size, ObjectStoreHeader const& header, std::vector<SchemaField>& fields)
+	{
+		auto cursor = data + sizeof(ObjectStoreHeader);
+		return ReadObjectStoreFieldList(cursor, data + size, header.fields_length, 0, UINT64_MAX, 0, fields);
+	}
+
+	static inline bool ReadFully(int fd, void* buffer, Size size, off_t offset)
+	{
+		auto bytes = static_cast<BytePointer>(buffer);
+		while (size > 0)
+		{
+			ssize_t count = pread(fd, bytes, size, offset);
+			if (count <= 0)
+			{
+				return false;
+			}
+
+			bytes += count;
+			size -= static_cast<Size>(count);
+			offset += count;
+		}
+		return true;
+	}
+
+	class ObjectStoreReader
+	{
+	private:
+		void* mapping;
+		Size mapping_size;
+		std::vector<std::max_align_t> converted;
+		Pointer data;
+		Size count;
+
+	public:
+		ObjectStoreReader() : mapping(nullptr), mapping_size(0), data(nullptr), count(0) {}
+		ObjectStoreReader(ObjectStoreReader const&) = delete;
+		ObjectStoreReader& operator=(ObjectStoreReader const&) = delete;
+		~ObjectStoreReader() { Close(); }
+
+		// elements are copy-on-write: changing them never touches the file
+		bool Open(char const* path, Type const* type)
+		{
+			Close();
+
+			if (HasIndirectFields(type))
+			{
+				return false;
+			}
+
+			int fd = open(path, O_RDONLY);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			struct stat st;
+			ObjectStoreHeader header;
+			bool valid = fstat(fd, &st) == 0 &&
+				ReadFully(fd, &header, sizeof(header), 0) &&
+				header.magic == kObjectStoreMagic &&
+				header.data_offset + header.count * header.element_size <= static_cast<uint64_t>(st.st_size);
+
+			Fingerprint fingerprint = GetLayoutFingerprint(type);
+			if (valid && header.fingerprint == fingerprint && header.element_size == type->GetSize())
+			{
+				mapping_size = static_cast<Size>(header.data_offset + header.count * header.element_size);
+				mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+				if (mapping == MAP_FAILED)
+				{
+					mapping = nullptr;
+					valid = false;
+				}
+				else
+				{
+					data = static_cast<BytePointer>(mapping) + header.data_offset;
+					count = static_cast<Size>(header.count);
+				}
+			}
+			else if (valid)
+			{
+				valid = Convert(fd, header, type, fingerprint);
+			}
+
+			close(fd);
+			return valid;
+		}
+
+		void Close()
+		{
+			if (mapping)
+			{
+				munmap(mapping, mapping_size);
+			}
+
+			mapping = nullptr;
+			mapping_size = 0;
+			converted.clear();
+			data = nullptr;
+			count = 0;
+		}
+
+		bool IsZeroCopy() const noexcept { return mapping != nullptr; }
+		Size GetCount() const noexcept { return count; }
+		Pointer GetData() const noexcept { return data; }
+
+		template<typename T>
+		T* GetArray() const noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "object store elements must be trivially copyable");
+			return static_cast<T*>(data);
+		}
+
+	private:
+		// streams the stored elements through a conversion plan in bounded blocks
+		bool Convert(int fd, ObjectStoreHeader const& header, Type const* type, Fingerprint fingerprint)
+		{
+			auto& cache = ConversionPlanCache::Get();
+			auto plan = cache.Find(header.fingerprint, fingerprint, DataLayout::kObject);
+			if (plan == nullptr)
+			{
+				std::vector<Byte> table(static_cast<Size>(header.data_offset));
+				std::vector<SchemaField> storedFields;
+				if (!ReadFully(fd, table.data(), table.size(), 0) || !ReadObjectStoreFields(table.data(), table.size(), header, storedFields))
+				{
+					return false;
+				}
+				plan = cache.Insert(header.fingerprint, fingerprint, BuildConversionPlan(storedFields, type, DataLayout::kObject));
+			}
+
+			Size elementSize = static_cast<Size>(header.element_size);
+			if (elementSize == 0 || plan->body_size > elementSize)
+			{
+				return false;
+			}
+
+			count = static_cast<Size>(header.count);
+			converted.assign((count * type->GetSize() + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t), std::max_align_t());
+			data = converted.data();
+
+			Size blockLength = kObjectStoreReadBlock / elementSize > 0 ? kObjectStoreReadBlock / elementSize : 1;
+			std::vector<Byte> block(blockLength * elementSize);
+			auto target = static_cast<BytePointer>(data);
+
+			for (Size first = 0; first < count; first += blockLength)
+			{
+				Size length = count - first < blockLength ? count - first : blockLength;
+				if (!ReadFully(fd, block.data(), length * elementSize, static_cast<off_t>(header.data_offset + first * elementSize)))
+				{
+					return false;
+				}
+
+				for (Size i = 0; i < length; ++i)
+				{
+					RunConversionPlan(*plan, block.data() + i * elementSize, target + (first + i) * type->GetSize());
+				}
+			}
+
+			return true;
+		}
+	};
+
+	// Appends elements through a shared writable mapping; dirty pages are flushed with
+	// msync(MS_ASYNC) by a background thread and synchronously on Flush/Close.
+	class ObjectStoreWriter
+	{
+	private:
+		int fd;
+		BytePointer mapping;
+		Size capacity;
+		Size data_offset;
+		Size element_size;
+		Size dirty_begin;
+		Size dirty_end;
+		bool stopping;
+		std::chrono::milliseconds flush_interval;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::thread flusher;
+
+		ObjectStoreHeader* GetHeader() const noexcept { return reinterpret_cast<ObjectStoreHeader*>(mapping); }
+
+		bool Map(Size size)
+		{
+			if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+			{
+				return false;
+			}
+
+			void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (address == MAP_FAILED)
+			{
+				return false;
+			}
+
+			mapping = static_cast<BytePointer>(address);
+			capacity = size;
+			return true;
+		}
+
+		// called with the mutex held
+		void SyncDirty(int flags)
+		{
+			if (dirty_begin < dirty_end)
+			{
+				Size begin = dirty_begin / kObjectStoreAlignment * kObjectStoreAlignment;
+				msync(mapping + begin, dirty_end - begin, flags);
+				dirty_begin = SIZE_MAX;
+				dirty_end = 0;
+			}
+		}
+
+		void MarkDirty(Size begin, Size end) noexcept
+		{
+			dirty_begin = begin < dirty_begin ? begin : dirty_begin;
+			dirty_end = end > dirty_end ? end : dirty_end;
+		}
+
+		void FlushLoop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping)
+			{
+				wake.wait_for(lock, flush_interval);
+				SyncDirty(MS_ASYNC);
+			}
+		}
+
+	public:
+		ObjectStoreWriter() :
+			fd(-1),
+			mapping(nullptr),
+			capacity(0),
+			data_offset(0),
+			element_size(0),
+			dirty_begin(SIZE_MAX),
+			dirty_end(0),
+			stopping(false),
+			flush_interval(100)
+		{}
+
+		ObjectStoreWriter(ObjectStoreWriter const&) = delete;
+		ObjectStoreWriter& operator=(ObjectStoreWriter const&) = delete;
+		~ObjectStoreWriter() { Close(); }
+
+		// creates the file, or reopens it for append when it was written with the same schema
+		bool Open(char const* path, Type const* type, std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100))
+		{
+			Close();
+
+			if (HasIndirectFields(type))
+			{
+				return false;
+			}
+
+			fd = open(path, O_RDWR | O_CREAT, 0644);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			struct stat st;
+			if (fstat(fd, &st) != 0)
+			{
+				Close();
+				return false;
+			}
+
+			ObjectStoreHeader header;
+			if (st.st_size == 0)
+			{
+				auto bytes = BuildObjectStoreHeader(type);
+				REFL_MEMCPY(&header, bytes.data(), sizeof(header));
+				if (pwrite(fd, bytes.data(), bytes.size(), 0) != static_cast<ssize_t>(bytes.size()))
+				{
+					Close();
+					return false;
+				}
+			}
+			else if (!ReadFully(fd, &header, sizeof(header), 0) ||
+				header.magic != kObjectStoreMagic ||
+				header.fingerprint != GetLayoutFingerprint(type) ||
+				header.element_size != type->GetSize())
+			{
+				// appending requires the exact same schema
+				Close();
+				return false;
+			}
+
+			data_offset = static_cast<Size>(header.data_offset);
+			element_size = static_cast<Size>(header.element_size);
+
+			Size used = data_offset + static_cast<Size>(header.count) * element_size;
+			if (!Map(AlignUp(used + element_size, kObjectStoreAlignment)))
+			{
+				Close();
+				return false;
+			}
+
+			stopping = false;
+			flush_interval = flushInterval;
+			flusher = std::thread(&ObjectStoreWriter::FlushLoop, this);
+			return true;
+		}
+
+		Size GetCount() const noexcept { return mapping ? static_cast<Size>(GetHeader()->count) : 0; }
+
+		bool Append(void const* objects, Size count)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (mapping == nullptr)
+			{
+				return false;
+			}
+
+			Size begin = data_offset + static_cast<Size>(GetHeader()->count) * element_size;
+			Size end = begin + count * element_size;
+
+			if (end > capacity)
+			{
+				// grow geometrically, dirty offsets stay valid across the remap
+				SyncDirty(MS_ASYNC);
+				munmap(mapping, capacity);
+				mapping = nullptr;
+				Size grown = capacity * 2 > end ? capacity * 2 : end;
+				if (!Map(AlignUp(grown, kObjectStoreAlignment)))
+				{
+					return false;
+				}
+			}
+
+			REFL_MEMCPY(mapping + begin, objects, end - begin);
+			// publish the count after the elements
+			GetHeader()->count += count;
+			MarkDirty(begin, end);
+			MarkDirty(0, sizeof(ObjectStoreHeader));
+			return true;
+		}
+
+		template<typename T>
+		bool Append(T const* objects, Size count)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "object store elements must be trivially copyable");
+			return Append(static_cast<void const*>(objects), count);
+		}
+
+		// blocks until every appended element is on disk
+		bool Flush()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (mapping == nullptr)
+			{
+				return false;
+			}
+
+			MarkDirty(0, data_offset + static_cast<Size>(GetHeader()->count) * element_size);
+			SyncDirty(MS_SYNC);
+			return true;
+		}
+
+		void Close()
+		{
+			if (flusher.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				wake.notify_one();
+				flusher.join();
+			}
+
+			if (mapping)
+			{
+				Size used = data_offset + static_cast<Size>(GetHeader()->count) * element_size;
+				msync(mapping, capacity, MS_SYNC);
+				munmap(mapping, capacity);
+				mapping = nullptr;
+				// drop the preallocated tail
+				if (ftruncate(fd, static_cast<off_t>(used)) != 0)
+				{
+					// the file stays valid, the header bounds the data
+				}
+			}
+
+			if (fd >= 0)
+			{
+				close(fd);
+				fd = -1;
+			}
+
+			capacity = 0;
+			dirty_begin = SIZE_MAX;
+			dirty_end = 0;
+		}
+	};
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "compact_serialization.hpp"
+#include "thread_pool.hpp"
+
+namespace Reflection
+{
+	enum class WireFormat : Byte
+	{
+		kBinary,
+		kCompact
+	};
+
+	constexpr Size kParallelChunkBytes = 1 << 18;
+
+	// Serializes count consecutive objects on the pool. The binary format has a fixed size per
+	// element, so every chunk encodes straight into its pre-offset slice of out. Compact chunks
+	// vary in size: they are encoded into local buffers and stitched together with a prefix sum.
+	// If any object fails out is left as it was.
+	inline bool SerializeArrayParallel(ThreadPool& pool, Type const* type, void const* objects, Size count, std::vector<Byte>& out,
+		WireFormat format = WireFormat::kBinary, Size chunkLength = 0)
+	{
+		auto bytes = static_cast<Byte const*>(objects);
+		Size stride = type->GetSize();
+		Size elementSize = GetSerializedSize(type);
+
+		if (chunkLength == 0)
+		{
+			Size perChunk = kParallelChunkBytes / (stride > 0 ? stride : 1);
+			Size perThread = (count + pool.GetThreadsLength() * 4 - 1) / (pool.GetThreadsLength() * 4);
+			chunkLength = perChunk < perThread ? perChunk : perThread;
+			chunkLength = chunkLength > 0 ? chunkLength : 1;
+		}
+
+		if (format == WireFormat::kBinary)
+		{
+			Size base = out.size();
+			out.resize(base + count * elementSize);
+			BytePointer target = out.data() + base;
+			std::atomic<bool> failed(false);
+
+			pool.ParallelFor(count, chunkLength, [&](Size begin, Size end)
+			{
+				BufferOutputStream os(target + begin * elementSize, (end - begin) * elementSize);
+				for (Size i = begin; i < end; ++i)
+				{
+					if (!Serialize(type, bytes + i * stride, os))
+					{
+						failed.store(true, std::memory_order_relaxed);
+						return;
+					}
+				}
+			});
+
+			if (failed.load())
+			{
+				out.resize(base);
+				return false;
+			}
+			return true;
+		}
+
+		Size chunksLength = (count + chunkLength - 1) / chunkLength;
+		std::vector<std::vector<Byte>> chunks(chunksLength);
+		std::atomic<bool> failed(false);
+
+		pool.ParallelFor(chunksLength, 1, [&](Size begin, Size end)
+		{
+			for (Size chunk = begin; chunk < end; ++chunk)
+			{
+				Size first = chunk * chunkLength;
+				Size last = first + chunkLength < count ? first + chunkLength : count;
+				for (Size i = first; i < last && !failed.load(std::memory_order_relaxed); ++i)
+				{
+					if (!SerializeCompact(type, bytes + i * stride, chunks[chunk]))
+					{
+						failed.store(true, std::memory_order_relaxed);
+					}
+				}
+			}
+		});
+
+		if (failed.load())
+		{
+			return false;
+		}
+
+		std::vector<Size> offsets(chunksLength + 1, out.size());
+		for (Size chunk = 0; chunk < chunksLength; ++chunk)
+		{
+			offsets[chunk + 1] = offsets[chunk] + chunks[chunk].size();
+		}
+
+		out.resize(offsets[chunksLength]);
+		pool.ParallelFor(chunksLength, 1, [&](Size begin, Size end)
+		{
+			for (Size chunk = begin; chunk < end; ++chunk)
+			{
+				if (!chunks[chunk].empty())
+				{
+					REFL_MEMCPY(out.data() + offsets[chunk], chunks[chunk].data(), chunks[chunk].size());
+				}
+			}
+		});
+
+		return true;
+	}
+
+	template<typename T>
+	bool SerializeArrayParallel(ThreadPool& pool, T const* objects, Size count, std::vector<Byte>& out, WireFormat format = WireFormat::kBinary, Size chunkLength = 0)
+	{
+		return SerializeArrayParallel(pool, GetType<T>(), objects, count, out, format, chunkLength);
+	}
+}
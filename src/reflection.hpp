@@ -2,6 +2,14 @@
 #include <ostream>
 #include <memory>
 #include <type_traits>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #ifndef _REFL_GEN_OFF_
 #define CLASS(class_name, ...) class __attribute__((annotate("reflect" #__VA_ARGS__))) class_name
@@ -16,6 +24,14 @@
 #endif
 
 #define REFL_MEMCPY(src, dst, size) std::memcpy(src, dst, size)
+// a comma inside a macro argument, the generator spells Vec<float REFL_COMMA 4> in offsetof
+#define REFL_COMMA ,
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define REFL_LITTLE_ENDIAN 1
+#else
+#define REFL_LITTLE_ENDIAN 0
+#endif
 
 namespace Reflection
 {
@@ -26,15 +42,26 @@ namespace Reflection
 	typedef void* Pointer;
 	typedef uint8_t Byte;
 	typedef Byte* BytePointer;
+	typedef uint64_t Fingerprint;
 
 	template<typename T, Size FieldsNum, Size MethodsNum>
 	struct TypeStorage;
+	// hot/cold split layout of T, specialized by the generator for types with FIELD(cold) members
+	template<typename T>
+	struct SplitStorage;
+	// T with its thread-owned fields on separate cache lines, specialized by meta_gen -emit-padded
+	template<typename T>
+	struct PaddedStorage;
 	class Field;
 	class Type;
 	class Method;
 	template<typename T>
 	struct Tag {};
 
+	// resolves a type on first use, pointer types name their pointee this way so that
+	// self-referential records do not recurse during static initialization
+	typedef Type const* (*TypeGetter)();
+
 	enum class TypeSpecifierType : Byte
 	{
 		kBuiltin,
@@ -106,11 +133,78 @@ namespace Reflection
 		kExternalLinkage
 	};
 
+	enum class NumericKind : Byte
+	{
+		kNone,
+		kSigned,
+		kUnsigned,
+		kFloat
+	};
+
+	template<typename T>
+	constexpr NumericKind GetNumericKindOf() noexcept
+	{
+		return std::is_floating_point<T>::value ? NumericKind::kFloat :
+			!std::is_integral<T>::value ? NumericKind::kNone :
+			std::is_signed<T>::value ? NumericKind::kSigned : NumericKind::kUnsigned;
+	}
+
+	// wire encoding selected through FIELD(encoding=...) / CLASS(name, encoding=...)
+	enum class Encoding : Byte
+	{
+		kDefault,
+		kFixed,
+		kVarint,
+		kDelta
+	};
+
+	// ordering of the atomic field helpers, selected through FIELD(memory_order=...)
+	enum class MemoryOrder : Byte
+	{
+		kRelaxed,
+		kConsume,
+		kAcquire,
+		kRelease,
+		kAcqRel,
+		kSeqCst
+	};
+
+	// options of FIELD(...), METHOD(...) and CLASS(name, ...) that meta_gen knows, one bit per
+	// option that is present; options with a value are listed in the attribute table as well
+	enum class AnnotationFlags : uint32_t
+	{
+		kNone = 0,
+		kTransient = 1 << 0,
+		kHot = 1 << 1,
+		kCold = 1 << 2,
+		kThreadOwned = 1 << 3,
+		kEncoding = 1 << 4,
+		kMemoryOrder = 1 << 5,
+		kName = 1 << 6,
+		kRange = 1 << 7,
+		kInstantiations = 1 << 8
+	};
+
+	// properties of the object representation, recorded by meta_gen from Clang and by
+	// DECLARE_TYPE from <type_traits>. object_ops.hpp and serialization.hpp check them once per
+	// type to handle a whole object with one memcpy or memcmp instead of walking its fields.
+	enum class TypeTraits : Byte
+	{
+		kNone = 0,
+		kTriviallyCopyable = 1 << 0,
+		kStandardLayout = 1 << 1,
+		// equal values have equal bytes: no padding, no floating point members
+		kUniqueRepresentations = 1 << 2,
+		// the field table covers every byte of the object: every non-static data member is
+		// reflected, recursively, and there are no base classes, bit-fields or a vtable pointer
+		kFieldsComplete = 1 << 3
+	};
+
 	template<typename TEnumType>
 	struct support_bitwise_enum : std::false_type {};
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator&(TEnumType left, TEnumType right)
 	{
 		return static_cast<TEnumType>(
@@ -119,7 +213,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator|(TEnumType left, TEnumType right)
 	{
 		return static_cast<TEnumType>(
@@ -128,7 +222,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator^(TEnumType left, TEnumType right)
 	{
 		return static_cast<TEnumType>(
@@ -137,7 +231,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator~(TEnumType value)
 	{
 		return static_cast<TEnumType>(
@@ -145,7 +239,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator&=(TEnumType& left, TEnumType right)
 	{
 		left = left & right;
@@ -153,7 +247,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator|=(TEnumType& left, TEnumType right)
 	{
 		left = left | right;
@@ -161,7 +255,7 @@ namespace Reflection
 	}
 
 	template<typename TEnumType>
-	typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
+	constexpr typename std::enable_if_t<support_bitwise_enum<TEnumType>::value, TEnumType>
 		operator^=(TEnumType& left, TEnumType right)
 	{
 		left = left ^ right;
@@ -171,7 +265,24 @@ namespace Reflection
 	template<>
 	struct support_bitwise_enum<CVRQualifier> : std::true_type {};
 
-	std::ostream& operator<<(std::ostream& stream, TypeSpecifierType const& value)
+	template<>
+	struct support_bitwise_enum<AnnotationFlags> : std::true_type {};
+
+	template<>
+	struct support_bitwise_enum<TypeTraits> : std::true_type {};
+
+	// traits of a builtin, enum or pointer type. Integers, enums and pointers have unique
+	// representations, floating point types do not (+0 and -0, NaN payloads).
+	template<typename T>
+	constexpr TypeTraits GetTypeTraitsOf() noexcept
+	{
+		return (std::is_trivially_copyable<T>::value ? TypeTraits::kTriviallyCopyable : TypeTraits::kNone) |
+			(std::is_standard_layout<T>::value ? TypeTraits::kStandardLayout : TypeTraits::kNone) |
+			(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value ? TypeTraits::kUniqueRepresentations : TypeTraits::kNone) |
+			(std::is_scalar<T>::value ? TypeTraits::kFieldsComplete : TypeTraits::kNone);
+	}
+
+	inline std::ostream& operator<<(std::ostream& stream, TypeSpecifierType const& value)
 	{
 		switch (value)
 		{
@@ -194,7 +305,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, CVRQualifier const& value)
+	inline std::ostream& operator<<(std::ostream& stream, CVRQualifier const& value)
 	{
 		if (value == CVRQualifier::kNone)
 		{
@@ -234,7 +345,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, RefDeclarator const& value)
+	inline std::ostream& operator<<(std::ostream& stream, RefDeclarator const& value)
 	{
 		switch (value)
 		{
@@ -251,7 +362,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, StorageClassSpecifier const& value)
+	inline std::ostream& operator<<(std::ostream& stream, StorageClassSpecifier const& value)
 	{
 		switch (value)
 		{
@@ -277,7 +388,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, ThreadStorageClassSpecifier const& value)
+	inline std::ostream& operator<<(std::ostream& stream, ThreadStorageClassSpecifier const& value)
 	{
 		switch (value)
 		{
@@ -297,7 +408,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, StorageDuration const& value)
+	inline std::ostream& operator<<(std::ostream& stream, StorageDuration const& value)
 	{
 		switch (value)
 		{
@@ -323,7 +434,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, AccessSpecifier const& value)
+	inline std::ostream& operator<<(std::ostream& stream, AccessSpecifier const& value)
 	{
 		switch (value)
 		{
@@ -343,7 +454,7 @@ namespace Reflection
 		return stream;
 	}
 
-	std::ostream& operator<<(std::ostream& stream, Linkage const& value)
+	inline std::ostream& operator<<(std::ostream& stream, Linkage const& value)
 	{
 		switch (value)
 		{
@@ -372,7 +483,78 @@ namespace Reflection
 		return stream;
 	}
 
-	int strcmp(char const *p1, char const *p2)
+	inline std::ostream& operator<<(std::ostream& stream, Encoding const& value)
+	{
+		switch (value)
+		{
+		case Encoding::kDefault:
+			stream << "kDefault";
+			break;
+		case Encoding::kFixed:
+			stream << "kFixed";
+			break;
+		case Encoding::kVarint:
+			stream << "kVarint";
+			break;
+		case Encoding::kDelta:
+			stream << "kDelta";
+			break;
+		}
+		return stream;
+	}
+
+	inline std::ostream& operator<<(std::ostream& stream, MemoryOrder const& value)
+	{
+		switch (value)
+		{
+		case MemoryOrder::kRelaxed:
+			stream << "kRelaxed";
+			break;
+		case MemoryOrder::kConsume:
+			stream << "kConsume";
+			break;
+		case MemoryOrder::kAcquire:
+			stream << "kAcquire";
+			break;
+		case MemoryOrder::kRelease:
+			stream << "kRelease";
+			break;
+		case MemoryOrder::kAcqRel:
+			stream << "kAcqRel";
+			break;
+		case MemoryOrder::kSeqCst:
+			stream << "kSeqCst";
+			break;
+		}
+		return stream;
+	}
+
+#if !defined(_MSC_VER)
+	// loads can not release and stores can not acquire, those parts of the order are dropped
+	constexpr int ToLoadOrder(MemoryOrder order) noexcept
+	{
+		return order == MemoryOrder::kRelaxed || order == MemoryOrder::kRelease ? __ATOMIC_RELAXED :
+			order == MemoryOrder::kConsume ? __ATOMIC_CONSUME :
+			order == MemoryOrder::kSeqCst ? __ATOMIC_SEQ_CST : __ATOMIC_ACQUIRE;
+	}
+
+	constexpr int ToStoreOrder(MemoryOrder order) noexcept
+	{
+		return order == MemoryOrder::kRelaxed || order == MemoryOrder::kConsume || order == MemoryOrder::kAcquire ? __ATOMIC_RELAXED :
+			order == MemoryOrder::kSeqCst ? __ATOMIC_SEQ_CST : __ATOMIC_RELEASE;
+	}
+
+	constexpr int ToExchangeOrder(MemoryOrder order) noexcept
+	{
+		return order == MemoryOrder::kRelaxed ? __ATOMIC_RELAXED :
+			order == MemoryOrder::kConsume ? __ATOMIC_CONSUME :
+			order == MemoryOrder::kAcquire ? __ATOMIC_ACQUIRE :
+			order == MemoryOrder::kRelease ? __ATOMIC_RELEASE :
+			order == MemoryOrder::kAcqRel ? __ATOMIC_ACQ_REL : __ATOMIC_SEQ_CST;
+	}
+#endif
+
+	inline int strcmp(char const *p1, char const *p2)
 	{
 		const unsigned char *s1 = (const unsigned char *)p1;
 		const unsigned char *s2 = (const unsigned char *)p2;
@@ -387,15 +569,152 @@ namespace Reflection
 		return c1 - c2;
 	}
 
+	// "Foo::field" -> "field"
+	inline char const* GetUnqualifiedName(char const* name) noexcept
+	{
+		char const* result = name;
+		for (char const* c = name; *c != '\0'; ++c)
+		{
+			if (c[0] == ':' && c[1] == ':')
+			{
+				result = c + 2;
+			}
+		}
+		return result;
+	}
+
+	// matches either the qualified or the unqualified name
+	inline bool MatchName(char const* name, char const* query) noexcept
+	{
+		return strcmp(name, query) == 0 || strcmp(GetUnqualifiedName(name), query) == 0;
+	}
+
+	// 64-bit FNV-1a
+	constexpr Fingerprint kFingerprintBasis = 14695981039346656037ull;
+	constexpr Fingerprint kFingerprintPrime = 1099511628211ull;
+
+	inline Fingerprint HashBytes(void const* data, Size size, Fingerprint hash = kFingerprintBasis) noexcept
+	{
+		auto bytes = static_cast<Byte const*>(data);
+		for (Size i = 0; i < size; ++i)
+		{
+			hash = (hash ^ bytes[i]) * kFingerprintPrime;
+		}
+		return hash;
+	}
+
+	inline Fingerprint HashString(char const* str, Fingerprint hash = kFingerprintBasis) noexcept
+	{
+		// include the terminator so that "ab" + "c" differs from "a" + "bc"
+		return HashBytes(str, std::strlen(str) + 1, hash);
+	}
+
+	// byte range of an object that no field covers
+	struct PaddingHole
+	{
+		Offset offset;
+		Size size;
+	};
+
+	// every hole of a record, nested records and base classes included, sorted by offset
+	struct PaddingMap
+	{
+		PaddingHole const* holes;
+		Size holes_length;
+		Size padding_size;
+	};
+
+	enum class TemplateArgumentKind : Byte
+	{
+		kType,
+		kValue,
+		// template template arguments, null pointers and the like, only the spelling is kept
+		kOther
+	};
+
+	// argument of a reflected class template instantiation; type resolves the argument type, or
+	// the type of a value argument, and is nullptr when that type is not reflected
+	struct TemplateArgument
+	{
+		TemplateArgumentKind kind;
+		char const* name;
+		TypeGetter type;
+		int64_t value;
+	};
+
+	// Vec<float, 4> is { "Vec", { float, 4 }, 2 }, packs are expanded in place
+	struct TemplateArguments
+	{
+		char const* template_name;
+		TemplateArgument const* arguments;
+		Size arguments_length;
+	};
+
+	// option with a value, or an unknown option; FIELD(name="x", range=0..100, replicated) is
+	// { "name", "x" }, { "range", "0..100" }, { "replicated", "" }
+	struct Attribute
+	{
+		char const* key;
+		char const* value;
+	};
+
+	struct AttributeTable
+	{
+		Attribute const* attributes;
+		Size attributes_length;
+	};
+
+	// value of an option, nullptr when it is not given
+	inline char const* FindAttribute(AttributeTable const* table, char const* key) noexcept
+	{
+		if (table == nullptr)
+		{
+			return nullptr;
+		}
+		for (Size i = 0; i < table->attributes_length; ++i)
+		{
+			if (strcmp(table->attributes[i].key, key) == 0)
+			{
+				return table->attributes[i].value;
+			}
+		}
+		return nullptr;
+	}
+
+	// lazily computed value that keeps Type copyable
+	class FingerprintCache
+	{
+	private:
+		mutable std::atomic<Fingerprint> value;
+
+	public:
+		constexpr FingerprintCache() : value(0) {}
+		FingerprintCache(FingerprintCache const& other) : value(other.Load()) {}
+		FingerprintCache& operator=(FingerprintCache const& other) { Store(other.Load()); return *this; }
+		Fingerprint Load() const noexcept { return value.load(std::memory_order_relaxed); }
+		void Store(Fingerprint fingerprint) const noexcept { value.store(fingerprint, std::memory_order_relaxed); }
+	};
+
 	class Base
 	{
 	protected:
 		char const* name;
+		AnnotationFlags annotation_flags;
+		AttributeTable const* attributes;
 
 	public:
-		constexpr Base() : name(kDefaultName) {}
-		constexpr Base(char const* _name) : name(_name) {}
+		constexpr Base() : name(kDefaultName), annotation_flags(AnnotationFlags::kNone), attributes(nullptr) {}
+		constexpr Base(char const* _name) : name(_name), annotation_flags(AnnotationFlags::kNone), attributes(nullptr) {}
+		constexpr Base(char const* _name, AnnotationFlags _annotation_flags, AttributeTable const* _attributes) :
+			name(_name),
+			annotation_flags(_annotation_flags),
+			attributes(_attributes)
+		{}
 		char const* GetName() const { return this->name; }
+		AnnotationFlags GetAnnotationFlags() const noexcept { return annotation_flags; }
+		bool HasAnnotation(AnnotationFlags flag) const noexcept { return (annotation_flags & flag) != AnnotationFlags::kNone; }
+		AttributeTable const* GetAttributes() const noexcept { return attributes; }
+		char const* GetAttribute(char const* key) const noexcept { return FindAttribute(attributes, key); }
 		virtual void Print(std::ostream& os, int indent) const;
 	};
 
@@ -428,27 +747,98 @@ namespace Reflection
 		void Print(std::ostream& os, int indent) const;
 	};
 
+	// the field lives in the object itself
+	constexpr Offset kNoIndirection = SIZE_MAX;
+
 	class Field : public Base
 	{
 	private:
 		Type const* type;
 		Offset offset;
+		Offset indirection;
 		CVRQualifier cvr_qualifier;
 		StorageClassSpecifier storage_class_specifier;
 		ThreadStorageClassSpecifier thread_storage_class_specifier;
 		StorageDuration storage_duration;
 		AccessSpecifier access_specifier;
+		Encoding encoding;
+		MemoryOrder memory_order;
+
+#if defined(_MSC_VER)
+		// the interlocked intrinsics are full barriers, stronger than any requested order;
+		// returns the previous value
+		template<typename T, typename Word>
+		static T CompareExchange(T volatile* address, T desired, T comparand) noexcept
+		{
+			Word desiredWord, comparandWord, previousWord;
+			REFL_MEMCPY(&desiredWord, &desired, sizeof(T));
+			REFL_MEMCPY(&comparandWord, &comparand, sizeof(T));
+			switch (sizeof(T))
+			{
+			case 1:
+				previousWord = _InterlockedCompareExchange8(reinterpret_cast<char volatile*>(address), desiredWord, comparandWord);
+				break;
+			case 2:
+				previousWord = _InterlockedCompareExchange16(reinterpret_cast<short volatile*>(address), desiredWord, comparandWord);
+				break;
+			case 4:
+				previousWord = _InterlockedCompareExchange(reinterpret_cast<long volatile*>(address), desiredWord, comparandWord);
+				break;
+			default:
+				previousWord = _InterlockedCompareExchange64(reinterpret_cast<__int64 volatile*>(address), desiredWord, comparandWord);
+				break;
+			}
+			T previous;
+			REFL_MEMCPY(&previous, &previousWord, sizeof(T));
+			return previous;
+		}
+
+		template<typename T>
+		static T CompareExchange(T volatile* address, T desired, T comparand) noexcept
+		{
+			typedef typename std::conditional<sizeof(T) == 1, char, typename std::conditional<sizeof(T) == 2, short,
+				typename std::conditional<sizeof(T) == 4, long, __int64>::type>::type>::type Word;
+			return CompareExchange<T, Word>(address, desired, comparand);
+		}
+
+		static __int8 IsoVolatileLoad(__int8 const volatile* address) noexcept { return __iso_volatile_load8(address); }
+		static __int16 IsoVolatileLoad(__int16 const volatile* address) noexcept { return __iso_volatile_load16(address); }
+		static __int32 IsoVolatileLoad(__int32 const volatile* address) noexcept { return __iso_volatile_load32(address); }
+		static __int64 IsoVolatileLoad(__int64 const volatile* address) noexcept { return __iso_volatile_load64(address); }
+
+		// aligned loads of up to 8 bytes are single-copy atomic, __iso_volatile_load keeps them a
+		// single plain load whatever /volatile mode is set; the barrier after it gives the load
+		// acquire order, which is also sequentially consistent as every store is interlocked
+		template<typename T>
+		static T Load(T const volatile* address) noexcept
+		{
+			typedef typename std::conditional<sizeof(T) == 1, __int8, typename std::conditional<sizeof(T) == 2, __int16,
+				typename std::conditional<sizeof(T) == 4, __int32, __int64>::type>::type>::type Word;
+			Word word = IsoVolatileLoad(reinterpret_cast<Word const volatile*>(address));
+#if defined(_M_ARM) || defined(_M_ARM64)
+			__dmb(0xB); // ish
+#else
+			_ReadWriteBarrier();
+#endif
+			T value;
+			REFL_MEMCPY(&value, &word, sizeof(T));
+			return value;
+		}
+#endif
 
 	public:
 		constexpr Field() :
 			Base(kDefaultName),
 			type(nullptr),
 			offset(0),
+			indirection(kNoIndirection),
 			cvr_qualifier(CVRQualifier::kNone),
 			storage_class_specifier(StorageClassSpecifier::kNone),
 			thread_storage_class_specifier(ThreadStorageClassSpecifier::kUnSpecified),
 			storage_duration(StorageDuration::kNone),
-			access_specifier(AccessSpecifier::kNone)
+			access_specifier(AccessSpecifier::kNone),
+			encoding(Encoding::kDefault),
+			memory_order(MemoryOrder::kSeqCst)
 		{}
 
 		constexpr Field(
@@ -459,24 +849,39 @@ namespace Reflection
 			StorageClassSpecifier _storage_class_specifier,
 			ThreadStorageClassSpecifier _thread_storage_class_specifier,
 			StorageDuration _storage_duration,
-			AccessSpecifier _access_specifier
+			AccessSpecifier _access_specifier,
+			Encoding _encoding = Encoding::kDefault,
+			Offset _indirection = kNoIndirection,
+			MemoryOrder _memory_order = MemoryOrder::kSeqCst,
+			AnnotationFlags _annotation_flags = AnnotationFlags::kNone,
+			AttributeTable const* _attributes = nullptr
 		) :
-			Base(_name),
+			Base(_name, _annotation_flags, _attributes),
 			type(_type),
 			offset(_offset),
+			indirection(_indirection),
 			cvr_qualifier(_cvr_qualifier),
 			storage_class_specifier(_storage_class_specifier),
 			thread_storage_class_specifier(_thread_storage_class_specifier),
 			storage_duration(_storage_duration),
-			access_specifier(_access_specifier)
+			access_specifier(_access_specifier),
+			encoding(_encoding),
+			memory_order(_memory_order)
 		{}
 
 		Type const* GetType() const noexcept { return type; }
+		// offset inside the object, or inside the side allocation for indirect fields
+		Offset GetOffset() const noexcept { return offset; }
+		// offset of the pointer to the side allocation that holds the field
+		Offset GetIndirection() const noexcept { return indirection; }
+		bool IsIndirect() const noexcept { return indirection != kNoIndirection; }
 		AccessSpecifier GetAccessSpecifier() const noexcept { return access_specifier; }
 		CVRQualifier GetCVRQualifier() const noexcept { return cvr_qualifier; }
 		StorageClassSpecifier GetStorageClassSpecifier() const noexcept { return storage_class_specifier; }
 		ThreadStorageClassSpecifier GetTSCSpecifier() const noexcept { return thread_storage_class_specifier; }
 		StorageDuration GetStorageDuration() const noexcept { return storage_duration; }
+		Encoding GetEncoding() const noexcept { return encoding; }
+		MemoryOrder GetMemoryOrder() const noexcept { return memory_order; }
 		bool IsPublic() const noexcept { return access_specifier == AccessSpecifier::kPublic; }
 		bool IsProtected() const noexcept { return access_specifier == AccessSpecifier::kProtected; }
 		bool IsPrivate() const noexcept { return access_specifier == AccessSpecifier::kPrivate; }
@@ -485,30 +890,102 @@ namespace Reflection
 		bool IsVolatile() const noexcept { return (cvr_qualifier & CVRQualifier::kVolatile) != CVRQualifier::kNone; }
 		bool IsThreadLocal() const noexcept { return thread_storage_class_specifier != ThreadStorageClassSpecifier::kUnSpecified; }
 
+		// address of the field in the object at ptr
+		BytePointer GetAddress(void const* ptr) const noexcept
+		{
+			BytePointer base = (BytePointer)ptr;
+			if (indirection != kNoIndirection)
+			{
+				REFL_MEMCPY(&base, base + indirection, sizeof(base));
+			}
+			return base + offset;
+		}
+
 		template<typename T>
 		T GetValue(Pointer ptr, typename std::enable_if<std::is_trivially_copyable<T>::value>::type* = 0) const noexcept
 		{
 			T value;
-			REFL_MEMCPY(&value, (BytePointer)ptr + offset, sizeof(T));
+			REFL_MEMCPY(&value, GetAddress(ptr), sizeof(T));
 			return value;
 		}
 
 		template<typename T>
 		void SetValue(Pointer ptr, T const& value, typename std::enable_if<std::is_trivially_copyable<T>::value>::type* = 0) const noexcept
 		{
-			REFL_MEMCPY((BytePointer)ptr + offset, &value, sizeof(T));
+			REFL_MEMCPY(GetAddress(ptr), &value, sizeof(T));
 		}
 
 		template<typename T>
 		T& GetRef(Pointer ptr) const noexcept
 		{
-			return *static_cast<T*>((BytePointer)ptr + offset);
+			return *reinterpret_cast<T*>(GetAddress(ptr));
 		}
 
 		template<typename T>
 		T* GetPtr(Pointer ptr) const noexcept
 		{
-			return static_cast<T*>((BytePointer)ptr + offset);
+			return reinterpret_cast<T*>(GetAddress(ptr));
+		}
+
+		// true when the field type is size bytes large
+		bool IsOfSize(Size size) const noexcept;
+
+		// Atomic access to fields written by several threads, ordered by the field's memory order.
+		// The field must be naturally aligned; every call fails when T is not of the size of the
+		// field type, and then leaves the field and the arguments alone.
+
+		template<typename T>
+		bool AtomicLoad(Pointer ptr, T& value) const noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "unsupported atomic field type");
+			if (!IsOfSize(sizeof(T)))
+			{
+				return false;
+			}
+#if defined(_MSC_VER)
+			value = Load<T>(reinterpret_cast<T const volatile*>(GetAddress(ptr)));
+#else
+			__atomic_load(reinterpret_cast<T*>(GetAddress(ptr)), &value, ToLoadOrder(memory_order));
+#endif
+			return true;
+		}
+
+		template<typename T>
+		bool AtomicStore(Pointer ptr, T value) const noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "unsupported atomic field type");
+			if (!IsOfSize(sizeof(T)))
+			{
+				return false;
+			}
+#if defined(_MSC_VER)
+			T expected;
+			AtomicLoad<T>(ptr, expected);
+			while (!AtomicCompareExchange<T>(ptr, expected, value)) {}
+#else
+			__atomic_store(reinterpret_cast<T*>(GetAddress(ptr)), &value, ToStoreOrder(memory_order));
+#endif
+			return true;
+		}
+
+		// stores desired when the field equals expected, otherwise loads the field into expected;
+		// check the size with AtomicLoad before looping on it
+		template<typename T>
+		bool AtomicCompareExchange(Pointer ptr, T& expected, T desired) const noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "unsupported atomic field type");
+			if (!IsOfSize(sizeof(T)))
+			{
+				return false;
+			}
+#if defined(_MSC_VER)
+			T previous = CompareExchange<T>(reinterpret_cast<T volatile*>(GetAddress(ptr)), desired, expected);
+			bool exchanged = std::memcmp(&previous, &expected, sizeof(T)) == 0;
+			expected = previous;
+			return exchanged;
+#else
+			return __atomic_compare_exchange(reinterpret_cast<T*>(GetAddress(ptr)), &expected, &desired, false, ToExchangeOrder(memory_order), ToLoadOrder(memory_order));
+#endif
 		}
 
 		void Print(std::ostream& os, int indent) const;
@@ -539,9 +1016,11 @@ namespace Reflection
 			Parameter const* _parameters,
 			Size _parameters_length,
 			AccessSpecifier _access_specifier,
-			Linkage _linkage
+			Linkage _linkage,
+			AnnotationFlags _annotation_flags = AnnotationFlags::kNone,
+			AttributeTable const* _attributes = nullptr
 		) :
-			Base(_name),
+			Base(_name, _annotation_flags, _attributes),
 			return_type(_return_type),
 			parameters(_parameters),
 			parameters_length(_parameters_length),
@@ -561,7 +1040,7 @@ namespace Reflection
 
 		Parameter const* GetParameter(char const* name) const noexcept {
 			for (int i = 0; i < parameters_length; ++i) {
-				if (strcmp(parameters[i].GetName(), name)) {
+				if (MatchName(parameters[i].GetName(), name)) {
 					return &parameters[i];
 				}
 			}
@@ -593,6 +1072,15 @@ namespace Reflection
 		Size array_length;
 		bool is_pointer;
 		Type const* raw_type;
+		TypeGetter raw_type_getter;
+		NumericKind numeric_kind;
+		Encoding encoding;
+		PaddingMap const* padding_map;
+		TemplateArguments const* template_arguments;
+		TypeTraits traits;
+		FingerprintCache fingerprint;
+
+		Fingerprint ComputeFingerprint() const noexcept;
 
 	public:
 		constexpr Type() :
@@ -607,7 +1095,13 @@ namespace Reflection
 			is_array(false),
 			array_length(0),
 			is_pointer(false),
-			raw_type(nullptr)
+			raw_type(nullptr),
+			raw_type_getter(nullptr),
+			numeric_kind(NumericKind::kNone),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(TypeTraits::kNone)
 		{}
 
 		// array type ctor
@@ -617,7 +1111,8 @@ namespace Reflection
 			TypeSpecifierType _type_specifier_type,
 			bool _is_array,
 			Size _array_length,
-			Type const* _raw_type
+			Type const* _raw_type,
+			TypeTraits _traits = TypeTraits::kNone
 		) :
 			Base(_name),
 			size(_size),
@@ -630,7 +1125,13 @@ namespace Reflection
 			is_array(_is_array),
 			array_length(_array_length),
 			is_pointer(false),
-			raw_type(_raw_type)
+			raw_type(_raw_type),
+			raw_type_getter(nullptr),
+			numeric_kind(NumericKind::kNone),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(_traits)
 		{}
 
 		// pointer type ctor
@@ -639,7 +1140,8 @@ namespace Reflection
 			Size _size,
 			TypeSpecifierType _type_specifier_type,
 			bool _is_pointer,
-			Type const* _raw_type
+			Type const* _raw_type,
+			TypeTraits _traits = TypeTraits::kNone
 		) :
 			Base(_name),
 			size(_size),
@@ -652,7 +1154,42 @@ namespace Reflection
 			is_array(false),
 			array_length(0),
 			is_pointer(_is_pointer),
-			raw_type(_raw_type)
+			raw_type(_raw_type),
+			raw_type_getter(nullptr),
+			numeric_kind(NumericKind::kNone),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(_traits)
+		{}
+
+		// pointer type ctor, the pointee is resolved on first use
+		constexpr Type(
+			char const* _name,
+			Size _size,
+			TypeSpecifierType _type_specifier_type,
+			bool _is_pointer,
+			TypeGetter _raw_type_getter,
+			TypeTraits _traits = TypeTraits::kNone
+		) :
+			Base(_name),
+			size(_size),
+			type_specifier_type(_type_specifier_type),
+			ref_declarator(RefDeclarator::kNone),
+			fields(nullptr),
+			fields_length(0),
+			methods(nullptr),
+			methods_length(0),
+			is_array(false),
+			array_length(0),
+			is_pointer(_is_pointer),
+			raw_type(nullptr),
+			raw_type_getter(_raw_type_getter),
+			numeric_kind(NumericKind::kNone),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(_traits)
 		{}
 
 		// reference type ctor
@@ -674,14 +1211,22 @@ namespace Reflection
 			is_array(false),
 			array_length(0),
 			is_pointer(false),
-			raw_type(_raw_type)
+			raw_type(_raw_type),
+			raw_type_getter(nullptr),
+			numeric_kind(NumericKind::kNone),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(TypeTraits::kNone)
 		{}
 
 		// builtin type ctor
 		constexpr Type(
 			char const* _name,
 			Size _size,
-			TypeSpecifierType _type_specifier_type
+			TypeSpecifierType _type_specifier_type,
+			NumericKind _numeric_kind = NumericKind::kNone,
+			TypeTraits _traits = TypeTraits::kNone
 		) :
 			Base(_name),
 			size(_size),
@@ -694,7 +1239,13 @@ namespace Reflection
 			is_array(false),
 			array_length(0),
 			is_pointer(false),
-			raw_type(nullptr)
+			raw_type(nullptr),
+			raw_type_getter(nullptr),
+			numeric_kind(_numeric_kind),
+			encoding(Encoding::kDefault),
+			padding_map(nullptr),
+			template_arguments(nullptr),
+			traits(_traits)
 		{}
 
 		// user type ctor
@@ -705,9 +1256,15 @@ namespace Reflection
 			Field* _fields,
 			Size _fields_length,
 			Method* _methods,
-			Size _methods_length
+			Size _methods_length,
+			Encoding _encoding = Encoding::kDefault,
+			PaddingMap const* _padding_map = nullptr,
+			TemplateArguments const* _template_arguments = nullptr,
+			AnnotationFlags _annotation_flags = AnnotationFlags::kNone,
+			AttributeTable const* _attributes = nullptr,
+			TypeTraits _traits = TypeTraits::kNone
 		) :
-			Base(_name),
+			Base(_name, _annotation_flags, _attributes),
 			size(_size),
 			type_specifier_type(_type_specifier_type),
 			ref_declarator(RefDeclarator::kNone),
@@ -718,23 +1275,58 @@ namespace Reflection
 			is_array(false),
 			array_length(0),
 			is_pointer(false),
-			raw_type(nullptr)
+			raw_type(nullptr),
+			raw_type_getter(nullptr),
+			numeric_kind(NumericKind::kNone),
+			encoding(_encoding),
+			padding_map(_padding_map),
+			template_arguments(_template_arguments),
+			traits(_traits)
 		{}
 
-		Type const* GetRawType() const noexcept { return raw_type; }
+		Type const* GetRawType() const noexcept { return raw_type != nullptr || raw_type_getter == nullptr ? raw_type : raw_type_getter(); }
+		Size GetSize() const noexcept { return size; }
+		bool IsArray() const noexcept { return is_array; }
+		Size GetArrayLength() const noexcept { return array_length; }
+		bool IsPointer() const noexcept { return is_pointer; }
+		bool IsReference() const noexcept { return ref_declarator != RefDeclarator::kNone; }
+		bool IsBuiltin() const noexcept { return type_specifier_type == TypeSpecifierType::kBuiltin && !is_pointer && raw_type == nullptr && fields_length == 0; }
 		Field* const GetField(Offset index) const noexcept { return &fields[index]; }
 		Size GetFieldsLength() const noexcept { return fields_length; }
 		Method* const GetMethod(Offset index) const noexcept { return &methods[index]; }
 		Size GetMethodsLength() const noexcept { return methods_length; }
 		TypeSpecifierType GetTypeSpecifierType() const { return type_specifier_type; }
 		RefDeclarator GetRefDeclarator() const { return ref_declarator; }
+		NumericKind GetNumericKind() const noexcept { return numeric_kind; }
+		Encoding GetEncoding() const noexcept { return encoding; }
+		// generated from the record layout, nullptr when it is not known
+		PaddingMap const* GetPaddingMap() const noexcept { return padding_map; }
+		// the arguments of a class template instantiation, nullptr for other types
+		TemplateArguments const* GetTemplateArguments() const noexcept { return template_arguments; }
+		TypeTraits GetTraits() const noexcept { return traits; }
+		bool IsTriviallyCopyable() const noexcept { return (traits & TypeTraits::kTriviallyCopyable) != TypeTraits::kNone; }
+		bool IsStandardLayout() const noexcept { return (traits & TypeTraits::kStandardLayout) != TypeTraits::kNone; }
+		bool HasUniqueRepresentations() const noexcept { return (traits & TypeTraits::kUniqueRepresentations) != TypeTraits::kNone; }
+		bool HasCompleteFields() const noexcept { return (traits & TypeTraits::kFieldsComplete) != TypeTraits::kNone; }
 		void Print(std::ostream& os, int indent) const;
 
+		// schema fingerprint over the names, types and order of the instance fields
+		Fingerprint GetFingerprint() const noexcept
+		{
+			Fingerprint value = fingerprint.Load();
+			if (value == 0)
+			{
+				value = ComputeFingerprint();
+				fingerprint.Store(value);
+			}
+			return value;
+		}
+
 		Field const* GetField(char const* name) const noexcept
 		{
 			for (int i = 0; i < fields_length; ++i)
 			{
-				if (strcmp(fields[i].GetName(), name)) {
+				if (MatchName(fields[i].GetName(), name)) {
 					return &fields[i];
 				}
 			}
@@ -746,7 +1338,7 @@ namespace Reflection
 		{
 			for (int i = 0; i < methods_length; ++i)
 			{
-				if (strcmp(methods[i].GetName(), name)) {
+				if (MatchName(methods[i].GetName(), name)) {
 					return &methods[i];
 				}
 			}
@@ -755,6 +1347,117 @@ namespace Reflection
 		}
 	};
 
+	// Path to a nested member such as "server.ports[1]", resolved once against a type and then
+	// applied to any number of objects. Each step is an unqualified field name or an array index;
+	// static and indirect fields can not be part of a path.
+	class FieldPath
+	{
+	private:
+		Type const* type;
+		Field const* field;
+		Offset offset;
+
+		static Field const* FindField(Type const* parent, char const* name, Size length) noexcept
+		{
+			for (Size i = 0; i < parent->GetFieldsLength(); ++i)
+			{
+				auto candidate = parent->GetField(i);
+				auto candidateName = GetUnqualifiedName(candidate->GetName());
+				if (std::strncmp(candidateName, name, length) == 0 && candidateName[length] == '\0')
+				{
+					return candidate;
+				}
+			}
+			return nullptr;
+		}
+
+	public:
+		constexpr FieldPath() : type(nullptr), field(nullptr), offset(0) {}
+		constexpr FieldPath(Type const* _type, Field const* _field, Offset _offset) : type(_type), field(_field), offset(_offset) {}
+
+		// an empty path is the root itself, the result is invalid when a step does not exist
+		static FieldPath Resolve(Type const* root, char const* path) noexcept
+		{
+			FieldPath result(root, nullptr, 0);
+			char const* cursor = path;
+			while (*cursor != '\0')
+			{
+				if (*cursor == '[')
+				{
+					if (!result.type->IsArray())
+					{
+						return FieldPath();
+					}
+
+					Size index = 0;
+					char const* digits = ++cursor;
+					for (; *cursor >= '0' && *cursor <= '9'; ++cursor)
+					{
+						index = index * 10 + static_cast<Size>(*cursor - '0');
+					}
+
+					if (cursor == digits || *cursor != ']' || index >= result.type->GetArrayLength())
+					{
+						return FieldPath();
+					}
+
+					++cursor;
+					result.type = result.type->GetRawType();
+					result.offset += index * result.type->GetSize();
+					continue;
+				}
+
+				if (*cursor == '.' && cursor != path)
+				{
+					++cursor;
+				}
+
+				char const* name = cursor;
+				while (*cursor != '\0' && *cursor != '.' && *cursor != '[')
+				{
+					++cursor;
+				}
+
+				auto step = FindField(result.type, name, static_cast<Size>(cursor - name));
+				if (step == nullptr || step->IsStatic() || step->IsIndirect())
+				{
+					return FieldPath();
+				}
+
+				result.field = step;
+				result.type = step->GetType();
+				result.offset += step->GetOffset();
+			}
+			return result;
+		}
+
+		bool IsValid() const noexcept { return type != nullptr; }
+		Type const* GetType() const noexcept { return type; }
+		// innermost field of the path, nullptr for the root
+		Field const* GetField() const noexcept { return field; }
+		Offset GetOffset() const noexcept { return offset; }
+		Size GetSize() const noexcept { return type->GetSize(); }
+
+		BytePointer GetAddress(void const* obj) const noexcept
+		{
+			return const_cast<BytePointer>(static_cast<Byte const*>(obj)) + offset;
+		}
+
+		template<typename T>
+		T GetValue(void const* obj) const noexcept
+		{
+			T value;
+			REFL_MEMCPY(&value, GetAddress(obj), sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		void SetValue(Pointer obj, T const& value) const noexcept
+		{
+			REFL_MEMCPY(GetAddress(obj), &value, sizeof(T));
+		}
+	};
+
 	template<typename T>
 	Type const* GetType() noexcept;
 
@@ -764,35 +1467,45 @@ namespace Reflection
 	template<typename T>
 	Type const* GetType() noexcept { return GetTypeImpl(Tag<T>()); }
 
-#define DECLARE_TYPE(T) \
+#define REFL_DEFINE_TYPE_IMPL(specifier, ...) \
 	template<> \
-	Type const* GetTypeImpl(Tag<T>) noexcept \
+	specifier Type const* GetTypeImpl(Tag<__VA_ARGS__>) noexcept \
 	{ \
-		if (std::is_pointer<T>::value) \
+		if (std::is_pointer<__VA_ARGS__>::value) \
 		{ \
-			static Type type(#T, sizeof(T), TypeSpecifierType::kBuiltin, true, GetType<std::remove_pointer<T>::type>()); \
+			static Type type(#__VA_ARGS__, sizeof(__VA_ARGS__), TypeSpecifierType::kBuiltin, true, static_cast<TypeGetter>(&GetType<std::remove_pointer<__VA_ARGS__>::type>), GetTypeTraitsOf<__VA_ARGS__>()); \
 			return &type; \
 		} \
-		else if (std::is_array<T>::value) \
+		else if (std::is_array<__VA_ARGS__>::value) \
 		{ \
-			static Type type(#T, sizeof(T), TypeSpecifierType::kBuiltin, true, std::extent<T>::value, GetType<std::remove_extent<T>::type>()); \
+			static Type type(#__VA_ARGS__, sizeof(__VA_ARGS__), TypeSpecifierType::kBuiltin, true, std::extent<__VA_ARGS__>::value, GetType<std::remove_extent<__VA_ARGS__>::type>(), GetType<std::remove_extent<__VA_ARGS__>::type>()->GetTraits()); \
 			return &type; \
 		} \
-		else if(std::is_reference<T>::value) \
+		else if(std::is_reference<__VA_ARGS__>::value) \
 		{ \
-			static Type type(#T, sizeof(T), TypeSpecifierType::kBuiltin, std::is_lvalue_reference<T>::value ? RefDeclarator::kLValueReference : RefDeclarator::kRValueReference, GetType<std::remove_reference<T>::type>()); \
+			static Type type(#__VA_ARGS__, sizeof(__VA_ARGS__), TypeSpecifierType::kBuiltin, std::is_lvalue_reference<__VA_ARGS__>::value ? RefDeclarator::kLValueReference : RefDeclarator::kRValueReference, GetType<std::remove_reference<__VA_ARGS__>::type>()); \
 			return &type; \
 		} \
 		else \
 		{ \
-			static Type typeCache(#T, sizeof(T), TypeSpecifierType::kBuiltin); \
+			static Type typeCache(#__VA_ARGS__, sizeof(__VA_ARGS__), TypeSpecifierType::kBuiltin, GetNumericKindOf<__VA_ARGS__>(), GetTypeTraitsOf<__VA_ARGS__>()); \
 			return &typeCache; \
 		} \
 	}
 
+	// DECLARE_TYPE defines the descriptor of a builtin, pointer, array or reference type inline, so
+	// any header may use it. meta_gen -emit-cpp instead defines the types of a project once with
+	// DEFINE_TYPE and declares them with DECLARE_EXTERN_TYPE. The type is variadic so that names
+	// such as Vec<float, 4>* pass as one argument.
+#define DECLARE_TYPE(...) REFL_DEFINE_TYPE_IMPL(inline, __VA_ARGS__)
+#define DEFINE_TYPE(...) REFL_DEFINE_TYPE_IMPL(, __VA_ARGS__)
+#define DECLARE_EXTERN_TYPE(...) \
+	template<> \
+	Type const* GetTypeImpl(Tag<__VA_ARGS__>) noexcept
+
 #define DECLARE_TYPE_WITH_SIZE(type, type_size) \
 	template<> \
-	Type const* GetTypeImpl(Tag<type>) noexcept \
+	inline Type const* GetTypeImpl(Tag<type>) noexcept \
 	{ \
 		static Type typeCache(#type, type_size, TypeSpecifierType::kBuiltin); \
 		return &typeCache; \
@@ -815,6 +1528,62 @@ namespace Reflection
 	DECLARE_TYPE(long double);
 	DECLARE_TYPE_WITH_SIZE(void, 0);
 
+	inline Fingerprint Type::ComputeFingerprint() const noexcept
+	{
+		Fingerprint hash = HashString(name);
+		hash = HashBytes(&size, sizeof(size), hash);
+
+		if (is_pointer || ref_declarator != RefDeclarator::kNone)
+		{
+			// only the pointee name, following it could recurse forever
+			Type const* pointee = GetRawType();
+			return HashString(pointee != nullptr ? pointee->GetName() : kDefaultName, hash);
+		}
+
+		if (is_array)
+		{
+			hash = HashBytes(&array_length, sizeof(array_length), hash);
+			Fingerprint elementFingerprint = raw_type->GetFingerprint();
+			return HashBytes(&elementFingerprint, sizeof(elementFingerprint), hash);
+		}
+
+		for (Size i = 0; i < fields_length; ++i)
+		{
+			auto& field = fields[i];
+			if (field.IsStatic())
+			{
+				continue;
+			}
+
+			hash = HashString(GetUnqualifiedName(field.GetName()), hash);
+			Fingerprint fieldFingerprint = field.GetType()->GetFingerprint();
+			hash = HashBytes(&fieldFingerprint, sizeof(fieldFingerprint), hash);
+		}
+
+		// 0 marks "not computed yet"
+		return hash != 0 ? hash : 1;
+	}
+
+	// true when a field of the type or of a nested record lives in the side allocation of a
+	// split type, see split_storage.hpp
+	inline bool HasIndirectFields(Type const* type) noexcept
+	{
+		if (type->IsArray())
+		{
+			return HasIndirectFields(type->GetRawType());
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic() && (field->IsIndirect() || HasIndirectFields(field->GetType())))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	// print helpers
 	static inline void PrintIndent(std::ostream& os, int indent)
 	{
@@ -824,13 +1593,13 @@ namespace Reflection
 		}
 	}
 
-	void Base::Print(std::ostream& os, int indent) const
+	inline void Base::Print(std::ostream& os, int indent) const
 	{
 		PrintIndent(os, indent);
 		os << "name: " << name << "\n";
 	}
 
-	void Parameter::Print(std::ostream& os, int indent) const
+	inline void Parameter::Print(std::ostream& os, int indent) const
 	{
 		Base::Print(os, indent);
 		PrintIndent(os, indent);
@@ -841,7 +1610,12 @@ namespace Reflection
 		os << "ref declarator: " << ref_declarator << "\n";
 	}
 
-	void Field::Print(std::ostream& os, int indent) const
+	inline bool Field::IsOfSize(Size size) const noexcept
+	{
+		return type != nullptr && type->GetSize() == size;
+	}
+
+	inline void Field::Print(std::ostream& os, int indent) const
 	{
 		Base::Print(os, indent);
 		PrintIndent(os, indent);
@@ -860,7 +1634,7 @@ namespace Reflection
 		os << "access specifier: " << access_specifier << "\n";
 	}
 
-	void Method::Print(std::ostream& os, int indent) const
+	inline void Method::Print(std::ostream& os, int indent) const
 	{
 		PrintIndent(os, indent);
 		os << "method name: " << name << "\n";
@@ -882,7 +1656,7 @@ namespace Reflection
 		}
 	}
 
-	void Type::Print(std::ostream& os, int indent) const
+	inline void Type::Print(std::ostream& os, int indent) const
 	{
 		Base::Print(os, indent);
 		PrintIndent(os, indent);
@@ -892,12 +1666,24 @@ namespace Reflection
 		PrintIndent(os, indent);
 		os << "ref declarator: " << ref_declarator << "\n";
 
-		if (raw_type != nullptr)
+		Type const* rawType = GetRawType();
+		if (rawType != nullptr)
 		{
 			PrintIndent(os, indent);
-			os << "is array: " << is_array << ", array length: " << array_length << ", element type: " << raw_type->GetName() << "\n";
+			os << "is array: " << is_array << ", array length: " << array_length << ", element type: " << rawType->GetName() << "\n";
 			PrintIndent(os, indent);
-			os << "is pointer: " << is_pointer << ", pointee type: " << raw_type->GetName() << "\n";
+			os << "is pointer: " << is_pointer << ", pointee type: " << rawType->GetName() << "\n";
+		}
+
+		if (template_arguments != nullptr)
+		{
+			PrintIndent(os, indent);
+			os << "template: " << template_arguments->template_name << ", arguments:";
+			for (Size i = 0; i < template_arguments->arguments_length; ++i)
+			{
+				os << (i > 0 ? ", " : " ") << template_arguments->arguments[i].name;
+			}
+			os << "\n";
 		}
 
 		PrintIndent(os, indent);
@@ -0,0 +1,649 @@
+#pragma once
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "serialization.hpp"
+
+namespace Reflection
+{
+	// Schema-tagged blobs start with a header describing the stored field list:
+	//
+	//   uint32 magic, uint32 header size, uint64 type fingerprint, uint32 fields length
+	//   per field: uint64 type fingerprint, uint32 serialized size, uint16 name length,
+	//              uint16 type name length, uint32 nested fields length, name, type name,
+	//              the fields of a record in the same format
+	//
+	// followed by the regular binary body. A blob whose fingerprint matches the current
+	// type is read directly, otherwise it is converted field by field, matching by name
+	// down into nested records.
+
+	constexpr uint32_t kSchemaMagic = 0x534C4652; // "RFLS"
+
+	inline NumericKind GetNumericKindByName(char const* typeName) noexcept
+	{
+		static char const* const kSignedNames[] = { "signed char", "short", "int", "long", "long long" };
+		static char const* const kUnsignedNames[] = { "bool", "unsigned char", "unsigned short", "unsigned int", "unsigned long", "unsigned long long" };
+		static char const* const kFloatNames[] = { "float", "double", "long double" };
+
+		// plain char is signed or not depending on the platform
+		if (strcmp("char", typeName) == 0)
+		{
+			return std::numeric_limits<char>::is_signed ? NumericKind::kSigned : NumericKind::kUnsigned;
+		}
+
+		for (auto name : kSignedNames)
+		{
+			if (strcmp(name, typeName) == 0)
+			{
+				return NumericKind::kSigned;
+			}
+		}
+
+		for (auto name : kUnsignedNames)
+		{
+			if (strcmp(name, typeName) == 0)
+			{
+				return NumericKind::kUnsigned;
+			}
+		}
+
+		for (auto name : kFloatNames)
+		{
+			if (strcmp(name, typeName) == 0)
+			{
+				return NumericKind::kFloat;
+			}
+		}
+
+		return NumericKind::kNone;
+	}
+
+	struct SchemaField
+	{
+		std::string name;
+		std::string type_name;
+		Fingerprint type_fingerprint;
+		Offset offset;
+		Size size;
+		// stored fields of a record, their offsets count from the start of the body as well
+		std::vector<SchemaField> fields;
+	};
+
+	// nesting limit of stored records, a hostile header can not exhaust the stack
+	constexpr Size kMaxSchemaDepth = 32;
+
+	// records are described down to their builtin fields, so a nested record whose schema
+	// changed is still converted field by field
+	inline bool IsSchemaRecord(Type const* type) noexcept
+	{
+		return !type->IsBuiltin() && !type->IsArray() && !type->IsPointer() && !type->IsReference();
+	}
+
+	enum class ConversionOpKind : Byte
+	{
+		kCopy,
+		kConvert,
+		kDefault
+	};
+
+	struct ConversionOp
+	{
+		ConversionOpKind kind;
+		NumericKind source_kind;
+		NumericKind target_kind;
+		Size source_offset;
+		Size source_size;
+		Offset target_offset;
+		// target_offset is inside the side allocation this pointer refers to, see Field::GetIndirection
+		Offset target_indirection;
+		Type const* target_type;
+	};
+
+	// flat list of ops turning a stored body into the current type
+	struct ConversionPlan
+	{
+		DataLayout source_layout;
+		Size body_size;
+		std::vector<ConversionOp> ops;
+	};
+
+	template<typename T>
+	static inline void WriteValue(OutputStream& os, T const& value)
+	{
+		os.Write(&value, sizeof(T));
+	}
+
+	template<typename T>
+	static inline bool ReadValue(Byte const*& cursor, Byte const* end, T& value)
+	{
+		if (static_cast<Size>(end - cursor) < sizeof(T))
+		{
+			return false;
+		}
+
+		REFL_MEMCPY(&value, cursor, sizeof(T));
+		cursor += sizeof(T);
+		return true;
+	}
+
+	// The schema fingerprint only covers names, types and order. Blobs of object layouts are
+	// copied bytewise when they match, so their fingerprint also covers where every instance
+	// field lives: its offset, the pointer it is reached through and the layout of its type.
+	inline Fingerprint GetLayoutFingerprint(Type const* type) noexcept
+	{
+		Fingerprint hash = type->GetFingerprint();
+		if (type->IsPointer() || type->IsReference())
+		{
+			return hash;
+		}
+
+		if (type->IsArray())
+		{
+			Fingerprint elementFingerprint = GetLayoutFingerprint(type->GetRawType());
+			return HashBytes(&elementFingerprint, sizeof(elementFingerprint), hash);
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (field->IsStatic())
+			{
+				continue;
+			}
+
+			Offset offset = field->GetOffset();
+			Offset indirection = field->GetIndirection();
+			Fingerprint fieldFingerprint = GetLayoutFingerprint(field->GetType());
+			hash = HashBytes(&offset, sizeof(offset), hash);
+			hash = HashBytes(&indirection, sizeof(indirection), hash);
+			hash = HashBytes(&fieldFingerprint, sizeof(fieldFingerprint), hash);
+		}
+		return hash;
+	}
+
+	static inline uint32_t GetSchemaFieldsLength(Type const* type) noexcept
+	{
+		uint32_t fieldsLength = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			fieldsLength += IsSerializableField(type->GetField(i)) ? 1 : 0;
+		}
+		return fieldsLength;
+	}
+
+	static inline Size GetSchemaFieldsSize(Type const* type) noexcept
+	{
+		Size size = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (IsSerializableField(field))
+			{
+				size += sizeof(Fingerprint) + sizeof(uint32_t) * 2 + sizeof(uint16_t) * 2;
+				size += std::strlen(GetUnqualifiedName(field->GetName())) + std::strlen(field->GetType()->GetName());
+				size += IsSchemaRecord(field->GetType()) ? GetSchemaFieldsSize(field->GetType()) : 0;
+			}
+		}
+		return size;
+	}
+
+	inline Size GetSchemaHeaderSize(Type const* type) noexcept
+	{
+		return sizeof(uint32_t) * 3 + sizeof(Fingerprint) + GetSchemaFieldsSize(type);
+	}
+
+	static inline void WriteSchemaFields(Type const* type, OutputStream& os)
+	{
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!IsSerializableField(field))
+			{
+				continue;
+			}
+
+			auto fieldType = field->GetType();
+			auto name = GetUnqualifiedName(field->GetName());
+			auto typeName = fieldType->GetName();
+			bool isRecord = IsSchemaRecord(fieldType);
+			WriteValue(os, fieldType->GetFingerprint());
+			WriteValue(os, static_cast<uint32_t>(GetSerializedSize(fieldType)));
+			WriteValue(os, static_cast<uint16_t>(std::strlen(name)));
+			WriteValue(os, static_cast<uint16_t>(std::strlen(typeName)));
+			WriteValue(os, isRecord ? GetSchemaFieldsLength(fieldType) : uint32_t(0));
+			os.Write(name, std::strlen(name));
+			os.Write(typeName, std::strlen(typeName));
+			if (isRecord)
+			{
+				WriteSchemaFields(fieldType, os);
+			}
+		}
+	}
+
+	inline void WriteSchemaHeader(Type const* type, OutputStream& os)
+	{
+		WriteValue(os, kSchemaMagic);
+		WriteValue(os, static_cast<uint32_t>(GetSchemaHeaderSize(type)));
+		WriteValue(os, type->GetFingerprint());
+		WriteValue(os, GetSchemaFieldsLength(type));
+		WriteSchemaFields(type, os);
+	}
+
+	// the fields are packed from offset on and must end within limit
+	static inline bool ReadSchemaFieldList(Byte const*& cursor, Byte const* end, uint32_t fieldsLength, Offset offset, Size limit, Size depth, std::vector<SchemaField>& fields)
+	{
+		if (depth > kMaxSchemaDepth)
+		{
+			return false;
+		}
+
+		fields.clear();
+		fields.reserve(fieldsLength < 256 ? fieldsLength : 256);
+		for (uint32_t i = 0; i < fieldsLength; ++i)
+		{
+			SchemaField field;
+			uint32_t fieldSize, nestedLength;
+			uint16_t nameLength, typeNameLength;
+			if (!ReadValue(cursor, end, field.type_fingerprint) ||
+				!ReadValue(cursor, end, fieldSize) ||
+				!ReadValue(cursor, end, nameLength) ||
+				!ReadValue(cursor, end, typeNameLength) ||
+				!ReadValue(cursor, end, nestedLength) ||
+				static_cast<Size>(end - cursor) < static_cast<Size>(nameLength) + typeNameLength ||
+				fieldSize > limit - offset)
+			{
+				return false;
+			}
+
+			field.name.assign(reinterpret_cast<char const*>(cursor), nameLength);
+			cursor += nameLength;
+			field.type_name.assign(reinterpret_cast<char const*>(cursor), typeNameLength);
+			cursor += typeNameLength;
+			field.offset = offset;
+			field.size = fieldSize;
+			offset += fieldSize;
+			if (!ReadSchemaFieldList(cursor, end, nestedLength, field.offset, field.offset + field.size, depth + 1, field.fields))
+			{
+				return false;
+			}
+			fields.push_back(std::move(field));
+		}
+
+		return true;
+	}
+
+	inline bool ReadSchemaFields(void const* data, Size size, std::vector<SchemaField>& fields)
+	{
+		auto cursor = static_cast<Byte const*>(data);
+		auto end = cursor + size;
+		uint32_t magic, headerSize, fieldsLength;
+		Fingerprint fingerprint;
+
+		return ReadValue(cursor, end, magic) && magic == kSchemaMagic &&
+			ReadValue(cursor, end, headerSize) &&
+			ReadValue(cursor, end, fingerprint) &&
+			ReadValue(cursor, end, fieldsLength) &&
+			ReadSchemaFieldList(cursor, end, fieldsLength, 0, SIZE_MAX, 0, fields);
+	}
+
+	// base and indirection locate the record the target fields belong to, see RunConversionPlan
+	static inline void CollectConversionOps(ConversionPlan& plan, std::vector<SchemaField> const& storedFields, Type const* type, Offset base, Offset indirection)
+	{
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!IsSerializableField(field))
+			{
+				continue;
+			}
+
+			auto fieldType = field->GetType();
+			ConversionOp op;
+			op.kind = ConversionOpKind::kDefault;
+			op.source_kind = NumericKind::kNone;
+			op.target_kind = NumericKind::kNone;
+			op.source_offset = 0;
+			op.source_size = 0;
+			op.target_offset = base + field->GetOffset();
+			op.target_indirection = indirection;
+			op.target_type = fieldType;
+			bool nested = false;
+
+			if (field->IsIndirect())
+			{
+				if (indirection != kNoIndirection)
+				{
+					// a split record inside a side allocation, out of reach
+					continue;
+				}
+				op.target_offset = field->GetOffset();
+				op.target_indirection = base + field->GetIndirection();
+			}
+
+			for (auto& stored : storedFields)
+			{
+				if (stored.name != GetUnqualifiedName(field->GetName()))
+				{
+					continue;
+				}
+
+				op.source_offset = stored.offset;
+				op.source_size = stored.size;
+
+				Fingerprint fingerprint = plan.source_layout == DataLayout::kObject ? GetLayoutFingerprint(fieldType) : fieldType->GetFingerprint();
+				Size size = plan.source_layout == DataLayout::kObject ? fieldType->GetSize() : GetSerializedSize(fieldType);
+				if (stored.type_fingerprint == fingerprint && stored.size == size)
+				{
+					op.kind = ConversionOpKind::kCopy;
+				}
+				else if (fieldType->IsBuiltin())
+				{
+					op.source_kind = GetNumericKindByName(stored.type_name.c_str());
+					op.target_kind = fieldType->GetNumericKind();
+					if (op.source_kind != NumericKind::kNone && op.target_kind != NumericKind::kNone)
+					{
+						op.kind = ConversionOpKind::kConvert;
+					}
+				}
+				else if (IsSchemaRecord(fieldType) && !stored.fields.empty())
+				{
+					// the record changed, match its fields by name in turn
+					CollectConversionOps(plan, stored.fields, fieldType, op.target_offset, op.target_indirection);
+					nested = true;
+				}
+				break;
+			}
+
+			if (!nested)
+			{
+				plan.ops.push_back(op);
+			}
+		}
+	}
+
+	// stored field offsets refer to sourceLayout, the body size is the end of the last stored field.
+	// Stored fields of kObject blobs carry layout fingerprints. Fields are matched by name, nested
+	// records whose schema or layout changed field by field; unmatched fields are reset to zero.
+	inline ConversionPlan BuildConversionPlan(std::vector<SchemaField> const& storedFields, Type const* type, DataLayout sourceLayout = DataLayout::kSerialized)
+	{
+		ConversionPlan plan;
+		plan.source_layout = sourceLayout;
+		plan.body_size = 0;
+
+		for (auto& stored : storedFields)
+		{
+			plan.body_size = stored.offset + stored.size > plan.body_size ? stored.offset + stored.size : plan.body_size;
+		}
+
+		CollectConversionOps(plan, storedFields, type, 0, kNoIndirection);
+		return plan;
+	}
+
+	template<typename T>
+	static inline T ReadNumeric(Byte const* source, Size size, NumericKind kind) noexcept
+	{
+		switch (kind)
+		{
+		case NumericKind::kSigned:
+			switch (size)
+			{
+			case 1: { int8_t v; REFL_MEMCPY(&v, source, 1); return static_cast<T>(v); }
+			case 2: { int16_t v; REFL_MEMCPY(&v, source, 2); return static_cast<T>(v); }
+			case 4: { int32_t v; REFL_MEMCPY(&v, source, 4); return static_cast<T>(v); }
+			case 8: { int64_t v; REFL_MEMCPY(&v, source, 8); return static_cast<T>(v); }
+			}
+			break;
+		case NumericKind::kUnsigned:
+			switch (size)
+			{
+			case 1: { uint8_t v; REFL_MEMCPY(&v, source, 1); return static_cast<T>(v); }
+			case 2: { uint16_t v; REFL_MEMCPY(&v, source, 2); return static_cast<T>(v); }
+			case 4: { uint32_t v; REFL_MEMCPY(&v, source, 4); return static_cast<T>(v); }
+			case 8: { uint64_t v; REFL_MEMCPY(&v, source, 8); return static_cast<T>(v); }
+			}
+			break;
+		case NumericKind::kFloat:
+			if (size == sizeof(float)) { float v; REFL_MEMCPY(&v, source, sizeof(v)); return static_cast<T>(v); }
+			if (size == sizeof(double)) { double v; REFL_MEMCPY(&v, source, sizeof(v)); return static_cast<T>(v); }
+			if (size == sizeof(long double)) { long double v; REFL_MEMCPY(&v, source, sizeof(v)); return static_cast<T>(v); }
+			break;
+		default:
+			break;
+		}
+		return T();
+	}
+
+	template<typename T>
+	static inline void WriteNumeric(BytePointer target, Size size, T value) noexcept
+	{
+		switch (size)
+		{
+		case 1: { uint8_t v = static_cast<uint8_t>(value); REFL_MEMCPY(target, &v, 1); break; }
+		case 2: { uint16_t v = static_cast<uint16_t>(value); REFL_MEMCPY(target, &v, 2); break; }
+		case 4: { uint32_t v = static_cast<uint32_t>(value); REFL_MEMCPY(target, &v, 4); break; }
+		case 8: { uint64_t v = static_cast<uint64_t>(value); REFL_MEMCPY(target, &v, 8); break; }
+		}
+	}
+
+	// a floating point value as an integer of size bytes: truncated toward zero and saturated at
+	// the limits of the target, NaN becomes 0. The limits are powers of two, exact in any float.
+	static inline int64_t SaturateSigned(long double value, Size size) noexcept
+	{
+		int bits = static_cast<int>((size < 8 ? size : 8) * 8) - 1;
+		int64_t max = bits == 63 ? INT64_MAX : (int64_t(1) << bits) - 1;
+		long double limit = std::ldexp(1.0L, bits);
+		if (value != value)
+		{
+			return 0;
+		}
+		return value >= limit ? max : value < -limit ? -max - 1 : static_cast<int64_t>(value);
+	}
+
+	static inline uint64_t SaturateUnsigned(long double value, Size size) noexcept
+	{
+		int bits = static_cast<int>((size < 8 ? size : 8) * 8);
+		uint64_t max = bits == 64 ? UINT64_MAX : (uint64_t(1) << bits) - 1;
+		long double limit = std::ldexp(1.0L, bits);
+		if (value != value || value <= -1.0L)
+		{
+			return 0;
+		}
+		return value >= limit ? max : static_cast<uint64_t>(value);
+	}
+
+	static inline void ConvertNumeric(ConversionOp const& op, Byte const* source, BytePointer target) noexcept
+	{
+		Size targetSize = op.target_type->GetSize();
+
+		if (op.target_kind == NumericKind::kFloat)
+		{
+			long double value = ReadNumeric<long double>(source, op.source_size, op.source_kind);
+			if (targetSize == sizeof(float)) { float v = static_cast<float>(value); REFL_MEMCPY(target, &v, sizeof(v)); }
+			else if (targetSize == sizeof(double)) { double v = static_cast<double>(value); REFL_MEMCPY(target, &v, sizeof(v)); }
+			else if (targetSize == sizeof(long double)) { REFL_MEMCPY(target, &value, sizeof(value)); }
+		}
+		else if (op.target_type->GetFingerprint() == GetType<bool>()->GetFingerprint())
+		{
+			// any other byte than 0 or 1 would be an invalid bool
+			bool value = op.source_kind == NumericKind::kFloat ?
+				ReadNumeric<long double>(source, op.source_size, op.source_kind) != 0 :
+				ReadNumeric<uint64_t>(source, op.source_size, op.source_kind) != 0;
+			REFL_MEMCPY(target, &value, sizeof(value));
+		}
+		else if (op.source_kind == NumericKind::kFloat)
+		{
+			long double value = ReadNumeric<long double>(source, op.source_size, op.source_kind);
+			if (op.target_kind == NumericKind::kSigned)
+			{
+				WriteNumeric(target, targetSize, SaturateSigned(value, targetSize));
+			}
+			else
+			{
+				WriteNumeric(target, targetSize, SaturateUnsigned(value, targetSize));
+			}
+		}
+		else if (op.source_kind == NumericKind::kSigned)
+		{
+			WriteNumeric(target, targetSize, ReadNumeric<int64_t>(source, op.source_size, op.source_kind));
+		}
+		else
+		{
+			WriteNumeric(target, targetSize, ReadNumeric<uint64_t>(source, op.source_size, op.source_kind));
+		}
+	}
+
+	inline void RunConversionPlan(ConversionPlan const& plan, void const* body, Pointer obj)
+	{
+		auto source = static_cast<Byte const*>(body);
+		auto target = static_cast<BytePointer>(obj);
+
+		for (auto& op : plan.ops)
+		{
+			BytePointer fieldTarget = target;
+			if (op.target_indirection != kNoIndirection)
+			{
+				REFL_MEMCPY(&fieldTarget, target + op.target_indirection, sizeof(fieldTarget));
+				if (fieldTarget == nullptr)
+				{
+					// the object has no side allocation to hold the field
+					continue;
+				}
+			}
+			fieldTarget += op.target_offset;
+
+			switch (op.kind)
+			{
+			case ConversionOpKind::kCopy:
+				if (plan.source_layout == DataLayout::kSerialized)
+				{
+					Deserialize(op.target_type, fieldTarget, source + op.source_offset, op.source_size);
+				}
+				else
+				{
+					// same layout fingerprint, same offsets all the way down
+					REFL_MEMCPY(fieldTarget, source + op.source_offset, op.source_size);
+				}
+				break;
+			case ConversionOpKind::kConvert:
+				ConvertNumeric(op, source + op.source_offset, fieldTarget);
+				break;
+			case ConversionOpKind::kDefault:
+				std::memset(fieldTarget, 0, op.target_type->GetSize());
+				break;
+			}
+		}
+	}
+
+	// plans are built once per (stored, current) fingerprint pair and never freed
+	class ConversionPlanCache
+	{
+	private:
+		struct Key
+		{
+			Fingerprint stored;
+			Fingerprint current;
+			DataLayout layout;
+
+			bool operator==(Key const& other) const noexcept { return stored == other.stored && current == other.current && layout == other.layout; }
+		};
+
+		struct KeyHash
+		{
+			Size operator()(Key const& key) const noexcept { return static_cast<Size>(key.stored ^ (key.current * kFingerprintPrime) ^ static_cast<Size>(key.layout)); }
+		};
+
+		std::mutex mutex;
+		std::unordered_map<Key, std::unique_ptr<ConversionPlan>, KeyHash> plans;
+
+	public:
+		static ConversionPlanCache& Get()
+		{
+			static ConversionPlanCache cache;
+			return cache;
+		}
+
+		ConversionPlan const* Find(Fingerprint stored, Fingerprint current, DataLayout layout = DataLayout::kSerialized)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = plans.find(Key{ stored, current, layout });
+			return it != plans.end() ? it->second.get() : nullptr;
+		}
+
+		ConversionPlan const* Insert(Fingerprint stored, Fingerprint current, ConversionPlan&& plan)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto& slot = plans[Key{ stored, current, plan.source_layout }];
+			if (!slot)
+			{
+				slot.reset(new ConversionPlan(std::move(plan)));
+			}
+			return slot.get();
+		}
+	};
+
+	inline bool SerializeWithSchema(Type const* type, void const* obj, OutputStream& os)
+	{
+		WriteSchemaHeader(type, os);
+		return Serialize(type, obj, os);
+	}
+
+	inline bool DeserializeWithSchema(Type const* type, Pointer obj, void const* data, Size size)
+	{
+		auto cursor = static_cast<Byte const*>(data);
+		auto end = cursor + size;
+		uint32_t magic, headerSize;
+		Fingerprint fingerprint;
+
+		if (!ReadValue(cursor, end, magic) || magic != kSchemaMagic ||
+			!ReadValue(cursor, end, headerSize) ||
+			!ReadValue(cursor, end, fingerprint) ||
+			headerSize > size)
+		{
+			return false;
+		}
+
+		auto body = static_cast<Byte const*>(data) + headerSize;
+		Size bodySize = size - headerSize;
+
+		if (fingerprint == type->GetFingerprint())
+		{
+			return Deserialize(type, obj, body, bodySize);
+		}
+
+		auto& cache = ConversionPlanCache::Get();
+		auto plan = cache.Find(fingerprint, type->GetFingerprint());
+		if (plan == nullptr)
+		{
+			std::vector<SchemaField> storedFields;
+			if (!ReadSchemaFields(data, headerSize, storedFields))
+			{
+				return false;
+			}
+			plan = cache.Insert(fingerprint, type->GetFingerprint(), BuildConversionPlan(storedFields, type));
+		}
+
+		if (bodySize < plan->body_size)
+		{
+			return false;
+		}
+
+		RunConversionPlan(*plan, body, obj);
+		return true;
+	}
+
+	template<typename T>
+	bool SerializeWithSchema(T const& obj, OutputStream& os)
+	{
+		return SerializeWithSchema(GetType<T>(), &obj, os);
+	}
+
+	template<typename T>
+	bool DeserializeWithSchema(T& obj, void const* data, Size size)
+	{
+		return DeserializeWithSchema(GetType<T>(), &obj, data, size);
+	}
+}
@@ -0,0 +1,358 @@
+#pragma once
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// The binary format is the depth-first walk of the instance fields of a type:
+	// builtin values are written as raw bytes, arrays element by element and nested
+	// records field by field. Static fields, pointers and references are skipped.
+
+	// which layout offsets refer to: the in-memory object or the packed binary body
+	enum class DataLayout : Byte
+	{
+		kObject,
+		kSerialized
+	};
+
+	class OutputStream
+	{
+	public:
+		virtual ~OutputStream() {}
+
+		// returns the number of bytes accepted
+		virtual Size Write(void const* data, Size size) = 0;
+	};
+
+	class InputStream
+	{
+	public:
+		virtual ~InputStream() {}
+
+		// returns the number of bytes read, 0 means no data is available right now (would block)
+		virtual Size Read(void* buffer, Size size) = 0;
+
+		// true once the peer will never deliver more data
+		virtual bool IsClosed() const = 0;
+	};
+
+	class MemoryOutputStream : public OutputStream
+	{
+	private:
+		std::vector<Byte> buffer;
+
+	public:
+		Size Write(void const* data, Size size) override
+		{
+			auto bytes = static_cast<Byte const*>(data);
+			buffer.insert(buffer.end(), bytes, bytes + size);
+			return size;
+		}
+
+		Byte const* GetData() const noexcept { return buffer.data(); }
+		Size GetSize() const noexcept { return buffer.size(); }
+		void Clear() noexcept { buffer.clear(); }
+	};
+
+	// writes into a caller-owned slice and rejects anything past its end
+	class BufferOutputStream : public OutputStream
+	{
+	private:
+		BytePointer data;
+		Size capacity;
+		Size size;
+
+	public:
+		BufferOutputStream(void* _data, Size _capacity) : data(static_cast<BytePointer>(_data)), capacity(_capacity), size(0) {}
+
+		Size Write(void const* bytes, Size length) override
+		{
+			Size count = length < capacity - size ? length : capacity - size;
+			REFL_MEMCPY(data + size, bytes, count);
+			size += count;
+			return count;
+		}
+
+		Size GetSize() const noexcept { return size; }
+	};
+
+	// Delivers the data in chunks of at most chunk_size bytes and reports "would block" once after
+	// every chunk, which emulates a non-blocking socket receiving one packet per poll.
+	class MemoryInputStream : public InputStream
+	{
+	private:
+		Byte const* data;
+		Size size;
+		Size position;
+		Size chunk_size;
+		Size chunk_remaining;
+
+	public:
+		MemoryInputStream(void const* _data, Size _size, Size _chunk_size = SIZE_MAX) :
+			data(static_cast<Byte const*>(_data)),
+			size(_size),
+			position(0),
+			chunk_size(_chunk_size == 0 ? 1 : _chunk_size),
+			chunk_remaining(chunk_size)
+		{}
+
+		Size Read(void* buffer, Size length) override
+		{
+			if (chunk_remaining == 0)
+			{
+				chunk_remaining = chunk_size;
+				return 0;
+			}
+
+			Size available = size - position;
+			Size count = length < available ? length : available;
+			count = count < chunk_remaining ? count : chunk_remaining;
+			REFL_MEMCPY(buffer, data + position, count);
+			position += count;
+			chunk_remaining -= count;
+			return count;
+		}
+
+		bool IsClosed() const override { return position == size; }
+		Size GetPosition() const noexcept { return position; }
+	};
+
+	static inline bool IsSerializableField(Field const* field) noexcept
+	{
+		auto type = field->GetType();
+		return !field->IsStatic() && !type->IsPointer() && !type->IsReference();
+	}
+
+	inline Size GetSerializedSize(Type const* type) noexcept
+	{
+		if (type->IsPointer() || type->IsReference())
+		{
+			return 0;
+		}
+
+		if (type->IsArray())
+		{
+			return type->GetArrayLength() * GetSerializedSize(type->GetRawType());
+		}
+
+		if (type->IsBuiltin())
+		{
+			return type->GetSize();
+		}
+
+		Size size = 0;
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (IsSerializableField(field))
+			{
+				size += GetSerializedSize(field->GetType());
+			}
+		}
+		return size;
+	}
+
+	// the body of the type is its object representation: trivially copyable, every byte belongs
+	// to a reflected field and no pointer is skipped, so it is written and read as one block. The
+	// traits are tested first, the size walk only runs for types that have them.
+	inline bool IsRawSerializable(Type const* type) noexcept
+	{
+		return type->IsTriviallyCopyable() && type->HasCompleteFields() && !type->IsPointer() &&
+			GetSerializedSize(type) == type->GetSize();
+	}
+
+	inline bool Serialize(Type const* type, void const* obj, OutputStream& os)
+	{
+		auto bytes = static_cast<Byte const*>(obj);
+
+		if (type->IsArray())
+		{
+			auto elementType = type->GetRawType();
+			if (elementType->IsBuiltin() || IsRawSerializable(elementType))
+			{
+				return os.Write(bytes, type->GetSize()) == type->GetSize();
+			}
+
+			for (Size i = 0; i < type->GetArrayLength(); ++i)
+			{
+				if (!Serialize(elementType, bytes + i * elementType->GetSize(), os))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		if (type->IsBuiltin() || IsRawSerializable(type))
+		{
+			return os.Write(bytes, type->GetSize()) == type->GetSize();
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (IsSerializableField(field) && !Serialize(field->GetType(), field->GetAddress(bytes), os))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	enum class DeserializeStatus : Byte
+	{
+		kNeedMoreData,
+		kDone,
+		// the stream was closed before the object was complete
+		kTruncated
+	};
+
+	// Resumable deserializer: input may arrive in arbitrary chunks, the position in the field tree
+	// is kept between calls and every byte is written straight into the target object.
+	class IncrementalDeserializer
+	{
+	private:
+		struct Frame
+		{
+			Type const* type;
+			BytePointer base;
+			Size index;
+		};
+
+		std::vector<Frame> frames;
+		BytePointer leaf;
+		Size leaf_remaining;
+
+		// descends from the frame on top of the stack until a leaf with pending bytes is found
+		void Advance()
+		{
+			while (leaf_remaining == 0 && !frames.empty())
+			{
+				auto& frame = frames.back();
+				auto type = frame.type;
+
+				if (type->IsArray())
+				{
+					auto elementType = type->GetRawType();
+					if (frame.index >= type->GetArrayLength())
+					{
+						frames.pop_back();
+						continue;
+					}
+
+					auto element = frame.base + frame.index * elementType->GetSize();
+					frame.index++;
+					Enter(elementType, element);
+				}
+				else
+				{
+					if (frame.index >= type->GetFieldsLength())
+					{
+						frames.pop_back();
+						continue;
+					}
+
+					auto field = type->GetField(frame.index);
+					auto base = frame.base;
+					frame.index++;
+					if (IsSerializableField(field))
+					{
+						Enter(field->GetType(), field->GetAddress(base));
+					}
+				}
+			}
+		}
+
+		void Enter(Type const* type, BytePointer base)
+		{
+			if (type->IsBuiltin() || IsRawSerializable(type) || (type->IsArray() && type->GetRawType()->IsBuiltin()))
+			{
+				// builtin arrays and raw records are contiguous, consume them as a single leaf
+				leaf = base;
+				leaf_remaining = type->GetSize();
+				return;
+			}
+
+			frames.push_back(Frame{ type, base, 0 });
+		}
+
+	public:
+		IncrementalDeserializer(Type const* type, Pointer target) : leaf(nullptr), leaf_remaining(0)
+		{
+			Reset(type, target);
+		}
+
+		void Reset(Type const* type, Pointer target)
+		{
+			frames.clear();
+			leaf = nullptr;
+			leaf_remaining = 0;
+			Enter(type, static_cast<BytePointer>(target));
+			Advance();
+		}
+
+		bool IsDone() const noexcept { return leaf_remaining == 0 && frames.empty(); }
+
+		// consumes bytes from data until the object is complete, consumed receives the number of bytes used
+		DeserializeStatus Feed(void const* data, Size size, Size* consumed = nullptr)
+		{
+			auto bytes = static_cast<Byte const*>(data);
+			Size position = 0;
+
+			while (!IsDone() && position < size)
+			{
+				Size count = size - position < leaf_remaining ? size - position : leaf_remaining;
+				REFL_MEMCPY(leaf, bytes + position, count);
+				leaf += count;
+				leaf_remaining -= count;
+				position += count;
+				Advance();
+			}
+
+			if (consumed)
+			{
+				*consumed = position;
+			}
+
+			return IsDone() ? DeserializeStatus::kDone : DeserializeStatus::kNeedMoreData;
+		}
+
+		// reads from the stream directly into the target, never past the end of the object
+		DeserializeStatus Pump(InputStream& stream)
+		{
+			while (!IsDone())
+			{
+				Size count = stream.Read(leaf, leaf_remaining);
+				if (count == 0)
+				{
+					return stream.IsClosed() ? DeserializeStatus::kTruncated : DeserializeStatus::kNeedMoreData;
+				}
+
+				leaf += count;
+				leaf_remaining -= count;
+				Advance();
+			}
+
+			return DeserializeStatus::kDone;
+		}
+	};
+
+	inline bool Deserialize(Type const* type, Pointer obj, void const* data, Size size)
+	{
+		IncrementalDeserializer deserializer(type, obj);
+		return deserializer.Feed(data, size) == DeserializeStatus::kDone;
+	}
+
+	template<typename T>
+	bool Serialize(T const& obj, OutputStream& os)
+	{
+		return Serialize(GetType<T>(), &obj, os);
+	}
+
+	template<typename T>
+	bool Deserialize(T& obj, void const* data, Size size)
+	{
+		return Deserialize(GetType<T>(), &obj, data, size);
+	}
+}
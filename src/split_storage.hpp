@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// Hot/cold split of a reflected type. For a type with FIELD(cold) members the generator emits
+	//
+	//   template<> struct SplitStorage<Entity>
+	//   {
+	//       struct Cold { ...cold fields... };
+	//       ...hot fields...
+	//       Cold* cold;
+	//   };
+	//
+	// and reflects it with the same fields in the same order as Entity; the cold ones are indirect,
+	// so Field::GetValue, GetRef, the serializers, byte order conversion, columnar export and
+	// memory accounting work on either layout. The compact serializer fails for a split object
+	// whose side pointer is null. The object store and object graphs refuse split types.
+
+	// converts between plain objects and their split layout field by field, the field types are
+	// copied bytewise
+	inline void CopyFields(Type const* sourceType, void const* source, Type const* targetType, Pointer target) noexcept
+	{
+		Size length = sourceType->GetFieldsLength() < targetType->GetFieldsLength() ? sourceType->GetFieldsLength() : targetType->GetFieldsLength();
+		for (Size i = 0; i < length; ++i)
+		{
+			auto sourceField = sourceType->GetField(i);
+			auto targetField = targetType->GetField(i);
+			if (!sourceField->IsStatic() && !targetField->IsStatic())
+			{
+				REFL_MEMCPY(targetField->GetAddress(target), sourceField->GetAddress(source), sourceField->GetType()->GetSize());
+			}
+		}
+	}
+
+	// array of split objects: hot parts are contiguous, cold parts live in a parallel side array
+	template<typename T>
+	class SplitArray
+	{
+	public:
+		typedef SplitStorage<T> Hot;
+		typedef typename SplitStorage<T>::Cold Cold;
+
+	private:
+		std::vector<Hot> hot;
+		std::vector<Cold> cold;
+
+		void Link() noexcept
+		{
+			for (Size i = 0; i < hot.size(); ++i)
+			{
+				hot[i].cold = &cold[i];
+			}
+		}
+
+	public:
+		SplitArray() {}
+		explicit SplitArray(Size length) : hot(length), cold(length) { Link(); }
+
+		SplitArray(T const* objects, Size length) : hot(length), cold(length)
+		{
+			Link();
+			for (Size i = 0; i < length; ++i)
+			{
+				CopyFields(GetType<T>(), &objects[i], GetType<Hot>(), &hot[i]);
+			}
+		}
+
+		SplitArray(SplitArray const& other) : hot(other.hot), cold(other.cold) { Link(); }
+
+		SplitArray& operator=(SplitArray const& other)
+		{
+			hot = other.hot;
+			cold = other.cold;
+			Link();
+			return *this;
+		}
+
+		// moved vectors keep their buffers, so the links stay valid
+		SplitArray(SplitArray&&) = default;
+		SplitArray& operator=(SplitArray&&) = default;
+
+		void Resize(Size length)
+		{
+			hot.resize(length);
+			cold.resize(length);
+			Link();
+		}
+
+		Size GetLength() const noexcept { return hot.size(); }
+		Hot* GetData() noexcept { return hot.data(); }
+		Hot const* GetData() const noexcept { return hot.data(); }
+		Hot& operator[](Size index) noexcept { return hot[index]; }
+		Hot const& operator[](Size index) const noexcept { return hot[index]; }
+
+		// writes element index back in the unsplit layout
+		void Join(Size index, T& object) const noexcept
+		{
+			CopyFields(GetType<Hot>(), &hot[index], GetType<T>(), &object);
+		}
+	};
+}
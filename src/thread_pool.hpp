@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// Work-stealing thread pool: every worker owns a deque, pops its own tasks LIFO and
+	// steals from the other deques FIFO when it runs dry. Threads that wait on a
+	// ParallelFor help by stealing, so nested parallel loops do not deadlock.
+	class ThreadPool
+	{
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		struct Worker
+		{
+			ThreadPool const* pool;
+			Size index;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+		std::mutex wake_mutex;
+		std::condition_variable wake;
+		std::atomic<Size> pending;
+		std::atomic<Size> next_queue;
+		bool stopping;
+
+		static Worker& GetCurrentWorker() noexcept
+		{
+			static thread_local Worker worker = { nullptr, 0 };
+			return worker;
+		}
+
+		Size GetCurrentIndex() const noexcept
+		{
+			auto& worker = GetCurrentWorker();
+			return worker.pool == this ? worker.index : SIZE_MAX;
+		}
+
+		bool Pop(Size index, std::function<void()>& task)
+		{
+			auto& queue = *queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+			{
+				return false;
+			}
+
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+
+		bool Steal(Size index, std::function<void()>& task)
+		{
+			auto& queue = *queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+			{
+				return false;
+			}
+
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+
+		// runs one task from the own queue or a stolen one, returns false when every queue is empty
+		bool RunOne(Size self)
+		{
+			std::function<void()> task;
+			bool found = self != SIZE_MAX && Pop(self, task);
+
+			for (Size i = 0; !found && i < queues.size(); ++i)
+			{
+				Size victim = (self == SIZE_MAX ? i : self + 1 + i) % queues.size();
+				found = victim != self && Steal(victim, task);
+			}
+
+			if (!found)
+			{
+				return false;
+			}
+
+			pending.fetch_sub(1, std::memory_order_relaxed);
+			task();
+			return true;
+		}
+
+		void WorkerLoop(Size index)
+		{
+			GetCurrentWorker() = Worker{ this, index };
+			while (true)
+			{
+				if (RunOne(index))
+				{
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(wake_mutex);
+				wake.wait(lock, [this] { return stopping || pending.load(std::memory_order_relaxed) > 0; });
+				if (stopping)
+				{
+					return;
+				}
+			}
+		}
+
+	public:
+		explicit ThreadPool(Size threadsLength = 0) : pending(0), next_queue(0), stopping(false)
+		{
+			if (threadsLength == 0)
+			{
+				threadsLength = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+			}
+
+			for (Size i = 0; i < threadsLength; ++i)
+			{
+				queues.emplace_back(new Queue());
+			}
+
+			for (Size i = 0; i < threadsLength; ++i)
+			{
+				threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+			}
+		}
+
+		ThreadPool(ThreadPool const&) = delete;
+		ThreadPool& operator=(ThreadPool const&) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(wake_mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		Size GetThreadsLength() const noexcept { return threads.size(); }
+
+		void Submit(std::function<void()> task)
+		{
+			Size index = GetCurrentIndex();
+			if (index == SIZE_MAX)
+			{
+				index = next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+			}
+
+			// count first so pending never drops below the number of queued tasks
+			{
+				std::lock_guard<std::mutex> lock(wake_mutex);
+				pending.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queues[index]->mutex);
+				queues[index]->tasks.push_back(std::move(task));
+			}
+			wake.notify_one();
+		}
+
+		// calls body(begin, end) over [0, count) in ranges of at most grain and waits for all of them
+		template<typename F>
+		void ParallelFor(Size count, Size grain, F const& body)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+
+			grain = grain > 0 ? grain : 1;
+			Size ranges = (count + grain - 1) / grain;
+			std::atomic<Size> remaining(ranges);
+
+			for (Size i = 0; i < ranges; ++i)
+			{
+				Size begin = i * grain;
+				Size end = begin + grain < count ? begin + grain : count;
+				Submit([&body, &remaining, begin, end]
+				{
+					body(begin, end);
+					remaining.fetch_sub(1, std::memory_order_release);
+				});
+			}
+
+			Size self = GetCurrentIndex();
+			while (remaining.load(std::memory_order_acquire) > 0)
+			{
+				if (!RunOne(self))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+	};
+}
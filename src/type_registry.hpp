@@ -0,0 +1,385 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	// Process-wide table of the reflected types of every loaded module. A module (the host or a
+	// dlopen'ed plugin) registers the getters meta_gen lists in <file>_gen_refl.h when it is
+	// loaded and unregisters them before it is unloaded:
+	//
+	//   REFLECTION_MODULE(physics, physics_gen_refl_types);
+	//
+	// Registration rebuilds an immutable snapshot and publishes it with one atomic store; readers
+	// pin the snapshot they loaded, so lookups never lock and never wait. A retired snapshot is
+	// freed once no reader can still hold it, which is detected SRCU-style with two generations
+	// of reader counters.
+	//
+	// Types are found by name (the fully qualified name the generator uses) or by fingerprint.
+	// When two modules register the same name, equal fingerprints mean the same definition was
+	// compiled into both and the first one stays visible; different fingerprints are a real
+	// conflict. Both cases are reported, a conflicting type keeps resolving to the first module.
+
+	struct TypeModule
+	{
+		char const* name;
+		TypeGetter const* getters;
+		Size getters_length;
+	};
+
+	enum class TypeCollisionKind : Byte
+	{
+		kDuplicate, // same name, same fingerprint
+		kConflict   // same name, different layout
+	};
+
+	struct TypeCollision
+	{
+		TypeCollisionKind kind;
+		char const* type_name;
+		std::string visible_module;
+		std::string hidden_module;
+		Fingerprint visible_fingerprint;
+		Fingerprint hidden_fingerprint;
+	};
+
+	struct RegisteredType
+	{
+		Type const* type;
+		Fingerprint fingerprint;
+		Size module_index;
+	};
+
+	// immutable once published
+	struct TypeRegistrySnapshot
+	{
+		std::vector<std::string> modules;
+		std::vector<RegisteredType> by_name;
+		std::vector<RegisteredType> by_fingerprint;
+
+		Type const* Find(char const* name) const noexcept
+		{
+			auto it = std::lower_bound(by_name.begin(), by_name.end(), name, [](RegisteredType const& entry, char const* key)
+			{
+				return std::strcmp(entry.type->GetName(), key) < 0;
+			});
+			return it != by_name.end() && std::strcmp(it->type->GetName(), name) == 0 ? it->type : nullptr;
+		}
+
+		Type const* Find(Fingerprint fingerprint) const noexcept
+		{
+			auto it = std::lower_bound(by_fingerprint.begin(), by_fingerprint.end(), fingerprint, [](RegisteredType const& entry, Fingerprint key)
+			{
+				return entry.fingerprint < key;
+			});
+			return it != by_fingerprint.end() && it->fingerprint == fingerprint ? it->type : nullptr;
+		}
+
+		// name of the module that provides the visible definition of name
+		char const* FindModule(char const* name) const noexcept
+		{
+			auto it = std::lower_bound(by_name.begin(), by_name.end(), name, [](RegisteredType const& entry, char const* key)
+			{
+				return std::strcmp(entry.type->GetName(), key) < 0;
+			});
+			return it != by_name.end() && std::strcmp(it->type->GetName(), name) == 0 ? modules[it->module_index].c_str() : nullptr;
+		}
+
+		Size GetTypesLength() const noexcept { return by_name.size(); }
+		Type const* GetType(Size index) const noexcept { return by_name[index].type; }
+	};
+
+	class TypeRegistry
+	{
+	private:
+		static constexpr Size kReaderShardsLength = 16;
+
+		// reader counters are split by thread, on separate cache lines, so concurrent
+		// lookups do not write to the same line
+		struct alignas(64) ReaderShard
+		{
+			std::atomic<Size> counters[2];
+		};
+
+		struct Module
+		{
+			std::string name;
+			std::vector<Type const*> types;
+		};
+
+		std::atomic<TypeRegistrySnapshot const*> current;
+		std::atomic<Size> generation;
+		mutable ReaderShard shards[kReaderShardsLength];
+
+		std::mutex writer_mutex;
+		std::vector<Module> modules;
+
+		static Size GetShardIndex() noexcept
+		{
+			static thread_local Size index = std::hash<std::thread::id>()(std::this_thread::get_id()) % kReaderShardsLength;
+			return index;
+		}
+
+		Size GetReadersLength(Size parity) const noexcept
+		{
+			Size length = 0;
+			for (auto& shard : shards)
+			{
+				length += shard.counters[parity].load(std::memory_order_seq_cst);
+			}
+			return length;
+		}
+
+		// waits until every reader that could have loaded a retired snapshot has left; a reader
+		// may pick its generation just before the flip and enter just after, so both
+		// generations are drained in turn
+		void Synchronize() noexcept
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				Size previous = generation.fetch_add(1, std::memory_order_seq_cst) & 1;
+				while (GetReadersLength(previous) != 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// modules in registration order, the first definition of a name wins
+		void Publish(std::vector<TypeCollision>* collisions)
+		{
+			auto snapshot = new TypeRegistrySnapshot();
+			for (Size i = 0; i < modules.size(); ++i)
+			{
+				snapshot->modules.push_back(modules[i].name);
+				for (auto type : modules[i].types)
+				{
+					snapshot->by_name.push_back(RegisteredType{ type, type->GetFingerprint(), i });
+				}
+			}
+
+			// stable, so equal names keep module order and the first one is the visible one
+			std::stable_sort(snapshot->by_name.begin(), snapshot->by_name.end(), [](RegisteredType const& a, RegisteredType const& b)
+			{
+				return std::strcmp(a.type->GetName(), b.type->GetName()) < 0;
+			});
+
+			Size length = 0;
+			for (Size i = 0; i < snapshot->by_name.size(); ++i)
+			{
+				auto& entry = snapshot->by_name[i];
+				if (length > 0 && std::strcmp(snapshot->by_name[length - 1].type->GetName(), entry.type->GetName()) == 0)
+				{
+					auto& visible = snapshot->by_name[length - 1];
+					if (collisions != nullptr && visible.module_index != entry.module_index)
+					{
+						collisions->push_back(TypeCollision{
+							visible.fingerprint == entry.fingerprint ? TypeCollisionKind::kDuplicate : TypeCollisionKind::kConflict,
+							entry.type->GetName(), modules[visible.module_index].name, modules[entry.module_index].name,
+							visible.fingerprint, entry.fingerprint });
+					}
+					continue;
+				}
+				snapshot->by_name[length++] = entry;
+			}
+			snapshot->by_name.resize(length);
+
+			snapshot->by_fingerprint = snapshot->by_name;
+			std::stable_sort(snapshot->by_fingerprint.begin(), snapshot->by_fingerprint.end(), [](RegisteredType const& a, RegisteredType const& b)
+			{
+				return a.fingerprint < b.fingerprint;
+			});
+
+			auto retired = current.exchange(snapshot, std::memory_order_seq_cst);
+			Synchronize();
+			delete retired;
+		}
+
+	public:
+		// pins the current snapshot for the lifetime of the reader, wait-free
+		class Reader
+		{
+		private:
+			TypeRegistry const& registry;
+			std::atomic<Size>& counter;
+			TypeRegistrySnapshot const* snapshot;
+
+		public:
+			explicit Reader(TypeRegistry const& _registry) noexcept :
+				registry(_registry),
+				counter(_registry.shards[GetShardIndex()].counters[_registry.generation.load(std::memory_order_seq_cst) & 1])
+			{
+				counter.fetch_add(1, std::memory_order_seq_cst);
+				snapshot = registry.current.load(std::memory_order_seq_cst);
+			}
+
+			~Reader() { counter.fetch_sub(1, std::memory_order_release); }
+
+			Reader(Reader const&) = delete;
+			Reader& operator=(Reader const&) = delete;
+
+			TypeRegistrySnapshot const& operator*() const noexcept { return *snapshot; }
+			TypeRegistrySnapshot const* operator->() const noexcept { return snapshot; }
+		};
+
+		TypeRegistry() : current(new TypeRegistrySnapshot()), generation(0)
+		{
+			for (auto& shard : shards)
+			{
+				shard.counters[0].store(0, std::memory_order_relaxed);
+				shard.counters[1].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		~TypeRegistry() { delete current.load(); }
+
+		TypeRegistry(TypeRegistry const&) = delete;
+		TypeRegistry& operator=(TypeRegistry const&) = delete;
+
+		// adds the types of module, collisions with the modules already registered are appended
+		// to collisions; returns false when a module of that name is already registered
+		bool RegisterModule(TypeModule const& module, std::vector<TypeCollision>* collisions = nullptr)
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+			for (auto& registered : modules)
+			{
+				if (registered.name == module.name)
+				{
+					return false;
+				}
+			}
+
+			Module entry;
+			entry.name = module.name;
+			for (Size i = 0; i < module.getters_length; ++i)
+			{
+				entry.types.push_back(module.getters[i]());
+			}
+			modules.push_back(std::move(entry));
+
+			// only the new module can collide, older collisions were reported when they appeared
+			std::vector<TypeCollision> all;
+			Publish(&all);
+			if (collisions != nullptr)
+			{
+				for (auto& collision : all)
+				{
+					if (collision.visible_module == module.name || collision.hidden_module == module.name)
+					{
+						collisions->push_back(collision);
+					}
+				}
+			}
+			return true;
+		}
+
+		// removes the types of a module; when this returns no reader can still reach them, so
+		// the module may be unloaded
+		bool UnregisterModule(char const* name)
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+			for (auto it = modules.begin(); it != modules.end(); ++it)
+			{
+				if (it->name == name)
+				{
+					modules.erase(it);
+					Publish(nullptr);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// the returned type is valid as long as its module stays loaded, use a Reader to look up
+		// several types or to keep them across an unload
+		Type const* Find(char const* name) const noexcept
+		{
+			Reader reader(*this);
+			return reader->Find(name);
+		}
+
+		Type const* Find(Fingerprint fingerprint) const noexcept
+		{
+			Reader reader(*this);
+			return reader->Find(fingerprint);
+		}
+	};
+
+	// one registry per process; plugins share the host's instance as long as this function is
+	// not hidden (default visibility, RTLD_GLOBAL), otherwise pass the host's registry to
+	// ModuleRegistration explicitly
+	inline TypeRegistry& GetTypeRegistry()
+	{
+		static TypeRegistry registry;
+		return registry;
+	}
+
+	inline void PrintTypeCollision(std::ostream& os, TypeCollision const& collision)
+	{
+		os << (collision.kind == TypeCollisionKind::kConflict ? "conflicting definitions of " : "duplicate definition of ") <<
+			collision.type_name << ": " << collision.visible_module << " (" << collision.visible_fingerprint << "), " <<
+			collision.hidden_module << " (" << collision.hidden_fingerprint << ")\n";
+	}
+
+	// registers a module for the lifetime of the object, a static instance registers when the
+	// module is loaded and unregisters when it is unloaded; collisions are printed to std::cerr
+	// unless a handler is installed. When another module already holds the name nothing is
+	// registered, and nothing is unregistered on destruction.
+	class ModuleRegistration
+	{
+	private:
+		TypeRegistry& registry;
+		char const* name;
+		bool registered;
+
+	public:
+		ModuleRegistration(TypeRegistry& _registry, char const* _name, TypeGetter const* getters, Size gettersLength,
+			std::function<void(TypeCollision const&)> const& onCollision = nullptr) :
+			registry(_registry),
+			name(_name),
+			registered(false)
+		{
+			std::vector<TypeCollision> collisions;
+			registered = registry.RegisterModule(TypeModule{ name, getters, gettersLength }, &collisions);
+			for (auto& collision : collisions)
+			{
+				if (onCollision)
+				{
+					onCollision(collision);
+				}
+				else
+				{
+					PrintTypeCollision(std::cerr, collision);
+				}
+			}
+		}
+
+		ModuleRegistration(char const* _name, TypeGetter const* getters, Size gettersLength) :
+			ModuleRegistration(GetTypeRegistry(), _name, getters, gettersLength)
+		{}
+
+		~ModuleRegistration()
+		{
+			if (registered)
+			{
+				registry.UnregisterModule(name);
+			}
+		}
+
+		bool IsRegistered() const noexcept { return registered; }
+
+		ModuleRegistration(ModuleRegistration const&) = delete;
+		ModuleRegistration& operator=(ModuleRegistration const&) = delete;
+	};
+}
+
+#define REFLECTION_MODULE(name, getters) \
+	static ::Reflection::ModuleRegistration reflection_module_##name(#name, getters, sizeof(getters) / sizeof(getters[0]))
@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+
+#include <thread>
+#include <vector>
+
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	struct Counters
+	{
+		uint64_t produced;
+		uint32_t consumed;
+	};
+
+	Field countersFields[3] = {
+		Field("Counters::produced", GetType<uint64_t>(), offsetof(Counters, produced), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kRelease),
+		Field("Counters::consumed", GetType<uint32_t>(), offsetof(Counters, consumed), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kAcquire),
+		Field()
+	};
+}
+
+TEST_CASE("Atomic field access loads, stores and exchanges the field", "[atomic_field]")
+{
+	Counters counters = { 5, 7 };
+	auto& produced = countersFields[0];
+
+	uint64_t value = 0;
+	REQUIRE(produced.AtomicLoad(&counters, value));
+	CHECK(value == 5);
+	REQUIRE(produced.AtomicStore(&counters, uint64_t(6)));
+	CHECK(counters.produced == 6);
+
+	uint64_t expected = 5;
+	CHECK_FALSE(produced.AtomicCompareExchange(&counters, expected, uint64_t(9)));
+	CHECK(expected == 6);
+	CHECK(produced.AtomicCompareExchange(&counters, expected, uint64_t(9)));
+	CHECK(counters.produced == 9);
+	CHECK(counters.consumed == 7);
+}
+
+TEST_CASE("Atomic field access with a type of another size fails", "[atomic_field]")
+{
+	Counters counters = { 5, 7 };
+	auto& consumed = countersFields[1];
+
+	uint64_t wide = 1;
+	CHECK_FALSE(consumed.AtomicLoad(&counters, wide));
+	CHECK(wide == 1);
+	CHECK_FALSE(consumed.AtomicStore(&counters, uint64_t(~0ull)));
+	uint64_t expected = 7;
+	CHECK_FALSE(consumed.AtomicCompareExchange(&counters, expected, uint64_t(8)));
+	CHECK(expected == 7);
+	CHECK(counters.produced == 5);
+	CHECK(counters.consumed == 7);
+
+	uint16_t narrow = 1;
+	CHECK_FALSE(countersFields[0].AtomicLoad(&counters, narrow));
+	CHECK(narrow == 1);
+}
+
+TEST_CASE("Atomic compare exchange loses no concurrent increment", "[atomic_field]")
+{
+	Counters counters = { 0, 0 };
+	auto& produced = countersFields[0];
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back([&]
+		{
+			for (int n = 0; n < 10000; ++n)
+			{
+				uint64_t expected;
+				produced.AtomicLoad(&counters, expected);
+				while (!produced.AtomicCompareExchange(&counters, expected, expected + 1)) {}
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	CHECK(counters.produced == 40000);
+}
@@ -0,0 +1,174 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "reflection.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+#if defined(_WIN32)
+	char const* const kNullDevice = "NUL";
+#else
+	char const* const kNullDevice = "/dev/null";
+#endif
+
+	// a directory of synthetic sources; every source includes prefix.hpp, a set of heavy standard
+	// headers, first and declares one reflected type
+	class MetaGenWorkspace
+	{
+	private:
+		std::string directory;
+		std::vector<std::string> sources;
+
+		static void WriteFile(std::string const& name, std::string const& text)
+		{
+			std::ofstream(name, std::ios::binary) << text;
+		}
+
+	public:
+		MetaGenWorkspace(std::string _directory, Size filesLength) : directory(std::move(_directory))
+		{
+#if defined(_WIN32)
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+			WriteFile(directory + "/prefix.hpp",
+				"#pragma once\n"
+				"#include <algorithm>\n#include <functional>\n#include <iostream>\n#include <map>\n"
+				"#include <memory>\n#include <regex>\n#include <sstream>\n#include <string>\n"
+				"#include <unordered_map>\n#include <vector>\n");
+
+			for (Size i = 0; i < filesLength; ++i)
+			{
+				auto name = "Record" + std::to_string(i);
+				sources.push_back(directory + "/record_" + std::to_string(i) + ".cpp");
+				WriteFile(sources.back(),
+					"#include \"prefix.hpp\"\n#include \"reflection.hpp\"\n\n"
+					"STRUCT(" + name + ")\n{\n"
+					"\tFIELD() int32_t id;\n"
+					"\tFIELD() float values[4];\n"
+					"\tFIELD() double weight;\n"
+					"\tFIELD() " + name + "* next;\n"
+					"};\n");
+			}
+		}
+
+		std::string GetPrefixHeader() const { return directory + "/prefix.hpp"; }
+
+		// runs meta_gen over every source without its cache, so each run parses every file
+		bool Run(std::string const& options) const
+		{
+			std::string command = std::string("\"") + META_GEN_PATH + "\" -cache= " + options;
+			for (auto& source : sources)
+			{
+				command += " " + source;
+			}
+			command += std::string(" -- -std=c++14 -I\"") + REFLECTION_SOURCE_DIR + "\" > " + kNullDevice + " 2>&1";
+			return std::system(command.c_str()) == 0;
+		}
+
+		// every generated header, in input order
+		std::string ReadGenerated() const
+		{
+			std::string generated;
+			for (auto& source : sources)
+			{
+				std::ifstream file(source.substr(0, source.rfind('.')) + "_gen_refl.h", std::ios::binary);
+				std::ostringstream text;
+				text << file.rdbuf();
+				generated += text.str();
+			}
+			return generated;
+		}
+	};
+
+	bool HasMetaGen()
+	{
+		if (META_GEN_PATH[0] == '\0')
+		{
+			WARN("configure with -DMETA_GEN=<path to meta_gen> to run the meta_gen benchmarks");
+			return false;
+		}
+		return true;
+	}
+
+	// 1, 2, 4, ... up to the core count, which is always included
+	std::vector<Size> GetJobCounts()
+	{
+		Size cores = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+		std::vector<Size> counts;
+		for (Size jobs = 1; jobs < cores; jobs *= 2)
+		{
+			counts.push_back(jobs);
+		}
+		counts.push_back(cores);
+		return counts;
+	}
+}
+
+TEST_CASE("meta_gen scaling over translation units", "[!benchmark][meta_gen]")
+{
+	if (!HasMetaGen())
+	{
+		return;
+	}
+
+	MetaGenWorkspace workspace("meta_gen_scaling", 200);
+	REQUIRE(workspace.Run("-j 1"));
+	auto serial = workspace.ReadGenerated();
+	REQUIRE_FALSE(serial.empty());
+
+	for (Size jobs : GetJobCounts())
+	{
+		std::string options = "-j " + std::to_string(jobs);
+		BENCHMARK("200 files, " + options)
+		{
+			return workspace.Run(options);
+		};
+
+		// parallel runs write the same headers as a serial one
+		CHECK(workspace.ReadGenerated() == serial);
+	}
+}
+
+TEST_CASE("meta_gen with and without a precompiled prefix header", "[!benchmark][meta_gen]")
+{
+	if (!HasMetaGen())
+	{
+		return;
+	}
+
+	MetaGenWorkspace workspace("meta_gen_prefix_header", 500);
+	std::string prefixHeader = "-prefix-header=" + workspace.GetPrefixHeader();
+	REQUIRE(workspace.Run(std::string()));
+	auto parsed = workspace.ReadGenerated();
+
+	// the first run builds the PCH, later runs reuse it as long as its inputs are unchanged
+	REQUIRE(workspace.Run(prefixHeader));
+	CHECK(workspace.ReadGenerated() == parsed);
+
+	BENCHMARK("500 files, no prefix header")
+	{
+		return workspace.Run(std::string());
+	};
+
+	BENCHMARK("500 files, -prefix-header")
+	{
+		return workspace.Run(prefixHeader);
+	};
+}
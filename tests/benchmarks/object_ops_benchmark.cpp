@@ -0,0 +1,118 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "object_ops.hpp"
+#include "serialization.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// Sample reflected without traits, as a type with a user-provided copy would be: every
+	// operation and the serializer walk its fields
+	Type const* GetPlannedSampleType()
+	{
+		static Field fields[5];
+		for (Size i = 0; i < GetType<Sample>()->GetFieldsLength(); ++i)
+		{
+			fields[i] = *GetType<Sample>()->GetField(i);
+		}
+		static Type type("Sample", sizeof(Sample), TypeSpecifierType::kStruct, fields, 4, nullptr, 0);
+		return &type;
+	}
+
+	// a mix of Vec3 (one memcpy, raw serializable, floats compared through the plan), Sample
+	// (trivially copyable with padding, serialized field by field) and Sample without traits
+	// (planned everywhere)
+	struct MixedObjects
+	{
+		std::vector<Type const*> types;
+		std::vector<Pointer> objects;
+		std::vector<Pointer> copies;
+		std::vector<Vec3> vectors;
+		std::vector<Sample> samples;
+
+		explicit MixedObjects(Size count) : vectors(count * 2), samples(count * 2)
+		{
+			Type const* mix[3] = { GetType<Vec3>(), GetType<Sample>(), GetPlannedSampleType() };
+			for (Size i = 0; i < count; ++i)
+			{
+				vectors[i] = Vec3{ i * 1.0f, 2.0f, 3.0f };
+				samples[i].id = static_cast<int32_t>(i);
+				samples[i].weights[1] = i * 0.5;
+
+				auto type = mix[i % 3];
+				types.push_back(type);
+				if (type == mix[0])
+				{
+					objects.push_back(&vectors[i]);
+					copies.push_back(&vectors[count + i]);
+				}
+				else
+				{
+					objects.push_back(&samples[i]);
+					copies.push_back(&samples[count + i]);
+				}
+			}
+		}
+	};
+}
+
+TEST_CASE("Object operations over mixed POD and non-POD types", "[!benchmark][object_ops]")
+{
+	MixedObjects mixed(1 << 16);
+	auto count = mixed.types.size();
+
+	BENCHMARK("CopyObject")
+	{
+		Size copied = 0;
+		for (Size i = 0; i < count; ++i)
+		{
+			copied += CopyObject(mixed.types[i], mixed.copies[i], mixed.objects[i]);
+		}
+		return copied;
+	};
+
+	BENCHMARK("EqualObjects")
+	{
+		Size equal = 0;
+		for (Size i = 0; i < count; ++i)
+		{
+			equal += EqualObjects(mixed.types[i], mixed.copies[i], mixed.objects[i]);
+		}
+		return equal;
+	};
+
+	BENCHMARK("HashObject")
+	{
+		Fingerprint hash = 0;
+		for (Size i = 0; i < count; ++i)
+		{
+			hash ^= HashObject(mixed.types[i], mixed.objects[i]);
+		}
+		return hash;
+	};
+
+	BENCHMARK("IsRawSerializable")
+	{
+		Size raw = 0;
+		for (Size i = 0; i < count; ++i)
+		{
+			raw += IsRawSerializable(mixed.types[i]);
+		}
+		return raw;
+	};
+
+	BENCHMARK("Serialize")
+	{
+		MemoryOutputStream os;
+		for (Size i = 0; i < count; ++i)
+		{
+			Serialize(mixed.types[i], mixed.objects[i], os);
+		}
+		return os.GetSize();
+	};
+}
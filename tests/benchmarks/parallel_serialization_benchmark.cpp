@@ -0,0 +1,78 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <thread>
+
+#include "parallel_serialization.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	std::vector<Sample> MakeSamples(Size count)
+	{
+		std::vector<Sample> samples(count);
+		for (Size i = 0; i < count; ++i)
+		{
+			samples[i].flag = static_cast<uint8_t>(i & 1);
+			samples[i].id = static_cast<int32_t>(i);
+			samples[i].position = Vec3{ i * 0.5f, -1.0f, 2.0f };
+			samples[i].weights[0] = i * 0.25;
+			samples[i].weights[1] = 1.0;
+			samples[i].weights[2] = -1.0;
+		}
+		return samples;
+	}
+
+	// 1, 2, 4, ... up to the core count, which is always included
+	std::vector<Size> GetThreadCounts()
+	{
+		Size cores = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+		std::vector<Size> counts;
+		for (Size threads = 1; threads < cores; threads *= 2)
+		{
+			counts.push_back(threads);
+		}
+		counts.push_back(cores);
+		return counts;
+	}
+}
+
+TEST_CASE("SerializeArrayParallel scaling", "[!benchmark][parallel_serialization]")
+{
+	auto samples = MakeSamples(1 << 18);
+	std::vector<Byte> out;
+	out.reserve(samples.size() * GetSerializedSize(GetType<Sample>()) * 2);
+
+	BENCHMARK("binary, serial loop")
+	{
+		MemoryOutputStream os;
+		for (auto& sample : samples)
+		{
+			Serialize(sample, os);
+		}
+		return os.GetSize();
+	};
+
+	for (Size threads : GetThreadCounts())
+	{
+		ThreadPool pool(threads);
+		std::string suffix = ", " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+
+		BENCHMARK("binary" + suffix)
+		{
+			out.clear();
+			SerializeArrayParallel(pool, samples.data(), samples.size(), out, WireFormat::kBinary);
+			return out.size();
+		};
+
+		BENCHMARK("compact" + suffix)
+		{
+			out.clear();
+			SerializeArrayParallel(pool, samples.data(), samples.size(), out, WireFormat::kCompact);
+			return out.size();
+		};
+	}
+}
@@ -0,0 +1,83 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "serialization.hpp"
+#include "split_storage.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	std::vector<Entity> MakeEntities(Size count)
+	{
+		std::vector<Entity> entities(count);
+		for (Size i = 0; i < count; ++i)
+		{
+			entities[i] = Entity{};
+			entities[i].position = Vec3{ i * 1.0f, 0.0f, 0.0f };
+			entities[i].velocity = Vec3{ 1.0f, 0.5f, 0.25f };
+			entities[i].created = static_cast<double>(i);
+			entities[i].id = static_cast<int32_t>(i);
+		}
+		return entities;
+	}
+
+	template<typename T>
+	float Integrate(T* entities, Size count)
+	{
+		for (Size i = 0; i < count; ++i)
+		{
+			entities[i].position.x += entities[i].velocity.x;
+			entities[i].position.y += entities[i].velocity.y;
+			entities[i].position.z += entities[i].velocity.z;
+		}
+		return entities[count - 1].position.x;
+	}
+}
+
+// the hot loop only touches position and velocity, the split layout keeps them 32 bytes apart
+// instead of 72
+TEST_CASE("Hot field iteration over plain and split layouts", "[!benchmark][split_storage]")
+{
+	auto plain = MakeEntities(1 << 20);
+	SplitArray<Entity> split(plain.data(), plain.size());
+
+	BENCHMARK("plain Entity")
+	{
+		return Integrate(plain.data(), plain.size());
+	};
+
+	BENCHMARK("SplitStorage<Entity>")
+	{
+		return Integrate(split.GetData(), split.GetLength());
+	};
+}
+
+TEST_CASE("Serialization of plain and split layouts", "[!benchmark][split_storage]")
+{
+	auto plain = MakeEntities(1 << 16);
+	SplitArray<Entity> split(plain.data(), plain.size());
+
+	BENCHMARK("plain Entity")
+	{
+		MemoryOutputStream os;
+		for (auto& entity : plain)
+		{
+			Serialize(entity, os);
+		}
+		return os.GetSize();
+	};
+
+	BENCHMARK("SplitStorage<Entity>")
+	{
+		MemoryOutputStream os;
+		for (Size i = 0; i < split.GetLength(); ++i)
+		{
+			Serialize(split[i], os);
+		}
+		return os.GetSize();
+	};
+}
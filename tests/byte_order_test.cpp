@@ -0,0 +1,104 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "byte_order.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	ByteOrder const kForeign = ByteOrder::kNative == ByteOrder::kLittle ? ByteOrder::kBig : ByteOrder::kLittle;
+
+	// serialized Sample: flag, id, position.x/y/z, weights[0..2]
+	Size const kSampleWidths[] = { 1, 4, 4, 4, 4, 8, 8, 8 };
+
+	Sample MakeSample(int32_t id)
+	{
+		Sample sample = {};
+		sample.flag = 7;
+		sample.id = id;
+		sample.position = Vec3{ 1.5f, -2.0f, 3.25f };
+		sample.weights[0] = 0.5;
+		sample.weights[1] = -1.0;
+		sample.weights[2] = 1e300;
+		return sample;
+	}
+
+	// accepts nothing
+	class FullOutputStream : public OutputStream
+	{
+	public:
+		Size Write(void const*, Size) override { return 0; }
+	};
+}
+
+TEST_CASE("Byte order conversion swaps every scalar of a plain type", "[byte_order]")
+{
+	Sample samples[2] = { MakeSample(0x01020304), MakeSample(-5) };
+	Sample original[2] = { samples[0], samples[1] };
+
+	ConvertByteOrder(GetType<Sample>(), samples, 2, kForeign);
+	CHECK(samples[0].flag == 7);
+	CHECK(samples[0].id == 0x04030201);
+	uint32_t x;
+	REFL_MEMCPY(&x, &samples[1].position.x, sizeof(x));
+	uint32_t expectedX;
+	REFL_MEMCPY(&expectedX, &original[1].position.x, sizeof(expectedX));
+	CHECK(x == ((expectedX >> 24) | ((expectedX >> 8) & 0xff00) | ((expectedX << 8) & 0xff0000) | (expectedX << 24)));
+
+	// swapping twice restores the objects, the native order leaves them alone
+	ConvertByteOrder(GetType<Sample>(), samples, 2, kForeign);
+	ConvertByteOrder(GetType<Sample>(), samples, 2, ByteOrder::kNative);
+	for (int i = 0; i < 2; ++i)
+	{
+		CHECK(samples[i].id == original[i].id);
+		CHECK(samples[i].position.x == original[i].position.x);
+		CHECK(samples[i].weights[2] == original[i].weights[2]);
+	}
+}
+
+TEST_CASE("Arrays written in a foreign byte order read back unchanged", "[byte_order]")
+{
+	Sample samples[3] = { MakeSample(1), MakeSample(-2), MakeSample(0x7fffffff) };
+
+	MemoryOutputStream native;
+	REQUIRE(SerializeArray(samples, 3, native));
+	MemoryOutputStream foreign;
+	REQUIRE(SerializeArray(samples, 3, foreign, kForeign));
+	REQUIRE(foreign.GetSize() == native.GetSize());
+	REQUIRE(native.GetSize() == 3 * GetSerializedSize(GetType<Sample>()));
+
+	// every field of every element is reversed in place
+	std::vector<Byte> expected(native.GetData(), native.GetData() + native.GetSize());
+	auto cursor = expected.begin();
+	for (int i = 0; i < 3; ++i)
+	{
+		for (Size width : kSampleWidths)
+		{
+			std::reverse(cursor, cursor + width);
+			cursor += width;
+		}
+	}
+	CHECK(std::equal(expected.begin(), expected.end(), foreign.GetData()));
+
+	Sample read[3] = {};
+	REQUIRE(DeserializeArray(read, 3, foreign.GetData(), foreign.GetSize(), kForeign));
+	for (int i = 0; i < 3; ++i)
+	{
+		CHECK(read[i].id == samples[i].id);
+		CHECK(read[i].position.y == samples[i].position.y);
+		CHECK(read[i].weights[2] == samples[i].weights[2]);
+	}
+	CHECK_FALSE(DeserializeArray(read, 3, foreign.GetData(), foreign.GetSize() - 1, kForeign));
+}
+
+TEST_CASE("Array serialization reports write failures in both byte orders", "[byte_order]")
+{
+	Sample samples[2] = { MakeSample(1), MakeSample(2) };
+	FullOutputStream full;
+	CHECK_FALSE(SerializeArray(samples, 2, full));
+	CHECK_FALSE(SerializeArray(samples, 2, full, kForeign));
+}
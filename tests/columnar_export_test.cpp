@@ -0,0 +1,151 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "columnar_export.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	struct Flags
+	{
+		bool enabled;
+		int16_t level;
+		double ratio;
+	};
+
+	Field flagsFields[4] = {
+		Field("Flags::enabled", GetType<bool>(), offsetof(Flags, enabled), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Flags::level", GetType<int16_t>(), offsetof(Flags, level), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Flags::ratio", GetType<double>(), offsetof(Flags, ratio), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Type flagsType("Flags", sizeof(Flags), TypeSpecifierType::kStruct, flagsFields, 3, nullptr, 0);
+
+	// reads the messages of a column batch stream back
+	struct MessageReader
+	{
+		Byte const* cursor;
+		Byte const* end;
+
+		template<typename T>
+		T Read()
+		{
+			T value;
+			REQUIRE(Size(end - cursor) >= sizeof(T));
+			REFL_MEMCPY(&value, cursor, sizeof(T));
+			cursor += sizeof(T);
+			return value;
+		}
+
+		// returns the metadata, cursor is left at the body
+		Byte const* Next(uint32_t& metadataLength)
+		{
+			CHECK(Read<uint32_t>() == 0xFFFFFFFF);
+			metadataLength = Read<uint32_t>();
+			CHECK(metadataLength % 8 == 0);
+			auto metadata = cursor;
+			cursor += metadataLength;
+			return metadata;
+		}
+	};
+}
+
+TEST_CASE("Column schemas flatten nested records and arrays", "[columnar_export]")
+{
+	auto columns = BuildColumnSchema(GetType<Sample>());
+	REQUIRE(columns.size() == 8);
+	CHECK(columns[0].name == "flag");
+	CHECK(columns[0].kind == ColumnKind::kUnsigned);
+	CHECK(columns[1].name == "id");
+	CHECK(columns[1].kind == ColumnKind::kSigned);
+	CHECK(columns[1].offset == offsetof(Sample, id));
+	CHECK(columns[3].name == "position.y");
+	CHECK(columns[3].offset == offsetof(Sample, position) + offsetof(Vec3, y));
+	CHECK(columns[7].name == "weights[2]");
+	CHECK(columns[7].kind == ColumnKind::kFloat);
+	CHECK(columns[7].width == 8);
+	CHECK(columns[7].offset == offsetof(Sample, weights) + 2 * sizeof(double));
+}
+
+TEST_CASE("Column batches hold one buffer per column", "[columnar_export]")
+{
+	Flags rows[3] = { { true, -3, 0.5 }, { false, 7, 1.5 }, { true, 9, 2.5 } };
+
+	MemoryOutputStream os;
+	ColumnarExporter exporter(&flagsType, os, 2);
+	REQUIRE(exporter.IsValid());
+	REQUIRE(exporter.Write(rows, 3));
+	REQUIRE(exporter.Finish());
+
+	MessageReader reader{ os.GetData(), os.GetData() + os.GetSize() };
+	uint32_t length;
+	MessageReader schema{ reader.Next(length), nullptr };
+	schema.end = schema.cursor + length;
+	CHECK(schema.Read<uint8_t>() == 1);
+	REQUIRE(schema.Read<uint32_t>() == 3);
+	CHECK(schema.Read<uint8_t>() == static_cast<uint8_t>(ColumnKind::kBool));
+	CHECK(schema.Read<uint8_t>() == 1);
+
+	Size expectedRows[2] = { 2, 1 };
+	for (Size batch = 0; batch < 2; ++batch)
+	{
+		MessageReader metadata{ reader.Next(length), nullptr };
+		metadata.end = metadata.cursor + length;
+		CHECK(metadata.Read<uint8_t>() == 2);
+		REQUIRE(metadata.Read<uint64_t>() == expectedRows[batch]);
+		REQUIRE(metadata.Read<uint32_t>() == 3);
+
+		uint64_t buffers[3][2];
+		for (auto& buffer : buffers)
+		{
+			buffer[0] = metadata.Read<uint64_t>();
+			buffer[1] = metadata.Read<uint64_t>();
+			CHECK(buffer[0] % 8 == 0);
+		}
+
+		auto body = reader.cursor;
+		// enabled is true, false in the first batch and true in the second
+		CHECK(body[buffers[0][0]] == 0x01);
+		int16_t level;
+		double ratio;
+		REFL_MEMCPY(&level, body + buffers[1][0], sizeof(level));
+		REFL_MEMCPY(&ratio, body + buffers[2][0] + (expectedRows[batch] - 1) * sizeof(double), sizeof(ratio));
+		CHECK(level == rows[batch * 2].level);
+		CHECK(ratio == rows[batch * 2 + expectedRows[batch] - 1].ratio);
+		reader.cursor = body + buffers[2][0] + buffers[2][1];
+		reader.cursor += (8 - Size(reader.cursor - body) % 8) % 8;
+	}
+
+	CHECK(reader.Read<uint32_t>() == 0xFFFFFFFF);
+	CHECK(reader.Read<uint32_t>() == 0);
+	CHECK(reader.cursor == reader.end);
+}
+
+TEST_CASE("A column exporter whose schema could not be written fails", "[columnar_export]")
+{
+	Flags row = { true, 1, 1.0 };
+	Byte buffer[4];
+	BufferOutputStream os(buffer, sizeof(buffer));
+
+	ColumnarExporter exporter(&flagsType, os);
+	CHECK_FALSE(exporter.IsValid());
+	CHECK_FALSE(exporter.Write(&row, 1));
+	CHECK_FALSE(exporter.Finish());
+}
+
+TEST_CASE("CSV export writes a header and one line per object", "[columnar_export]")
+{
+	Flags rows[2] = { { true, -3, 0.5 }, { false, 7, 1.5 } };
+
+	MemoryOutputStream os;
+	CsvExporter exporter(&flagsType, os);
+	REQUIRE(exporter.WriteHeader());
+	REQUIRE(exporter.Write(rows, 2));
+	REQUIRE(exporter.Flush());
+
+	std::string csv(reinterpret_cast<char const*>(os.GetData()), os.GetSize());
+	CHECK(csv == "enabled,level,ratio\n1,-3,0.5\n0,7,1.5\n");
+}
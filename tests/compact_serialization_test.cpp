@@ -0,0 +1,165 @@
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "compact_serialization.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	struct Packet
+	{
+		int64_t position;
+		uint64_t mask;
+		int32_t tick;
+		uint16_t port;
+		float ratio;
+	};
+
+	Field packetFields[6] = {
+		Field("Packet::position", GetType<int64_t>(), offsetof(Packet, position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Packet::mask", GetType<uint64_t>(), offsetof(Packet, mask), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Packet::tick", GetType<int32_t>(), offsetof(Packet, tick), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDelta),
+		Field("Packet::port", GetType<uint16_t>(), offsetof(Packet, port), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kFixed),
+		Field("Packet::ratio", GetType<float>(), offsetof(Packet, ratio), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+
+	// integers without their own encoding inherit the varint encoding of the type
+	Type const packetType("Packet", sizeof(Packet), TypeSpecifierType::kStruct, packetFields, 5, nullptr, 0, Encoding::kVarint);
+
+	std::vector<Byte> Encode(Packet const& packet, Packet const* baseline = nullptr)
+	{
+		std::vector<Byte> out;
+		REQUIRE(SerializeCompact(&packetType, &packet, out, baseline));
+		return out;
+	}
+
+	Packet Decode(std::vector<Byte> const& data, Packet const* baseline = nullptr)
+	{
+		Packet packet = {};
+		Size consumed = 0;
+		REQUIRE(DeserializeCompact(&packetType, &packet, data.data(), data.size(), baseline, &consumed));
+		CHECK(consumed == data.size());
+		return packet;
+	}
+}
+
+TEST_CASE("Varints round trip at every length boundary", "[compact_serialization]")
+{
+	uint64_t const values[] = { 0, 1, 127, 128, (1ull << 14) - 1, 1ull << 14, (1ull << 56) - 1, 1ull << 56, (1ull << 63) - 1, 1ull << 63, UINT64_MAX };
+	Size const lengths[] = { 1, 1, 1, 2, 2, 3, 8, 9, 9, 10, 10 };
+
+	for (Size i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+	{
+		CAPTURE(values[i]);
+		CHECK(GetVarintLength(values[i]) == lengths[i]);
+
+		// the encoder may write a whole word, decode from both a tight and a padded buffer
+		Byte buffer[kMaxVarintLength + 8] = {};
+		REQUIRE(EncodeVarint(values[i], buffer) == lengths[i]);
+		std::vector<Byte> tight(buffer, buffer + lengths[i]);
+
+		uint64_t value = 0;
+		CHECK(DecodeVarint(tight.data(), tight.data() + tight.size(), value) == lengths[i]);
+		CHECK(value == values[i]);
+		value = 0;
+		CHECK(DecodeVarint(buffer, buffer + sizeof(buffer), value) == lengths[i]);
+		CHECK(value == values[i]);
+
+		// one byte short is truncated
+		CHECK(DecodeVarint(tight.data(), tight.data() + tight.size() - 1, value) == 0);
+	}
+
+	CHECK(ZigZagEncode(0) == 0);
+	CHECK(ZigZagEncode(-1) == 1);
+	CHECK(ZigZagEncode(INT64_MAX) == UINT64_MAX - 1);
+	CHECK(ZigZagEncode(INT64_MIN) == UINT64_MAX);
+	CHECK(ZigZagDecode(UINT64_MAX) == INT64_MIN);
+	CHECK(ZigZagDecode(UINT64_MAX - 1) == INT64_MAX);
+}
+
+TEST_CASE("Compact records round trip the extreme integers", "[compact_serialization]")
+{
+	Packet packet = { INT64_MIN, 1ull << 63, INT32_MIN, 0xffff, 0.5f };
+	auto data = Encode(packet);
+
+	// mask, two 10-byte varints, a 5-byte zigzag varint, fixed port and raw float
+	CHECK(data.size() == 1 + 10 + 10 + 5 + 2 + 4);
+	auto read = Decode(data);
+	CHECK(read.position == INT64_MIN);
+	CHECK(read.mask == 1ull << 63);
+	CHECK(read.tick == INT32_MIN);
+	CHECK(read.port == 0xffff);
+	CHECK(read.ratio == 0.5f);
+
+	packet.position = INT64_MAX;
+	packet.mask = UINT64_MAX;
+	read = Decode(Encode(packet));
+	CHECK(read.position == INT64_MAX);
+	CHECK(read.mask == UINT64_MAX);
+
+	data.pop_back();
+	Packet truncated = {};
+	CHECK_FALSE(DeserializeCompact(&packetType, &truncated, data.data(), data.size()));
+}
+
+TEST_CASE("Compact records only carry the fields present in the bitmask", "[compact_serialization]")
+{
+	Packet packet = {};
+	CHECK(Encode(packet) == std::vector<Byte>{ 0x00 });
+
+	// bits follow the field order, least significant first
+	packet.ratio = 1.0f;
+	auto data = Encode(packet);
+	REQUIRE(data.size() == 1 + sizeof(float));
+	CHECK(data[0] == 0x10);
+
+	packet.mask = 3;
+	packet.port = 80;
+	data = Encode(packet);
+	CHECK(data[0] == 0x1a);
+	CHECK(data.size() == 1 + 1 + 2 + sizeof(float));
+
+	auto read = Decode(data);
+	CHECK(read.position == 0);
+	CHECK(read.mask == 3);
+	CHECK(read.tick == 0);
+	CHECK(read.port == 80);
+	CHECK(read.ratio == 1.0f);
+}
+
+TEST_CASE("Delta fields encode the difference to the baseline", "[compact_serialization]")
+{
+	Packet baseline = { -5, 9, 1000, 80, 2.0f };
+
+	// only the tick differs, by one
+	Packet packet = baseline;
+	packet.tick = 1001;
+	auto data = Encode(packet, &baseline);
+	CHECK(data == std::vector<Byte>{ 0x04, 0x02 });
+	CHECK(Decode(data, &baseline).tick == 1001);
+
+	// the difference wraps at the width of the field
+	baseline.tick = INT32_MAX;
+	packet.tick = INT32_MIN;
+	data = Encode(packet, &baseline);
+	CHECK(data == std::vector<Byte>{ 0x04, 0x02 });
+	auto read = Decode(data, &baseline);
+	CHECK(read.tick == INT32_MIN);
+	CHECK(read.position == -5);
+	CHECK(read.port == 80);
+
+	packet.tick = INT32_MAX - 1;
+	data = Encode(packet, &baseline);
+	CHECK(data == std::vector<Byte>{ 0x04, 0x01 });
+	CHECK(Decode(data, &baseline).tick == INT32_MAX - 1);
+
+	// without a baseline a delta field is a plain zigzag varint
+	Packet plain = {};
+	plain.tick = -2;
+	CHECK(Encode(plain) == std::vector<Byte>{ 0x04, 0x03 });
+}
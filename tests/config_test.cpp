@@ -0,0 +1,186 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	std::string const kSampleConfig =
+		"# sample\n"
+		"flag = 1\n"
+		"id = 7   ; trailing comment\n"
+		"weights = [0.5, 1.5]\n"
+		"[position]\n"
+		"x = 1.0\n"
+		"y = -2\n";
+
+	// every value of the object is the same, so a torn read shows up as a mix
+	std::string MakeUniformConfig(int value)
+	{
+		auto text = std::to_string(value);
+		return "weights = [" + text + ", " + text + ", " + text + "]\n[position]\nx = " + text + "\ny = " + text + "\nz = " + text + "\n";
+	}
+}
+
+TEST_CASE("Config values are parsed into the reflected fields", "[config]")
+{
+	Sample sample = {};
+	sample.position.z = 9.0f;
+	sample.weights[2] = 3.0;
+
+	ConfigLoader loader(sample, "sample.conf");
+	REQUIRE(loader.Apply(kSampleConfig));
+	CHECK(sample.flag == 1);
+	CHECK(sample.id == 7);
+	CHECK(sample.position.x == 1.0f);
+	CHECK(sample.position.y == -2.0f);
+	CHECK(sample.position.z == 9.0f);
+	CHECK(sample.weights[0] == 0.5);
+	CHECK(sample.weights[1] == 1.5);
+	CHECK(sample.weights[2] == 0.0);
+
+	CHECK(loader.ReadValue<int32_t>(FieldPath::Resolve(GetType<Sample>(), "id")) == 7);
+	CHECK(loader.Read<Sample>().position.y == -2.0f);
+}
+
+TEST_CASE("Config files with errors are not applied", "[config]")
+{
+	Sample sample = {};
+	ConfigLoader loader(sample, "sample.conf");
+	REQUIRE(loader.Apply(kSampleConfig));
+
+	CHECK_FALSE(loader.Apply("id = 8\nunknown = 1\n"));
+	CHECK(loader.GetError() == "sample.conf: line 2: unknown key 'unknown'");
+	CHECK_FALSE(loader.Apply("id = 8\nflag = 256\n"));
+	CHECK_FALSE(loader.Apply("id = 8\n[position\n"));
+	CHECK_FALSE(loader.Apply("weights = [1, 2, 3, 4]\n"));
+	CHECK(sample.id == 7);
+	CHECK(sample.weights[0] == 0.5);
+
+	CHECK_FALSE(ConfigLoader(sample, "missing/sample.conf").Load());
+}
+
+TEST_CASE("Config reloads apply and report only the values that changed", "[config]")
+{
+	Sample sample = {};
+	ConfigLoader loader(sample, "sample.conf");
+
+	int positionChanges = 0;
+	int idChanges = 0;
+	int xChanges = 0;
+	REQUIRE(loader.OnChange("position", [&](FieldPath const&) { ++positionChanges; }));
+	REQUIRE(loader.OnChange("id", [&](FieldPath const&) { ++idChanges; }));
+	REQUIRE(loader.OnChange("position.x", [&](FieldPath const&) { ++xChanges; }));
+	CHECK_FALSE(loader.OnChange("position.w", [](FieldPath const&) {}));
+
+	// two changed fields inside position fire its callback once
+	REQUIRE(loader.Apply(kSampleConfig));
+	CHECK(positionChanges == 1);
+	CHECK(idChanges == 1);
+	CHECK(xChanges == 1);
+
+	// the same file again changes nothing
+	REQUIRE(loader.Apply(kSampleConfig));
+	CHECK(positionChanges == 1);
+	CHECK(idChanges == 1);
+
+	// only y differs, keys missing from the file keep their value
+	REQUIRE(loader.Apply("[position]\nx = 1.0\ny = 5\n"));
+	CHECK(positionChanges == 2);
+	CHECK(idChanges == 1);
+	CHECK(xChanges == 1);
+	CHECK(sample.id == 7);
+	CHECK(sample.position.y == 5.0f);
+
+	// a callback may reload
+	bool reloaded = false;
+	REQUIRE(loader.OnChange("flag", [&](FieldPath const&) { reloaded = loader.Apply("id = 11\n"); }));
+	REQUIRE(loader.Apply("flag = 0\n"));
+	CHECK(reloaded);
+	CHECK(sample.id == 11);
+	CHECK(idChanges == 2);
+}
+
+TEST_CASE("Config readers never see a reload half applied", "[config]")
+{
+	Sample sample = {};
+	ConfigLoader loader(sample, "sample.conf");
+	REQUIRE(loader.Apply(MakeUniformConfig(0)));
+
+	std::atomic<bool> stop(false);
+	std::atomic<Size> torn(0);
+	std::atomic<Size> reads(0);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; ++i)
+	{
+		readers.emplace_back([&]
+		{
+			while (!stop.load())
+			{
+				auto copy = loader.Read<Sample>();
+				double value = copy.weights[0];
+				bool whole = copy.weights[1] == value && copy.weights[2] == value &&
+					copy.position.x == value && copy.position.y == value && copy.position.z == value;
+				torn += whole ? 0 : 1;
+				reads++;
+			}
+		});
+	}
+
+	for (int i = 1; i <= 2000; ++i)
+	{
+		REQUIRE(loader.Apply(MakeUniformConfig(i)));
+	}
+
+	stop = true;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+	CHECK(reads > 0);
+	CHECK(torn == 0);
+	CHECK(sample.position.z == 2000.0f);
+}
+
+#if defined(__linux__)
+TEST_CASE("Config watcher reloads a rewritten file", "[config]")
+{
+	char const* fileName = "config_test_watched.conf";
+	{
+		std::ofstream file(fileName);
+		file << "id = 1\n";
+	}
+
+	Sample sample = {};
+	ConfigLoader loader(sample, fileName);
+	REQUIRE(loader.Load());
+
+	std::atomic<int> changes(0);
+	REQUIRE(loader.OnChange("id", [&](FieldPath const&) { ++changes; }));
+	ConfigWatcher watcher(loader);
+	REQUIRE(watcher.IsWatching());
+
+	{
+		std::ofstream file(fileName);
+		file << "id = 2\n";
+	}
+
+	for (int i = 0; i < 500 && changes.load() == 0; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	CHECK(changes.load() == 1);
+	CHECK(loader.ReadValue<int32_t>(FieldPath::Resolve(GetType<Sample>(), "id")) == 2);
+	std::remove(fileName);
+}
+#endif
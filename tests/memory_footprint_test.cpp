@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "memory_footprint.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	TypeFootprint const* FindFootprint(FootprintReport const& report, Type const* type)
+	{
+		for (auto& entry : report.GetTypes())
+		{
+			if (entry.type == type)
+			{
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+}
+
+TEST_CASE("Deep size counts every reachable object once", "[memory_footprint]")
+{
+	// a ring of three nodes
+	Node nodes[3];
+	for (int32_t i = 0; i < 3; ++i)
+	{
+		nodes[i].value = i;
+		nodes[i].next = &nodes[(i + 1) % 3];
+	}
+
+	FootprintReport report;
+	CHECK(DeepSize(nodes[0], &report) == 3 * sizeof(Node));
+	auto node = FindFootprint(report, GetType<Node>());
+	REQUIRE(node != nullptr);
+	CHECK(node->instances == 3);
+	CHECK(node->heap_bytes == 2 * sizeof(Node));
+
+	// holders sharing a node and a vector
+	Vec3 vec = { 1.0f, 2.0f, 3.0f };
+	Holder holders[2] = { { &nodes[0], &vec, 1 }, { &nodes[0], &vec, 2 } };
+	report = FootprintReport();
+	CHECK(DeepSize(holders, 2, &report) == 2 * sizeof(Holder) + 3 * sizeof(Node) + sizeof(Vec3));
+	auto holder = FindFootprint(report, GetType<Holder>());
+	REQUIRE(holder != nullptr);
+	CHECK(holder->instances == 2);
+	CHECK(holder->heap_bytes == sizeof(Node) + sizeof(Vec3));
+}
+
+TEST_CASE("Deep size counts padding from the layout of each type", "[memory_footprint]")
+{
+	CHECK(GetPaddingSize(GetType<Vec3>()) == 0);
+	CHECK(GetPaddingSize(GetType<Sample>()) == 7);
+
+	Sample samples[4] = {};
+	FootprintReport report;
+	CHECK(DeepSize(samples, 4, &report) == 4 * sizeof(Sample));
+	CHECK(report.GetTotal().padding_bytes == 4 * 7);
+}
+
+TEST_CASE("Parallel deep size matches the sequential walk", "[memory_footprint]")
+{
+	std::vector<Node> shared(16);
+	std::vector<Holder> holders(1000);
+	for (Size i = 0; i < holders.size(); ++i)
+	{
+		holders[i].node = &shared[i % shared.size()];
+	}
+
+	FootprintReport sequential;
+	Size expected = DeepSize(holders.data(), holders.size(), &sequential);
+	CHECK(expected == holders.size() * sizeof(Holder) + shared.size() * sizeof(Node));
+
+	ThreadPool pool(4);
+	FootprintReport parallel;
+	CHECK(DeepSizeParallel(pool, GetType<Holder>(), holders.data(), holders.size(), &parallel, 16) == expected);
+	CHECK(FindFootprint(parallel, GetType<Node>())->instances == shared.size());
+	CHECK(parallel.GetTotal().heap_bytes == sequential.GetTotal().heap_bytes);
+}
+
+TEST_CASE("Footprint reports write fingerprints as hex strings", "[memory_footprint]")
+{
+	Vec3 vec = {};
+	FootprintReport report;
+	DeepSize(vec, &report);
+
+	std::ostringstream os;
+	report.WriteJson(os);
+
+	char fingerprint[17];
+	std::snprintf(fingerprint, sizeof(fingerprint), "%016llx", static_cast<unsigned long long>(GetType<Vec3>()->GetFingerprint()));
+	std::string expected = std::string("{\"total\":{\"instances\":1,\"shallow_bytes\":12,\"heap_bytes\":0,\"padding_bytes\":0,\"side_bytes\":0},") +
+		"\"types\":[{\"name\":\"Vec3\",\"fingerprint\":\"" + fingerprint + "\",\"instances\":1,\"shallow_bytes\":12,\"heap_bytes\":0,\"padding_bytes\":0,\"side_bytes\":0}]}\n";
+	CHECK(os.str() == expected);
+}
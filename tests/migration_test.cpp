@@ -0,0 +1,162 @@
+#include <catch2/catch.hpp>
+
+#include <dlfcn.h>
+
+#include "migration.hpp"
+#include "split_storage.hpp"
+#include "test_types.hpp"
+#include "type_registry.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	typedef void (*AttachParticleModuleFunction)(TypeRegistry* registry);
+	typedef Type const* (*GetParticleTypeFunction)();
+	typedef void (*InitParticlesFunction)(void* storage, Size count);
+
+	// one loaded version of the particle plugin
+	class Plugin
+	{
+	private:
+		void* handle;
+
+	public:
+		explicit Plugin(char const* path) : handle(dlopen(path, RTLD_NOW | RTLD_LOCAL))
+		{
+			if (handle != nullptr)
+			{
+				Find<AttachParticleModuleFunction>("AttachParticleModule")(&GetTypeRegistry());
+			}
+		}
+		Plugin(Plugin const&) = delete;
+		Plugin& operator=(Plugin const&) = delete;
+		~Plugin() { Unload(); }
+
+		void Unload()
+		{
+			if (handle != nullptr)
+			{
+				dlclose(handle);
+				handle = nullptr;
+			}
+		}
+
+		bool IsLoaded() const noexcept { return handle != nullptr; }
+
+		template<typename T>
+		T Find(char const* name) const { return reinterpret_cast<T>(dlsym(handle, name)); }
+
+		Type const* GetParticleType() const { return Find<GetParticleTypeFunction>("GetParticleType")(); }
+	};
+
+	template<typename T>
+	T GetValue(Type const* type, void* particles, Size index, char const* name)
+	{
+		return type->GetField(name)->GetValue<T>(static_cast<BytePointer>(particles) + index * type->GetSize());
+	}
+
+	void* GetTarget(Type const* type, void* particles, Size index)
+	{
+		return GetValue<void*>(type, particles, index, "target");
+	}
+}
+
+TEST_CASE("Live objects follow a plugin reloaded with another layout and back", "[migration]")
+{
+	constexpr Size kCount = 5;
+	auto& registry = GetTypeRegistry();
+
+	Plugin v1(PARTICLE_V1_PATH);
+	REQUIRE(v1.IsLoaded());
+	Type const* oldType = v1.GetParticleType();
+	CHECK(registry.Find("Particle") == oldType);
+
+	void* particles = ::operator new(kCount * oldType->GetSize());
+	v1.Find<InitParticlesFunction>("InitParticles")(particles, kCount);
+	void* selected = static_cast<BytePointer>(particles) + 3 * oldType->GetSize();
+
+	// first reload: reordered fields, id and mass widened, charge added
+	{
+		Plugin v2(PARTICLE_V2_PATH);
+		REQUIRE(v2.IsLoaded());
+		Type const* newType = v2.GetParticleType();
+		REQUIRE(newType != oldType);
+		CHECK(newType->GetSize() != oldType->GetSize());
+
+		LayoutMigration migration(oldType, newType);
+		REQUIRE(migration.IsMigratable());
+		migration.AddPool(&particles, kCount);
+		migration.AddReference(&selected);
+		auto result = migration.Run();
+		CHECK(result.objects == kCount);
+		CHECK(result.patched_references == 1);
+		CHECK(result.unresolved_references == 0);
+
+		v1.Unload();
+		CHECK(registry.Find("Particle") == newType);
+
+		for (Size i = 0; i < kCount; ++i)
+		{
+			CHECK(GetValue<int64_t>(newType, particles, i, "id") == static_cast<int64_t>(i) - 2);
+			CHECK(GetValue<double>(newType, particles, i, "mass") == 0.5 * i);
+			CHECK(GetValue<float>(newType, particles, i, "charge") == 0.0f);
+			CHECK(newType->GetField("position")->GetRef<float[3]>(static_cast<BytePointer>(particles) + i * newType->GetSize())[0] == static_cast<float>(i));
+			CHECK(GetTarget(newType, particles, i) == static_cast<BytePointer>(particles) + (i + 1) % kCount * newType->GetSize());
+		}
+		CHECK(selected == static_cast<BytePointer>(particles) + 3 * newType->GetSize());
+
+		// second reload: back to the first layout from a fresh dlopen
+		Plugin reloaded(PARTICLE_V1_PATH);
+		REQUIRE(reloaded.IsLoaded());
+		oldType = reloaded.GetParticleType();
+
+		LayoutMigration back(newType, oldType);
+		REQUIRE(back.IsMigratable());
+		back.AddPool(&particles, kCount);
+		back.AddReference(&selected);
+		result = back.Run();
+		CHECK(result.objects == kCount);
+		CHECK(result.patched_references == 1);
+
+		v2.Unload();
+		CHECK(registry.Find("Particle") == oldType);
+
+		for (Size i = 0; i < kCount; ++i)
+		{
+			CHECK(GetValue<int32_t>(oldType, particles, i, "id") == static_cast<int32_t>(i) - 2);
+			CHECK(GetValue<float>(oldType, particles, i, "mass") == 0.5f * i);
+			CHECK(GetTarget(oldType, particles, i) == static_cast<BytePointer>(particles) + (i + 1) % kCount * oldType->GetSize());
+		}
+		CHECK(selected == static_cast<BytePointer>(particles) + 3 * oldType->GetSize());
+
+		::operator delete(particles);
+	}
+}
+
+TEST_CASE("Migration refuses split types", "[migration]")
+{
+	auto plan = BuildMigrationPlan(GetType<Entity>(), GetType<SplitStorage<Entity>>());
+	CHECK_FALSE(plan.migratable);
+	CHECK(plan.runs.empty());
+	CHECK(plan.conversions.empty());
+
+	Entity plain = {};
+	plain.id = 4;
+	SplitArray<Entity> entities(&plain, 1);
+	void* storage = entities.GetData();
+	LayoutMigration migration(GetType<SplitStorage<Entity>>(), GetType<Entity>());
+	CHECK_FALSE(migration.IsMigratable());
+	migration.AddObject(&storage);
+	auto result = migration.Run();
+	CHECK(result.objects == 0);
+	CHECK(storage == entities.GetData());
+}
+
+TEST_CASE("Migration copies types with the same layout in one run", "[migration]")
+{
+	auto plan = BuildMigrationPlan(GetType<Sample>(), GetType<Sample>());
+	REQUIRE(plan.migratable);
+	REQUIRE(plan.runs.size() == 1);
+	CHECK(plan.runs[0].size == sizeof(Sample));
+}
@@ -0,0 +1,99 @@
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "object_graph.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// the bodies follow the type table and the object type table, in object order
+	Size GetBodiesOffset(Size typesLength, Size objectsLength)
+	{
+		return sizeof(uint32_t) * 2 + typesLength * (sizeof(Fingerprint) + sizeof(uint32_t)) + sizeof(uint32_t) + objectsLength * sizeof(uint32_t);
+	}
+}
+
+TEST_CASE("Object graph round trips shared and cyclic pointers", "[object_graph]")
+{
+	Node a{ 1, nullptr };
+	Node b{ 2, &a };
+	a.next = &b;
+	Vec3 vec{ 1.0f, 2.0f, 3.0f };
+	Holder holder{ &a, &vec, 7 };
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeGraph(holder, os));
+
+	ObjectGraph graph;
+	auto loaded = LoadGraph<Holder>(graph, os.GetData(), os.GetSize());
+	REQUIRE(loaded != nullptr);
+	CHECK(graph.GetObjectsLength() == 4);
+	CHECK(loaded->tag == 7);
+	REQUIRE(loaded->node != nullptr);
+	CHECK(loaded->node->value == 1);
+	CHECK(loaded->node->next->value == 2);
+	CHECK(loaded->node->next->next == loaded->node);
+	CHECK(loaded->vec->z == 3.0f);
+}
+
+TEST_CASE("Object graph rejects pointer ids of another type", "[object_graph]")
+{
+	Node node{ 5, nullptr };
+	Vec3 vec{ 1.0f, 2.0f, 3.0f };
+	Holder holder{ &node, &vec, 7 };
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeGraph(holder, os));
+	std::vector<Byte> blob(os.GetData(), os.GetData() + os.GetSize());
+
+	// objects are Holder, Node, Vec3; the Holder body starts with the ids of node and vec
+	Size body = GetBodiesOffset(3, 3);
+	ObjectId ids[2];
+	REFL_MEMCPY(ids, blob.data() + body, sizeof(ids));
+	REQUIRE(ids[0] == 2);
+	REQUIRE(ids[1] == 3);
+
+	std::swap(ids[0], ids[1]);
+	REFL_MEMCPY(blob.data() + body, ids, sizeof(ids));
+
+	ObjectGraph graph;
+	CHECK(LoadGraph<Holder>(graph, blob.data(), blob.size()) == nullptr);
+	CHECK(graph.GetObjectsLength() == 0);
+
+	ObjectId outOfRange = 4;
+	REFL_MEMCPY(blob.data() + body, &outOfRange, sizeof(outOfRange));
+	CHECK(LoadGraph<Holder>(graph, blob.data(), blob.size()) == nullptr);
+}
+
+TEST_CASE("Object graph rejects a root of another type", "[object_graph]")
+{
+	Vec3 vec{ 0.0f, 0.0f, 0.0f };
+	Holder holder{ nullptr, &vec, 0 };
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeGraph(holder, os));
+	std::vector<Byte> blob(os.GetData(), os.GetData() + os.GetSize());
+
+	// objects are Holder and Vec3, whose bodies have the same size; swapping their type indices
+	// would make the Vec3 the root
+	Size table = GetBodiesOffset(2, 2) - 2 * sizeof(uint32_t);
+	uint32_t typeIndices[2];
+	REFL_MEMCPY(typeIndices, blob.data() + table, sizeof(typeIndices));
+	REQUIRE(typeIndices[0] == 0);
+	REQUIRE(typeIndices[1] == 1);
+
+	std::swap(typeIndices[0], typeIndices[1]);
+	REFL_MEMCPY(blob.data() + table, typeIndices, sizeof(typeIndices));
+
+	ObjectGraph graph;
+	CHECK(LoadGraph<Holder>(graph, blob.data(), blob.size()) == nullptr);
+	CHECK(graph.GetRoot() == nullptr);
+
+	// a graph of another root type is rejected as a whole
+	os.Clear();
+	REQUIRE(SerializeGraph(vec, os));
+	CHECK(LoadGraph<Holder>(graph, os.GetData(), os.GetSize()) == nullptr);
+}
@@ -0,0 +1,154 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+
+#include "object_ops.hpp"
+#include "split_storage.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	typedef SplitStorage<Entity> SplitEntity;
+
+	template<typename T>
+	void CopyFieldTable(Field* fields)
+	{
+		for (Size i = 0; i < GetType<T>()->GetFieldsLength(); ++i)
+		{
+			fields[i] = *GetType<T>()->GetField(i);
+		}
+	}
+
+	// the generated reflection of SplitStorage<Entity> carries no traits, this one is reflected as
+	// what the struct is: trivially copyable
+	Type const* GetTriviallyCopyableSplitEntityType()
+	{
+		static Field fields[6];
+		CopyFieldTable<SplitEntity>(fields);
+		static Type type("SplitStorage<Entity>", sizeof(SplitEntity), TypeSpecifierType::kStruct, fields, 5, nullptr, 0, Encoding::kDefault, nullptr, nullptr, AnnotationFlags::kNone, nullptr, GetTypeTraitsOf<SplitEntity>());
+		return &type;
+	}
+
+	// Sample reflected without traits, so every operation goes through the per-type plan
+	Type const* GetPlannedSampleType()
+	{
+		static Field fields[5];
+		CopyFieldTable<Sample>(fields);
+		static Type type("Sample", sizeof(Sample), TypeSpecifierType::kStruct, fields, 4, nullptr, 0);
+		return &type;
+	}
+
+	SplitEntity MakeSplitEntity(SplitEntity::Cold* cold, int32_t id)
+	{
+		SplitEntity entity = {};
+		entity.position = Vec3{ 1.0f, 2.0f, 3.0f };
+		entity.id = id;
+		entity.cold = cold;
+		cold->created = id * 0.5;
+		std::strcpy(cold->name, "entity");
+		return entity;
+	}
+}
+
+TEST_CASE("Split objects are copied and swapped into their own side allocations", "[object_ops]")
+{
+	// the generated reflection and one that carries the traits of the struct behave alike
+	auto type = GENERATE(GetType<SplitEntity>(), GetTriviallyCopyableSplitEntityType());
+
+	SplitEntity::Cold sourceCold = {};
+	SplitEntity::Cold targetCold = {};
+	auto source = MakeSplitEntity(&sourceCold, 1);
+	auto target = MakeSplitEntity(&targetCold, 2);
+	std::strcpy(sourceCold.name, "source");
+
+	REQUIRE(CopyObject(type, &target, &source));
+	CHECK(target.id == 1);
+	CHECK(target.cold == &targetCold);
+	CHECK(targetCold.created == 0.5);
+	CHECK(std::strcmp(targetCold.name, "source") == 0);
+
+	// the copies are independent
+	sourceCold.created = 7.0;
+	CHECK(targetCold.created == 0.5);
+
+	target.id = 2;
+	targetCold.created = 1.0;
+	REQUIRE(SwapObjects(type, &target, &source));
+	CHECK(source.id == 2);
+	CHECK(source.cold == &sourceCold);
+	CHECK(sourceCold.created == 1.0);
+	CHECK(target.id == 1);
+	CHECK(targetCold.created == 7.0);
+}
+
+TEST_CASE("Split objects without a side allocation are not copied", "[object_ops]")
+{
+	SplitEntity::Cold sourceCold = {};
+	auto source = MakeSplitEntity(&sourceCold, 1);
+	SplitEntity target = {};
+	target.id = 2;
+
+	CHECK_FALSE(CopyObject(target, source));
+	CHECK_FALSE(SwapObjects(target, source));
+	CHECK(target.id == 2);
+	CHECK(target.cold == nullptr);
+}
+
+TEST_CASE("Split objects compare and hash their cold fields", "[object_ops]")
+{
+	auto type = GENERATE(GetType<SplitEntity>(), GetTriviallyCopyableSplitEntityType());
+
+	SplitEntity::Cold aCold = {};
+	SplitEntity::Cold bCold = {};
+	auto a = MakeSplitEntity(&aCold, 1);
+	auto b = MakeSplitEntity(&bCold, 1);
+
+	CHECK(EqualObjects(type, &a, &b));
+	CHECK(HashObject(type, &a) == HashObject(type, &b));
+
+	bCold.created = 2.0;
+	CHECK_FALSE(EqualObjects(type, &a, &b));
+	CHECK(HashObject(type, &a) != HashObject(type, &b));
+
+	b.cold = nullptr;
+	CHECK_FALSE(EqualObjects(type, &a, &b));
+	a.cold = nullptr;
+	CHECK(EqualObjects(type, &a, &b));
+}
+
+TEST_CASE("Planned and bytewise object operations agree", "[object_ops]")
+{
+	auto planned = GetPlannedSampleType();
+	REQUIRE_FALSE(planned->IsTriviallyCopyable());
+	REQUIRE(GetObjectPlan(planned).IsCopyable());
+
+	Sample source;
+	std::memset(&source, 0xAB, sizeof(source));
+	source.flag = 1;
+	source.id = 42;
+	source.position = Vec3{ 1.0f, -0.0f, 3.0f };
+	source.weights[0] = 0.25;
+	source.weights[1] = 0.0;
+	source.weights[2] = -4.0;
+
+	Sample bytewise;
+	Sample fieldwise;
+	std::memset(&fieldwise, 0, sizeof(fieldwise));
+	REQUIRE(CopyObject(bytewise, source));
+	REQUIRE(CopyObject(planned, &fieldwise, &source));
+
+	// padding is not copied by the plan, so only the fields compare equal
+	CHECK(std::memcmp(&bytewise, &source, sizeof(source)) == 0);
+	CHECK(EqualObjects(fieldwise, source));
+	CHECK(EqualObjects(planned, &fieldwise, &bytewise));
+
+	fieldwise.position.y = 0.0f;
+	CHECK(EqualObjects(fieldwise, source));
+	CHECK(HashObject(fieldwise) == HashObject(source));
+	CHECK(HashObject(planned, &fieldwise) == HashObject(GetType<Sample>(), &source));
+
+	fieldwise.id = 43;
+	CHECK_FALSE(EqualObjects(fieldwise, source));
+}
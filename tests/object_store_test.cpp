@@ -0,0 +1,126 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+
+#include "object_store.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// two versions of struct Pair { int32_t a, b; } with the same schema, the second one stores
+	// b first
+	Field pairFields[3] = {
+		Field("Pair::a", GetType<int32_t>(), 0, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Pair::b", GetType<int32_t>(), 4, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Field swappedPairFields[3] = {
+		Field("Pair::a", GetType<int32_t>(), 4, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Pair::b", GetType<int32_t>(), 0, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Type pairType("Pair", 8, TypeSpecifierType::kStruct, pairFields, 2, nullptr, 0, Encoding::kDefault, nullptr, nullptr, AnnotationFlags::kNone, nullptr, GetTypeTraitsOf<int32_t[2]>());
+	Type swappedPairType("Pair", 8, TypeSpecifierType::kStruct, swappedPairFields, 2, nullptr, 0, Encoding::kDefault, nullptr, nullptr, AnnotationFlags::kNone, nullptr, GetTypeTraitsOf<int32_t[2]>());
+
+	// struct Outer { int32_t tag; Pair pair; } holding either version of Pair
+	Field outerFields[3] = {
+		Field("Outer::tag", GetType<int32_t>(), 0, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Outer::pair", &pairType, 4, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Field swappedOuterFields[3] = {
+		Field("Outer::tag", GetType<int32_t>(), 0, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field("Outer::pair", &swappedPairType, 4, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Type outerType("Outer", 12, TypeSpecifierType::kStruct, outerFields, 2, nullptr, 0, Encoding::kDefault, nullptr, nullptr, AnnotationFlags::kNone, nullptr, GetTypeTraitsOf<int32_t[3]>());
+	Type swappedOuterType("Outer", 12, TypeSpecifierType::kStruct, swappedOuterFields, 2, nullptr, 0, Encoding::kDefault, nullptr, nullptr, AnnotationFlags::kNone, nullptr, GetTypeTraitsOf<int32_t[3]>());
+
+	struct TempFile
+	{
+		char const* path;
+		explicit TempFile(char const* _path) : path(_path) { std::remove(path); }
+		~TempFile() { std::remove(path); }
+	};
+}
+
+TEST_CASE("Object store maps files of the same layout in place", "[object_store]")
+{
+	TempFile file("object_store_same.bin");
+	Sample samples[3] = {};
+	for (int i = 0; i < 3; ++i)
+	{
+		samples[i].id = i * 10;
+		samples[i].position.y = static_cast<float>(i);
+		samples[i].weights[2] = i * 0.5;
+	}
+
+	ObjectStoreWriter writer;
+	REQUIRE(writer.Open(file.path, GetType<Sample>()));
+	REQUIRE(writer.Append(samples, 3));
+	writer.Close();
+
+	ObjectStoreReader reader;
+	REQUIRE(reader.Open(file.path, GetType<Sample>()));
+	CHECK(reader.IsZeroCopy());
+	REQUIRE(reader.GetCount() == 3);
+	CHECK(reader.GetArray<Sample>()[2].id == 20);
+	CHECK(reader.GetArray<Sample>()[2].position.y == 2.0f);
+	CHECK(reader.GetArray<Sample>()[2].weights[2] == 1.0);
+}
+
+TEST_CASE("Layout fingerprints tell apart types that differ only in offsets", "[object_store]")
+{
+	REQUIRE(pairType.GetFingerprint() == swappedPairType.GetFingerprint());
+	CHECK(GetLayoutFingerprint(&pairType) != GetLayoutFingerprint(&swappedPairType));
+	CHECK(GetLayoutFingerprint(GetType<Sample>()) == GetLayoutFingerprint(GetType<Sample>()));
+}
+
+TEST_CASE("Object store converts files whose offsets changed", "[object_store]")
+{
+	TempFile file("object_store_offsets.bin");
+	int32_t pairs[2][2] = { { 1, 2 }, { 3, 4 } };
+
+	ObjectStoreWriter writer;
+	REQUIRE(writer.Open(file.path, &pairType));
+	REQUIRE(writer.Append(pairs, 2));
+	writer.Close();
+
+	// appending with another layout must not mix the two
+	CHECK_FALSE(writer.Open(file.path, &swappedPairType));
+
+	ObjectStoreReader reader;
+	REQUIRE(reader.Open(file.path, &swappedPairType));
+	CHECK_FALSE(reader.IsZeroCopy());
+	REQUIRE(reader.GetCount() == 2);
+	auto converted = static_cast<int32_t const*>(reader.GetData());
+	CHECK(converted[0] == 2);
+	CHECK(converted[1] == 1);
+	CHECK(converted[2] == 4);
+	CHECK(converted[3] == 3);
+}
+
+TEST_CASE("Object store converts nested records whose offsets changed", "[object_store]")
+{
+	TempFile file("object_store_nested.bin");
+	int32_t outers[2][3] = { { 7, 1, 2 }, { 8, 3, 4 } };
+
+	ObjectStoreWriter writer;
+	REQUIRE(writer.Open(file.path, &outerType));
+	REQUIRE(writer.Append(outers, 2));
+	writer.Close();
+
+	ObjectStoreReader reader;
+	REQUIRE(reader.Open(file.path, &swappedOuterType));
+	CHECK_FALSE(reader.IsZeroCopy());
+	REQUIRE(reader.GetCount() == 2);
+	auto converted = static_cast<int32_t const*>(reader.GetData());
+	CHECK(converted[0] == 7);
+	CHECK(converted[1] == 2);
+	CHECK(converted[2] == 1);
+	CHECK(converted[3] == 8);
+	CHECK(converted[4] == 4);
+	CHECK(converted[5] == 3);
+}
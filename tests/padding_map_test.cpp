@@ -0,0 +1,117 @@
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "memory_footprint.hpp"
+#include "split_storage.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// marks the bytes of an object at offset that a field, or a field of a nested record, covers
+	void MarkCovered(Type const* type, Offset offset, std::vector<bool>& covered)
+	{
+		if (type->IsArray())
+		{
+			for (Size i = 0; i < type->GetArrayLength(); ++i)
+			{
+				MarkCovered(type->GetRawType(), offset + i * type->GetRawType()->GetSize(), covered);
+			}
+			return;
+		}
+
+		if (type->IsBuiltin() || type->IsPointer() || type->GetFieldsLength() == 0)
+		{
+			for (Size i = 0; i < type->GetSize(); ++i)
+			{
+				covered[offset + i] = true;
+			}
+			return;
+		}
+
+		for (Size i = 0; i < type->GetFieldsLength(); ++i)
+		{
+			auto field = type->GetField(i);
+			if (!field->IsStatic() && !field->IsIndirect())
+			{
+				MarkCovered(field->GetType(), offset + field->GetOffset(), covered);
+			}
+		}
+	}
+
+	// the holes of the layout as the fields describe it
+	std::vector<PaddingHole> FindHoles(Type const* type)
+	{
+		std::vector<bool> covered(type->GetSize(), false);
+		MarkCovered(type, 0, covered);
+
+		std::vector<PaddingHole> holes;
+		for (Size i = 0; i < covered.size(); ++i)
+		{
+			if (covered[i])
+			{
+				continue;
+			}
+			if (!holes.empty() && holes.back().offset + holes.back().size == i)
+			{
+				holes.back().size++;
+			}
+			else
+			{
+				holes.push_back(PaddingHole{ i, 1 });
+			}
+		}
+		return holes;
+	}
+}
+
+TEST_CASE("Padding maps list the holes the fields leave", "[padding_map]")
+{
+	auto sample = GetType<Sample>()->GetPaddingMap();
+	REQUIRE(sample != nullptr);
+	REQUIRE(sample->holes_length == 2);
+	CHECK(sample->holes[0].offset == 1);
+	CHECK(sample->holes[0].size == 3);
+	CHECK(sample->holes[1].offset == 20);
+	CHECK(sample->holes[1].size == 4);
+	CHECK(sample->padding_size == 7);
+
+	auto vec = GetType<Vec3>()->GetPaddingMap();
+	REQUIRE(vec != nullptr);
+	CHECK(vec->holes_length == 0);
+	CHECK(vec->padding_size == 0);
+
+	for (auto type : { GetType<Vec3>(), GetType<Sample>(), GetType<Node>(), GetType<Holder>(), GetType<Entity>() })
+	{
+		CAPTURE(type->GetName());
+		auto map = type->GetPaddingMap();
+		REQUIRE(map != nullptr);
+
+		auto holes = FindHoles(type);
+		REQUIRE(map->holes_length == holes.size());
+		Size padding = 0;
+		for (Size i = 0; i < holes.size(); ++i)
+		{
+			CHECK(map->holes[i].offset == holes[i].offset);
+			CHECK(map->holes[i].size == holes[i].size);
+			padding += holes[i].size;
+		}
+		CHECK(map->padding_size == padding);
+		CHECK(GetPaddingSize(type) == padding);
+	}
+}
+
+TEST_CASE("Types without a padding map estimate the padding from their fields", "[padding_map]")
+{
+	static Field fields[5];
+	for (Size i = 0; i < 4; ++i)
+	{
+		fields[i] = *GetType<Sample>()->GetField(i);
+	}
+	static Type type("Sample", sizeof(Sample), TypeSpecifierType::kStruct, fields, 4, nullptr, 0);
+
+	CHECK(type.GetPaddingMap() == nullptr);
+	CHECK(GetPaddingSize(&type) == GetType<Sample>()->GetPaddingMap()->padding_size);
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "parallel_serialization.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	std::vector<Sample> MakeSamples(Size count)
+	{
+		std::vector<Sample> samples(count);
+		for (Size i = 0; i < count; ++i)
+		{
+			// every third sample is left at zero so compact records vary in size
+			if (i % 3 != 0)
+			{
+				samples[i].flag = static_cast<uint8_t>(i);
+				samples[i].id = static_cast<int32_t>(i * 7919);
+				samples[i].position = Vec3{ 0.5f * i, -1.0f, 2.0f };
+				samples[i].weights[i % 3] = 1.0 / i;
+			}
+		}
+		return samples;
+	}
+}
+
+TEST_CASE("Parallel serialization matches the serial output", "[parallel_serialization]")
+{
+	auto samples = MakeSamples(1001);
+
+	std::vector<Byte> binary;
+	MemoryOutputStream os;
+	for (auto& sample : samples)
+	{
+		REQUIRE(Serialize(sample, os));
+	}
+	binary.assign(os.GetData(), os.GetData() + os.GetSize());
+
+	std::vector<Byte> compact;
+	for (auto& sample : samples)
+	{
+		REQUIRE(SerializeCompact(sample, compact));
+	}
+
+	for (Size threads : { 1, 2, 4 })
+	{
+		ThreadPool pool(threads);
+		for (Size chunkLength : { 0, 1, 7, 2000 })
+		{
+			// out keeps what it held before
+			std::vector<Byte> out(3, 0xab);
+			REQUIRE(SerializeArrayParallel(pool, samples.data(), samples.size(), out, WireFormat::kBinary, chunkLength));
+			REQUIRE(out.size() == 3 + binary.size());
+			CHECK(std::equal(binary.begin(), binary.end(), out.begin() + 3));
+			CHECK(out[2] == 0xab);
+
+			out.assign(3, 0xab);
+			REQUIRE(SerializeArrayParallel(pool, samples.data(), samples.size(), out, WireFormat::kCompact, chunkLength));
+			REQUIRE(out.size() == 3 + compact.size());
+			CHECK(std::equal(compact.begin(), compact.end(), out.begin() + 3));
+		}
+	}
+}
+
+TEST_CASE("Parallel serialization of nothing leaves the output alone", "[parallel_serialization]")
+{
+	ThreadPool pool(2);
+	std::vector<Byte> out(5, 1);
+	CHECK(SerializeArrayParallel(pool, static_cast<Sample const*>(nullptr), 0, out));
+	CHECK(SerializeArrayParallel(pool, static_cast<Sample const*>(nullptr), 0, out, WireFormat::kCompact));
+	CHECK(out == std::vector<Byte>(5, 1));
+}
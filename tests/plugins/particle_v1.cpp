@@ -0,0 +1,73 @@
+// first version of a plugin type, reloaded as particle_v2 by migration_test.cpp
+#include "type_registry.hpp"
+
+STRUCT(Particle)
+{
+	FIELD() float position[3];
+	FIELD() float mass;
+	FIELD() int32_t id;
+	FIELD() Particle* target;
+};
+
+// reflection in the form meta_gen emits it
+namespace Reflection
+{
+	DECLARE_TYPE(float[3]);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Particle>) noexcept;
+
+	DECLARE_TYPE(Particle*);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Particle>) noexcept
+	{
+		static TypeStorage<Particle, 4, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<float[3]>();
+			typeStorage.fields[0] = Reflection::Field("Particle::position", &field_0_Type, offsetof(Particle, Particle::position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<float>();
+			typeStorage.fields[1] = Reflection::Field("Particle::mass", &field_1_Type, offsetof(Particle, Particle::mass), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_2_Type = *GetType<int32_t>();
+			typeStorage.fields[2] = Reflection::Field("Particle::id", &field_2_Type, offsetof(Particle, Particle::id), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_3_Type = *GetType<Particle*>();
+			typeStorage.fields[3] = Reflection::Field("Particle::target", &field_3_Type, offsetof(Particle, Particle::target), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingMap const paddingMap = { nullptr, 0, 0 };
+		static Type type("Particle", sizeof(Particle), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout);
+		return &type;
+	};
+
+	constexpr TypeGetter particle_v1_gen_refl_types[] = { &GetType<Particle> };
+}
+
+// built with hidden visibility, so that the Particle of each version stays its own; the host
+// passes its registry in, unloading the plugin unregisters the module
+static std::unique_ptr<Reflection::ModuleRegistration> registration;
+
+extern "C" __attribute__((visibility("default"))) void AttachParticleModule(Reflection::TypeRegistry* registry)
+{
+	registration.reset(new Reflection::ModuleRegistration(*registry, "particle_v1", Reflection::particle_v1_gen_refl_types, 1));
+}
+
+extern "C" __attribute__((visibility("default"))) Reflection::Type const* GetParticleType()
+{
+	return Reflection::GetType<Particle>();
+}
+
+// fills count particles the host allocated, each one targets the next
+extern "C" __attribute__((visibility("default"))) void InitParticles(void* storage, Reflection::Size count)
+{
+	auto particles = static_cast<Particle*>(storage);
+	for (Reflection::Size i = 0; i < count; ++i)
+	{
+		particles[i].position[0] = static_cast<float>(i);
+		particles[i].position[1] = 1.0f;
+		particles[i].position[2] = -1.0f;
+		particles[i].mass = 0.5f * i;
+		particles[i].id = static_cast<int32_t>(i) - 2;
+		particles[i].target = &particles[(i + 1) % count];
+	}
+}
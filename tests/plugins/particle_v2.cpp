@@ -0,0 +1,61 @@
+// second version of the plugin type in particle_v1.cpp: fields reordered and widened, charge added
+#include "type_registry.hpp"
+
+STRUCT(Particle)
+{
+	FIELD() int64_t id;
+	FIELD() Particle* target;
+	FIELD() double mass;
+	FIELD() float charge;
+	FIELD() float position[3];
+};
+
+// reflection in the form meta_gen emits it
+namespace Reflection
+{
+	DECLARE_TYPE(float[3]);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Particle>) noexcept;
+
+	DECLARE_TYPE(Particle*);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Particle>) noexcept
+	{
+		static TypeStorage<Particle, 5, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<int64_t>();
+			typeStorage.fields[0] = Reflection::Field("Particle::id", &field_0_Type, offsetof(Particle, Particle::id), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<Particle*>();
+			typeStorage.fields[1] = Reflection::Field("Particle::target", &field_1_Type, offsetof(Particle, Particle::target), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_2_Type = *GetType<double>();
+			typeStorage.fields[2] = Reflection::Field("Particle::mass", &field_2_Type, offsetof(Particle, Particle::mass), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_3_Type = *GetType<float>();
+			typeStorage.fields[3] = Reflection::Field("Particle::charge", &field_3_Type, offsetof(Particle, Particle::charge), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_4_Type = *GetType<float[3]>();
+			typeStorage.fields[4] = Reflection::Field("Particle::position", &field_4_Type, offsetof(Particle, Particle::position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingMap const paddingMap = { nullptr, 0, 0 };
+		static Type type("Particle", sizeof(Particle), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	constexpr TypeGetter particle_v2_gen_refl_types[] = { &GetType<Particle> };
+}
+
+// built with hidden visibility, so that the Particle of each version stays its own; the host
+// passes its registry in, unloading the plugin unregisters the module
+static std::unique_ptr<Reflection::ModuleRegistration> registration;
+
+extern "C" __attribute__((visibility("default"))) void AttachParticleModule(Reflection::TypeRegistry* registry)
+{
+	registration.reset(new Reflection::ModuleRegistration(*registry, "particle_v2", Reflection::particle_v2_gen_refl_types, 1));
+}
+
+extern "C" __attribute__((visibility("default"))) Reflection::Type const* GetParticleType()
+{
+	return Reflection::GetType<Particle>();
+}
@@ -0,0 +1,211 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <limits>
+
+#include "schema.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// two versions of a record, reflected by hand: the second one widens id and inner.b, turns
+	// weight into a double, reorders the fields of Record and Inner, drops removed and adds
+	// added and inner.c
+	struct InnerV1
+	{
+		int32_t a;
+		int16_t b;
+	};
+
+	struct RecordV1
+	{
+		int16_t id;
+		float weight;
+		InnerV1 inner;
+		uint8_t removed;
+	};
+
+	struct InnerV2
+	{
+		int64_t b;
+		int32_t c;
+		int32_t a;
+	};
+
+	struct RecordV2
+	{
+		InnerV2 inner;
+		int32_t added;
+		double weight;
+		int64_t id;
+	};
+
+	Field MakeField(char const* name, Type const* type, Offset offset)
+	{
+		return Field(name, type, offset, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+	}
+
+	Field innerV1Fields[3] = {
+		MakeField("Inner::a", GetType<int32_t>(), offsetof(InnerV1, a)),
+		MakeField("Inner::b", GetType<int16_t>(), offsetof(InnerV1, b)),
+		Field()
+	};
+	Type innerV1Type("Inner", sizeof(InnerV1), TypeSpecifierType::kStruct, innerV1Fields, 2, nullptr, 0);
+
+	Field recordV1Fields[5] = {
+		MakeField("Record::id", GetType<int16_t>(), offsetof(RecordV1, id)),
+		MakeField("Record::weight", GetType<float>(), offsetof(RecordV1, weight)),
+		MakeField("Record::inner", &innerV1Type, offsetof(RecordV1, inner)),
+		MakeField("Record::removed", GetType<uint8_t>(), offsetof(RecordV1, removed)),
+		Field()
+	};
+	Type recordV1Type("Record", sizeof(RecordV1), TypeSpecifierType::kStruct, recordV1Fields, 4, nullptr, 0);
+
+	Field innerV2Fields[4] = {
+		MakeField("Inner::b", GetType<int64_t>(), offsetof(InnerV2, b)),
+		MakeField("Inner::c", GetType<int32_t>(), offsetof(InnerV2, c)),
+		MakeField("Inner::a", GetType<int32_t>(), offsetof(InnerV2, a)),
+		Field()
+	};
+	Type innerV2Type("Inner", sizeof(InnerV2), TypeSpecifierType::kStruct, innerV2Fields, 3, nullptr, 0);
+
+	Field recordV2Fields[5] = {
+		MakeField("Record::inner", &innerV2Type, offsetof(RecordV2, inner)),
+		MakeField("Record::added", GetType<int32_t>(), offsetof(RecordV2, added)),
+		MakeField("Record::weight", GetType<double>(), offsetof(RecordV2, weight)),
+		MakeField("Record::id", GetType<int64_t>(), offsetof(RecordV2, id)),
+		Field()
+	};
+	Type recordV2Type("Record", sizeof(RecordV2), TypeSpecifierType::kStruct, recordV2Fields, 4, nullptr, 0);
+
+	template<typename Target, typename Source>
+	Target Convert(Source value)
+	{
+		ConversionOp op;
+		op.kind = ConversionOpKind::kConvert;
+		op.source_kind = GetNumericKindOf<Source>();
+		op.target_kind = GetNumericKindOf<Target>();
+		op.source_offset = 0;
+		op.source_size = sizeof(Source);
+		op.target_offset = 0;
+		op.target_indirection = kNoIndirection;
+		op.target_type = GetType<Target>();
+
+		Target target;
+		std::memset(&target, 0xFF, sizeof(target));
+		ConvertNumeric(op, reinterpret_cast<Byte const*>(&value), reinterpret_cast<BytePointer>(&target));
+		return target;
+	}
+}
+
+TEST_CASE("Schema blobs of the current type are read directly", "[schema]")
+{
+	Sample source = {};
+	source.id = 7;
+	source.position = Vec3{ 1.0f, 2.0f, 3.0f };
+	source.weights[2] = 0.5;
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeWithSchema(source, os));
+
+	Sample target = {};
+	REQUIRE(DeserializeWithSchema(target, os.GetData(), os.GetSize()));
+	CHECK(target.id == 7);
+	CHECK(target.position.z == 3.0f);
+	CHECK(target.weights[2] == 0.5);
+}
+
+TEST_CASE("Schema conversion matches added, removed, reordered, widened and nested fields", "[schema]")
+{
+	REQUIRE(innerV1Type.GetFingerprint() != innerV2Type.GetFingerprint());
+
+	RecordV1 source = {};
+	source.id = -1234;
+	source.weight = 2.5f;
+	source.inner.a = 100000;
+	source.inner.b = -300;
+	source.removed = 9;
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeWithSchema(&recordV1Type, &source, os));
+
+	RecordV2 target;
+	std::memset(&target, 0x5A, sizeof(target));
+	REQUIRE(DeserializeWithSchema(&recordV2Type, &target, os.GetData(), os.GetSize()));
+	CHECK(target.id == -1234);
+	CHECK(target.weight == 2.5);
+	CHECK(target.added == 0);
+	CHECK(target.inner.a == 100000);
+	CHECK(target.inner.b == -300);
+	CHECK(target.inner.c == 0);
+
+	// and back, the narrowed fields keep their values
+	os.Clear();
+	REQUIRE(SerializeWithSchema(&recordV2Type, &target, os));
+	RecordV1 back;
+	std::memset(&back, 0x5A, sizeof(back));
+	REQUIRE(DeserializeWithSchema(&recordV1Type, &back, os.GetData(), os.GetSize()));
+	CHECK(back.id == -1234);
+	CHECK(back.weight == 2.5f);
+	CHECK(back.inner.a == 100000);
+	CHECK(back.inner.b == -300);
+	CHECK(back.removed == 0);
+}
+
+TEST_CASE("Schema headers with a truncated nested field list are rejected", "[schema]")
+{
+	RecordV1 source = {};
+	MemoryOutputStream os;
+	REQUIRE(SerializeWithSchema(&recordV1Type, &source, os));
+
+	std::vector<SchemaField> fields;
+	Size headerSize = GetSchemaHeaderSize(&recordV1Type);
+	REQUIRE(ReadSchemaFields(os.GetData(), headerSize, fields));
+	REQUIRE(fields.size() == 4);
+	REQUIRE(fields[2].fields.size() == 2);
+	CHECK(fields[2].fields[1].offset == fields[2].offset + sizeof(int32_t));
+
+	CHECK_FALSE(ReadSchemaFields(os.GetData(), headerSize - 1, fields));
+}
+
+TEST_CASE("Floating point values saturate when converted to integers", "[schema]")
+{
+	CHECK(Convert<int32_t>(1e30) == std::numeric_limits<int32_t>::max());
+	CHECK(Convert<int32_t>(-1e30) == std::numeric_limits<int32_t>::min());
+	CHECK(Convert<int32_t>(-2.75) == -2);
+	CHECK(Convert<int64_t>(9.3e18) == std::numeric_limits<int64_t>::max());
+	CHECK(Convert<int64_t>(-9.3e18) == std::numeric_limits<int64_t>::min());
+	CHECK(Convert<int64_t>(-9223372036854775808.0) == std::numeric_limits<int64_t>::min());
+	CHECK(Convert<uint8_t>(300.7f) == 255);
+	CHECK(Convert<uint16_t>(-1.5) == 0);
+	CHECK(Convert<uint32_t>(-0.5) == 0);
+	CHECK(Convert<uint64_t>(1.9e19) == std::numeric_limits<uint64_t>::max());
+	CHECK(Convert<uint64_t>(1.8e19) == 18000000000000000000ull);
+	CHECK(Convert<int32_t>(std::numeric_limits<double>::quiet_NaN()) == 0);
+	CHECK(Convert<uint32_t>(std::numeric_limits<float>::infinity()) == std::numeric_limits<uint32_t>::max());
+}
+
+TEST_CASE("Conversions to bool store 0 or 1", "[schema]")
+{
+	auto check = [](bool value, uint8_t expected)
+	{
+		uint8_t byte;
+		std::memcpy(&byte, &value, 1);
+		CHECK(byte == expected);
+	};
+
+	check(Convert<bool>(int32_t(2)), 1);
+	check(Convert<bool>(uint16_t(256)), 1);
+	check(Convert<bool>(int8_t(0)), 0);
+	check(Convert<bool>(0.25), 1);
+	check(Convert<bool>(-0.0f), 0);
+}
+
+TEST_CASE("Plain char takes the signedness of the platform", "[schema]")
+{
+	CHECK(GetNumericKindByName("char") == GetNumericKindOf<char>());
+	CHECK(GetNumericKindByName("signed char") == NumericKind::kSigned);
+	CHECK(GetNumericKindByName("unsigned char") == NumericKind::kUnsigned);
+}
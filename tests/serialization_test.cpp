@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+
+#include "serialization.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	Sample MakeSample()
+	{
+		Sample sample;
+		sample.flag = 7;
+		sample.id = -42;
+		sample.position = Vec3{ 1.5f, -2.0f, 3.25f };
+		sample.weights[0] = 0.5;
+		sample.weights[1] = -1.0;
+		sample.weights[2] = 1e300;
+		return sample;
+	}
+
+	bool SameValues(Sample const& a, Sample const& b)
+	{
+		return a.flag == b.flag && a.id == b.id &&
+			a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+			a.weights[0] == b.weights[0] && a.weights[1] == b.weights[1] && a.weights[2] == b.weights[2];
+	}
+
+	// returns the first split point and then the rest, the stream reports "would block" in between
+	class SplitInputStream : public InputStream
+	{
+	private:
+		Byte const* data;
+		Size size;
+		Size split;
+		Size position;
+		bool blocked;
+
+	public:
+		SplitInputStream(void const* _data, Size _size, Size _split) :
+			data(static_cast<Byte const*>(_data)), size(_size), split(_split), position(0), blocked(false)
+		{}
+
+		Size Read(void* buffer, Size length) override
+		{
+			Size end = position < split ? split : size;
+			if (position == split && !blocked)
+			{
+				blocked = true;
+				return 0;
+			}
+			Size count = length < end - position ? length : end - position;
+			REFL_MEMCPY(buffer, data + position, count);
+			position += count;
+			return count;
+		}
+
+		bool IsClosed() const override { return position == size; }
+	};
+}
+
+TEST_CASE("Feed accepts the input split at every byte", "[serialization]")
+{
+	Sample source = MakeSample();
+	MemoryOutputStream os;
+	REQUIRE(Serialize(source, os));
+	REQUIRE(os.GetSize() == GetSerializedSize(GetType<Sample>()));
+
+	for (Size split = 0; split <= os.GetSize(); ++split)
+	{
+		Sample target{};
+		IncrementalDeserializer deserializer(GetType<Sample>(), &target);
+		Size consumed = 0;
+		auto status = deserializer.Feed(os.GetData(), split, &consumed);
+		CHECK(consumed == split);
+		CHECK(status == (split == os.GetSize() ? DeserializeStatus::kDone : DeserializeStatus::kNeedMoreData));
+		REQUIRE(deserializer.Feed(os.GetData() + split, os.GetSize() - split) == DeserializeStatus::kDone);
+		CHECK(SameValues(source, target));
+	}
+}
+
+TEST_CASE("Pump resumes after a stream split at every byte", "[serialization]")
+{
+	Sample source = MakeSample();
+	MemoryOutputStream os;
+	REQUIRE(Serialize(source, os));
+
+	for (Size split = 0; split <= os.GetSize(); ++split)
+	{
+		Sample target{};
+		SplitInputStream stream(os.GetData(), os.GetSize(), split);
+		IncrementalDeserializer deserializer(GetType<Sample>(), &target);
+		Size polls = 0;
+		DeserializeStatus status;
+		while ((status = deserializer.Pump(stream)) == DeserializeStatus::kNeedMoreData)
+		{
+			REQUIRE(++polls < 4);
+		}
+		REQUIRE(status == DeserializeStatus::kDone);
+		CHECK(SameValues(source, target));
+	}
+}
+
+TEST_CASE("Pump over a chunked memory stream", "[serialization]")
+{
+	Sample source = MakeSample();
+	MemoryOutputStream os;
+	REQUIRE(Serialize(source, os));
+
+	for (Size chunk = 1; chunk <= os.GetSize(); ++chunk)
+	{
+		Sample target{};
+		MemoryInputStream stream(os.GetData(), os.GetSize(), chunk);
+		IncrementalDeserializer deserializer(GetType<Sample>(), &target);
+		DeserializeStatus status;
+		while ((status = deserializer.Pump(stream)) == DeserializeStatus::kNeedMoreData)
+		{
+		}
+		REQUIRE(status == DeserializeStatus::kDone);
+		CHECK(stream.GetPosition() == os.GetSize());
+		CHECK(SameValues(source, target));
+	}
+}
+
+TEST_CASE("Pump reports a stream closed before the object is complete", "[serialization]")
+{
+	Sample source = MakeSample();
+	MemoryOutputStream os;
+	REQUIRE(Serialize(source, os));
+
+	for (Size length = 0; length < os.GetSize(); ++length)
+	{
+		Sample target{};
+		MemoryInputStream stream(os.GetData(), length, 5);
+		IncrementalDeserializer deserializer(GetType<Sample>(), &target);
+		DeserializeStatus status;
+		Size polls = 0;
+		while ((status = deserializer.Pump(stream)) == DeserializeStatus::kNeedMoreData)
+		{
+			REQUIRE(++polls <= os.GetSize());
+		}
+		CHECK(status == DeserializeStatus::kTruncated);
+		CHECK_FALSE(deserializer.IsDone());
+	}
+}
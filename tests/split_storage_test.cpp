@@ -0,0 +1,254 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <string>
+
+#include "byte_order.hpp"
+#include "columnar_export.hpp"
+#include "compact_serialization.hpp"
+#include "memory_footprint.hpp"
+#include "object_graph.hpp"
+#include "object_store.hpp"
+#include "parallel_serialization.hpp"
+#include "schema.hpp"
+#include "split_storage.hpp"
+#include "test_types.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	typedef SplitStorage<Entity> SplitEntity;
+
+	Entity MakeEntity(int32_t id)
+	{
+		Entity entity = {};
+		entity.position = Vec3{ 1.0f * id, 2.0f, 3.0f };
+		entity.velocity = Vec3{ -1.0f, 0.5f, 0.25f * id };
+		std::snprintf(entity.name, sizeof(entity.name), "entity %d", id);
+		entity.created = 1234.5 + id;
+		entity.id = id;
+		return entity;
+	}
+
+	bool SameValues(Entity const& a, Entity const& b)
+	{
+		return std::memcmp(&a.position, &b.position, sizeof(a.position)) == 0 &&
+			std::memcmp(&a.velocity, &b.velocity, sizeof(a.velocity)) == 0 &&
+			std::strcmp(a.name, b.name) == 0 && a.created == b.created && a.id == b.id;
+	}
+
+	Entity Join(SplitArray<Entity> const& entities, Size index)
+	{
+		Entity entity = {};
+		entities.Join(index, entity);
+		return entity;
+	}
+}
+
+TEST_CASE("Split types expose their cold fields through the side allocation", "[split_storage]")
+{
+	Entity plain = MakeEntity(3);
+	SplitArray<Entity> entities(&plain, 1);
+
+	auto type = GetType<SplitEntity>();
+	CHECK(HasIndirectFields(type));
+	CHECK_FALSE(HasIndirectFields(GetType<Entity>()));
+	CHECK(type->GetField("created")->GetValue<double>(&entities[0]) == plain.created);
+	CHECK(entities[0].cold->created == plain.created);
+	CHECK(SameValues(Join(entities, 0), plain));
+}
+
+TEST_CASE("Split types round trip through the binary serializer", "[split_storage]")
+{
+	Entity plain = MakeEntity(1);
+	SplitArray<Entity> entities(&plain, 1);
+
+	MemoryOutputStream split;
+	MemoryOutputStream unsplit;
+	REQUIRE(Serialize(entities[0], split));
+	REQUIRE(Serialize(plain, unsplit));
+	REQUIRE(split.GetSize() == unsplit.GetSize());
+	CHECK(std::memcmp(split.GetData(), unsplit.GetData(), split.GetSize()) == 0);
+
+	SplitArray<Entity> loaded(1);
+	REQUIRE(Deserialize(loaded[0], split.GetData(), split.GetSize()));
+	CHECK(SameValues(Join(loaded, 0), plain));
+}
+
+TEST_CASE("Split types round trip through schema conversion", "[split_storage]")
+{
+	Entity plain = MakeEntity(2);
+	SplitArray<Entity> entities(&plain, 1);
+
+	SECTION("same type")
+	{
+		MemoryOutputStream os;
+		REQUIRE(SerializeWithSchema(entities[0], os));
+		SplitArray<Entity> loaded(1);
+		REQUIRE(DeserializeWithSchema(loaded[0], os.GetData(), os.GetSize()));
+		CHECK(SameValues(Join(loaded, 0), plain));
+	}
+
+	SECTION("plain blob into the split layout")
+	{
+		MemoryOutputStream os;
+		REQUIRE(SerializeWithSchema(plain, os));
+		SplitArray<Entity> loaded(1);
+		REQUIRE(DeserializeWithSchema(loaded[0], os.GetData(), os.GetSize()));
+		CHECK(SameValues(Join(loaded, 0), plain));
+	}
+
+	SECTION("split blob into the plain layout")
+	{
+		MemoryOutputStream os;
+		REQUIRE(SerializeWithSchema(entities[0], os));
+		Entity loaded = {};
+		REQUIRE(DeserializeWithSchema(loaded, os.GetData(), os.GetSize()));
+		CHECK(SameValues(loaded, plain));
+	}
+}
+
+TEST_CASE("Split types round trip through the compact serializer", "[split_storage]")
+{
+	Entity plain[2] = { MakeEntity(4), MakeEntity(5) };
+	SplitArray<Entity> entities(plain, 2);
+
+	std::vector<Byte> out;
+	SerializeCompact(entities[1], out, &entities[0]);
+	SplitArray<Entity> loaded(plain, 2);
+	REQUIRE(DeserializeCompact(loaded[1], out.data(), out.size(), &loaded[0]));
+	CHECK(SameValues(Join(loaded, 1), plain[1]));
+}
+
+TEST_CASE("Compact serialization refuses split objects without a side allocation", "[split_storage]")
+{
+	Entity plain[2] = { MakeEntity(4), MakeEntity(5) };
+	SplitArray<Entity> entities(plain, 2);
+	SplitEntity detached = entities[1];
+	detached.cold = nullptr;
+
+	std::vector<Byte> out(2, 1);
+	CHECK_FALSE(SerializeCompact(detached, out));
+	CHECK_FALSE(SerializeCompact(entities[1], out, &detached));
+	CHECK(out == std::vector<Byte>(2, 1));
+
+	REQUIRE(SerializeCompact(entities[1], out));
+	CHECK_FALSE(DeserializeCompact(detached, out.data() + 2, out.size() - 2));
+
+	std::vector<SplitEntity> objects = { entities[0], detached, entities[1] };
+	ThreadPool pool(2);
+	out.assign(2, 1);
+	CHECK_FALSE(SerializeArrayParallel(pool, objects.data(), objects.size(), out, WireFormat::kCompact, 1));
+	CHECK(out == std::vector<Byte>(2, 1));
+}
+
+TEST_CASE("Split types round trip through byte order conversion", "[split_storage]")
+{
+	Entity plain[3] = { MakeEntity(6), MakeEntity(7), MakeEntity(8) };
+	SplitArray<Entity> entities(plain, 3);
+	ByteOrder other = ByteOrder::kNative == ByteOrder::kLittle ? ByteOrder::kBig : ByteOrder::kLittle;
+
+	ConvertByteOrder(GetType<SplitEntity>(), entities.GetData(), 3, other);
+	Entity swapped[3] = { MakeEntity(6), MakeEntity(7), MakeEntity(8) };
+	ConvertByteOrder(GetType<Entity>(), swapped, 3, other);
+	for (Size i = 0; i < 3; ++i)
+	{
+		CHECK(std::memcmp(&entities[i].cold->created, &swapped[i].created, sizeof(double)) == 0);
+		CHECK(entities[i].id == swapped[i].id);
+		CHECK(std::memcmp(&entities[i].velocity, &swapped[i].velocity, sizeof(Vec3)) == 0);
+	}
+
+	ConvertByteOrder(GetType<SplitEntity>(), entities.GetData(), 3, other);
+	for (Size i = 0; i < 3; ++i)
+	{
+		CHECK(SameValues(Join(entities, i), plain[i]));
+	}
+
+	MemoryOutputStream os;
+	REQUIRE(SerializeArray(entities.GetData(), 3, os, other));
+	SplitArray<Entity> loaded(3);
+	REQUIRE(DeserializeArray(loaded.GetData(), 3, os.GetData(), os.GetSize(), other));
+	for (Size i = 0; i < 3; ++i)
+	{
+		CHECK(SameValues(Join(loaded, i), plain[i]));
+	}
+}
+
+TEST_CASE("Split types are exported with their cold columns", "[split_storage]")
+{
+	Entity plain[3] = { MakeEntity(1), MakeEntity(2), MakeEntity(3) };
+	SplitArray<Entity> entities(plain, 3);
+
+	auto columns = BuildColumnSchema(GetType<SplitEntity>());
+	auto plainColumns = BuildColumnSchema(GetType<Entity>());
+	REQUIRE(columns.size() == plainColumns.size());
+	for (Size i = 0; i < columns.size(); ++i)
+	{
+		CHECK(columns[i].name == plainColumns[i].name);
+	}
+
+	MemoryOutputStream split;
+	MemoryOutputStream unsplit;
+	ColumnarExporter splitExporter(GetType<SplitEntity>(), split, 2);
+	ColumnarExporter plainExporter(GetType<Entity>(), unsplit, 2);
+	REQUIRE(splitExporter.Write(entities.GetData(), 3));
+	REQUIRE(plainExporter.Write(plain, 3));
+	REQUIRE(splitExporter.Finish());
+	REQUIRE(plainExporter.Finish());
+	REQUIRE(split.GetSize() == unsplit.GetSize());
+	CHECK(std::memcmp(split.GetData(), unsplit.GetData(), split.GetSize()) == 0);
+
+	// without its side allocation an object has empty cold cells
+	SplitEntity detached = entities[0];
+	detached.cold = nullptr;
+	detached.id = 4;
+	MemoryOutputStream csv;
+	CsvExporter csvExporter(GetType<SplitEntity>(), csv);
+	REQUIRE(csvExporter.Write(&entities[0], 1));
+	REQUIRE(csvExporter.Write(&detached, 1));
+	REQUIRE(csvExporter.Flush());
+
+	std::string text(reinterpret_cast<char const*>(csv.GetData()), csv.GetSize());
+	auto first = text.substr(0, text.find('\n') + 1);
+	auto second = text.substr(first.size());
+	std::string created = ",1235.5,1\n";
+	std::string missing = std::string(34, ',') + "4\n";
+	CHECK(first.compare(first.size() - created.size(), created.size(), created) == 0);
+	CHECK(second.compare(second.size() - missing.size(), missing.size(), missing) == 0);
+}
+
+TEST_CASE("Deep size counts the side allocations of split objects", "[split_storage]")
+{
+	Entity plain[3] = { MakeEntity(1), MakeEntity(2), MakeEntity(3) };
+	SplitArray<Entity> entities(plain, 3);
+	auto type = GetType<SplitEntity>();
+	CHECK(GetSideSize(type, offsetof(SplitEntity, cold)) == sizeof(SplitEntity::Cold));
+
+	FootprintReport report;
+	CHECK(DeepSize(entities.GetData(), 3, &report) == 3 * (sizeof(SplitEntity) + sizeof(SplitEntity::Cold)));
+	CHECK(report.GetTotal().side_bytes == 3 * sizeof(SplitEntity::Cold));
+
+	// a shared side allocation is counted once, a missing one not at all
+	entities[1].cold = entities[0].cold;
+	entities[2].cold = nullptr;
+	report = FootprintReport();
+	CHECK(DeepSize(entities.GetData(), 3, &report) == 3 * sizeof(SplitEntity) + sizeof(SplitEntity::Cold));
+
+	ThreadPool pool(2);
+	CHECK(DeepSizeParallel(pool, type, entities.GetData(), 3, nullptr, 1) == 3 * sizeof(SplitEntity) + sizeof(SplitEntity::Cold));
+}
+
+TEST_CASE("Engines that can not give a split object its side allocation refuse it", "[split_storage]")
+{
+	Entity plain = MakeEntity(9);
+	SplitArray<Entity> entities(&plain, 1);
+
+	MemoryOutputStream os;
+	CHECK_FALSE(SerializeGraph(entities[0], os));
+
+	ObjectStoreWriter writer;
+	CHECK_FALSE(writer.Open("split_storage_store.bin", GetType<SplitEntity>()));
+	ObjectStoreReader reader;
+	CHECK_FALSE(reader.Open("split_storage_store.bin", GetType<SplitEntity>()));
+}
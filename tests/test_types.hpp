@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+#include "reflection.hpp"
+
+STRUCT(Vec3)
+{
+	FIELD() float x;
+	FIELD() float y;
+	FIELD() float z;
+};
+
+// padded, so it is serialized field by field
+STRUCT(Sample)
+{
+	FIELD() uint8_t flag;
+	FIELD() int32_t id;
+	FIELD() Vec3 position;
+	FIELD() double weights[3];
+};
+
+STRUCT(Node)
+{
+	FIELD() int32_t value;
+	FIELD() Node* next;
+};
+
+// points at objects of two different types
+STRUCT(Holder)
+{
+	FIELD() Node* node;
+	FIELD() Vec3* vec;
+	FIELD() int32_t tag;
+};
+
+// split by meta_gen into SplitStorage<Entity>, see test_types_gen_refl.h
+STRUCT(Entity)
+{
+	FIELD(hot) Vec3 position;
+	FIELD(hot) Vec3 velocity;
+	FIELD(cold) char name[32];
+	FIELD(cold) double created;
+	FIELD() int32_t id;
+};
+
+#include "test_types_gen_refl.h"
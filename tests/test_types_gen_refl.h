@@ -0,0 +1,200 @@
+// reflection of test_types.hpp, written by hand as meta_gen prints it (PrintType, PrintLayoutAsserts
+// and PrintSplitStorage) because the tests are built without Clang; keep the two in step
+#pragma once
+#include "reflection.hpp"
+
+namespace Reflection
+{
+	template<>
+	inline Type const* GetTypeImpl(Tag<Vec3>) noexcept
+	{
+		static TypeStorage<Vec3, 3, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<float>();
+			typeStorage.fields[0] = Reflection::Field("Vec3::x", &field_0_Type, offsetof(Vec3, Vec3::x), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<float>();
+			typeStorage.fields[1] = Reflection::Field("Vec3::y", &field_1_Type, offsetof(Vec3, Vec3::y), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_2_Type = *GetType<float>();
+			typeStorage.fields[2] = Reflection::Field("Vec3::z", &field_2_Type, offsetof(Vec3, Vec3::z), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingMap const paddingMap = { nullptr, 0, 0 };
+		static Type type("Vec3", sizeof(Vec3), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	static_assert(sizeof(Vec3) == 12, "layout of Vec3 changed, regenerate reflection");
+	static_assert(alignof(Vec3) == 4, "layout of Vec3 changed, regenerate reflection");
+	static_assert(std::is_trivially_copyable<Vec3>::value, "layout of Vec3 changed, regenerate reflection");
+	static_assert(std::is_standard_layout<Vec3>::value, "layout of Vec3 changed, regenerate reflection");
+	static_assert(offsetof(Vec3, Vec3::x) == 0, "layout of Vec3 changed, regenerate reflection");
+	static_assert(offsetof(Vec3, Vec3::y) == 4, "layout of Vec3 changed, regenerate reflection");
+	static_assert(offsetof(Vec3, Vec3::z) == 8, "layout of Vec3 changed, regenerate reflection");
+
+	DECLARE_TYPE(double[3]);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Sample>) noexcept
+	{
+		static TypeStorage<Sample, 4, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<uint8_t>();
+			typeStorage.fields[0] = Reflection::Field("Sample::flag", &field_0_Type, offsetof(Sample, Sample::flag), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<int32_t>();
+			typeStorage.fields[1] = Reflection::Field("Sample::id", &field_1_Type, offsetof(Sample, Sample::id), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_2_Type = *GetType<Vec3>();
+			typeStorage.fields[2] = Reflection::Field("Sample::position", &field_2_Type, offsetof(Sample, Sample::position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_3_Type = *GetType<double[3]>();
+			typeStorage.fields[3] = Reflection::Field("Sample::weights", &field_3_Type, offsetof(Sample, Sample::weights), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingHole const paddingHoles[] = { { 1, 3 }, { 20, 4 } };
+		static PaddingMap const paddingMap = { paddingHoles, 2, 7 };
+		static Type type("Sample", sizeof(Sample), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	static_assert(sizeof(Sample) == 48, "layout of Sample changed, regenerate reflection");
+	static_assert(alignof(Sample) == 8, "layout of Sample changed, regenerate reflection");
+	static_assert(std::is_trivially_copyable<Sample>::value, "layout of Sample changed, regenerate reflection");
+	static_assert(std::is_standard_layout<Sample>::value, "layout of Sample changed, regenerate reflection");
+	static_assert(offsetof(Sample, Sample::flag) == 0, "layout of Sample changed, regenerate reflection");
+	static_assert(offsetof(Sample, Sample::id) == 4, "layout of Sample changed, regenerate reflection");
+	static_assert(offsetof(Sample, Sample::position) == 8, "layout of Sample changed, regenerate reflection");
+	static_assert(offsetof(Sample, Sample::weights) == 24, "layout of Sample changed, regenerate reflection");
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Node>) noexcept;
+
+	DECLARE_TYPE(Node*);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Node>) noexcept
+	{
+		static TypeStorage<Node, 2, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<int32_t>();
+			typeStorage.fields[0] = Reflection::Field("Node::value", &field_0_Type, offsetof(Node, Node::value), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<Node*>();
+			typeStorage.fields[1] = Reflection::Field("Node::next", &field_1_Type, offsetof(Node, Node::next), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingHole const paddingHoles[] = { { 4, 4 } };
+		static PaddingMap const paddingMap = { paddingHoles, 1, 4 };
+		static Type type("Node", sizeof(Node), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	static_assert(sizeof(Node) == 16, "layout of Node changed, regenerate reflection");
+	static_assert(alignof(Node) == 8, "layout of Node changed, regenerate reflection");
+	static_assert(std::is_trivially_copyable<Node>::value, "layout of Node changed, regenerate reflection");
+	static_assert(std::is_standard_layout<Node>::value, "layout of Node changed, regenerate reflection");
+	static_assert(offsetof(Node, Node::value) == 0, "layout of Node changed, regenerate reflection");
+	static_assert(offsetof(Node, Node::next) == 8, "layout of Node changed, regenerate reflection");
+
+	DECLARE_TYPE(Vec3*);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Holder>) noexcept
+	{
+		static TypeStorage<Holder, 3, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<Node*>();
+			typeStorage.fields[0] = Reflection::Field("Holder::node", &field_0_Type, offsetof(Holder, Holder::node), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_1_Type = *GetType<Vec3*>();
+			typeStorage.fields[1] = Reflection::Field("Holder::vec", &field_1_Type, offsetof(Holder, Holder::vec), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			static Type field_2_Type = *GetType<int32_t>();
+			typeStorage.fields[2] = Reflection::Field("Holder::tag", &field_2_Type, offsetof(Holder, Holder::tag), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingHole const paddingHoles[] = { { 20, 4 } };
+		static PaddingMap const paddingMap = { paddingHoles, 1, 4 };
+		static Type type("Holder", sizeof(Holder), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	static_assert(sizeof(Holder) == 24, "layout of Holder changed, regenerate reflection");
+	static_assert(alignof(Holder) == 8, "layout of Holder changed, regenerate reflection");
+	static_assert(std::is_trivially_copyable<Holder>::value, "layout of Holder changed, regenerate reflection");
+	static_assert(std::is_standard_layout<Holder>::value, "layout of Holder changed, regenerate reflection");
+	static_assert(offsetof(Holder, Holder::node) == 0, "layout of Holder changed, regenerate reflection");
+	static_assert(offsetof(Holder, Holder::vec) == 8, "layout of Holder changed, regenerate reflection");
+	static_assert(offsetof(Holder, Holder::tag) == 16, "layout of Holder changed, regenerate reflection");
+
+	DECLARE_TYPE(char[32]);
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<Entity>) noexcept
+	{
+		static TypeStorage<Entity, 5, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<Vec3>();
+			typeStorage.fields[0] = Reflection::Field("Entity::position", &field_0_Type, offsetof(Entity, Entity::position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kHot, nullptr);
+			static Type field_1_Type = *GetType<Vec3>();
+			typeStorage.fields[1] = Reflection::Field("Entity::velocity", &field_1_Type, offsetof(Entity, Entity::velocity), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kHot, nullptr);
+			static Type field_2_Type = *GetType<char[32]>();
+			typeStorage.fields[2] = Reflection::Field("Entity::name", &field_2_Type, offsetof(Entity, Entity::name), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kCold, nullptr);
+			static Type field_3_Type = *GetType<double>();
+			typeStorage.fields[3] = Reflection::Field("Entity::created", &field_3_Type, offsetof(Entity, Entity::created), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kCold, nullptr);
+			static Type field_4_Type = *GetType<int32_t>();
+			typeStorage.fields[4] = Reflection::Field("Entity::id", &field_4_Type, offsetof(Entity, Entity::id), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static PaddingHole const paddingHoles[] = { { 68, 4 } };
+		static PaddingMap const paddingMap = { paddingHoles, 1, 4 };
+		static Type type("Entity", sizeof(Entity), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum, Encoding::kDefault, &paddingMap, nullptr, AnnotationFlags::kNone, nullptr, TypeTraits::kTriviallyCopyable | TypeTraits::kStandardLayout | TypeTraits::kFieldsComplete);
+		return &type;
+	};
+
+	static_assert(sizeof(Entity) == 72, "layout of Entity changed, regenerate reflection");
+	static_assert(alignof(Entity) == 8, "layout of Entity changed, regenerate reflection");
+	static_assert(std::is_trivially_copyable<Entity>::value, "layout of Entity changed, regenerate reflection");
+	static_assert(std::is_standard_layout<Entity>::value, "layout of Entity changed, regenerate reflection");
+	static_assert(offsetof(Entity, Entity::position) == 0, "layout of Entity changed, regenerate reflection");
+	static_assert(offsetof(Entity, Entity::velocity) == 12, "layout of Entity changed, regenerate reflection");
+	static_assert(offsetof(Entity, Entity::name) == 24, "layout of Entity changed, regenerate reflection");
+	static_assert(offsetof(Entity, Entity::created) == 56, "layout of Entity changed, regenerate reflection");
+	static_assert(offsetof(Entity, Entity::id) == 64, "layout of Entity changed, regenerate reflection");
+
+	template<>
+	struct SplitStorage<Entity>
+	{
+		struct Cold
+		{
+			std::remove_cv<decltype(Entity::created)>::type created;
+			std::remove_cv<decltype(Entity::name)>::type name;
+		};
+
+		std::remove_cv<decltype(Entity::position)>::type position;
+		std::remove_cv<decltype(Entity::velocity)>::type velocity;
+		std::remove_cv<decltype(Entity::id)>::type id;
+		Cold* cold;
+	};
+
+	template<>
+	inline Type const* GetTypeImpl(Tag<SplitStorage<Entity>>) noexcept
+	{
+		static TypeStorage<SplitStorage<Entity>, 5, 0> typeStorage;
+		static bool initialized = [] {
+			static Type field_0_Type = *GetType<Vec3>();
+			typeStorage.fields[0] = Reflection::Field("Entity::position", &field_0_Type, offsetof(SplitStorage<Entity>, position), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kHot, nullptr);
+			static Type field_1_Type = *GetType<Vec3>();
+			typeStorage.fields[1] = Reflection::Field("Entity::velocity", &field_1_Type, offsetof(SplitStorage<Entity>, velocity), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, kNoIndirection, MemoryOrder::kSeqCst, AnnotationFlags::kHot, nullptr);
+			static Type field_2_Type = *GetType<char[32]>();
+			typeStorage.fields[2] = Reflection::Field("Entity::name", &field_2_Type, offsetof(SplitStorage<Entity>::Cold, name), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, offsetof(SplitStorage<Entity>, cold), MemoryOrder::kSeqCst, AnnotationFlags::kCold, nullptr);
+			static Type field_3_Type = *GetType<double>();
+			typeStorage.fields[3] = Reflection::Field("Entity::created", &field_3_Type, offsetof(SplitStorage<Entity>::Cold, created), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic, Encoding::kDefault, offsetof(SplitStorage<Entity>, cold), MemoryOrder::kSeqCst, AnnotationFlags::kCold, nullptr);
+			static Type field_4_Type = *GetType<int32_t>();
+			typeStorage.fields[4] = Reflection::Field("Entity::id", &field_4_Type, offsetof(SplitStorage<Entity>, id), CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic);
+			return true;
+		}();
+		(void)initialized;
+		static Type type("SplitStorage<Entity>", sizeof(SplitStorage<Entity>), TypeSpecifierType::kStruct, typeStorage.fields, typeStorage.kFieldsNum, typeStorage.methods, typeStorage.kMethodsNum);
+		return &type;
+	};
+}
@@ -0,0 +1,126 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test_types.hpp"
+#include "type_registry.hpp"
+
+using namespace Reflection;
+
+namespace
+{
+	// another definition of Vec3, as a plugin built against an older header would have it
+	Field otherVec3Fields[2] = {
+		Field("Vec3::x", GetType<float>(), 0, CVRQualifier::kNone, StorageClassSpecifier::kNone, ThreadStorageClassSpecifier::kUnSpecified, StorageDuration::kNone, AccessSpecifier::kPublic),
+		Field()
+	};
+	Type otherVec3Type("Vec3", sizeof(float), TypeSpecifierType::kStruct, otherVec3Fields, 1, nullptr, 0);
+
+	Type const* GetOtherVec3Type() { return &otherVec3Type; }
+
+	TypeGetter const hostTypes[] = { &GetType<Vec3>, &GetType<Node> };
+	TypeGetter const pluginTypes[] = { &GetType<Vec3>, &GetType<Sample> };
+	TypeGetter const conflictingTypes[] = { &GetOtherVec3Type };
+}
+
+TEST_CASE("Type registry finds types by name and fingerprint", "[type_registry]")
+{
+	TypeRegistry registry;
+	CHECK(registry.Find("Vec3") == nullptr);
+
+	REQUIRE(registry.RegisterModule(TypeModule{ "host", hostTypes, 2 }));
+	CHECK(registry.Find("Vec3") == GetType<Vec3>());
+	CHECK(registry.Find("Node") == GetType<Node>());
+	CHECK(registry.Find(GetType<Node>()->GetFingerprint()) == GetType<Node>());
+	CHECK(registry.Find("Sample") == nullptr);
+
+	TypeRegistry::Reader reader(registry);
+	CHECK(reader->GetTypesLength() == 2);
+	CHECK(std::strcmp(reader->FindModule("Vec3"), "host") == 0);
+}
+
+TEST_CASE("Type registry reports duplicate and conflicting definitions", "[type_registry]")
+{
+	TypeRegistry registry;
+	REQUIRE(registry.RegisterModule(TypeModule{ "host", hostTypes, 2 }));
+
+	std::vector<TypeCollision> collisions;
+	REQUIRE(registry.RegisterModule(TypeModule{ "plugin", pluginTypes, 2 }, &collisions));
+	REQUIRE(collisions.size() == 1);
+	CHECK(collisions[0].kind == TypeCollisionKind::kDuplicate);
+	CHECK(std::strcmp(collisions[0].type_name, "Vec3") == 0);
+	CHECK(collisions[0].visible_module == "host");
+	CHECK(collisions[0].hidden_module == "plugin");
+	CHECK(registry.Find("Sample") == GetType<Sample>());
+
+	collisions.clear();
+	REQUIRE(registry.RegisterModule(TypeModule{ "old_plugin", conflictingTypes, 1 }, &collisions));
+	REQUIRE(collisions.size() == 1);
+	CHECK(collisions[0].kind == TypeCollisionKind::kConflict);
+	CHECK(collisions[0].hidden_module == "old_plugin");
+	CHECK(collisions[0].hidden_fingerprint == otherVec3Type.GetFingerprint());
+	CHECK(registry.Find("Vec3") == GetType<Vec3>());
+
+	// once the first definition is gone the next module in registration order provides it
+	REQUIRE(registry.UnregisterModule("host"));
+	CHECK(registry.Find("Node") == nullptr);
+	TypeRegistry::Reader reader(registry);
+	CHECK(std::strcmp(reader->FindModule("Vec3"), "plugin") == 0);
+	CHECK_FALSE(registry.UnregisterModule("host"));
+}
+
+TEST_CASE("A module registration under a taken name leaves the owner registered", "[type_registry]")
+{
+	TypeRegistry registry;
+	ModuleRegistration host(registry, "host", hostTypes, 2);
+	REQUIRE(host.IsRegistered());
+
+	{
+		ModuleRegistration impostor(registry, "host", pluginTypes, 2);
+		CHECK_FALSE(impostor.IsRegistered());
+		CHECK(registry.Find("Sample") == nullptr);
+	}
+
+	CHECK(registry.Find("Node") == GetType<Node>());
+}
+
+TEST_CASE("Type registry readers see whole snapshots while modules come and go", "[type_registry]")
+{
+	TypeRegistry registry;
+	REQUIRE(registry.RegisterModule(TypeModule{ "host", hostTypes, 2 }));
+
+	std::atomic<bool> stop(false);
+	std::atomic<Size> failures(0);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&]
+		{
+			while (!stop.load())
+			{
+				TypeRegistry::Reader reader(registry);
+				auto vec = reader->Find("Vec3");
+				auto sample = reader->Find("Sample");
+				// the plugin's types come and go together
+				bool whole = vec == GetType<Vec3>() && (sample == nullptr ? reader->GetTypesLength() == 2 : reader->GetTypesLength() == 3 && sample->GetSize() == sizeof(Sample));
+				failures += whole ? 0 : 1;
+			}
+		});
+	}
+
+	for (int i = 0; i < 200; ++i)
+	{
+		REQUIRE(registry.RegisterModule(TypeModule{ "plugin", pluginTypes, 2 }));
+		REQUIRE(registry.UnregisterModule("plugin"));
+	}
+
+	stop = true;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+	CHECK(failures == 0);
+	CHECK(registry.Find("Sample") == nullptr);
+}